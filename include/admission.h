@@ -0,0 +1,53 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum RoutePriority {
+  PRIORITY_LOW,     // Expensive responses: schedule, location, log and history reads
+  PRIORITY_NORMAL,
+  PRIORITY_HIGH     // The presence status the dashboard depends on
+};
+
+// Decides whether the web server takes on a request. Each client (by IP
+// address) has a token bucket, so one script polling in a tight loop is
+// slowed down without affecting anybody else, and a global cap on requests
+// in flight keeps a crowd of dashboards from starving loop(). Expensive
+// routes cost more tokens and see a lower cap, so /status is still served
+// while they are being turned away.
+class AdmissionControl {
+public:
+  enum Result {
+    ADMITTED,
+    RATE_LIMITED,  // The client used up its tokens
+    OVERLOADED     // Too many requests in flight
+  };
+
+  // retryAfter is set to the seconds to wait when the request is refused.
+  // An admitted request holds a slot until release() is called for it.
+  Result admit(uint32_t client, RoutePriority priority, unsigned long now, uint32_t& retryAfter);
+  void release();
+
+  static RoutePriority priorityFor(const char* path);
+
+  uint8_t activeRequests() const { return active; }
+  uint32_t rateLimited() const { return rejected[RATE_LIMITED]; }
+  uint32_t overloaded() const { return rejected[OVERLOADED]; }
+
+private:
+  struct Bucket {
+    uint32_t client;
+    uint32_t milliTokens;
+    unsigned long updatedAt;
+  };
+
+  Bucket buckets[ADMISSION_MAX_CLIENTS];
+  uint8_t clients = 0;
+  uint8_t active = 0;
+  uint32_t rejected[3] = {0, 0, 0};
+
+  Bucket& bucketFor(uint32_t client, unsigned long now);
+};
+
+#endif // ADMISSION_H
@@ -0,0 +1,46 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+// Host builds (test/host) count too, and can attribute allocations to call sites
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#endif
+
+// Counts heap allocations so tests can assert that a path stays off the heap.
+// Counting needs a build with -DALLOC_COUNTER. On the device it also links
+// with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free (the
+// esp32dev_alloccheck environment); everything that goes through malloc is
+// seen, String and operator new included, heap_caps_malloc() callers are not.
+// Host builds replace malloc itself, since on the host operator new lives in
+// a shared library that --wrap does not reach. In other builds enabled() is
+// false and the counts stay zero.
+class AllocCounter {
+public:
+  static bool enabled();
+  static uint32_t allocations();  // malloc, calloc and non-zero realloc calls
+  static uint32_t frees();        // free calls with a non-null pointer
+
+#if defined(ALLOC_SITES) && !defined(ARDUINO)
+  // Host builds with -DALLOC_COUNTER -DALLOC_SITES also record the call stack
+  // of every allocation. Prints the top stacks by live bytes, then by count;
+  // link with -rdynamic so the frames have names.
+  static void reportSites(FILE* out, int top);
+#endif
+};
+
+// Allocations made since construction
+class AllocWindow {
+public:
+  AllocWindow() : startAllocations(AllocCounter::allocations()) {}
+
+  uint32_t allocations() const { return AllocCounter::allocations() - startAllocations; }
+
+private:
+  uint32_t startAllocations;
+};
+
+#endif // ALLOC_COUNTER_H
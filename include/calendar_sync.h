@@ -0,0 +1,99 @@
+#ifndef CALENDAR_SYNC_H
+#define CALENDAR_SYNC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <time.h>
+#include "config.h"
+#include "metrics.h"
+
+// Free/busy status reported by Graph for an event (showAs)
+enum CalendarShowAs {
+  SHOW_AS_UNKNOWN = 0,
+  SHOW_AS_FREE = 1,
+  SHOW_AS_TENTATIVE = 2,
+  SHOW_AS_BUSY = 3,
+  SHOW_AS_OOF = 4,
+  SHOW_AS_WORKING_ELSEWHERE = 5
+};
+
+// Compact calendar event record kept in the local store.
+// Graph event ids are ~150 characters, so only a hash of the id is kept.
+struct CalendarEvent {
+  uint32_t idHash;
+  time_t start;   // UTC epoch seconds
+  time_t end;     // UTC epoch seconds
+  uint8_t showAs; // CalendarShowAs
+  bool isAllDay;
+  char subject[CALENDAR_SUBJECT_LEN];
+};
+
+// Fixed-size event store ordered by start time. loop() changes it while
+// web handlers on the AsyncTCP task read it, so changes and next() hold
+// the lock; at() and save() are for the task that makes the changes.
+class CalendarStore {
+public:
+  void clear();
+  bool upsert(const CalendarEvent& event);  // True when the event is stored and changed the store
+  bool remove(uint32_t idHash);
+  uint8_t count() const { return eventCount; }
+  const CalendarEvent& at(uint8_t index) const { return events[index]; }
+
+  // Copies the first event ordered after `after` (by start, then id hash),
+  // or the first one when after is null; false when there is none. Walking
+  // by key rather than index is not thrown off by changes in between.
+  bool next(const CalendarEvent* after, CalendarEvent& out) const;
+
+  // True once an event was dropped or evicted because the store was full.
+  // A delta sync never sends such an event again, so the caller resyncs.
+  bool truncated() const { return wasTruncated; }
+
+  void load(MeteredPreferences& prefs);  // Before any reader runs
+  void save(MeteredPreferences& prefs) const;
+
+  static uint32_t hashId(const char* id);
+
+private:
+  CalendarEvent events[CALENDAR_MAX_EVENTS];
+  uint8_t eventCount = 0;
+  bool wasTruncated = false;
+  mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  int indexOf(uint32_t idHash) const;
+  void removeAt(int index);
+};
+
+// Incremental calendar sync using the Graph calendarView/delta endpoint.
+// The first sync downloads the whole window; later syncs replay the stored
+// delta link and only transfer changed or removed events.
+class CalendarSync {
+public:
+  void begin(MeteredPreferences* prefs);
+  int sync(const String& accessToken);
+  void reset();
+
+  const CalendarStore& store() const { return eventStore; }
+  bool hasSynced() const { return lastSyncTime != 0; }
+  unsigned long lastSyncMillis() const { return lastSyncTime; }
+  time_t windowStartTime() const { return windowStart; }
+
+  static time_t parseDateTime(const char* dateTime);
+  static void formatDateTime(time_t t, char* buffer, size_t size);
+  static uint8_t parseShowAs(const char* showAs);
+  static const char* showAsName(uint8_t showAs);
+
+private:
+  MeteredPreferences* preferences = nullptr;
+  CalendarStore eventStore;
+  String deltaLink;
+  time_t windowStart = 0;
+  unsigned long lastSyncTime = 0;
+  unsigned long lastDeltaPersist = 0;
+
+  time_t currentWindowStart() const;
+  String initialUrl() const;
+  int fetchPage(const String& url, const String& accessToken, String& nextLink, String& newDeltaLink, bool& changed);
+  bool applyEvent(JsonObject item);
+  void persist(bool eventsChanged);
+};
+
+#endif // CALENDAR_SYNC_H
@@ -23,6 +23,9 @@
 
 // Network Configuration
 #define HTTP_PORT 80
+#define API_MAX_BODY_SIZE 512               // Largest JSON request body accepted by the API
+#define CONFIG_MAX_BODY_SIZE 2048           // Largest body accepted by POST /api/config
+#define CONFIG_DOCUMENT_VERSION 1           // Version of the fleet document of /api/config/export and /import
 
 // Microsoft Graph API Configuration
 #define GRAPH_API_HOST "graph.microsoft.com"
@@ -35,6 +38,87 @@
 #define NTP_DAYLIGHT_OFFSET 0       // No daylight saving by default
 #define TIME_UPDATE_INTERVAL 3600000 // Update time every hour (in milliseconds)
 
+// Presence Polling Configuration
+#define PRESENCE_POLL_INTERVAL 30000        // Graph presence poll (30 seconds)
+#define PRESENCE_REFRESH_MIN_INTERVAL 5000  // Earliest on-demand poll after the previous one (freshness-bound requests)
+
+// Presence Relay Configuration (optional push channel)
+#define RELAY_CONNECT_TIMEOUT 1000          // TCP connect timeout (blocks loop(), so kept short)
+#define RELAY_HANDSHAKE_TIMEOUT 2           // TLS handshake timeout (seconds)
+#define RELAY_IDLE_TIMEOUT 45000            // Drop the stream when no data or heartbeat arrives
+#define RELAY_RECONNECT_MIN_DELAY 5000      // First reconnect attempt after 5 seconds
+#define RELAY_RECONNECT_MAX_DELAY 300000    // Back off to at most 5 minutes
+#define RELAY_SAFETY_POLL_INTERVAL 300000   // Graph poll while the relay is connected (5 minutes)
+#define RELAY_LINE_MAX 256                  // Longest SSE line / event payload kept
+#define RELAY_READ_BUDGET 512               // Max bytes consumed per loop iteration
+
+// Local Presence Push Configuration (desk-side agents)
+#define LOCAL_PUSH_DEFAULT_TTL 120          // Seconds a pushed presence overrides Graph
+#define LOCAL_PUSH_MAX_TTL 3600             // Longest TTL accepted from an agent (1 hour)
+#define LOCAL_PUSH_KEY_BYTES 16             // Random bytes in a generated API key (32 hex chars)
+
+// Status Board Configuration (app-only roster polling)
+#define BOARD_MAX_MEMBERS 32                // Roster size polled with one bulk request
+#define BOARD_UPN_LEN 64                    // Longest roster entry (email or object id)
+#define BOARD_ID_LEN 37                     // Azure AD object id (GUID) plus terminator
+#define BOARD_RESOLVE_RETRY 60000           // Wait before retrying a member that failed to resolve
+#define BOARD_RESOLVE_MAX_RETRY 3600000     // Longest wait, reached by doubling (1 hour)
+
+// Dashboard Push Configuration (server-sent events to browsers)
+#define DASHBOARD_EVENTS_PATH "/events"
+#define DASHBOARD_HEARTBEAT_INTERVAL 15000  // Ping when nothing changed, so browsers can spot a dead channel
+#define DASHBOARD_RECONNECT_DELAY 5000      // Retry delay suggested to browsers
+#define DASHBOARD_MAX_CLIENTS 4             // Open event streams (browser tabs) accepted at once
+
+// Web Server Admission Configuration (per-client rate limit and concurrency cap)
+#define ADMISSION_MAX_CLIENTS 8             // Clients tracked with their own token bucket; the least recent is recycled
+#define ADMISSION_BURST 20                  // Requests a client may send back to back (bucket size)
+#define ADMISSION_REFILL_PER_SECOND 4       // Sustained requests per second per client
+#define ADMISSION_LOW_PRIORITY_COST 2       // Tokens taken by an expensive route (/schedule, /location, /logs)
+#define ADMISSION_MAX_ACTIVE 10             // Requests in flight at once; the last slots are kept for /status
+#define ADMISSION_MAX_ACTIVE_NORMAL 8       // In-flight limit seen by ordinary routes
+#define ADMISSION_MAX_ACTIVE_LOW 4          // In-flight limit seen by expensive routes
+
+// Heap Governor Configuration (load shedding as free memory runs low)
+// A level is entered when free heap or the largest free block drops below
+// its thresholds, and left once both are back above them by the margin.
+// The presence poll needs one TLS session (two 16 KB record buffers), so
+// the last level still leaves room for it.
+#define HEAP_SAMPLE_INTERVAL 250            // Heap is sampled this often from loop()
+#define HEAP_DEFER_FREE 48000               // Below this, calendar syncs and early presence polls wait
+#define HEAP_DEFER_BLOCK 32000
+#define HEAP_CACHED_FREE 40000              // Below this, responses come from caches only
+#define HEAP_CACHED_BLOCK 26000
+#define HEAP_SHRINK_FREE 32000              // Below this, the log buffer is cut down
+#define HEAP_SHRINK_BLOCK 22000
+#define HEAP_REFUSE_FREE 24000              // Below this, new web requests and connections are refused
+#define HEAP_REFUSE_BLOCK 18000
+#define HEAP_RECOVERY_MARGIN 4096           // Headroom needed above a threshold before its level is left
+#define HEAP_CACHED_REBUILD_INTERVAL 30000  // Snapshots are rebuilt at most this often while serving from caches
+#define HEAP_REFUSE_RETRY_AFTER 10          // Retry-After (seconds) sent with a refusal
+
+// Keep-Alive Web Server Configuration (persistent connections for pollers and scrapers)
+#define KEEPALIVE_PORT 8080                 // Serves /status, /api/snapshot and /metrics over HTTP/1.1 keep-alive
+#define KEEPALIVE_MAX_CONNECTIONS 4         // Open sockets accepted at once; further ones get 503 and are closed
+#define KEEPALIVE_IDLE_TIMEOUT 30000        // An idle connection is closed after this
+#define KEEPALIVE_MAX_REQUESTS 1000         // Requests served on one connection before it is closed
+#define KEEPALIVE_REQUEST_SIZE 512          // Longest request head (request line and headers) accepted
+
+// Status Snapshot Configuration (cached /status and /api/snapshot bodies)
+#define STATUS_SNAPSHOT_CHECK_INTERVAL 250  // How often loop() looks for status changes
+#define STATUS_SNAPSHOT_TICK 60000          // Uptime and clock fields are refreshed at least this often
+
+// Calendar Sync Configuration
+#define CALENDAR_SYNC_DAYS 3                // Days covered by the local event store (starting today)
+#define CALENDAR_MAX_EVENTS 48              // Maximum number of events kept in the local store
+#define CALENDAR_SUBJECT_LEN 48             // Subject bytes kept per event (truncated)
+#define CALENDAR_PAGE_SIZE 50               // Events per Graph delta page (parsed one event at a time)
+#define CALENDAR_MAX_PAGES 20               // Safety cap on pages followed per sync
+#define CALENDAR_ITEM_DOC_SIZE 768          // JSON document used to parse a single event
+#define CALENDAR_SYNC_MIN_INTERVAL 60000    // Minimum time between delta sync attempts, also after a failure (1 minute)
+#define CALENDAR_CACHE_TTL 300000           // Schedule is refreshed in the background once older than this (5 minutes)
+#define CALENDAR_DELTA_PERSIST_INTERVAL 3600000 // Persist an unchanged delta link at most hourly
+
 // Device Code Flow Configuration
 #define DEVICE_CODE_SCOPE "https://graph.microsoft.com/Presence.Read offline_access"
 #define DEVICE_CODE_POLL_INTERVAL 5000  // 5 seconds
@@ -63,6 +147,11 @@
 #define KEY_PRESENCE_LOG_PREFIX "pres_log_"
 #define MAX_PRESENCE_LOGS 50  // Maximum number of presence logs to store
 
+// Calendar Sync Storage Keys
+#define KEY_CALENDAR_EVENTS "cal_events"
+#define KEY_CALENDAR_DELTA "cal_delta"
+#define KEY_CALENDAR_WINDOW "cal_window"
+
 // Time Configuration Storage Keys
 #define KEY_TIMEZONE_OFFSET "timezone_offset"
 #define KEY_DAYLIGHT_OFFSET "daylight_offset"
@@ -78,6 +167,21 @@
 #define KEY_LED_AWAY_PATTERN_PREFIX "led_away_"
 #define KEY_LED_OFFLINE_PATTERN_PREFIX "led_offline_"
 
+// Presence Relay Storage Keys
+#define KEY_RELAY_URL "relay_url"
+#define KEY_RELAY_KEY "relay_key"
+
+// Local Presence Push Storage Keys
+#define KEY_PUSH_API_KEY "push_api_key"
+#define KEY_PUSH_TTL "push_ttl"
+
+// Status Board Storage Keys
+#define KEY_BOARD_MODE "board_mode"
+#define KEY_BOARD_ROSTER "board_roster"
+
+// Fleet Import Storage Keys
+#define KEY_CONFIG_JOURNAL "cfg_journal"    // Imported settings while their keys are written, finished at boot
+
 // Update Configuration
 #define OTA_UPDATE_URL_KEY "ota_url"
 #define DEFAULT_OTA_URL "https://github.com/fchapleau/teams-redlight/releases/latest/download/firmware.bin"
@@ -0,0 +1,38 @@
+#ifndef CURSOR_READ_H
+#define CURSOR_READ_H
+
+#include <Arduino.h>
+
+#define CURSOR_MAX_WAIT 25000  // Longest long-poll hold (ms), below common proxy timeouts
+#define CURSOR_MAX_LIMIT 100   // Largest page a client may ask for
+
+// Entries to return from a ring buffer, as positions from the oldest entry
+// still held (0) to one past the last one to send
+struct CursorWindow {
+  int first = 0;
+  int end = 0;
+  bool more = false;    // Entries after end exist; read again from the last seq returned
+  bool missed = false;  // Entries after since were overwritten before they were read
+  uint32_t oldestSeq = 0;  // Seq of position 0
+  uint32_t cursor = 0;     // Pass as since to continue after this window
+
+  uint32_t seqAt(int position) const { return oldestSeq + position; }
+};
+
+// An incremental read (?since=<seq>&limit=<n>&wait=<seconds>) of a buffer
+// whose entries carry consecutive sequence numbers ending at lastSeq.
+// Without since the newest `limit` entries are returned. A since beyond
+// lastSeq comes from before a restart and reads from the start.
+struct CursorQuery {
+  bool hasSince = false;
+  uint32_t since = 0;
+  int limit = 0;                 // 0 means no limit
+  unsigned long waitMillis = 0;  // Long-poll: hold the response until there is something new
+
+  CursorWindow window(uint32_t lastSeq, int count) const;
+
+  // True when the read would return at least one entry (or there is nothing to wait for)
+  bool satisfiedBy(uint32_t lastSeq) const;
+};
+
+#endif // CURSOR_READ_H
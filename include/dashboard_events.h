@@ -0,0 +1,34 @@
+#ifndef DASHBOARD_EVENTS_H
+#define DASHBOARD_EVENTS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// The parts of the device status the dashboard redraws when they change
+struct DashboardState {
+  const char* state;
+  const char* presence;
+  uint8_t ledCount;
+  uint8_t ledPresence[MAX_LEDS];  // TeamsPresence shown by each LED
+};
+
+// Remembers what has been pushed to the dashboard and writes only the fields
+// that changed since then, using the same keys as /status.
+class DashboardDelta {
+public:
+  // Returns false (and leaves delta empty) when nothing changed
+  bool write(const DashboardState& current, JsonDocument& delta);
+
+  // The next write() reports every field
+  void reset() { primed = false; }
+
+private:
+  bool primed = false;
+  char state[24] = "";
+  char presence[16] = "";
+  uint8_t ledCount = 0;
+  uint8_t ledPresence[MAX_LEDS] = {};
+};
+
+#endif // DASHBOARD_EVENTS_H
@@ -0,0 +1,93 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Subsystems a configuration change touches, as a bit mask
+enum ConfigChange : uint32_t {
+  CONFIG_WIFI = 1 << 0,          // SSID or password
+  CONFIG_ACCOUNT = 1 << 1,       // User email, tenant, client ID or secret
+  CONFIG_RELAY = 1 << 2,         // Presence relay URL or key
+  CONFIG_BOARD = 1 << 3,         // Status board mode or roster
+  CONFIG_PUSH = 1 << 4,          // Local push default TTL
+  CONFIG_OTA = 1 << 5,           // Firmware update URL
+  CONFIG_TIME = 1 << 6,          // Time zone or daylight offset
+  CONFIG_LED_PINS = 1 << 7,      // LED count or GPIO pins
+  CONFIG_LED_PATTERNS = 1 << 8   // Per-state LED patterns
+};
+
+// One Preferences key per LED and setting: the prefix plus the LED index
+// ("led_call_2")
+enum LedKey {
+  LED_KEY_PIN,
+  LED_KEY_CALL,
+  LED_KEY_MEETING,
+  LED_KEY_AVAILABLE,
+  LED_KEY_AWAY,
+  LED_KEY_OFFLINE,
+  LED_KEY_COUNT
+};
+
+#define LED_KEY_SIZE 16  // Longest prefix ("led_offline_") plus a two-digit index
+
+struct LedSettings {
+  uint8_t pin;
+  LEDPattern call;
+  LEDPattern meeting;
+  LEDPattern available;
+  LEDPattern away;
+  LEDPattern offline;
+};
+
+// The user-editable settings, as one value that can be copied, updated from
+// a JSON body and compared. Tokens and other runtime state are not part of it.
+struct DeviceConfig {
+  String wifiSSID;
+  String wifiPassword;
+  String userEmail;
+  String tenantId;
+  String clientId;
+  String clientSecret;
+  String relayUrl;
+  String relayKey;
+  bool boardMode = false;
+  String boardRoster;
+  unsigned long pushTtl = LOCAL_PUSH_DEFAULT_TTL;
+  String otaUrl;
+  int timezoneOffset = NTP_TIMEZONE_OFFSET;
+  int daylightOffset = NTP_DAYLIGHT_OFFSET;
+  uint8_t ledCount = 1;
+  LedSettings leds[MAX_LEDS];
+
+  // Applies the members present in body (the keys of GET /api/config) on top
+  // of this configuration. Nothing is changed when a value is invalid; error
+  // then names the offending field.
+  bool update(JsonObjectConst body, const uint8_t* validPins, uint8_t validPinCount, String& error);
+
+  // ConfigChange bits for the settings that differ between the two
+  static uint32_t diff(const DeviceConfig& from, const DeviceConfig& to);
+
+  // Adds the name of every ConfigChange bit set in changes ("wifi", "led_pins", ...)
+  static void describe(uint32_t changes, JsonArray out);
+
+  static LedSettings defaultLed(uint8_t pin);
+
+  // Preferences key of one LED setting, written into the caller's buffer
+  static void ledKey(LedKey setting, uint8_t index, char (&key)[LED_KEY_SIZE]);
+
+  // The settings a fleet shares, as the document of GET /api/config/export:
+  // {"version":1,"config":{...},"crc32":"<hex>"}. The user email, status
+  // board and secrets stay out of it.
+  void exportDocument(JsonObject document) const;
+
+  // Checks an imported document's version and checksum and points config at
+  // its settings, ready for update()
+  static bool readDocument(JsonObjectConst document, JsonObjectConst& config, String& error);
+
+  // CRC-32 of the settings serialized as minified JSON
+  static uint32_t checksum(JsonVariantConst config);
+};
+
+#endif // DEVICE_CONFIG_H
@@ -0,0 +1,65 @@
+#ifndef GRAPH_STREAM_H
+#define GRAPH_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+#define GRAPH_STREAM_TIMEOUT 10000  // Max wait for the next byte of a response (ms)
+#define GRAPH_STREAM_KEY_LEN 32     // Longest top-level key we need to recognise
+
+// Stream adapter with a blocking one-character lookahead. Network streams
+// return -1 from peek() when the next packet has not arrived yet, which is
+// indistinguishable from end of input for a parser.
+class LookaheadStream : public Stream {
+public:
+  explicit LookaheadStream(Stream& input) : source(input) {}
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+  void flush() override {}
+
+private:
+  Stream& source;
+  int pending = -1;
+  int waitForByte();
+};
+
+// Reads one Graph collection page ({"value":[...], "@odata.nextLink":...})
+// straight from the response stream. Each element of "value" is deserialized
+// on its own into the caller's document, so memory use depends on the size
+// of a single item rather than the size of the page.
+class GraphPageReader {
+public:
+  typedef std::function<void(JsonObject item)> ItemHandler;
+
+  GraphPageReader(Stream& input, JsonDocument& itemDoc, JsonDocument& itemFilter);
+
+  bool read(const ItemHandler& onItem);
+
+  const String& nextLink() const { return next; }
+  const String& deltaLink() const { return delta; }
+  int itemCount() const { return items; }
+  const char* error() const { return errorMessage; }
+
+private:
+  LookaheadStream stream;
+  JsonDocument& doc;
+  JsonDocument& filter;
+  String next;
+  String delta;
+  int items = 0;
+  const char* errorMessage = "";
+
+  int nextToken();
+  bool expect(char c);
+  bool readString(char* buffer, size_t size);
+  bool readString(String& out);
+  bool readValueArray(const ItemHandler& onItem);
+  bool skipValue();
+  bool fail(const char* message);
+};
+
+#endif // GRAPH_STREAM_H
@@ -0,0 +1,71 @@
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define GZIP_WINDOW_SIZE 1024   // LZ77 history searched for matches; the stream buffers twice this
+#define GZIP_HASH_BITS 9        // Match candidates are found through 2^bits hash heads
+#define GZIP_MAX_STREAMS 2      // Responses compressed at once; further ones are sent plain
+
+// Compresses a response on the fly as gzip. Each fill() pulls plain bytes
+// from the source, runs them through a small LZ77 matcher (one candidate per
+// hash, no chains) and writes them as fixed-Huffman deflate, so memory use is
+// a few kilobytes per stream regardless of the response size. JSON with
+// repeated keys typically shrinks to a quarter.
+class GzipStream {
+public:
+  // Same contract as a chunked response filler: 0 means no more data
+  typedef std::function<size_t(uint8_t* buffer, size_t maxLength)> Source;
+
+  explicit GzipStream(const Source& source);
+  ~GzipStream();
+
+  // Copies up to maxLength bytes of gzip output; 0 means the stream is complete
+  size_t fill(uint8_t* buffer, size_t maxLength);
+
+  bool finished() const { return done && pendingOffset == pendingLength; }
+  size_t inputBytes() const { return inputSize; }
+  size_t outputBytes() const { return outputSize; }
+  uint32_t cpuMicros() const { return compressMicros; }  // Excludes time spent in the source
+
+  // False while GZIP_MAX_STREAMS streams are alive
+  static bool available() { return activeStreams < GZIP_MAX_STREAMS; }
+
+  static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length);
+
+private:
+  Source source;
+  uint8_t data[GZIP_WINDOW_SIZE * 2];
+  uint16_t head[1 << GZIP_HASH_BITS];  // Position + 1 of the latest string per hash, 0 when none
+  size_t position = 0;                 // Next byte of data to encode
+  size_t end = 0;                      // Bytes of data filled
+  bool sourceDone = false;
+  bool started = false;
+  bool done = false;
+
+  uint8_t pending[256];
+  size_t pendingLength = 0;
+  size_t pendingOffset = 0;
+  uint32_t bitBuffer = 0;
+  uint8_t bitCount = 0;
+
+  uint32_t crc = 0;
+  size_t inputSize = 0;
+  size_t outputSize = 0;
+  uint32_t compressMicros = 0;
+  uint32_t sourceMicros = 0;
+
+  static uint8_t activeStreams;
+
+  void produce();
+  void refill();
+  void finish();
+  void putBits(uint32_t value, uint8_t count);
+  void putCode(uint16_t code, uint8_t length);
+  void putLiteral(uint16_t symbol);
+  void putMatch(size_t length, size_t distance);
+  void putByte(uint8_t value);
+};
+
+#endif // GZIP_STREAM_H
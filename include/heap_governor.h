@@ -0,0 +1,56 @@
+#ifndef HEAP_GOVERNOR_H
+#define HEAP_GOVERNOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Load shedding steps, in the order they are taken. Each level keeps the
+// measures of the ones below it.
+enum HeapPressure {
+  HEAP_NORMAL,
+  HEAP_DEFER_FETCHES,    // Calendar syncs and early presence polls for /location wait
+  HEAP_CACHED_ONLY,      // Snapshots are rebuilt less often and nothing is gzipped
+  HEAP_SHRINK_BUFFERS,   // The log buffer keeps only its newest entries
+  HEAP_REFUSE_REQUESTS   // New web requests and keep-alive connections get 503
+};
+
+#define HEAP_PRESSURE_LEVELS 5
+
+// Watches free heap and the largest free block and decides how much work the
+// device sheds. TLS sessions, JSON documents and response Strings all compete
+// for the same heap, and on a fragmented heap the largest block runs out long
+// before the total does, so both are checked. The presence poll and LED
+// rendering are never shed; everything else gives way first.
+//
+// sample() runs from loop(); the level is read from any task.
+class HeapGovernor {
+public:
+  // Records one reading and returns true when the level changed
+  bool sample(uint32_t freeHeap, uint32_t largestBlock);
+
+  HeapPressure level() const { return (HeapPressure)current; }
+  bool deferFetches() const { return current >= HEAP_DEFER_FETCHES; }
+  bool cachedOnly() const { return current >= HEAP_CACHED_ONLY; }
+  bool shrinkBuffers() const { return current >= HEAP_SHRINK_BUFFERS; }
+  bool refuseRequests() const { return current >= HEAP_REFUSE_REQUESTS; }
+
+  // Watermarks since boot
+  uint32_t lowestFree() const { return minFree; }
+  uint32_t lowestLargestBlock() const { return minBlock; }
+  HeapPressure highestLevel() const { return (HeapPressure)peak; }
+  uint32_t timesEntered(HeapPressure level) const { return entered[level]; }
+
+  static const char* levelName(HeapPressure level);
+
+  // The level whose thresholds, raised by margin, the reading falls below
+  static HeapPressure levelFor(uint32_t freeHeap, uint32_t largestBlock, uint32_t margin);
+
+private:
+  volatile uint8_t current = HEAP_NORMAL;
+  uint8_t peak = HEAP_NORMAL;
+  uint32_t minFree = UINT32_MAX;
+  uint32_t minBlock = UINT32_MAX;
+  uint32_t entered[HEAP_PRESSURE_LEVELS] = {0, 0, 0, 0, 0};
+};
+
+#endif // HEAP_GOVERNOR_H
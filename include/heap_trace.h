@@ -0,0 +1,131 @@
+#ifndef HEAP_TRACE_H
+#define HEAP_TRACE_H
+
+#include <Arduino.h>
+#include "json_stream.h"
+#include "metrics.h"
+
+#define HEAP_TRACE_POINTS (METRICS_MAX_ROUTES + 8)  // Web routes, keep-alive routes, Graph calls and saves
+#define HEAP_TRACE_SPANS 16      // Most recent traced calls kept with their readings
+#define HEAP_TRACE_SERIES 48     // Periodic samples kept
+#define HEAP_TRACE_INTERVAL 60   // Seconds between samples until the series first fills
+
+// Traced points that are not web routes. Routes are registered after these.
+enum HeapTracePoint {
+  TRACE_GRAPH_PRESENCE,
+  TRACE_GRAPH_TOKEN,
+  TRACE_GRAPH_CALENDAR,
+  TRACE_GRAPH_BOARD,
+  TRACE_SAVE_CONFIG,
+  TRACE_SAVE_PRESENCE_HISTORY,
+  TRACE_FIXED_POINTS
+};
+
+// One reading of the heap. Allocation counts are AllocCounter totals and stay
+// zero unless the build counts allocations.
+struct HeapReading {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;   // Lowest free heap since boot
+  uint32_t largestBlock;
+  uint32_t allocations;
+  uint32_t frees;
+};
+
+// The heap around one traced call
+struct HeapSpan {
+  uint32_t uptime;  // Seconds, when the call returned
+  uint8_t point;
+  HeapReading before;
+  HeapReading after;
+};
+
+struct HeapSample {
+  uint32_t uptime;
+  HeapReading reading;
+  uint32_t lowestLargestBlock;  // Smallest largest block any traced call saw since the previous sample
+};
+
+// Totals per traced point. A point whose net change keeps drifting down over
+// many calls is holding on to memory.
+struct HeapPointTotals {
+  const char* kind;  // HTTP method, "keepalive", "graph" or "save"
+  const char* name;
+  uint32_t calls;
+  int32_t netFree;         // Sum of free heap changes
+  uint32_t worstDrop;      // Largest drop in one call
+  int32_t netAllocations;  // Allocations minus frees
+};
+
+// Heap and fragmentation telemetry for finding slow leaks, served on
+// /api/heap. Readings are taken before and after every web route, Graph call
+// and save, and the heap is sampled periodically into a series that covers
+// the whole uptime: when it fills, every other sample is dropped and the
+// interval doubles.
+//
+// Readings are global, so a call that overlaps another (a web route during a
+// Graph poll) is charged with both; the totals over many calls still single
+// out the point that leaks. Everything is fixed size and nothing allocates.
+class HeapTrace {
+public:
+  // Returns the point's index, or -1 once the table is full. kind and name
+  // must outlive the program (literals or flash tables).
+  static int registerPoint(const char* kind, const char* name);
+
+  static HeapReading read();
+  static uint32_t uptime();
+
+  // point < 0 is ignored
+  static void recordSpan(int point, const HeapReading& before, const HeapReading& after, uint32_t uptimeSeconds);
+
+  // From loop(): samples the heap once the interval has passed
+  static void tick();
+  static void recordSample(uint32_t uptimeSeconds, const HeapReading& reading);
+
+  static uint32_t sampleInterval();
+  static int sampleCount();
+  static bool sampleAt(int position, HeapSample& out);  // position 0 is the oldest
+  static int spanCount();
+  static bool spanAt(int position, HeapSpan& out);      // position 0 is the oldest
+  static int pointCount();
+  static bool pointAt(int index, HeapPointTotals& out);
+
+  // Writes the /api/heap document, one sample, span or point per step
+  static bool produce(JsonChunkWriter& out, size_t step);
+
+  // Forgets all readings; registered points stay
+  static void clear();
+
+private:
+  static HeapPointTotals points[HEAP_TRACE_POINTS];
+  static int pointsUsed;
+  static HeapSpan spans[HEAP_TRACE_SPANS];
+  static int spanHead;
+  static int spansHeld;
+  static HeapSample series[HEAP_TRACE_SERIES];
+  static int samplesHeld;
+  static uint32_t interval;
+  static uint32_t lastSampleUptime;
+  static uint32_t pendingLowestBlock;
+  static portMUX_TYPE lock;
+
+  static void fillReading(JsonObject out, const HeapReading& reading);
+};
+
+// Records the heap before and after the enclosing scope
+class HeapTraceScope {
+public:
+  explicit HeapTraceScope(int point) : point(point), before(point >= 0 ? HeapTrace::read() : HeapReading()) {}
+  ~HeapTraceScope() {
+    if (point >= 0) {
+      HeapTrace::recordSpan(point, before, HeapTrace::read(), HeapTrace::uptime());
+    }
+  }
+  HeapTraceScope(const HeapTraceScope&) = delete;
+  HeapTraceScope& operator=(const HeapTraceScope&) = delete;
+
+private:
+  int point;
+  HeapReading before;
+};
+
+#endif // HEAP_TRACE_H
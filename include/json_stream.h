@@ -0,0 +1,57 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+#define JSON_STREAM_FRAGMENT_SIZE 1024 // Largest piece a producer may emit in one step (fits a full log line)
+#define JSON_STREAM_MAX_DEPTH 4        // Nested objects/arrays a response may open
+
+// Writes a JSON response a piece at a time. The producer is called with an
+// increasing step number and appends the next fragment (typically one array
+// element, built in a small stack document); fill() hands the bytes to the
+// HTTP layer, which sends them with chunked transfer encoding as the socket
+// drains. Memory use is one fragment, whatever the size of the response.
+class JsonChunkWriter {
+public:
+  // Returns false once the step it just wrote was the last one
+  typedef std::function<bool(JsonChunkWriter& out, size_t step)> Producer;
+
+  explicit JsonChunkWriter(const Producer& producer);
+
+  // Copies up to maxLength bytes of output; 0 means the response is complete
+  size_t fill(uint8_t* buffer, size_t maxLength);
+
+  // Runs the producer to completion, appending everything to out
+  void writeTo(String& out);
+
+  // Producer side. Keys are literals from our own code and are not escaped.
+  void beginObject(const char* key = nullptr);
+  void endObject();
+  void beginArray(const char* key = nullptr);
+  void endArray();
+  void members(const JsonDocument& doc);  // Members of an object document, without braces
+  void element(const JsonDocument& doc);  // One array element
+
+  // Values that did not fit in a fragment and were left out (or written as null)
+  int dropped() const { return droppedValues; }
+
+private:
+  Producer producer;
+  char fragment[JSON_STREAM_FRAGMENT_SIZE];
+  size_t length = 0;
+  size_t offset = 0;
+  size_t step = 0;
+  bool done = false;
+  bool first[JSON_STREAM_MAX_DEPTH + 1];
+  uint8_t depth = 0;
+  int droppedValues = 0;
+
+  bool append(const char* text, size_t textLength);
+  bool separator();
+  void open(const char* key, char bracket);
+  void close(char bracket);
+};
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,113 @@
+#ifndef KEEPALIVE_SERVER_H
+#define KEEPALIVE_SERVER_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <functional>
+#include "config.h"
+
+#define KEEPALIVE_MAX_ROUTES 4
+#define KEEPALIVE_HEAD_SIZE 320  // Status line and headers of one response
+#define KEEPALIVE_CHUNK_SIZE 1024
+
+// A parsed request head. The strings point into the connection's buffer and
+// are valid until the response has been sent.
+struct KeepAliveRequest {
+  uint32_t remoteIP = 0;
+  const char* method = "";
+  const char* path = "";
+  const char* query = "";        // After '?', empty when there is none
+  const char* accept = "";
+  const char* ifNoneMatch = "";
+  bool http11 = false;
+  bool keepAlive = false;        // HTTP/1.1 without "Connection: close", or HTTP/1.0 asking for it
+  bool hasBody = false;
+
+  // Value of a query parameter, copied into value; false when it is absent
+  bool queryArg(const char* name, char* value, size_t size) const;
+};
+
+struct KeepAliveResponse {
+  // Same contract as a chunked response filler: 0 means no more data
+  typedef std::function<size_t(uint8_t* buffer, size_t maxLength)> Source;
+
+  int status = 200;
+  const char* contentType = "text/plain";
+  long contentLength = -1;        // -1 sends the body chunked
+  Source body;                    // No body when empty
+  std::function<void()> onDone;   // Called once the response is sent or the connection is gone
+
+  void addHeader(const char* name, const char* value);
+  void send(int code, const char* type, const char* text);
+
+  char headers[128] = "";         // Extra header lines, each ending in CRLF
+};
+
+// A small HTTP/1.1 server with persistent connections, for the clients that
+// poll the device over and over (dashboards, fleet scrapers). The main web
+// server closes the socket after every response, which costs a TCP handshake
+// and a TIME_WAIT PCB per poll; here a connection stays open between
+// requests until it is idle for KEEPALIVE_IDLE_TIMEOUT. Only GET routes with
+// bodies streamed from a filler are supported. Everything runs on the
+// AsyncTCP task.
+class KeepAliveServer {
+public:
+  typedef std::function<void(const KeepAliveRequest& request, KeepAliveResponse& response)> Handler;
+
+  explicit KeepAliveServer(uint16_t port) : server(port) {}
+
+  // Routes must be added before begin(); path must outlive the server
+  bool on(const char* path, const Handler& handler);
+  void begin();
+
+  uint8_t openConnections() const;
+
+  // While refusing, new connections get 503 and are closed; open ones are served
+  void setAccepting(bool accept) { accepting = accept; }
+
+  // Parses a complete request head at the start of buffer, which it modifies
+  // in place. Returns the head length including the blank line, 0 while the
+  // head is incomplete, or -1 for a malformed request.
+  static int parse(char* buffer, size_t length, KeepAliveRequest& request);
+
+private:
+  struct Route {
+    const char* path;
+    Handler handler;
+  };
+
+  struct Connection {
+    AsyncClient* client = nullptr;
+    char buffer[KEEPALIVE_REQUEST_SIZE];
+    size_t buffered = 0;
+    size_t headLength = 0;        // Bytes of buffer taken by the request being answered
+    unsigned long lastActivity = 0;
+    uint16_t requests = 0;
+
+    bool responding = false;
+    bool closeAfter = false;
+    KeepAliveResponse response;
+    char head[KEEPALIVE_HEAD_SIZE];
+    size_t headSize = 0;
+    size_t headSent = 0;
+    size_t bodySent = 0;
+    bool chunked = false;
+    bool bodyDone = false;
+  };
+
+  AsyncServer server;
+  Route routes[KEEPALIVE_MAX_ROUTES];
+  uint8_t routeCount = 0;
+  Connection connections[KEEPALIVE_MAX_CONNECTIONS];
+  volatile bool accepting = true;
+
+  void accept(AsyncClient* client);
+  void receive(Connection& connection, const uint8_t* data, size_t length);
+  void dispatch(Connection& connection);
+  void startResponse(Connection& connection, const KeepAliveRequest& request, int error);
+  void pump(Connection& connection);
+  void finishResponse(Connection& connection);
+  void release(Connection& connection);
+};
+
+#endif // KEEPALIVE_SERVER_H
@@ -0,0 +1,50 @@
+#ifndef LOCAL_PUSH_H
+#define LOCAL_PUSH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Presence pushed by a desk-side agent on the local network (call started,
+// camera on, ...). A push takes precedence over Graph and the relay until its
+// TTL runs out; the agent is expected to refresh it while the state lasts.
+//
+// authorize() runs in web handlers on the AsyncTCP task while loop() may be
+// replacing the key, so the key is fixed size and copied under a lock. The
+// rest is changed from loop() only.
+class LocalPresencePush {
+public:
+  void begin(const String& apiKey, unsigned long defaultTtlSeconds);
+
+  // Accepts "Bearer <key>" or a bare key; compared in constant time
+  bool authorize(const String& credential) const;
+
+  // ttlSeconds of 0 selects the configured default; longer TTLs are clamped
+  void apply(TeamsPresence presence, unsigned long ttlSeconds, const char* source);
+  unsigned long ttlFor(unsigned long ttlSeconds) const;  // The TTL apply() would use
+  void clear();
+
+  // Returns true once when an active push has just expired
+  bool expired();
+
+  bool isActive() const { return active; }
+  TeamsPresence presence() const { return pushedPresence; }
+  const char* source() const { return pushSource; }
+  unsigned long remainingSeconds() const;
+  unsigned long defaultTtl() const { return ttlDefault; }
+  unsigned long pushesReceived() const { return pushCount; }
+
+  static String generateKey();
+
+private:
+  char key[LOCAL_PUSH_KEY_BYTES * 2 + 1] = "";
+  mutable portMUX_TYPE keyLock = portMUX_INITIALIZER_UNLOCKED;
+  unsigned long ttlDefault = LOCAL_PUSH_DEFAULT_TTL;
+  bool active = false;
+  TeamsPresence pushedPresence = PRESENCE_UNKNOWN;
+  char pushSource[24] = "";
+  unsigned long appliedAt = 0;
+  unsigned long ttlMillis = 0;
+  unsigned long pushCount = 0;
+};
+
+#endif // LOCAL_PUSH_H
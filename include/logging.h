@@ -2,6 +2,7 @@
 #define LOGGING_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 
 // Log levels
 #define LOG_LEVEL_DEBUG 0
@@ -30,27 +31,47 @@
 
 // Log buffer configuration for web interface
 #define LOG_BUFFER_SIZE 50  // Keep last 50 log messages
+#define LOG_BUFFER_SHRUNK_SIZE 10  // Entries kept while heap is low
 
 // Log entry structure for web interface
 struct LogEntry {
+    uint32_t seq;  // Increases by one per entry, never reused until restart
     unsigned long timestamp;
     int level;
     String component;
     String message;
 };
 
-// Circular buffer for recent logs
+// Circular buffer for recent logs. loop() and web handlers on the AsyncTCP
+// task both log and read it, so every access to the entries holds the lock.
+// addEntry allocates and frees its Strings outside it; only setCapacity
+// frees inside.
 class LogBuffer {
 public:
     void addEntry(int level, const String& component, const String& message);
-    String getLogsAsJson() const;
+    int size() const { return count; }
+    int getCapacity() const { return capacity; }
+    uint32_t lastSeq() const { return nextSeq - 1; }
+    bool entryToJson(int position, JsonObject out) const;  // position 0 is the oldest
+    // By seq, so a reader is not thrown off by entries added meanwhile; false
+    // once the entry has been overwritten or dropped
+    bool seqToJson(uint32_t seq, JsonObject out) const;
+    bool seqToRow(uint32_t seq, JsonArray out) const;      // [seq, timestamp, level, component, message]
     void clear();
+    void setCapacity(int size);  // 1 to LOG_BUFFER_SIZE; older entries that no longer fit are dropped
     
 private:
     LogEntry entries[LOG_BUFFER_SIZE];
+    int capacity = LOG_BUFFER_SIZE;
     int head = 0;
     int count = 0;
+    uint32_t nextSeq = 1;
+    mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
     const char* getLevelString(int level) const;
+    int indexOf(int position) const;
+    int positionOfSeq(uint32_t seq) const;  // -1 when not held
+    void writeJson(int index, JsonObject out) const;
+    void writeRow(int index, JsonArray out) const;
 };
 
 class Logger {
@@ -77,8 +98,12 @@ public:
     static void error(const String& component, const String& message);
     
     // Web interface support
-    static String getLogsAsJson();
+    static int getLogCount();
+    static uint32_t getLastLogSeq();
+    static bool getLogEntry(uint32_t seq, JsonObject out);  // false once the entry is gone
+    static bool getLogRow(uint32_t seq, JsonArray out);
     static void clearLogs();
+    static void setLogCapacity(int entries);
 
 private:
     static int currentLevel;
@@ -89,16 +114,20 @@ private:
     static void logMessagef(int level, const char* format, va_list args);
 };
 
-// Convenience macros for logging with automatic component detection
-#define LOG_DEBUG(msg) Logger::debug(__FUNCTION__, msg)
-#define LOG_INFO(msg) Logger::info(__FUNCTION__, msg)
-#define LOG_WARN(msg) Logger::warn(__FUNCTION__, msg)
-#define LOG_ERROR(msg) Logger::error(__FUNCTION__, msg)
+// Convenience macros for logging with automatic component detection. The
+// level is checked first, so a filtered-out message neither builds its
+// String arguments nor evaluates its format arguments.
+#define LOG_AT(level, call) do { if (Logger::getLevel() <= (level)) { call; } } while (0)
+
+#define LOG_DEBUG(msg) LOG_AT(LOG_LEVEL_DEBUG, Logger::debug(__FUNCTION__, msg))
+#define LOG_INFO(msg) LOG_AT(LOG_LEVEL_INFO, Logger::info(__FUNCTION__, msg))
+#define LOG_WARN(msg) LOG_AT(LOG_LEVEL_WARN, Logger::warn(__FUNCTION__, msg))
+#define LOG_ERROR(msg) LOG_AT(LOG_LEVEL_ERROR, Logger::error(__FUNCTION__, msg))
 
 // Formatted logging macros
-#define LOG_DEBUGF(fmt, ...) Logger::debugf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__)
-#define LOG_INFOF(fmt, ...) Logger::infof("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__)
-#define LOG_WARNF(fmt, ...) Logger::warnf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__)
-#define LOG_ERRORF(fmt, ...) Logger::errorf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__)
+#define LOG_DEBUGF(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, Logger::debugf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__))
+#define LOG_INFOF(fmt, ...) LOG_AT(LOG_LEVEL_INFO, Logger::infof("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__))
+#define LOG_WARNF(fmt, ...) LOG_AT(LOG_LEVEL_WARN, Logger::warnf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__))
+#define LOG_ERRORF(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, Logger::errorf("[%s] " fmt, __FUNCTION__, ##__VA_ARGS__))
 
 #endif // LOGGING_H
\ No newline at end of file
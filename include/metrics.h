@@ -0,0 +1,125 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "heap_governor.h"
+
+#define METRICS_MAX_ROUTES 32         // Web routes with their own request histogram
+#define METRICS_BUCKET_COUNT 9        // Latency buckets per histogram, the last one is +Inf
+#define METRICS_FRAGMENT_SIZE 1536    // Largest section rendered in one step (one route histogram)
+#define METRICS_SCRAPE_TIMEOUT 10000  // A scrape whose client stopped reading is abandoned after this
+
+// Latency histogram with fixed buckets (1 ms to 10 s). Bucket counts are kept
+// per bucket and only made cumulative when rendered.
+struct LatencyHistogram {
+  uint32_t buckets[METRICS_BUCKET_COUNT];
+  uint32_t count;
+  uint64_t sumMicros;
+
+  void observe(uint32_t micros);
+};
+
+// Device metrics in the Prometheus text format, served on /metrics.
+//
+// Everything is a fixed-size counter or histogram updated in place, and a
+// scrape renders one section at a time into a single static buffer, so
+// neither recording nor scraping allocates. Heap, WiFi and uptime gauges are
+// read when scraped.
+class Metrics {
+public:
+  // Returns the route's slot for observeRoute(), or -1 once all slots are taken.
+  // method and path must outlive the program (literals or flash tables).
+  static int registerRoute(const char* method, const char* path);
+  static void observeRoute(int route, uint32_t micros);
+
+  static void observeGraphPoll(bool success, uint32_t micros);
+  static void observeLoop(uint32_t micros);
+  static void countTokenRefresh(bool success);
+  static void countWifiReconnect();
+  static void countNvsWrite();
+  static void countHttpRejection(bool overloaded);
+  static void observeGzip(size_t inputBytes, size_t outputBytes, uint32_t micros);
+  static void observeKeepAliveConnection(bool accepted);
+  static void observeKeepAliveClose();
+  static void observeKeepAliveRequest(bool reused);
+  // Load shedding level (HeapPressure) and the largest-block watermark
+  static void observeHeap(uint8_t pressure, uint32_t lowestLargestBlock);
+
+  // A scrape is a ticket plus fill() calls until fill() returns 0. Only one
+  // scrape renders at a time; beginScrape() returns 0 while another one is
+  // in flight. Both run on the AsyncTCP task.
+  static uint32_t beginScrape();
+  static size_t fillScrape(uint32_t ticket, uint8_t* buffer, size_t maxLength);
+
+  static int routeCount() { return routes; }
+  static LatencyHistogram routeHistogram(int route);
+
+private:
+  struct Route {
+    const char* method;
+    const char* path;
+    LatencyHistogram latency;
+  };
+
+  static Route routeTable[METRICS_MAX_ROUTES];
+  static int routes;
+  static LatencyHistogram graphPollLatency;
+  static LatencyHistogram loopLatency;
+  static uint32_t graphPolls[2];       // Failure, success
+  static uint32_t tokenRefreshes[2];   // Failure, success
+  static uint32_t wifiReconnects;
+  static uint32_t nvsWrites;
+  static uint32_t httpRejections[2];  // Rate limited, overloaded
+  static LatencyHistogram gzipLatency;
+  static uint64_t gzipBytes[2];        // Input, output
+  static uint32_t keepAliveConnections[2];  // Refused, accepted
+  static uint32_t keepAliveRequests[2];     // First on a connection, reused
+  static uint32_t keepAliveOpen;
+  static uint8_t heapPressure;
+  static uint32_t heapPressureRaised[HEAP_PRESSURE_LEVELS];    // Times each level was entered from below
+  static uint32_t heapLowestBlock;
+  static portMUX_TYPE lock;
+
+  // Scrape state
+  static char fragment[METRICS_FRAGMENT_SIZE];
+  static size_t length;
+  static size_t offset;
+  static size_t section;
+  static uint32_t scrapeTicket;
+  static uint32_t lastTicket;
+  static unsigned long scrapeActivity;
+
+  static bool renderSection(size_t index);
+  static void appendf(const char* format, ...);
+  static void appendHistogram(const char* name, const char* labels, const LatencyHistogram& histogram);
+  static LatencyHistogram snapshot(const LatencyHistogram& histogram);
+};
+
+// Preferences that count every write to flash for /metrics. Preferences
+// methods are not virtual, so writes are only counted when made through
+// this type.
+class MeteredPreferences : public Preferences {
+public:
+  size_t putBool(const char* key, bool value) { return counted(Preferences::putBool(key, value)); }
+  size_t putInt(const char* key, int32_t value) { return counted(Preferences::putInt(key, value)); }
+  size_t putUInt(const char* key, uint32_t value) { return counted(Preferences::putUInt(key, value)); }
+  size_t putULong(const char* key, uint32_t value) { return counted(Preferences::putULong(key, value)); }
+  size_t putULong64(const char* key, uint64_t value) { return counted(Preferences::putULong64(key, value)); }
+  size_t putString(const char* key, const char* value) { return counted(Preferences::putString(key, value)); }
+  size_t putString(const char* key, const String& value) { return counted(Preferences::putString(key, value)); }
+  size_t putBytes(const char* key, const void* value, size_t len) { return counted(Preferences::putBytes(key, value, len)); }
+  bool remove(const char* key) { return counted(Preferences::remove(key)); }
+  bool clear() { return counted(Preferences::clear()); }
+
+private:
+  template <typename T>
+  static T counted(T result) {
+    if (result) {
+      Metrics::countNvsWrite();
+    }
+    return result;
+  }
+};
+
+#endif // METRICS_H
@@ -0,0 +1,55 @@
+#ifndef MSGPACK_STREAM_H
+#define MSGPACK_STREAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "json_stream.h"
+
+#define MSGPACK_CONTENT_TYPE "application/msgpack"
+
+// MessagePack counterpart of JsonChunkWriter for the binary API variants.
+// MessagePack containers carry their size up front instead of a closing
+// bracket, so producers declare how many members or elements follow when
+// they open one; there is nothing to close.
+class MsgPackChunkWriter {
+public:
+  // Returns false once the step it just wrote was the last one
+  typedef std::function<bool(MsgPackChunkWriter& out, size_t step)> Producer;
+
+  explicit MsgPackChunkWriter(const Producer& producer);
+
+  // Copies up to maxLength bytes of output; 0 means the response is complete
+  size_t fill(uint8_t* buffer, size_t maxLength);
+
+  // Runs the producer to completion, appending everything to out
+  void writeTo(String& out);
+
+  // Producer side. With a key, the container is the value of that member of
+  // the enclosing map.
+  void beginMap(const char* key, size_t count);
+  void beginArray(const char* key, size_t count);
+  void members(const JsonDocument& doc);  // Members of an object document, counted by the enclosing map (nil values when they do not fit)
+  void element(const JsonDocument& doc);  // One value (written as nil when it does not fit)
+
+  // Values that did not fit in a fragment and were written as nil
+  int dropped() const { return droppedValues; }
+
+  // Size of the map or array header MessagePack uses for count entries
+  static size_t headerSize(size_t count) { return count < 16 ? 1 : 3; }
+
+private:
+  Producer producer;
+  uint8_t fragment[JSON_STREAM_FRAGMENT_SIZE];
+  size_t length = 0;
+  size_t offset = 0;
+  size_t step = 0;
+  bool done = false;
+  int droppedValues = 0;
+
+  bool append(const uint8_t* data, size_t dataLength);
+  void header(uint8_t fixBase, uint8_t wide, size_t count);
+  void key(const char* key);
+};
+
+#endif // MSGPACK_STREAM_H
@@ -0,0 +1,89 @@
+#ifndef PRESENCE_CLIENT_H
+#define PRESENCE_CLIENT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFiClientSecure.h>
+
+#define PRESENCE_HOST "graph.microsoft.com"
+#define PRESENCE_PATH "/v1.0/me/presence"
+#define PRESENCE_TIMEOUT 10000    // Max wait for a whole response (ms)
+#define PRESENCE_LINE_SIZE 128    // Status and header lines kept; longer ones are cut
+#define PRESENCE_BODY_SIZE 1024   // Body kept for parsing; the rest is read and dropped
+
+// Availability and activity as Graph reports them
+struct GraphPresence {
+  char availability[24];
+  char activity[32];
+};
+
+// Reads an HTTP/1.1 response into fixed buffers as its bytes arrive. Bodies
+// with Content-Length, chunked bodies and bodies ending at close are all read
+// to their end, so a kept connection is ready for the next request.
+class PresenceResponse {
+public:
+  void reset();
+
+  // Consumes bytes up to the end of the response and returns how many it took
+  size_t feed(const char* data, size_t length);
+
+  // The connection closed; completes a body that was read until close
+  void finish();
+
+  bool done() const { return state == DONE; }
+  bool failed() const { return state == FAILED; }
+  int status() const { return statusCode; }
+  bool keepAlive() const { return keepConnection; }
+  const char* body() const { return bodyText; }
+  size_t bodyLength() const { return bodyUsed; }
+  bool truncated() const { return bodyDropped; }
+
+  // Copies availability and activity out of a /me/presence body; missing
+  // members come back empty
+  static DeserializationError parsePresence(const char* body, size_t length, GraphPresence& out);
+
+private:
+  enum State { STATUS_LINE, HEADERS, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILERS, DONE, FAILED };
+
+  State state = STATUS_LINE;
+  int statusCode = 0;
+  bool keepConnection = false;
+  bool chunked = false;
+  bool bodyDropped = false;
+  long remaining = -1;  // Body or chunk bytes still to come; -1 reads until close
+  char line[PRESENCE_LINE_SIZE];
+  size_t lineUsed = 0;
+  char bodyText[PRESENCE_BODY_SIZE + 1];
+  size_t bodyUsed = 0;
+
+  void endLine();
+  void endHeaders();
+  void header(const char* name, const char* value);
+  void keepBody(const char* data, size_t length);
+};
+
+// Polls /me/presence over one TLS connection that stays open between polls.
+// The request is built in a scratch arena and the response is read into
+// PresenceResponse, so once the connection is up a poll makes no heap
+// allocations. Not thread safe; loop() owns it.
+class PresenceClient {
+public:
+  // HTTP status of the poll, or -1 when no complete response arrived
+  int fetch(const String& accessToken);
+
+  const PresenceResponse& response() const { return reply; }
+
+  // While off, the connection is closed after each poll so its TLS buffers
+  // go back to the heap
+  void setKeepAlive(bool keep);
+  void stop();
+
+private:
+  WiFiClientSecure client;
+  PresenceResponse reply;
+  bool keepAlive = true;
+
+  bool exchange(const String& accessToken);
+};
+
+#endif // PRESENCE_CLIENT_H
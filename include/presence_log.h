@@ -0,0 +1,20 @@
+#ifndef PRESENCE_LOG_H
+#define PRESENCE_LOG_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#define PRESENCE_LOG_KEY_SIZE 16     // "pres_log_" plus the entry position
+#define PRESENCE_LOG_RECORD_SIZE 48  // "timestamp,presence,presenceString"
+
+// Flash format of the presence history. Entry i of the history (oldest first)
+// is saved under "pres_log_<i>" as "timestamp,presence,presenceString". All
+// three work in caller buffers, so saving 50 entries makes no heap
+// allocations.
+void presenceLogKey(uint8_t position, char (&key)[PRESENCE_LOG_KEY_SIZE]);
+size_t formatPresenceLog(const PresenceLogEntry& entry, char (&record)[PRESENCE_LOG_RECORD_SIZE]);
+
+// False for a malformed record, which leaves entry unchanged
+bool parsePresenceLog(const char* record, PresenceLogEntry& entry);
+
+#endif // PRESENCE_LOG_H
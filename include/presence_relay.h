@@ -0,0 +1,92 @@
+#ifndef PRESENCE_RELAY_H
+#define PRESENCE_RELAY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <functional>
+#include "config.h"
+
+// Incremental parser for a text/event-stream body
+class SseParser {
+public:
+  typedef std::function<void(const char* event, const char* data)> EventHandler;
+
+  void reset();
+  void feed(char c, const EventHandler& onEvent);
+
+private:
+  char line[RELAY_LINE_MAX];
+  size_t lineLength = 0;
+  char eventName[24] = "";
+  char data[RELAY_LINE_MAX];
+  size_t dataLength = 0;
+  bool hasData = false;
+
+  void processLine(const EventHandler& onEvent);
+};
+
+// Optional long-lived outbound connection to a relay service that forwards
+// Graph presence change notifications as server-sent events:
+//
+//   event: presence
+//   data: {"availability":"Busy","activity":"InACall"}
+//
+// The relay is expected to send a comment line (": keepalive") at least every
+// RELAY_IDLE_TIMEOUT; a silent stream is treated as dead and reconnected with
+// exponential backoff while the caller falls back to polling. When a key is
+// configured it is sent as "Authorization: Bearer <key>" so the relay can
+// refuse streams for other users' presence.
+class PresenceRelay {
+public:
+  typedef std::function<void(const char* availability, const char* activity)> PresenceHandler;
+
+  bool begin(const String& url, const String& user, const String& key, PresenceHandler handler);
+  void stop();
+  void loop();
+
+  bool isEnabled() const { return enabled; }
+  bool isConnected() const { return state == RELAY_STREAMING; }
+  unsigned long eventsReceived() const { return eventCount; }
+  unsigned long reconnects() const { return reconnectCount; }
+
+private:
+  enum RelayState {
+    RELAY_IDLE,
+    RELAY_READING_HEADERS,
+    RELAY_STREAMING
+  };
+
+  bool enabled = false;
+  RelayState state = RELAY_IDLE;
+  bool secure = false;
+  String host;
+  uint16_t port = 80;
+  String path;
+  String authorization;
+  PresenceHandler onPresence;
+
+  WiFiClient plainClient;
+  WiFiClientSecure secureClient;
+  Client* client = nullptr;
+  SseParser parser;
+
+  char headerLine[RELAY_LINE_MAX];
+  size_t headerLength = 0;
+  bool statusSeen = false;
+  bool statusOk = false;
+
+  unsigned long lastActivity = 0;
+  unsigned long nextAttempt = 0;
+  unsigned long reconnectDelay = RELAY_RECONNECT_MIN_DELAY;
+  unsigned long eventCount = 0;
+  unsigned long reconnectCount = 0;
+
+  bool parseUrl(const String& url, const String& user);
+  bool connect();
+  void disconnect(const char* reason);
+  void readHeaderByte(char c);
+  void handleEvent(const char* event, const char* data);
+};
+
+#endif // PRESENCE_RELAY_H
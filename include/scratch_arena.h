@@ -0,0 +1,123 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+// Host builds (test/host) use the arena without the Arduino core
+#include <cstddef>
+#include <cstdint>
+#endif
+
+#ifndef SCRATCH_ARENA_COUNT
+#define SCRATCH_ARENA_COUNT 3    // Lent out at once: a web handler, loop()'s Graph call, one spare
+#endif
+#ifndef SCRATCH_ARENA_SIZE
+#define SCRATCH_ARENA_SIZE 4096  // Holds a token request (refresh token and secret) or a bearer header
+#endif
+
+// Bump-pointer scratch memory for the short-lived text a request handler or
+// an outbound call builds: URLs, headers, form bodies, small HTML pages.
+// Allocating is a pointer increment and giving the arena back is a reset, so
+// the heap sees one allocation per finished String instead of one per
+// append. The pool is static memory taken from the heap; it does not leave a
+// larger free block (see test/host/arena_simulation.cpp).
+//
+// A few arenas live in static memory and are lent out through ScratchScope.
+// Borrowing and releasing are O(1) and safe from any task.
+class ScratchArena {
+public:
+  ScratchArena() {}
+  ScratchArena(uint8_t* memory, size_t size) : memory(memory), size(size) {}
+
+  // A 4-byte aligned block, or nullptr when the arena is full
+  void* allocate(size_t length);
+  // Grows the most recent block to length in place; false when another block
+  // was allocated after it or the arena is full
+  bool extend(void* block, size_t length);
+  void reset() { offset = 0; lastBlock = 0; }
+
+  size_t used() const { return offset; }
+  size_t capacity() const { return size; }
+  size_t highWater() const { return peak; }
+
+  // Pool of SCRATCH_ARENA_COUNT arenas; borrow() returns nullptr when all of
+  // them are lent out. release() resets the arena and ignores nullptr.
+  static ScratchArena* borrow();
+  static void release(ScratchArena* arena);
+  static uint8_t available();
+  static size_t poolHighWater();
+
+  // Builders that found no arena or no room in it and used the heap
+  static uint32_t fallbacks() { return fallbackCount; }
+  static void countFallback() { fallbackCount++; }
+
+private:
+  uint8_t* memory = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+  size_t lastBlock = 0;
+  size_t peak = 0;
+
+  static volatile uint32_t fallbackCount;
+};
+
+// Borrows an arena for the lifetime of a scope, typically one handler or one
+// outbound call. get() is nullptr when the pool was empty; builders then use
+// the heap.
+class ScratchScope {
+public:
+  ScratchScope() : arena(ScratchArena::borrow()) {}
+  ~ScratchScope() { ScratchArena::release(arena); }
+  ScratchScope(const ScratchScope&) = delete;
+  ScratchScope& operator=(const ScratchScope&) = delete;
+
+  ScratchArena* get() const { return arena; }
+
+private:
+  ScratchArena* arena;
+};
+
+// Append-only, NUL-terminated text in an arena. While it is the newest block
+// it grows in place; otherwise it moves to the end of the arena. Once the
+// arena is full it moves to the heap, so text is never cut short unless the
+// heap is exhausted too (truncated() is then true). Must not outlive the
+// scope it was built in.
+class ScratchString {
+public:
+  explicit ScratchString(ScratchScope& scope, size_t reserve = 64) : ScratchString(scope.get(), reserve) {}
+  explicit ScratchString(ScratchArena* arena, size_t reserve = 64);
+  ~ScratchString();
+  ScratchString(const ScratchString&) = delete;
+  ScratchString& operator=(const ScratchString&) = delete;
+
+  ScratchString& append(const char* text);
+  ScratchString& append(const char* text, size_t length);
+  ScratchString& append(char c) { return append(&c, 1); }
+  ScratchString& appendf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+#ifdef ARDUINO
+  ScratchString& append(const String& text) { return append(text.c_str(), text.length()); }
+#endif
+  template <typename T>
+  ScratchString& operator+=(const T& text) { return append(text); }
+
+  void clear();
+
+  const char* c_str() const { return data ? data : ""; }
+  uint8_t* bytes() { return (uint8_t*)data; }  // For HTTPClient::POST(uint8_t*, size_t)
+  size_t length() const { return used; }
+  bool onHeap() const { return heap; }
+  bool truncated() const { return failed; }
+
+private:
+  ScratchArena* arena;
+  char* data = nullptr;
+  size_t used = 0;
+  size_t reserved = 0;
+  bool heap = false;
+  bool failed = false;
+
+  bool reserve(size_t length);
+};
+
+#endif // SCRATCH_ARENA_H
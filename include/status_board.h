@@ -0,0 +1,68 @@
+#ifndef STATUS_BOARD_H
+#define STATUS_BOARD_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// One person on the status board roster
+struct BoardMember {
+  char upn[BOARD_UPN_LEN];         // As entered in the roster (email or object id)
+  char id[BOARD_ID_LEN];           // Azure AD object id, resolved once
+  TeamsPresence presence;
+  char availability[20];
+  char activity[24];
+  uint8_t resolveFailures;         // Lookups failed in a row; retries back off
+  unsigned long resolveRetryAt;    // millis() of the next lookup after a failure
+};
+
+// App-only (client credentials) presence polling for a whole roster.
+// One cached application token and one getPresencesByUserId call per cycle
+// cover every member, so a single device can drive an office status board.
+//
+// Requires the Presence.Read.All and User.Read.All application permissions
+// and a specific tenant id (client credentials cannot use "common").
+class StatusBoard {
+public:
+  typedef TeamsPresence (*PresenceMapper)(const char* availability, const char* activity);
+
+  void begin(const String& clientId, const String& clientSecret, const String& tenantId,
+             const String& roster, PresenceMapper mapper);
+  void stop();
+  int poll();
+
+  bool isEnabled() const { return enabled; }
+  uint8_t memberCount() const { return count; }
+  const BoardMember& member(uint8_t index) const { return members[index]; }
+  TeamsPresence presenceAt(uint8_t index) const;
+  bool hasToken() const { return appToken.length() > 0; }
+  unsigned long tokenRefreshes() const { return tokenCount; }
+  unsigned long lastPollMillis() const { return lastPoll; }
+  int lastHttpCode() const { return lastCode; }
+
+  static uint8_t parseRoster(const String& roster, BoardMember* out, uint8_t max);
+  static bool isObjectId(const char* value);
+  static unsigned long resolveRetryDelay(uint8_t failures);
+
+private:
+  bool enabled = false;
+  String clientId;
+  String clientSecret;
+  String tenantId;
+  PresenceMapper mapPresence = nullptr;
+
+  BoardMember members[BOARD_MAX_MEMBERS];
+  uint8_t count = 0;
+
+  String appToken;
+  unsigned long tokenAcquired = 0;
+  unsigned long tokenLifetime = 0;
+  unsigned long tokenCount = 0;
+  unsigned long lastPoll = 0;
+  int lastCode = 0;
+
+  bool ensureToken();
+  int resolveMembers();
+  int fetchPresences();
+};
+
+#endif // STATUS_BOARD_H
@@ -0,0 +1,52 @@
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <memory>
+
+// FNV-1a hash of the values a response is built from. When the hash is
+// unchanged the response would be too, so it does not need to be rebuilt.
+class Fingerprint {
+public:
+  Fingerprint& add(uint32_t value);
+  Fingerprint& add(const char* text);
+  Fingerprint& add(const String& text) { return add(text.c_str()); }
+  uint32_t value() const { return hash; }
+
+private:
+  uint32_t hash = 2166136261u;
+  void mix(const uint8_t* data, size_t length);
+};
+
+struct SnapshotEntry {
+  String body;
+  char etag[24];
+  uint32_t version;
+};
+
+// A serialized response body (JSON or MessagePack) that is rebuilt by loop() only when its fingerprint
+// changes and served as-is (or as 304 Not Modified) by the web handlers.
+// Handlers hold a reference to the entry they send, so publishing a newer one
+// never pulls a body out from under a response in flight.
+class StatusSnapshot {
+public:
+  // The boot id keeps ETags from one run from matching the next
+  void begin(uint32_t bootId) { boot = bootId; }
+
+  bool stale(uint32_t fingerprint) const;
+  void publish(uint32_t fingerprint, const String& body);
+  std::shared_ptr<const SnapshotEntry> current() const;
+  uint32_t version() const { return versionCounter; }
+
+  // True when an If-None-Match header names this ETag (or is "*")
+  static bool etagMatches(const String& ifNoneMatch, const char* etag);
+
+private:
+  std::shared_ptr<const SnapshotEntry> entry;
+  uint32_t lastFingerprint = 0;
+  uint32_t versionCounter = 0;
+  uint32_t boot = 0;
+  mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif // STATUS_SNAPSHOT_H
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Device UI Asset Builder
+
+Minifies and gzips the files in ui/ into flash-resident byte arrays so the
+firmware can serve its pages without building them at runtime.
+
+- Each asset is minified, gzipped and hashed (SHA-256, first 16 hex chars)
+- {{hash:<file>}} placeholders in HTML are replaced by that file's hash, so
+  CSS/JS URLs change whenever their content does and can be cached forever
+- Output: include/ui_assets.h (generated, not committed)
+
+Runs automatically as a PlatformIO pre-build script and can also be run by
+hand:
+    python scripts/build_ui.py
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+# Asset file, URL path, content type, Cache-Control
+ASSETS = [
+    ("style.css", "/style.css", "text/css", "public, max-age=31536000, immutable"),
+    ("index.js", "/index.js", "application/javascript", "public, max-age=31536000, immutable"),
+    ("config.js", "/config.js", "application/javascript", "public, max-age=31536000, immutable"),
+    # Pages keep their URL, so browsers revalidate them with the ETag
+    ("index.html", "/", "text/html", "no-cache"),
+    ("config.html", "/config", "text/html", "no-cache"),
+]
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};:,>])\s*", r"\1", text)
+    return text.replace(";}", "}").strip()
+
+
+def minify_js(text):
+    # Conservative: drop comment-only lines and indentation, keep statements intact
+    lines = []
+    for line in text.splitlines():
+        stripped = line.strip()
+        if stripped and not stripped.startswith("//"):
+            lines.append(stripped)
+    return "\n".join(lines)
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    text = re.sub(r">\s+<", "><", text)
+    text = re.sub(r"\n\s*", "\n", text)
+    return text.strip()
+
+
+MINIFIERS = {".css": minify_css, ".js": minify_js, ".html": minify_html}
+
+
+def c_identifier(name):
+    return "ui_" + re.sub(r"[^A-Za-z0-9]", "_", name)
+
+
+def build(project_dir):
+    ui_dir = os.path.join(project_dir, "ui")
+    output = os.path.join(project_dir, "include", "ui_assets.h")
+
+    hashes = {}
+    blobs = []
+    for filename, path, content_type, cache_control in ASSETS:
+        with open(os.path.join(ui_dir, filename), encoding="utf-8") as f:
+            text = f.read()
+
+        # Assets listed earlier are hashed first, so pages can reference them
+        text = re.sub(r"\{\{hash:([^}]+)\}\}", lambda m: hashes[m.group(1)], text)
+        text = MINIFIERS[os.path.splitext(filename)[1]](text)
+
+        # mtime=0 keeps the output byte-identical across builds
+        data = gzip.compress(text.encode("utf-8"), compresslevel=9, mtime=0)
+        digest = hashlib.sha256(data).hexdigest()[:16]
+        hashes[filename] = digest
+        blobs.append((filename, path, content_type, cache_control, data, digest, len(text)))
+
+    lines = [
+        "// Generated by scripts/build_ui.py from ui/ - do not edit",
+        "#ifndef UI_ASSETS_H",
+        "#define UI_ASSETS_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "struct UiAsset {",
+        "  const char* path;",
+        "  const char* contentType;",
+        "  const char* cacheControl;",
+        "  const char* etag;",
+        "  const uint8_t* data;  // gzip-compressed",
+        "  size_t length;",
+        "};",
+        "",
+    ]
+    for filename, _, _, _, data, digest, raw_length in blobs:
+        lines.append(f"// {filename}: {raw_length} bytes minified, {len(data)} bytes gzipped")
+        lines.append(f"static const uint8_t {c_identifier(filename)}[] PROGMEM = {{")
+        for i in range(0, len(data), 16):
+            lines.append("  " + ", ".join(f"0x{b:02x}" for b in data[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const UiAsset UI_ASSETS[] = {")
+    for filename, path, content_type, cache_control, data, digest, _ in blobs:
+        lines.append(f'  {{"{path}", "{content_type}", "{cache_control}", "\\"{digest}\\"", '
+                     f"{c_identifier(filename)}, sizeof({c_identifier(filename)})}},")
+    lines.append("};")
+    lines.append("static const size_t UI_ASSET_COUNT = sizeof(UI_ASSETS) / sizeof(UI_ASSETS[0]);")
+    lines.append("")
+    lines.append("#endif // UI_ASSETS_H")
+    lines.append("")
+    content = "\n".join(lines)
+
+    # Only touch the header when it changes so unchanged UI does not force a rebuild
+    if os.path.exists(output):
+        with open(output, encoding="utf-8") as f:
+            if f.read() == content:
+                return blobs
+    with open(output, "w", encoding="utf-8") as f:
+        f.write(content)
+    return blobs
+
+
+def report(blobs):
+    for filename, path, _, _, data, digest, raw_length in blobs:
+        print(f"UI asset {path:12} {filename:12} {raw_length:6} -> {len(data):5} bytes gzip, etag {digest}")
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    report(build(env.subst("$PROJECT_DIR")))  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        report(build(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))))
+        sys.exit(0)
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""
+Local Presence Relay Stand-in
+
+Minimal stand-in for the presence relay service used to test the firmware's
+push channel without a public Graph change-notification endpoint.
+
+- GET  /stream?user=<email>  Server-sent event stream consumed by the device;
+                             with --key, requires "Authorization: Bearer <key>"
+- POST /presence             Body {"availability": "...", "activity": "..."}
+                             is forwarded to every connected device
+
+Usage:
+    python scripts/presence_relay_stub.py --port 8080
+    curl -X POST http://localhost:8080/presence \\
+         -d '{"availability":"Busy","activity":"InACall"}'
+
+Then set the device's Relay Stream URL to http://<this-host>:8080/stream.
+Use --cycle N to rotate through presence states every N seconds and
+--key SECRET to require the device's Relay Key.
+"""
+
+import argparse
+import hmac
+import itertools
+import json
+import queue
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse, parse_qs
+
+HEARTBEAT_INTERVAL = 15  # Must stay below the firmware's RELAY_IDLE_TIMEOUT (45 s)
+
+CYCLE_STATES = [
+    {"availability": "Available", "activity": "Available"},
+    {"availability": "Busy", "activity": "InACall"},
+    {"availability": "Busy", "activity": "InAMeeting"},
+    {"availability": "Away", "activity": "Away"},
+]
+
+relay_key = ""
+subscribers = []
+subscribers_lock = threading.Lock()
+
+
+def broadcast(presence):
+    """Queue a presence event for every connected stream."""
+    event = "event: presence\ndata: " + json.dumps(presence, separators=(",", ":")) + "\n\n"
+    with subscribers_lock:
+        targets = list(subscribers)
+    for subscriber in targets:
+        subscriber.put((time.monotonic(), event))
+    print(f"📤 Sent {presence} to {len(targets)} device(s)")
+
+
+class RelayHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        url = urlparse(self.path)
+        if url.path != "/stream":
+            self.send_error(404)
+            return
+
+        if relay_key:
+            credential = self.headers.get("Authorization", "")
+            if not hmac.compare_digest(credential, "Bearer " + relay_key):
+                print(f"🚫 Rejected stream from {self.client_address[0]}: missing or wrong key")
+                self.send_error(401)
+                return
+
+        user = parse_qs(url.query).get("user", ["(unknown)"])[0]
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Cache-Control", "no-cache")
+        self.end_headers()
+
+        events = queue.Queue()
+        with subscribers_lock:
+            subscribers.append(events)
+        print(f"🔌 Device connected from {self.client_address[0]} for {user}")
+
+        try:
+            while True:
+                try:
+                    queued_at, event = events.get(timeout=HEARTBEAT_INTERVAL)
+                    self.wfile.write(event.encode())
+                    self.wfile.flush()
+                    print(f"   delivered in {(time.monotonic() - queued_at) * 1000:.1f} ms")
+                except queue.Empty:
+                    self.wfile.write(b": keepalive\n\n")
+                    self.wfile.flush()
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+        finally:
+            with subscribers_lock:
+                subscribers.remove(events)
+            print(f"❌ Device {self.client_address[0]} disconnected")
+
+    def do_POST(self):
+        if urlparse(self.path).path != "/presence":
+            self.send_error(404)
+            return
+
+        length = int(self.headers.get("Content-Length", 0))
+        try:
+            presence = json.loads(self.rfile.read(length) or b"{}")
+        except json.JSONDecodeError:
+            self.send_error(400, "Invalid JSON")
+            return
+
+        broadcast(presence)
+        self.send_response(204)
+        self.end_headers()
+
+    def log_message(self, format, *args):
+        pass  # Keep output focused on relay events
+
+
+def cycle_presence(interval):
+    for presence in itertools.cycle(CYCLE_STATES):
+        time.sleep(interval)
+        broadcast(presence)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local presence relay stand-in")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--cycle", type=float, default=0,
+                        help="rotate presence states every N seconds")
+    parser.add_argument("--key", default="",
+                        help="require this Relay Key as a Bearer token on /stream")
+    args = parser.parse_args()
+
+    global relay_key
+    relay_key = args.key
+
+    if args.cycle > 0:
+        threading.Thread(target=cycle_presence, args=(args.cycle,), daemon=True).start()
+
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), RelayHandler)
+    print(f"🚀 Presence relay stand-in listening on port {args.port}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        print("\n👋 Stopping relay")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Fleet Provisioning Tool
+
+Exports the shared settings of one Teams Red Light device as a versioned
+document and imports it into many devices in parallel. Devices apply the
+document without rebooting, so a whole fleet is provisioned in seconds.
+
+Usage:
+    # Take the settings of a configured device as the template
+    python scripts/provision_fleet.py export --device 192.168.1.50 -o fleet.json
+
+    # Push it to every device listed (one address per line), adding secrets
+    # that export leaves out
+    WIFI_PASSWORD=... CLIENT_SECRET=... \\
+        python scripts/provision_fleet.py push fleet.json --hosts lights.txt
+
+The document is {"version": 1, "config": {...}, "crc32": "<hex>"}. Edit the
+config object freely; push recomputes the checksum before sending.
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+from concurrent.futures import ThreadPoolExecutor
+
+DOCUMENT_VERSION = 1
+
+
+def checksum(config):
+    # Same bytes as the device's minified serialization of the config object
+    text = json.dumps(config, separators=(",", ":"), ensure_ascii=False)
+    return f"{zlib.crc32(text.encode()):08x}"
+
+
+def export(device):
+    with urllib.request.urlopen(f"http://{device}/api/config/export", timeout=10) as response:
+        return json.loads(response.read())
+
+
+def push(device, body, attempts=3):
+    """Returns (device, ok, message, seconds)."""
+    start = time.monotonic()
+    for attempt in range(attempts):
+        request = urllib.request.Request(f"http://{device}/api/config/import", data=body, method="POST")
+        request.add_header("Content-Type", "application/json")
+        try:
+            with urllib.request.urlopen(request, timeout=10) as response:
+                result = json.loads(response.read())
+            changed = ", ".join(result.get("changed", [])) or "nothing"
+            return device, True, f"changed {changed}", time.monotonic() - start
+        except urllib.error.HTTPError as e:
+            # 503 means an earlier update is still being applied; 429 is the rate limit
+            if e.code in (429, 503) and attempt + 1 < attempts:
+                time.sleep(float(e.headers.get("Retry-After", "1")))
+                continue
+            message = e.read().decode(errors="replace")
+            return device, False, f"HTTP {e.code} {message}", time.monotonic() - start
+        except (urllib.error.URLError, OSError) as e:
+            return device, False, f"unreachable: {getattr(e, 'reason', e)}", time.monotonic() - start
+    return device, False, "gave up", time.monotonic() - start
+
+
+def read_hosts(args):
+    hosts = list(args.device or [])
+    if args.hosts:
+        with open(args.hosts, encoding="utf-8") as f:
+            hosts += [line.split("#")[0].strip() for line in f]
+    return [host for host in hosts if host]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Export and import Teams Red Light fleet settings")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    export_parser = commands.add_parser("export", help="save a device's settings as a fleet document")
+    export_parser.add_argument("--device", required=True, help="device IP address or hostname")
+    export_parser.add_argument("-o", "--output", default="-", help="file to write (default: stdout)")
+
+    push_parser = commands.add_parser("push", help="import a fleet document into many devices")
+    push_parser.add_argument("document", help="fleet document from export")
+    push_parser.add_argument("--device", action="append", help="device address (repeatable)")
+    push_parser.add_argument("--hosts", help="file with one device address per line")
+    push_parser.add_argument("--parallel", type=int, default=32, help="devices provisioned at once")
+    push_parser.add_argument("--wifi-password", default=os.environ.get("WIFI_PASSWORD"),
+                             help="WiFi password to add (default: $WIFI_PASSWORD)")
+    push_parser.add_argument("--client-secret", default=os.environ.get("CLIENT_SECRET"),
+                             help="Azure AD client secret to add (default: $CLIENT_SECRET)")
+    push_parser.add_argument("--relay-key", default=os.environ.get("RELAY_KEY"),
+                             help="presence relay key to add (default: $RELAY_KEY)")
+    args = parser.parse_args()
+
+    if args.command == "export":
+        try:
+            document = export(args.device)
+        except (urllib.error.URLError, OSError) as e:
+            print(f"❌ Could not export from {args.device}: {getattr(e, 'reason', e)}", file=sys.stderr)
+            sys.exit(1)
+        text = json.dumps(document, indent=2, ensure_ascii=False) + "\n"
+        if args.output == "-":
+            sys.stdout.write(text)
+        else:
+            with open(args.output, "w", encoding="utf-8") as f:
+                f.write(text)
+            print(f"✅ Exported {args.device} to {args.output}")
+        return
+
+    with open(args.document, encoding="utf-8") as f:
+        document = json.load(f)
+    if document.get("version") != DOCUMENT_VERSION:
+        print(f"❌ Unsupported document version {document.get('version')}", file=sys.stderr)
+        sys.exit(1)
+    config = document["config"]
+    if args.wifi_password:
+        config["wifi_password"] = args.wifi_password
+    if args.client_secret:
+        config["client_secret"] = args.client_secret
+    if args.relay_key:
+        config["relay_key"] = args.relay_key
+    document["crc32"] = checksum(config)
+    body = json.dumps(document, separators=(",", ":"), ensure_ascii=False).encode()
+
+    hosts = read_hosts(args)
+    if not hosts:
+        print("❌ No devices given (use --device or --hosts)", file=sys.stderr)
+        sys.exit(1)
+
+    start = time.monotonic()
+    failed = 0
+    with ThreadPoolExecutor(max_workers=max(1, args.parallel)) as pool:
+        for device, ok, message, seconds in pool.map(lambda host: push(host, body), hosts):
+            print(f"{'✅' if ok else '❌'} {device:<21} {seconds:5.1f}s  {message}")
+            failed += not ok
+    elapsed = time.monotonic() - start
+    print(f"\n{len(hosts) - failed}/{len(hosts)} devices provisioned in {elapsed:.1f}s")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
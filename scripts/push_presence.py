@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Local Presence Push Client
+
+Pushes presence straight to a Teams Red Light device from a desk-side agent
+(call started, camera on, ...). The pushed state takes precedence over the
+Graph poll until its TTL expires, so agents should re-send it while the state
+lasts and clear it when it ends.
+
+Usage:
+    python scripts/push_presence.py --device 192.168.1.50 --key <api key> \\
+        --availability Busy --activity InACall --ttl 120
+    python scripts/push_presence.py --device 192.168.1.50 --key <api key> --clear
+
+The API key is shown once, when it is generated on the device configuration page.
+"""
+
+import argparse
+import json
+import sys
+import urllib.error
+import urllib.request
+
+
+def push(device, key, method, payload=None):
+    data = json.dumps(payload).encode() if payload is not None else None
+    request = urllib.request.Request(f"http://{device}/api/presence", data=data, method=method)
+    request.add_header("Authorization", f"Bearer {key}")
+    request.add_header("Content-Type", "application/json")
+    with urllib.request.urlopen(request, timeout=5) as response:
+        return json.loads(response.read() or b"{}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Push presence to a Teams Red Light device")
+    parser.add_argument("--device", required=True, help="device IP address or hostname")
+    parser.add_argument("--key", required=True, help="API key shown when it was generated")
+    parser.add_argument("--availability", default="Busy")
+    parser.add_argument("--activity", default="InACall")
+    parser.add_argument("--ttl", type=int, default=0, help="seconds (0 = device default)")
+    parser.add_argument("--source", default="push_presence.py")
+    parser.add_argument("--clear", action="store_true", help="drop the active push")
+    args = parser.parse_args()
+
+    try:
+        if args.clear:
+            result = push(args.device, args.key, "DELETE")
+        else:
+            result = push(args.device, args.key, "POST", {
+                "availability": args.availability,
+                "activity": args.activity,
+                "ttl": args.ttl,
+                "source": args.source,
+            })
+    except urllib.error.HTTPError as e:
+        print(f"❌ Device rejected push: HTTP {e.code} {e.read().decode(errors='replace')}")
+        sys.exit(1)
+    except urllib.error.URLError as e:
+        print(f"❌ Could not reach device: {e.reason}")
+        sys.exit(1)
+
+    print(f"✅ {json.dumps(result)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#include "admission.h"
+
+#define ADMISSION_MILLI_BURST ((uint32_t)ADMISSION_BURST * 1000)
+
+AdmissionControl::Result AdmissionControl::admit(uint32_t client, RoutePriority priority, unsigned long now, uint32_t& retryAfter) {
+  // The concurrency cap is checked first, so a refused request costs no tokens
+  uint8_t limit = priority == PRIORITY_HIGH ? ADMISSION_MAX_ACTIVE
+                : priority == PRIORITY_NORMAL ? ADMISSION_MAX_ACTIVE_NORMAL
+                : ADMISSION_MAX_ACTIVE_LOW;
+  if (active >= limit) {
+    retryAfter = 1;
+    rejected[OVERLOADED]++;
+    return OVERLOADED;
+  }
+
+  Bucket& bucket = bucketFor(client, now);
+  // One token per 1000 / rate ms; tokens are kept in thousandths
+  uint32_t elapsed = min((uint32_t)(now - bucket.updatedAt), ADMISSION_MILLI_BURST / ADMISSION_REFILL_PER_SECOND);
+  bucket.milliTokens = min(bucket.milliTokens + elapsed * ADMISSION_REFILL_PER_SECOND, ADMISSION_MILLI_BURST);
+  bucket.updatedAt = now;
+
+  uint32_t cost = (priority == PRIORITY_LOW ? ADMISSION_LOW_PRIORITY_COST : 1) * 1000;
+  if (bucket.milliTokens < cost) {
+    uint32_t waitMillis = (cost - bucket.milliTokens + ADMISSION_REFILL_PER_SECOND - 1) / ADMISSION_REFILL_PER_SECOND;
+    retryAfter = (waitMillis + 999) / 1000;
+    rejected[RATE_LIMITED]++;
+    return RATE_LIMITED;
+  }
+
+  bucket.milliTokens -= cost;
+  active++;
+  return ADMITTED;
+}
+
+void AdmissionControl::release() {
+  if (active > 0) {
+    active--;
+  }
+}
+
+RoutePriority AdmissionControl::priorityFor(const char* path) {
+  if (strcmp(path, "/status") == 0 || strcmp(path, "/api/snapshot") == 0) {
+    return PRIORITY_HIGH;
+  }
+  if (strcmp(path, "/schedule") == 0 || strcmp(path, "/location") == 0 ||
+      strcmp(path, "/logs") == 0 || strcmp(path, "/presence-history") == 0) {
+    return PRIORITY_LOW;
+  }
+  return PRIORITY_NORMAL;
+}
+
+// Finds the client's bucket, recycling the least recently used one for a new
+// client. A new client starts with a full bucket.
+AdmissionControl::Bucket& AdmissionControl::bucketFor(uint32_t client, unsigned long now) {
+  uint8_t oldest = 0;
+  for (uint8_t i = 0; i < clients; i++) {
+    if (buckets[i].client == client) {
+      return buckets[i];
+    }
+    if (now - buckets[i].updatedAt > now - buckets[oldest].updatedAt) {
+      oldest = i;
+    }
+  }
+
+  uint8_t slot = clients < ADMISSION_MAX_CLIENTS ? clients++ : oldest;
+  buckets[slot].client = client;
+  buckets[slot].milliTokens = ADMISSION_MILLI_BURST;
+  buckets[slot].updatedAt = now;
+  return buckets[slot];
+}
@@ -0,0 +1,304 @@
+#include "alloc_counter.h"
+
+#ifdef ALLOC_COUNTER
+
+static uint32_t allocationCount = 0;
+static uint32_t freeCount = 0;
+
+// Both cores and the host allocate, so counts are atomic
+static inline void countAllocation() {
+  __atomic_fetch_add(&allocationCount, 1, __ATOMIC_RELAXED);
+}
+
+static inline void countFree() {
+  __atomic_fetch_add(&freeCount, 1, __ATOMIC_RELAXED);
+}
+
+#ifdef ARDUINO
+
+// The linker sends every malloc reference here and the original becomes
+// __real_malloc
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void __real_free(void* pointer);
+
+void* __wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+  if (size > 0) {
+    countAllocation();
+  }
+  return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void* pointer) {
+  if (pointer != nullptr) {
+    countFree();
+  }
+  __real_free(pointer);
+}
+}
+
+#else
+
+// Host: glibc's own entry points sit under the malloc defined here
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+}
+
+#ifdef ALLOC_SITES
+#include <algorithm>
+#include <cstring>
+#include <execinfo.h>
+
+#define SITE_DEPTH 8     // Frames kept per stack, below the allocator's own
+#define SITE_SLOTS 4096  // Distinct stacks; allocations from further stacks are only counted
+#define LIVE_BITS 18     // Allocations tracked until freed: 2^18
+
+struct AllocSite {
+  uint64_t hash;  // 0 while the slot is unused
+  void* frames[SITE_DEPTH];
+  int depth;
+  uint64_t count;
+  uint64_t bytes;
+  int64_t liveCount;
+  int64_t liveBytes;
+};
+
+struct LiveBlock {
+  void* pointer;  // nullptr while the slot is unused
+  size_t size;
+  int site;
+};
+
+static AllocSite sites[SITE_SLOTS];
+static int sitesUsed = 0;
+static LiveBlock live[1 << LIVE_BITS];
+static int liveUsed = 0;
+static int siteLock = 0;
+static thread_local bool recording = false;  // backtrace() allocates on first use
+
+static void lockSites() {
+  while (__atomic_exchange_n(&siteLock, 1, __ATOMIC_ACQUIRE)) {
+  }
+}
+
+static void unlockSites() {
+  __atomic_store_n(&siteLock, 0, __ATOMIC_RELEASE);
+}
+
+static size_t liveSlot(const void* pointer) {
+  return (size_t)(((uintptr_t)pointer >> 4) * 0x9E3779B97F4A7C15ull >> (64 - LIVE_BITS));
+}
+
+static int findSite(void* const* frames, int depth) {
+  uint64_t hash = 1469598103934665603ull;
+  for (int i = 0; i < depth; i++) {
+    hash = (hash ^ (uintptr_t)frames[i]) * 1099511628211ull;
+  }
+  hash |= 1;
+  for (size_t i = hash % SITE_SLOTS, probes = 0; probes < SITE_SLOTS; i = (i + 1) % SITE_SLOTS, probes++) {
+    AllocSite& site = sites[i];
+    if (site.hash == hash && site.depth == depth && memcmp(site.frames, frames, depth * sizeof(void*)) == 0) {
+      return i;
+    }
+    if (site.hash == 0) {
+      // Keep probe chains short; later stacks go unattributed
+      if (sitesUsed >= SITE_SLOTS * 3 / 4) {
+        return -1;
+      }
+      site.hash = hash;
+      site.depth = depth;
+      memcpy(site.frames, frames, depth * sizeof(void*));
+      sitesUsed++;
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void forgetBlock(void* pointer) {
+  size_t mask = (1 << LIVE_BITS) - 1;
+  size_t i = liveSlot(pointer);
+  while (live[i].pointer != pointer) {
+    if (live[i].pointer == nullptr) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  sites[live[i].site].liveCount--;
+  sites[live[i].site].liveBytes -= live[i].size;
+  liveUsed--;
+
+  // Backward-shift deletion keeps every probe chain unbroken
+  size_t hole = i;
+  for (size_t next = (hole + 1) & mask; live[next].pointer != nullptr; next = (next + 1) & mask) {
+    size_t home = liveSlot(live[next].pointer);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      live[hole] = live[next];
+      hole = next;
+    }
+  }
+  live[hole].pointer = nullptr;
+}
+
+// noinline keeps the frames to skip fixed: this function and malloc
+static void __attribute__((noinline)) recordBlock(void* pointer, size_t size) {
+  if (pointer == nullptr || recording) {
+    return;
+  }
+  recording = true;
+  void* stack[SITE_DEPTH + 2];
+  int depth = backtrace(stack, SITE_DEPTH + 2) - 2;
+  lockSites();
+  int site = depth > 0 ? findSite(stack + 2, depth) : -1;
+  if (site >= 0) {
+    sites[site].count++;
+    sites[site].bytes += size;
+    // A nearly full table stops tracking new blocks rather than probing forever
+    if (liveUsed < (1 << LIVE_BITS) * 3 / 4) {
+      size_t i = liveSlot(pointer);
+      while (live[i].pointer != nullptr) {
+        i = (i + 1) & ((1 << LIVE_BITS) - 1);
+      }
+      live[i] = {pointer, size, site};
+      liveUsed++;
+      sites[site].liveCount++;
+      sites[site].liveBytes += size;
+    }
+  }
+  unlockSites();
+  recording = false;
+}
+
+static void releaseBlock(void* pointer) {
+  lockSites();
+  forgetBlock(pointer);
+  unlockSites();
+}
+
+void AllocCounter::reportSites(FILE* out, int top) {
+  static int order[SITE_SLOTS];
+  static AllocSite shown[64];
+  top = std::min(top, (int)(sizeof(shown) / sizeof(shown[0])));
+
+  // Copy under the lock, print without it: printing allocates and frees
+  lockSites();
+  int used = 0;
+  for (int i = 0; i < SITE_SLOTS; i++) {
+    if (sites[i].hash != 0) {
+      order[used++] = i;
+    }
+  }
+  top = std::min(top, used);
+  std::partial_sort(order, order + top, order + used, [](int a, int b) {
+    if (sites[a].liveBytes != sites[b].liveBytes) {
+      return sites[a].liveBytes > sites[b].liveBytes;
+    }
+    return sites[a].count > sites[b].count;
+  });
+  for (int i = 0; i < top; i++) {
+    shown[i] = sites[order[i]];
+  }
+  unlockSites();
+
+  bool wasRecording = recording;
+  recording = true;
+  fprintf(out, "Allocation sites: %d stacks, %u allocations, %u frees\n",
+          used, AllocCounter::allocations(), AllocCounter::frees());
+  for (int i = 0; i < top; i++) {
+    fprintf(out, "\n#%d  %lld bytes live in %lld blocks; %llu allocations, %llu bytes in all\n", i + 1,
+            (long long)shown[i].liveBytes, (long long)shown[i].liveCount,
+            (unsigned long long)shown[i].count, (unsigned long long)shown[i].bytes);
+    fflush(out);
+    backtrace_symbols_fd(shown[i].frames, shown[i].depth, fileno(out));
+  }
+  fflush(out);
+  recording = wasRecording;
+}
+
+#define RECORD(pointer, size) recordBlock(pointer, size)
+#define RELEASE(pointer) releaseBlock(pointer)
+#else
+#define RECORD(pointer, size)
+#define RELEASE(pointer)
+#endif // ALLOC_SITES
+
+extern "C" {
+void* malloc(size_t size) {
+  countAllocation();
+  void* pointer = __libc_malloc(size);
+  RECORD(pointer, size);
+  return pointer;
+}
+
+void* calloc(size_t count, size_t size) {
+  countAllocation();
+  void* pointer = __libc_calloc(count, size);
+  RECORD(pointer, count * size);
+  return pointer;
+}
+
+void* realloc(void* pointer, size_t size) {
+  if (size > 0) {
+    countAllocation();
+  }
+  void* moved = __libc_realloc(pointer, size);
+  if (pointer != nullptr && (moved != nullptr || size == 0)) {
+    RELEASE(pointer);
+  }
+  RECORD(moved, size);
+  return moved;
+}
+
+void free(void* pointer) {
+  if (pointer != nullptr) {
+    countFree();
+    RELEASE(pointer);
+  }
+  __libc_free(pointer);
+}
+}
+
+#endif // ARDUINO
+
+bool AllocCounter::enabled() {
+  return true;
+}
+
+uint32_t AllocCounter::allocations() {
+  return __atomic_load_n(&allocationCount, __ATOMIC_RELAXED);
+}
+
+uint32_t AllocCounter::frees() {
+  return __atomic_load_n(&freeCount, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool AllocCounter::enabled() {
+  return false;
+}
+
+uint32_t AllocCounter::allocations() {
+  return 0;
+}
+
+uint32_t AllocCounter::frees() {
+  return 0;
+}
+
+#endif // ALLOC_COUNTER
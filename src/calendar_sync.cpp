@@ -0,0 +1,400 @@
+#include "calendar_sync.h"
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include "graph_stream.h"
+#include "logging.h"
+#include "scratch_arena.h"
+
+// CalendarStore implementation
+void CalendarStore::clear() {
+  portENTER_CRITICAL(&lock);
+  eventCount = 0;
+  wasTruncated = false;
+  portEXIT_CRITICAL(&lock);
+}
+
+int CalendarStore::indexOf(uint32_t idHash) const {
+  for (uint8_t i = 0; i < eventCount; i++) {
+    if (events[i].idHash == idHash) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool CalendarStore::upsert(const CalendarEvent& event) {
+  portENTER_CRITICAL(&lock);
+  int existing = indexOf(event.idHash);
+  if (existing >= 0) {
+    if (memcmp(&events[existing], &event, sizeof(CalendarEvent)) == 0) {
+      portEXIT_CRITICAL(&lock);
+      return false; // Unchanged
+    }
+    removeAt(existing);
+  }
+
+  // Store is full - keep the earliest events, drop the one furthest in the
+  // future. Either way an event is gone that a delta will not send again.
+  bool dropped = false;
+  if (eventCount >= CALENDAR_MAX_EVENTS) {
+    wasTruncated = true;
+    if (event.start >= events[eventCount - 1].start) {
+      dropped = true;
+    } else {
+      eventCount--;
+    }
+  }
+
+  if (!dropped) {
+    // Insert keeping the array ordered by start time
+    uint8_t pos = eventCount;
+    while (pos > 0 && events[pos - 1].start > event.start) {
+      events[pos] = events[pos - 1];
+      pos--;
+    }
+    events[pos] = event;
+    eventCount++;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if (dropped) {
+    LOG_WARNF("Calendar store full (%d events), dropping event starting at %ld", CALENDAR_MAX_EVENTS, (long)event.start);
+  }
+  return !dropped;
+}
+
+bool CalendarStore::remove(uint32_t idHash) {
+  portENTER_CRITICAL(&lock);
+  int index = indexOf(idHash);
+  if (index >= 0) {
+    removeAt(index);
+  }
+  portEXIT_CRITICAL(&lock);
+  return index >= 0;
+}
+
+// Callers hold the lock
+void CalendarStore::removeAt(int index) {
+  for (uint8_t i = index; i + 1 < eventCount; i++) {
+    events[i] = events[i + 1];
+  }
+  eventCount--;
+}
+
+bool CalendarStore::next(const CalendarEvent* after, CalendarEvent& out) const {
+  portENTER_CRITICAL(&lock);
+  int found = -1;
+  for (uint8_t i = 0; i < eventCount; i++) {
+    const CalendarEvent& event = events[i];
+    bool later = after == nullptr || event.start > after->start ||
+                 (event.start == after->start && event.idHash > after->idHash);
+    if (later && (found < 0 || event.start < events[found].start ||
+                  (event.start == events[found].start && event.idHash < events[found].idHash))) {
+      found = i;
+    }
+  }
+  if (found >= 0) {
+    out = events[found];
+  }
+  portEXIT_CRITICAL(&lock);
+  return found >= 0;
+}
+
+void CalendarStore::load(MeteredPreferences& prefs) {
+  eventCount = 0;
+  size_t length = prefs.getBytesLength(KEY_CALENDAR_EVENTS);
+  if (length == 0) {
+    return;
+  }
+  if (length % sizeof(CalendarEvent) != 0 || length > sizeof(events)) {
+    LOG_WARNF("Ignoring stored calendar events with unexpected size %d", length);
+    return;
+  }
+  prefs.getBytes(KEY_CALENDAR_EVENTS, events, length);
+  eventCount = length / sizeof(CalendarEvent);
+  // Whether events were dropped is not stored; a full store may have been
+  wasTruncated = eventCount >= CALENDAR_MAX_EVENTS;
+}
+
+void CalendarStore::save(MeteredPreferences& prefs) const {
+  if (eventCount == 0) {
+    prefs.remove(KEY_CALENDAR_EVENTS);
+    return;
+  }
+  prefs.putBytes(KEY_CALENDAR_EVENTS, events, eventCount * sizeof(CalendarEvent));
+}
+
+uint32_t CalendarStore::hashId(const char* id) {
+  // FNV-1a 32-bit
+  uint32_t hash = 2166136261UL;
+  while (*id) {
+    hash ^= (uint8_t)*id++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// CalendarSync implementation
+void CalendarSync::begin(MeteredPreferences* prefs) {
+  preferences = prefs;
+  eventStore.load(*preferences);
+  deltaLink = preferences->getString(KEY_CALENDAR_DELTA, "");
+  windowStart = (time_t)preferences->getULong64(KEY_CALENDAR_WINDOW, 0);
+  LOG_INFOF("Loaded %d calendar events (delta link %s)", eventStore.count(), deltaLink.length() > 0 ? "available" : "not available");
+}
+
+void CalendarSync::reset() {
+  LOG_INFO("Resetting calendar store and delta link");
+  eventStore.clear();
+  deltaLink = "";
+  windowStart = 0;
+  lastSyncTime = 0;
+  lastDeltaPersist = 0;
+  if (preferences) {
+    preferences->remove(KEY_CALENDAR_EVENTS);
+    preferences->remove(KEY_CALENDAR_DELTA);
+    preferences->remove(KEY_CALENDAR_WINDOW);
+  }
+}
+
+int CalendarSync::sync(const String& accessToken) {
+  if (time(nullptr) < 1000000000) {
+    LOG_WARN("Cannot sync calendar - time not configured");
+    return -1;
+  }
+
+  // The delta link is bound to the window it was created for, so a new day
+  // means a fresh full sync of the new window.
+  time_t window = currentWindowStart();
+  if (window != windowStart) {
+    if (windowStart != 0) {
+      LOG_INFO("Calendar window moved to a new day, starting full resync");
+    }
+    eventStore.clear();
+    deltaLink = "";
+    windowStart = window;
+  }
+
+  bool fullSync = deltaLink.length() == 0;
+  String url = fullSync ? initialUrl() : deltaLink;
+  bool changed = fullSync;
+  bool restarted = false;
+  uint8_t countBefore = eventStore.count();
+  LOG_DEBUGF("Starting %s calendar sync", fullSync ? "full" : "delta");
+
+  for (int page = 0; page < CALENDAR_MAX_PAGES; page++) {
+    String nextLink;
+    String newDeltaLink;
+    int httpCode = fetchPage(url, accessToken, nextLink, newDeltaLink, changed);
+
+    if (httpCode == 410 && !restarted) {
+      // Delta token expired or invalidated by the service - start over
+      LOG_WARN("Calendar delta link expired (HTTP 410), starting full resync");
+      eventStore.clear();
+      deltaLink = "";
+      url = initialUrl();
+      changed = true;
+      restarted = true;
+      continue;
+    }
+
+    if (httpCode != HTTP_CODE_OK) {
+      return httpCode;
+    }
+
+    if (nextLink.length() > 0) {
+      url = nextLink;
+      continue;
+    }
+
+    // Once the store has dropped events, a delta that changes anything may
+    // have made room for one of them, which only a full sync brings back
+    if (newDeltaLink.length() > 0 && !fullSync && !restarted && eventStore.truncated() &&
+        (changed || eventStore.count() != countBefore)) {
+      LOG_INFO("Calendar store is full and the delta changed it, starting full resync");
+      eventStore.clear();
+      deltaLink = "";
+      url = initialUrl();
+      changed = true;
+      restarted = true;
+      continue;
+    }
+
+    if (newDeltaLink.length() > 0) {
+      deltaLink = newDeltaLink;
+      lastSyncTime = millis();
+      persist(changed);
+      LOG_DEBUGF("Calendar sync complete (%d events, %s)", eventStore.count(), changed ? "changed" : "unchanged");
+      return HTTP_CODE_OK;
+    }
+
+    LOG_ERROR("Calendar delta response contained neither next nor delta link");
+    return -1;
+  }
+
+  LOG_WARNF("Calendar sync stopped after %d pages", CALENDAR_MAX_PAGES);
+  return -1;
+}
+
+int CalendarSync::fetchPage(const String& url, const String& accessToken, String& nextLink, String& newDeltaLink, bool& changed) {
+  WiFiClientSecure secureClient;
+  secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
+  HTTPClient http;
+  ScratchScope scratch;
+  ScratchString authorization(scratch, 8 + accessToken.length());
+  authorization.append("Bearer ").append(accessToken);
+  ScratchString prefer(scratch, 64);
+  prefer.appendf("outlook.timezone=\"UTC\", odata.maxpagesize=%d", CALENDAR_PAGE_SIZE);
+
+  http.begin(secureClient, url);
+  http.addHeader("Authorization", authorization.c_str());
+  http.addHeader("User-Agent", "TeamsRedLight/1.0");
+  http.addHeader("Prefer", prefer.c_str());
+
+  // HTTP/1.0 keeps the body free of chunked framing so it can be parsed
+  // straight off the socket
+  http.useHTTP10(true);
+
+  int httpCode = http.GET();
+  LOG_DEBUGF("Calendar delta response: HTTP %d", httpCode);
+
+  if (httpCode != HTTP_CODE_OK) {
+    if (httpCode != 410) {
+      LOG_ERRORF("Calendar delta request failed with HTTP %d", httpCode);
+    }
+    http.end();
+    return httpCode;
+  }
+
+  // Only keep the fields the store needs
+  StaticJsonDocument<256> filter;
+  filter["id"] = true;
+  filter["@removed"] = true;
+  filter["subject"] = true;
+  filter["isAllDay"] = true;
+  filter["showAs"] = true;
+  filter["start"]["dateTime"] = true;
+  filter["end"]["dateTime"] = true;
+
+  // Events are parsed one at a time off the stream, so a page costs the
+  // same memory no matter how many events it carries
+  StaticJsonDocument<CALENDAR_ITEM_DOC_SIZE> item;
+  GraphPageReader reader(http.getStream(), item, filter);
+  bool ok = reader.read([&](JsonObject event) {
+    if (applyEvent(event)) {
+      changed = true;
+    }
+  });
+  http.end();
+
+  if (!ok) {
+    LOG_ERRORF("Failed to parse calendar delta page after %d events: %s", reader.itemCount(), reader.error());
+    return -1;
+  }
+
+  nextLink = reader.nextLink();
+  newDeltaLink = reader.deltaLink();
+  return HTTP_CODE_OK;
+}
+
+bool CalendarSync::applyEvent(JsonObject item) {
+  const char* id = item["id"];
+  if (id == nullptr) {
+    return false;
+  }
+  uint32_t idHash = CalendarStore::hashId(id);
+
+  if (!item["@removed"].isNull()) {
+    return eventStore.remove(idHash);
+  }
+
+  CalendarEvent event;
+  memset(&event, 0, sizeof(event));
+  event.idHash = idHash;
+  event.start = parseDateTime(item["start"]["dateTime"] | "");
+  event.end = parseDateTime(item["end"]["dateTime"] | "");
+  event.showAs = parseShowAs(item["showAs"] | "");
+  event.isAllDay = item["isAllDay"] | false;
+  strlcpy(event.subject, item["subject"] | "", sizeof(event.subject));
+
+  return eventStore.upsert(event);
+}
+
+void CalendarSync::persist(bool eventsChanged) {
+  if (preferences == nullptr) {
+    return;
+  }
+
+  if (eventsChanged) {
+    eventStore.save(*preferences);
+  }
+
+  // Graph hands out a new delta link on every round trip. Older links stay
+  // valid, so an unchanged store only refreshes the stored link occasionally
+  // to spare flash writes.
+  if (eventsChanged || lastDeltaPersist == 0 || millis() - lastDeltaPersist > CALENDAR_DELTA_PERSIST_INTERVAL) {
+    preferences->putString(KEY_CALENDAR_DELTA, deltaLink);
+    preferences->putULong64(KEY_CALENDAR_WINDOW, (uint64_t)windowStart);
+    lastDeltaPersist = millis();
+  }
+}
+
+time_t CalendarSync::currentWindowStart() const {
+  // Local midnight, expressed as a UTC epoch
+  time_t now = time(nullptr);
+  struct tm local;
+  localtime_r(&now, &local);
+  return now - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+}
+
+String CalendarSync::initialUrl() const {
+  char startTime[32], endTime[32];
+  formatDateTime(windowStart, startTime, sizeof(startTime));
+  formatDateTime(windowStart + CALENDAR_SYNC_DAYS * 86400L, endTime, sizeof(endTime));
+  return "https://graph.microsoft.com/v1.0/me/calendarView/delta?startDateTime=" + String(startTime) + "Z&endDateTime=" + String(endTime) + "Z";
+}
+
+time_t CalendarSync::parseDateTime(const char* dateTime) {
+  // Graph format: 2024-01-15T09:30:00.0000000 (UTC, fractional seconds ignored)
+  int year, month, day, hour, minute, second;
+  if (sscanf(dateTime, "%4d-%2d-%2dT%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+
+  // Days since 1970-01-01 (civil calendar, valid for years >= 1970)
+  int y = year - (month <= 2 ? 1 : 0);
+  int era = y / 400;
+  int yearOfEra = y - era * 400;
+  int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  long days = (long)era * 146097 + dayOfEra - 719468;
+
+  return (time_t)(days * 86400L + hour * 3600L + minute * 60L + second);
+}
+
+void CalendarSync::formatDateTime(time_t t, char* buffer, size_t size) {
+  struct tm utc;
+  gmtime_r(&t, &utc);
+  strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &utc);
+}
+
+uint8_t CalendarSync::parseShowAs(const char* showAs) {
+  if (strcmp(showAs, "free") == 0) return SHOW_AS_FREE;
+  if (strcmp(showAs, "tentative") == 0) return SHOW_AS_TENTATIVE;
+  if (strcmp(showAs, "busy") == 0) return SHOW_AS_BUSY;
+  if (strcmp(showAs, "oof") == 0) return SHOW_AS_OOF;
+  if (strcmp(showAs, "workingElsewhere") == 0) return SHOW_AS_WORKING_ELSEWHERE;
+  return SHOW_AS_UNKNOWN;
+}
+
+const char* CalendarSync::showAsName(uint8_t showAs) {
+  switch (showAs) {
+    case SHOW_AS_FREE: return "free";
+    case SHOW_AS_TENTATIVE: return "tentative";
+    case SHOW_AS_BUSY: return "busy";
+    case SHOW_AS_OOF: return "oof";
+    case SHOW_AS_WORKING_ELSEWHERE: return "workingElsewhere";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,33 @@
+#include "cursor_read.h"
+
+CursorWindow CursorQuery::window(uint32_t lastSeq, int count) const {
+  CursorWindow result;
+  result.end = max(count, 0);
+  result.oldestSeq = lastSeq - result.end + 1;
+  result.cursor = lastSeq;
+  if (count <= 0) {
+    return result;
+  }
+
+  uint32_t oldestSeq = result.oldestSeq;
+  if (hasSince && since <= lastSeq) {
+    if (since + 1 < oldestSeq) {
+      result.missed = true;
+    } else {
+      result.first = since + 1 - oldestSeq;
+    }
+    if (limit > 0 && result.end - result.first > limit) {
+      result.end = result.first + limit;
+      result.more = true;
+      result.cursor = result.seqAt(result.end - 1);
+    }
+  } else if (!hasSince && limit > 0 && count > limit) {
+    // Tail: the newest entries
+    result.first = count - limit;
+  }
+  return result;
+}
+
+bool CursorQuery::satisfiedBy(uint32_t lastSeq) const {
+  return !hasSince || since != lastSeq;
+}
@@ -0,0 +1,31 @@
+#include "dashboard_events.h"
+
+bool DashboardDelta::write(const DashboardState& current, JsonDocument& delta) {
+  delta.clear();
+  uint8_t count = min(current.ledCount, (uint8_t)MAX_LEDS);
+
+  if (!primed || strcmp(state, current.state) != 0) {
+    strlcpy(state, current.state, sizeof(state));
+    delta["state"] = current.state;
+  }
+  if (!primed || strcmp(presence, current.presence) != 0) {
+    strlcpy(presence, current.presence, sizeof(presence));
+    delta["presence"] = current.presence;
+  }
+
+  bool ledsChanged = !primed || count != ledCount;
+  for (uint8_t i = 0; i < count && !ledsChanged; i++) {
+    ledsChanged = ledPresence[i] != current.ledPresence[i];
+  }
+  if (ledsChanged) {
+    ledCount = count;
+    JsonArray leds = delta.createNestedArray("led_presence");
+    for (uint8_t i = 0; i < count; i++) {
+      ledPresence[i] = current.ledPresence[i];
+      leds.add(ledPresence[i]);
+    }
+  }
+
+  primed = true;
+  return delta.size() > 0;
+}
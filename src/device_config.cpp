@@ -0,0 +1,316 @@
+#include "device_config.h"
+#include "gzip_stream.h"
+
+static const char* const PATTERN_KEYS[] = {"call", "meeting", "available", "away", "offline"};
+
+// Preferences key prefixes, in LedKey order
+static const char* const LED_KEY_PREFIXES[LED_KEY_COUNT] = {
+  KEY_LED_PIN_PREFIX, KEY_LED_CALL_PATTERN_PREFIX, KEY_LED_MEETING_PATTERN_PREFIX,
+  KEY_LED_AVAILABLE_PATTERN_PREFIX, KEY_LED_AWAY_PATTERN_PREFIX, KEY_LED_OFFLINE_PATTERN_PREFIX
+};
+
+// Names of the ConfigChange bits, lowest bit first
+static const char* const CHANGE_NAMES[] = {
+  "wifi", "account", "relay", "board", "push", "ota", "time", "led_pins", "led_patterns"
+};
+
+static LEDPattern* patternField(LedSettings& led, uint8_t index) {
+  LEDPattern* fields[] = {&led.call, &led.meeting, &led.available, &led.away, &led.offline};
+  return fields[index];
+}
+
+// Reads an optional string member; false when present with another type
+static bool readString(JsonObjectConst body, const char* key, String& value, String& error) {
+  JsonVariantConst member = body[key];
+  if (member.isNull()) {
+    return true;
+  }
+  if (!member.is<const char*>()) {
+    error = String(key) + " must be a string";
+    return false;
+  }
+  value = member.as<const char*>();
+  return true;
+}
+
+// Reads an optional integer member within [low, high]
+static bool readInt(JsonObjectConst body, const char* key, long low, long high, long& value, bool& present, String& error) {
+  JsonVariantConst member = body[key];
+  present = !member.isNull();
+  if (!present) {
+    return true;
+  }
+  if (!member.is<long>() || member.as<long>() < low || member.as<long>() > high) {
+    error = String(key) + " must be an integer from " + low + " to " + high;
+    return false;
+  }
+  value = member.as<long>();
+  return true;
+}
+
+LedSettings DeviceConfig::defaultLed(uint8_t pin) {
+  return {pin, DEFAULT_CALL_PATTERN, DEFAULT_MEETING_PATTERN, DEFAULT_AVAILABLE_PATTERN, DEFAULT_AWAY_PATTERN, DEFAULT_OFFLINE_PATTERN};
+}
+
+void DeviceConfig::ledKey(LedKey setting, uint8_t index, char (&key)[LED_KEY_SIZE]) {
+  snprintf(key, sizeof(key), "%s%u", LED_KEY_PREFIXES[setting], index);
+}
+
+bool DeviceConfig::update(JsonObjectConst body, const uint8_t* validPins, uint8_t validPinCount, String& error) {
+  DeviceConfig next = *this;
+  String secret;
+
+  if (!readString(body, "wifi_ssid", next.wifiSSID, error) ||
+      !readString(body, "user_email", next.userEmail, error) ||
+      !readString(body, "tenant_id", next.tenantId, error) ||
+      !readString(body, "client_id", next.clientId, error) ||
+      !readString(body, "relay_url", next.relayUrl, error) ||
+      !readString(body, "board_roster", next.boardRoster, error) ||
+      !readString(body, "ota_url", next.otaUrl, error)) {
+    return false;
+  }
+  next.relayUrl.trim();
+  next.boardRoster.trim();
+  if (next.tenantId.length() == 0) {
+    next.tenantId = "common";
+  }
+
+  // Secrets are never returned by GET, so an empty value keeps the stored one
+  if (!readString(body, "wifi_password", secret, error)) {
+    return false;
+  }
+  if (secret.length() > 0) {
+    next.wifiPassword = secret;
+  }
+  secret = "";
+  if (!readString(body, "client_secret", secret, error)) {
+    return false;
+  }
+  if (secret.length() > 0) {
+    next.clientSecret = secret;
+  }
+  secret = "";
+  if (!readString(body, "relay_key", secret, error)) {
+    return false;
+  }
+  if (secret.length() > 0) {
+    next.relayKey = secret;
+  }
+
+  if (!body["board_mode"].isNull()) {
+    if (!body["board_mode"].is<bool>()) {
+      error = "board_mode must be true or false";
+      return false;
+    }
+    next.boardMode = body["board_mode"].as<bool>();
+  }
+
+  long value = 0;
+  bool present = false;
+  if (!readInt(body, "push_ttl", 10, LOCAL_PUSH_MAX_TTL, value, present, error)) {
+    return false;
+  }
+  if (present) {
+    next.pushTtl = value;
+  }
+  if (!readInt(body, "timezone_offset", -12, 14, value, present, error)) {
+    return false;
+  }
+  if (present) {
+    next.timezoneOffset = value;
+  }
+  if (!readInt(body, "daylight_offset", 0, 2, value, present, error)) {
+    return false;
+  }
+  if (present) {
+    next.daylightOffset = value;
+  }
+  if (!readInt(body, "led_count", 1, MAX_LEDS, value, present, error)) {
+    return false;
+  }
+  if (present) {
+    next.ledCount = value;
+  }
+
+  // leds[i] updates LED i; added LEDs start from the default patterns and
+  // need a pin
+  JsonArrayConst ledArray = body["leds"];
+  if (!body["leds"].isNull() && (ledArray.isNull() || ledArray.size() > MAX_LEDS)) {
+    error = String("leds must be an array of at most ") + MAX_LEDS + " objects";
+    return false;
+  }
+  for (uint8_t i = ledCount; i < next.ledCount; i++) {
+    next.leds[i] = defaultLed(0);
+  }
+  for (uint8_t i = 0; i < next.ledCount; i++) {
+    String prefix = String("leds[") + i + "].";
+    if (i < ledArray.size() && !ledArray[i].is<JsonObjectConst>()) {
+      error = String("leds[") + i + "] must be an object";
+      return false;
+    }
+    JsonObjectConst led = i < ledArray.size() ? ledArray[i].as<JsonObjectConst>() : JsonObjectConst();
+    if (!led.isNull()) {
+      if (!readInt(led, "pin", 0, 255, value, present, error)) {
+        error = prefix + error;
+        return false;
+      }
+      if (present) {
+        next.leds[i].pin = value;
+      } else if (i >= ledCount) {
+        error = prefix + "pin is required for an added LED";
+        return false;
+      }
+      for (uint8_t p = 0; p < 5; p++) {
+        if (!readInt(led, PATTERN_KEYS[p], PATTERN_OFF, PATTERN_DIM_SOLID, value, present, error)) {
+          error = prefix + error;
+          return false;
+        }
+        if (present) {
+          *patternField(next.leds[i], p) = (LEDPattern)value;
+        }
+      }
+    } else if (i >= ledCount) {
+      error = prefix + "pin is required for an added LED";
+      return false;
+    }
+
+    bool validPin = false;
+    for (uint8_t p = 0; p < validPinCount; p++) {
+      validPin |= validPins[p] == next.leds[i].pin;
+    }
+    if (!validPin) {
+      error = prefix + "pin " + next.leds[i].pin + " is not an available GPIO";
+      return false;
+    }
+    for (uint8_t j = 0; j < i; j++) {
+      if (next.leds[j].pin == next.leds[i].pin) {
+        error = prefix + "pin " + next.leds[i].pin + " is already used by LED " + j;
+        return false;
+      }
+    }
+  }
+
+  *this = next;
+  return true;
+}
+
+uint32_t DeviceConfig::diff(const DeviceConfig& from, const DeviceConfig& to) {
+  uint32_t changes = 0;
+  if (from.wifiSSID != to.wifiSSID || from.wifiPassword != to.wifiPassword) {
+    changes |= CONFIG_WIFI;
+  }
+  if (from.userEmail != to.userEmail || from.tenantId != to.tenantId ||
+      from.clientId != to.clientId || from.clientSecret != to.clientSecret) {
+    changes |= CONFIG_ACCOUNT;
+  }
+  if (from.relayUrl != to.relayUrl || from.relayKey != to.relayKey) {
+    changes |= CONFIG_RELAY;
+  }
+  if (from.boardMode != to.boardMode || from.boardRoster != to.boardRoster) {
+    changes |= CONFIG_BOARD;
+  }
+  if (from.pushTtl != to.pushTtl) {
+    changes |= CONFIG_PUSH;
+  }
+  if (from.otaUrl != to.otaUrl) {
+    changes |= CONFIG_OTA;
+  }
+  if (from.timezoneOffset != to.timezoneOffset || from.daylightOffset != to.daylightOffset) {
+    changes |= CONFIG_TIME;
+  }
+  if (from.ledCount != to.ledCount) {
+    changes |= CONFIG_LED_PINS;
+  }
+  for (uint8_t i = 0; i < min(from.ledCount, to.ledCount); i++) {
+    const LedSettings& a = from.leds[i];
+    const LedSettings& b = to.leds[i];
+    if (a.pin != b.pin) {
+      changes |= CONFIG_LED_PINS;
+    }
+    if (a.call != b.call || a.meeting != b.meeting || a.available != b.available ||
+        a.away != b.away || a.offline != b.offline) {
+      changes |= CONFIG_LED_PATTERNS;
+    }
+  }
+  return changes;
+}
+
+void DeviceConfig::describe(uint32_t changes, JsonArray out) {
+  for (uint8_t bit = 0; bit < sizeof(CHANGE_NAMES) / sizeof(CHANGE_NAMES[0]); bit++) {
+    if (changes & (1UL << bit)) {
+      out.add(CHANGE_NAMES[bit]);
+    }
+  }
+}
+
+// Feeds serialized JSON through CRC-32 without buffering it
+class ChecksumPrint : public Print {
+public:
+  uint32_t crc = 0;
+
+  size_t write(uint8_t value) override {
+    crc = GzipStream::crc32(crc, &value, 1);
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    crc = GzipStream::crc32(crc, buffer, size);
+    return size;
+  }
+};
+
+uint32_t DeviceConfig::checksum(JsonVariantConst config) {
+  ChecksumPrint out;
+  serializeJson(config, out);
+  return out.crc;
+}
+
+void DeviceConfig::exportDocument(JsonObject document) const {
+  document["version"] = CONFIG_DOCUMENT_VERSION;
+  JsonObject config = document.createNestedObject("config");
+  config["wifi_ssid"] = wifiSSID;
+  config["tenant_id"] = tenantId;
+  config["client_id"] = clientId;
+  config["relay_url"] = relayUrl;
+  config["ota_url"] = otaUrl;
+  config["push_ttl"] = pushTtl;
+  config["timezone_offset"] = timezoneOffset;
+  config["daylight_offset"] = daylightOffset;
+  config["led_count"] = ledCount;
+  JsonArray ledArray = config.createNestedArray("leds");
+  for (uint8_t i = 0; i < ledCount; i++) {
+    JsonObject led = ledArray.createNestedObject();
+    led["pin"] = leds[i].pin;
+    LedSettings settings = leds[i];
+    for (uint8_t p = 0; p < 5; p++) {
+      led[PATTERN_KEYS[p]] = (int)*patternField(settings, p);
+    }
+  }
+
+  char crc[9];
+  snprintf(crc, sizeof(crc), "%08lx", (unsigned long)checksum(config));
+  document["crc32"] = crc;
+}
+
+bool DeviceConfig::readDocument(JsonObjectConst document, JsonObjectConst& config, String& error) {
+  if (document["version"] != CONFIG_DOCUMENT_VERSION) {
+    error = String("version must be ") + CONFIG_DOCUMENT_VERSION;
+    return false;
+  }
+  config = document["config"].as<JsonObjectConst>();
+  if (config.isNull()) {
+    error = "config must be an object";
+    return false;
+  }
+  const char* crc = document["crc32"];
+  char* end = nullptr;
+  unsigned long expected = crc != nullptr ? strtoul(crc, &end, 16) : 0;
+  if (crc == nullptr || strlen(crc) != 8 || *end != '\0') {
+    error = "crc32 must be 8 hex digits";
+    return false;
+  }
+  if (expected != checksum(config)) {
+    error = "crc32 does not match config";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,228 @@
+#include "graph_stream.h"
+
+// LookaheadStream implementation
+int LookaheadStream::waitForByte() {
+  unsigned long start = millis();
+  do {
+    int c = source.read();
+    if (c >= 0) {
+      return c;
+    }
+    delay(1);
+  } while (millis() - start < GRAPH_STREAM_TIMEOUT);
+  return -1;
+}
+
+int LookaheadStream::available() {
+  return (pending >= 0 ? 1 : 0) + source.available();
+}
+
+int LookaheadStream::read() {
+  if (pending >= 0) {
+    int c = pending;
+    pending = -1;
+    return c;
+  }
+  return waitForByte();
+}
+
+int LookaheadStream::peek() {
+  if (pending < 0) {
+    pending = waitForByte();
+  }
+  return pending;
+}
+
+// GraphPageReader implementation
+GraphPageReader::GraphPageReader(Stream& input, JsonDocument& itemDoc, JsonDocument& itemFilter)
+  : stream(input), doc(itemDoc), filter(itemFilter) {
+}
+
+bool GraphPageReader::read(const ItemHandler& onItem) {
+  if (!expect('{')) {
+    return fail("expected object");
+  }
+  if (nextToken() == '}') {
+    stream.read();
+    return true;
+  }
+
+  while (true) {
+    char key[GRAPH_STREAM_KEY_LEN];
+    if (nextToken() != '"' || !readString(key, sizeof(key))) {
+      return fail("expected key");
+    }
+    if (!expect(':')) {
+      return fail("expected ':'");
+    }
+
+    bool ok;
+    if (strcmp(key, "value") == 0) {
+      ok = readValueArray(onItem);
+    } else if (strcmp(key, "@odata.nextLink") == 0) {
+      ok = nextToken() == '"' && readString(next);
+    } else if (strcmp(key, "@odata.deltaLink") == 0) {
+      ok = nextToken() == '"' && readString(delta);
+    } else {
+      ok = skipValue();
+    }
+    if (!ok) {
+      return fail(*errorMessage ? errorMessage : "invalid value");
+    }
+
+    int c = nextToken();
+    if (c == ',') {
+      stream.read();
+    } else if (c == '}') {
+      stream.read();
+      return true;
+    } else {
+      return fail("expected ',' or '}'");
+    }
+  }
+}
+
+bool GraphPageReader::readValueArray(const ItemHandler& onItem) {
+  if (!expect('[')) {
+    return fail("expected array");
+  }
+  if (nextToken() == ']') {
+    stream.read();
+    return true;
+  }
+
+  while (true) {
+    // Elements are objects, so the deserializer stops right after the
+    // closing brace and leaves the delimiter in the stream
+    DeserializationError error = deserializeJson(doc, stream, DeserializationOption::Filter(filter));
+    if (error) {
+      return fail(error.c_str());
+    }
+    items++;
+    onItem(doc.as<JsonObject>());
+
+    int c = nextToken();
+    if (c == ',') {
+      stream.read();
+    } else if (c == ']') {
+      stream.read();
+      return true;
+    } else {
+      return fail("expected ',' or ']'");
+    }
+  }
+}
+
+bool GraphPageReader::skipValue() {
+  int depth = 0;
+  do {
+    int c = nextToken();
+    if (c < 0) {
+      return fail("unexpected end of input");
+    }
+    if (c == '"') {
+      if (!readString(nullptr, 0)) {
+        return false;
+      }
+    } else if (c == '{' || c == '[') {
+      stream.read();
+      depth++;
+    } else if (c == '}' || c == ']' || c == ',' || c == ':') {
+      if (depth == 0) {
+        return fail("unexpected delimiter");
+      }
+      stream.read();
+      if (c == '}' || c == ']') {
+        depth--;
+      }
+    } else {
+      // Number or literal - consume up to the next delimiter
+      while (c >= 0 && c != ',' && c != '}' && c != ']' && !isspace(c)) {
+        stream.read();
+        c = stream.peek();
+      }
+    }
+  } while (depth > 0);
+  return true;
+}
+
+int GraphPageReader::nextToken() {
+  int c = stream.peek();
+  while (c >= 0 && isspace(c)) {
+    stream.read();
+    c = stream.peek();
+  }
+  return c;
+}
+
+bool GraphPageReader::expect(char c) {
+  if (nextToken() != c) {
+    return false;
+  }
+  stream.read();
+  return true;
+}
+
+// Reads the next decoded character of a string body.
+// Returns -2 at the closing quote and -1 on malformed input.
+static int readStringChar(Stream& stream) {
+  int c = stream.read();
+  if (c < 0 || c == '"') {
+    return c < 0 ? -1 : -2;
+  }
+  if (c != '\\') {
+    return c;
+  }
+
+  c = stream.read();
+  switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'u': {
+      int code = 0;
+      for (int i = 0; i < 4; i++) {
+        int h = stream.read();
+        if (h >= '0' && h <= '9') code = code * 16 + (h - '0');
+        else if (h >= 'a' && h <= 'f') code = code * 16 + (h - 'a' + 10);
+        else if (h >= 'A' && h <= 'F') code = code * 16 + (h - 'A' + 10);
+        else return -1;
+      }
+      return code < 0x80 ? code : '?';
+    }
+    default:
+      return c; // \" \\ \/ and anything else taken literally
+  }
+}
+
+bool GraphPageReader::readString(char* buffer, size_t size) {
+  stream.read(); // Opening quote
+  size_t length = 0;
+  int c;
+  while ((c = readStringChar(stream)) >= 0) {
+    if (buffer != nullptr && length + 1 < size) {
+      buffer[length++] = (char)c;
+    }
+  }
+  if (buffer != nullptr && size > 0) {
+    buffer[length] = '\0';
+  }
+  return c == -2 || fail("unterminated string");
+}
+
+bool GraphPageReader::readString(String& out) {
+  stream.read(); // Opening quote
+  out = "";
+  int c;
+  while ((c = readStringChar(stream)) >= 0) {
+    out += (char)c;
+  }
+  return c == -2 || fail("unterminated string");
+}
+
+bool GraphPageReader::fail(const char* message) {
+  errorMessage = message;
+  return false;
+}
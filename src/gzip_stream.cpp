@@ -0,0 +1,230 @@
+#include "gzip_stream.h"
+
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+static_assert(GZIP_WINDOW_SIZE >= GZIP_MAX_MATCH, "the window must hold a full match");
+static_assert(GZIP_WINDOW_SIZE * 2 < 65536, "positions are kept in 16 bits");
+
+// Deflate length and distance codes (RFC 1951, 3.2.5)
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+uint8_t GzipStream::activeStreams = 0;
+
+static inline uint16_t hashAt(const uint8_t* bytes) {
+  uint32_t value = ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | bytes[2];
+  return (uint32_t)(value * 2654435761U) >> (32 - GZIP_HASH_BITS);
+}
+
+GzipStream::GzipStream(const Source& source) : source(source) {
+  memset(head, 0, sizeof(head));
+  activeStreams++;
+}
+
+GzipStream::~GzipStream() {
+  activeStreams--;
+}
+
+size_t GzipStream::fill(uint8_t* buffer, size_t maxLength) {
+  uint32_t start = micros();
+  uint32_t sourceBefore = sourceMicros;
+  size_t written = 0;
+  while (written < maxLength) {
+    if (pendingOffset == pendingLength) {
+      if (done) {
+        break;
+      }
+      pendingLength = 0;
+      pendingOffset = 0;
+      produce();
+      continue;
+    }
+    size_t count = min(pendingLength - pendingOffset, maxLength - written);
+    memcpy(buffer + written, pending + pendingOffset, count);
+    pendingOffset += count;
+    written += count;
+  }
+  outputSize += written;
+  compressMicros += (micros() - start) - (sourceMicros - sourceBefore);
+  return written;
+}
+
+// Encodes input until the pending buffer is nearly full or the input ends
+void GzipStream::produce() {
+  if (!started) {
+    // Member header: deflate, no name or timestamp, unknown OS
+    static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+    memcpy(pending, header, sizeof(header));
+    pendingLength = sizeof(header);
+    // Everything goes into one fixed-Huffman block; finish() closes it with
+    // an empty final block, since the end of the input is not known up front
+    putBits(0, 1);
+    putBits(1, 2);
+    started = true;
+    return;
+  }
+
+  while (!done && pendingLength < sizeof(pending) - 16) {
+    // Keep a full match of lookahead while the source has more
+    if (!sourceDone && end - position < GZIP_MAX_MATCH) {
+      refill();
+      continue;
+    }
+    if (position == end) {
+      finish();
+      break;
+    }
+
+    size_t available = end - position;
+    size_t matchLength = 0;
+    size_t distance = 0;
+    if (available >= GZIP_MIN_MATCH) {
+      uint16_t hash = hashAt(data + position);
+      size_t candidate = head[hash];
+      head[hash] = position + 1;
+      if (candidate != 0) {
+        candidate--;
+        distance = position - candidate;
+        if (distance <= GZIP_WINDOW_SIZE) {
+          size_t limit = min(available, (size_t)GZIP_MAX_MATCH);
+          while (matchLength < limit && data[candidate + matchLength] == data[position + matchLength]) {
+            matchLength++;
+          }
+        }
+      }
+    }
+
+    if (matchLength >= GZIP_MIN_MATCH) {
+      putMatch(matchLength, distance);
+      // Index the covered positions too, so later text can refer to them
+      for (size_t i = 1; i < matchLength && end - (position + i) >= GZIP_MIN_MATCH; i++) {
+        head[hashAt(data + position + i)] = position + i + 1;
+      }
+      position += matchLength;
+    } else {
+      putLiteral(data[position]);
+      position++;
+    }
+  }
+}
+
+void GzipStream::refill() {
+  if (end == sizeof(data)) {
+    // Drop the older half; matches never reach back further than the window
+    memmove(data, data + GZIP_WINDOW_SIZE, GZIP_WINDOW_SIZE);
+    position -= GZIP_WINDOW_SIZE;
+    end -= GZIP_WINDOW_SIZE;
+    for (size_t i = 0; i < (1 << GZIP_HASH_BITS); i++) {
+      head[i] = head[i] > GZIP_WINDOW_SIZE ? head[i] - GZIP_WINDOW_SIZE : 0;
+    }
+  }
+
+  uint32_t start = micros();
+  size_t count = source(data + end, sizeof(data) - end);
+  sourceMicros += micros() - start;
+  if (count == 0) {
+    sourceDone = true;
+    return;
+  }
+  crc = crc32(crc, data + end, count);
+  inputSize += count;
+  end += count;
+}
+
+void GzipStream::finish() {
+  putLiteral(256);  // End of the open block
+  putBits(1, 1);    // Empty final block
+  putBits(1, 2);
+  putLiteral(256);
+  if (bitCount > 0) {
+    putBits(0, 8 - bitCount);
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    putByte(crc >> (8 * i));
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    putByte(inputSize >> (8 * i));
+  }
+  done = true;
+}
+
+// Deflate packs bits starting at the least significant bit of each byte
+void GzipStream::putBits(uint32_t value, uint8_t count) {
+  bitBuffer |= value << bitCount;
+  bitCount += count;
+  while (bitCount >= 8) {
+    putByte(bitBuffer);
+    bitBuffer >>= 8;
+    bitCount -= 8;
+  }
+}
+
+// Huffman codes are defined most significant bit first
+void GzipStream::putCode(uint16_t code, uint8_t length) {
+  uint16_t reversed = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  putBits(reversed, length);
+}
+
+// Fixed literal/length code (RFC 1951, 3.2.6)
+void GzipStream::putLiteral(uint16_t symbol) {
+  if (symbol < 144) {
+    putCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    putCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    putCode(symbol - 256, 7);
+  } else {
+    putCode(0xc0 + symbol - 280, 8);
+  }
+}
+
+void GzipStream::putMatch(size_t length, size_t distance) {
+  uint8_t code = 28;
+  while (LENGTH_BASE[code] > length) {
+    code--;
+  }
+  putLiteral(257 + code);
+  putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+  code = 29;
+  while (DISTANCE_BASE[code] > distance) {
+    code--;
+  }
+  putCode(code, 5);
+  putBits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+void GzipStream::putByte(uint8_t value) {
+  pending[pendingLength++] = value;
+}
+
+// CRC-32 as used by gzip, with a 16-entry table
+uint32_t GzipStream::crc32(uint32_t crc, const uint8_t* data, size_t length) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 15];
+    crc = (crc >> 4) ^ table[crc & 15];
+  }
+  return ~crc;
+}
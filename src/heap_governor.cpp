@@ -0,0 +1,49 @@
+#include "heap_governor.h"
+
+// Thresholds of each level above HEAP_NORMAL: free heap, largest block
+static const uint32_t THRESHOLDS[HEAP_PRESSURE_LEVELS - 1][2] = {
+  {HEAP_DEFER_FREE, HEAP_DEFER_BLOCK},
+  {HEAP_CACHED_FREE, HEAP_CACHED_BLOCK},
+  {HEAP_SHRINK_FREE, HEAP_SHRINK_BLOCK},
+  {HEAP_REFUSE_FREE, HEAP_REFUSE_BLOCK},
+};
+
+static const char* const LEVEL_NAMES[HEAP_PRESSURE_LEVELS] = {
+  "normal", "defer_fetches", "cached_only", "shrink_buffers", "refuse_requests"
+};
+
+bool HeapGovernor::sample(uint32_t freeHeap, uint32_t largestBlock) {
+  minFree = min(minFree, freeHeap);
+  minBlock = min(minBlock, largestBlock);
+
+  // Rising takes effect at once. Falling back needs the margin as well, so a
+  // reading hovering at a threshold does not flip the level on every sample.
+  HeapPressure rising = levelFor(freeHeap, largestBlock, 0);
+  HeapPressure held = levelFor(freeHeap, largestBlock, HEAP_RECOVERY_MARGIN);
+  uint8_t previous = current;
+  uint8_t next = max((uint8_t)rising, min(previous, (uint8_t)held));
+  if (next == previous) {
+    return false;
+  }
+
+  if (next > previous) {
+    entered[next]++;
+  }
+  current = next;
+  peak = max(peak, next);
+  return true;
+}
+
+HeapPressure HeapGovernor::levelFor(uint32_t freeHeap, uint32_t largestBlock, uint32_t margin) {
+  uint8_t level = HEAP_NORMAL;
+  for (uint8_t i = 0; i < HEAP_PRESSURE_LEVELS - 1; i++) {
+    if (freeHeap < THRESHOLDS[i][0] + margin || largestBlock < THRESHOLDS[i][1] + margin) {
+      level = i + 1;
+    }
+  }
+  return (HeapPressure)level;
+}
+
+const char* HeapGovernor::levelName(HeapPressure level) {
+  return level < HEAP_PRESSURE_LEVELS ? LEVEL_NAMES[level] : "unknown";
+}
@@ -0,0 +1,240 @@
+#include "heap_trace.h"
+#include "alloc_counter.h"
+#include <esp_timer.h>
+
+// Static member initialization; the fixed points come first, in HeapTracePoint order
+HeapPointTotals HeapTrace::points[HEAP_TRACE_POINTS] = {
+  {"graph", "presence"},
+  {"graph", "token"},
+  {"graph", "calendar"},
+  {"graph", "board"},
+  {"save", "config"},
+  {"save", "presence_history"},
+};
+int HeapTrace::pointsUsed = TRACE_FIXED_POINTS;
+HeapSpan HeapTrace::spans[HEAP_TRACE_SPANS];
+int HeapTrace::spanHead = 0;
+int HeapTrace::spansHeld = 0;
+HeapSample HeapTrace::series[HEAP_TRACE_SERIES];
+int HeapTrace::samplesHeld = 0;
+uint32_t HeapTrace::interval = HEAP_TRACE_INTERVAL;
+uint32_t HeapTrace::lastSampleUptime = 0;
+uint32_t HeapTrace::pendingLowestBlock = UINT32_MAX;
+portMUX_TYPE HeapTrace::lock = portMUX_INITIALIZER_UNLOCKED;
+
+int HeapTrace::registerPoint(const char* kind, const char* name) {
+  if (pointsUsed >= HEAP_TRACE_POINTS) {
+    return -1;
+  }
+  points[pointsUsed] = {kind, name, 0, 0, 0, 0};
+  return pointsUsed++;
+}
+
+HeapReading HeapTrace::read() {
+  return {ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(),
+          AllocCounter::allocations(), AllocCounter::frees()};
+}
+
+// Seconds since boot; unlike millis() this does not wrap after 49 days
+uint32_t HeapTrace::uptime() {
+  return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+void HeapTrace::recordSpan(int point, const HeapReading& before, const HeapReading& after, uint32_t uptimeSeconds) {
+  if (point < 0 || point >= pointsUsed) {
+    return;
+  }
+  portENTER_CRITICAL(&lock);
+  HeapPointTotals& totals = points[point];
+  int32_t change = (int32_t)(after.freeHeap - before.freeHeap);
+  totals.calls++;
+  totals.netFree += change;
+  if (change < 0 && (uint32_t)-change > totals.worstDrop) {
+    totals.worstDrop = -change;
+  }
+  totals.netAllocations += (int32_t)(after.allocations - before.allocations) - (int32_t)(after.frees - before.frees);
+
+  spans[spanHead] = {uptimeSeconds, (uint8_t)point, before, after};
+  spanHead = (spanHead + 1) % HEAP_TRACE_SPANS;
+  if (spansHeld < HEAP_TRACE_SPANS) {
+    spansHeld++;
+  }
+  pendingLowestBlock = min(pendingLowestBlock, min(before.largestBlock, after.largestBlock));
+  portEXIT_CRITICAL(&lock);
+}
+
+void HeapTrace::tick() {
+  uint32_t now = uptime();
+  if (samplesHeld > 0 && now - lastSampleUptime < interval) {
+    return;
+  }
+  recordSample(now, read());
+}
+
+void HeapTrace::recordSample(uint32_t uptimeSeconds, const HeapReading& reading) {
+  portENTER_CRITICAL(&lock);
+  if (samplesHeld == HEAP_TRACE_SERIES) {
+    // Halve the resolution: each pair becomes its later sample, keeping the
+    // pair's smallest largest block
+    for (int i = 0; i < HEAP_TRACE_SERIES / 2; i++) {
+      HeapSample merged = series[2 * i + 1];
+      merged.lowestLargestBlock = min(series[2 * i].lowestLargestBlock, merged.lowestLargestBlock);
+      series[i] = merged;
+    }
+    samplesHeld = HEAP_TRACE_SERIES / 2;
+    interval *= 2;
+  }
+  series[samplesHeld++] = {uptimeSeconds, reading, min(pendingLowestBlock, reading.largestBlock)};
+  pendingLowestBlock = UINT32_MAX;
+  lastSampleUptime = uptimeSeconds;
+  portEXIT_CRITICAL(&lock);
+}
+
+uint32_t HeapTrace::sampleInterval() {
+  return interval;
+}
+
+int HeapTrace::sampleCount() {
+  return samplesHeld;
+}
+
+bool HeapTrace::sampleAt(int position, HeapSample& out) {
+  portENTER_CRITICAL(&lock);
+  bool found = position >= 0 && position < samplesHeld;
+  if (found) {
+    out = series[position];
+  }
+  portEXIT_CRITICAL(&lock);
+  return found;
+}
+
+int HeapTrace::spanCount() {
+  return spansHeld;
+}
+
+bool HeapTrace::spanAt(int position, HeapSpan& out) {
+  portENTER_CRITICAL(&lock);
+  bool found = position >= 0 && position < spansHeld;
+  if (found) {
+    int oldest = (spanHead - spansHeld + HEAP_TRACE_SPANS) % HEAP_TRACE_SPANS;
+    out = spans[(oldest + position) % HEAP_TRACE_SPANS];
+  }
+  portEXIT_CRITICAL(&lock);
+  return found;
+}
+
+int HeapTrace::pointCount() {
+  return pointsUsed;
+}
+
+bool HeapTrace::pointAt(int index, HeapPointTotals& out) {
+  portENTER_CRITICAL(&lock);
+  bool found = index >= 0 && index < pointsUsed;
+  if (found) {
+    out = points[index];
+  }
+  portEXIT_CRITICAL(&lock);
+  return found;
+}
+
+void HeapTrace::clear() {
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < pointsUsed; i++) {
+    points[i].calls = 0;
+    points[i].netFree = 0;
+    points[i].worstDrop = 0;
+    points[i].netAllocations = 0;
+  }
+  spanHead = 0;
+  spansHeld = 0;
+  samplesHeld = 0;
+  interval = HEAP_TRACE_INTERVAL;
+  lastSampleUptime = 0;
+  pendingLowestBlock = UINT32_MAX;
+  portEXIT_CRITICAL(&lock);
+}
+
+void HeapTrace::fillReading(JsonObject out, const HeapReading& reading) {
+  out["free_heap"] = reading.freeHeap;
+  out["min_free_heap"] = reading.minFreeHeap;
+  out["largest_free_block"] = reading.largestBlock;
+  out["allocations"] = reading.allocations;
+  out["frees"] = reading.frees;
+}
+
+// Steps: the current reading, then one step per series, span and point slot
+// (empty slots write nothing), with the array boundaries in between
+bool HeapTrace::produce(JsonChunkWriter& out, size_t step) {
+  const size_t spansStart = 1 + HEAP_TRACE_SERIES + 1;
+  const size_t pointsStart = spansStart + HEAP_TRACE_SPANS + 1;
+  const size_t end = pointsStart + HEAP_TRACE_POINTS;
+  StaticJsonDocument<384> doc;
+
+  if (step == 0) {
+    JsonObject current = doc.to<JsonObject>();
+    current["uptime"] = uptime();
+    fillReading(current, read());
+    current["alloc_counting"] = AllocCounter::enabled();
+    current["sample_interval"] = sampleInterval();
+    out.beginObject();
+    out.members(doc);
+    out.beginArray("series");
+    return true;
+  }
+
+  if (step < spansStart - 1) {
+    HeapSample sample;
+    if (sampleAt(step - 1, sample)) {
+      JsonObject item = doc.to<JsonObject>();
+      item["uptime"] = sample.uptime;
+      fillReading(item, sample.reading);
+      item["lowest_largest_block"] = sample.lowestLargestBlock;
+      out.element(doc);
+    }
+    return true;
+  }
+  if (step == spansStart - 1) {
+    out.endArray();
+    out.beginArray("spans");
+    return true;
+  }
+
+  if (step < pointsStart - 1) {
+    HeapSpan span;
+    HeapPointTotals point;
+    if (spanAt(step - spansStart, span) && pointAt(span.point, point)) {
+      JsonObject item = doc.to<JsonObject>();
+      item["uptime"] = span.uptime;
+      item["kind"] = point.kind;
+      item["point"] = point.name;
+      fillReading(item.createNestedObject("before"), span.before);
+      fillReading(item.createNestedObject("after"), span.after);
+      out.element(doc);
+    }
+    return true;
+  }
+  if (step == pointsStart - 1) {
+    out.endArray();
+    out.beginArray("points");
+    return true;
+  }
+
+  if (step < end) {
+    HeapPointTotals point;
+    if (pointAt(step - pointsStart, point) && point.calls > 0) {
+      JsonObject item = doc.to<JsonObject>();
+      item["kind"] = point.kind;
+      item["point"] = point.name;
+      item["calls"] = point.calls;
+      item["net_free_heap"] = point.netFree;
+      item["worst_drop"] = point.worstDrop;
+      item["net_allocations"] = point.netAllocations;
+      out.element(doc);
+    }
+    return true;
+  }
+
+  out.endArray();
+  out.endObject();
+  return false;
+}
@@ -0,0 +1,132 @@
+#include "json_stream.h"
+#include "logging.h"
+
+JsonChunkWriter::JsonChunkWriter(const Producer& producer) : producer(producer) {
+  first[0] = true;
+}
+
+size_t JsonChunkWriter::fill(uint8_t* buffer, size_t maxLength) {
+  size_t written = 0;
+  while (written < maxLength) {
+    if (offset == length) {
+      if (done) {
+        break;
+      }
+      length = 0;
+      offset = 0;
+      done = !producer(*this, step++);
+      continue;
+    }
+    size_t count = min(length - offset, maxLength - written);
+    memcpy(buffer + written, fragment + offset, count);
+    offset += count;
+    written += count;
+  }
+  return written;
+}
+
+void JsonChunkWriter::writeTo(String& out) {
+  uint8_t buffer[64];
+  size_t written;
+  while ((written = fill(buffer, sizeof(buffer))) > 0) {
+    out.concat((const char*)buffer, written);
+  }
+}
+
+bool JsonChunkWriter::append(const char* text, size_t textLength) {
+  if (length + textLength > sizeof(fragment)) {
+    return false;
+  }
+  memcpy(fragment + length, text, textLength);
+  length += textLength;
+  return true;
+}
+
+// Writes the comma before every value of a container except the first
+bool JsonChunkWriter::separator() {
+  if (first[depth]) {
+    first[depth] = false;
+    return true;
+  }
+  return append(",", 1);
+}
+
+void JsonChunkWriter::open(const char* key, char bracket) {
+  if (depth >= JSON_STREAM_MAX_DEPTH) {
+    LOG_ERROR("JSON response nested too deeply");
+    return;
+  }
+  if (depth > 0) {
+    separator();
+  }
+  if (key != nullptr) {
+    append("\"", 1);
+    append(key, strlen(key));
+    append("\":", 2);
+  }
+  append(&bracket, 1);
+  first[++depth] = true;
+}
+
+void JsonChunkWriter::close(char bracket) {
+  if (depth > 0) {
+    depth--;
+  }
+  append(&bracket, 1);
+}
+
+void JsonChunkWriter::beginObject(const char* key) {
+  open(key, '{');
+}
+
+void JsonChunkWriter::endObject() {
+  close('}');
+}
+
+void JsonChunkWriter::beginArray(const char* key) {
+  open(key, '[');
+}
+
+void JsonChunkWriter::endArray() {
+  close(']');
+}
+
+void JsonChunkWriter::members(const JsonDocument& doc) {
+  size_t size = measureJson(doc);
+  if (size <= 2) {
+    return;  // Empty object
+  }
+
+  // Serialize "{...}" in place, then turn the braces into the separator
+  bool needsComma = !first[depth];
+  if (length + size + 1 > sizeof(fragment)) {
+    droppedValues++;
+    LOG_WARNF("Dropped %u bytes of JSON members that exceed the stream fragment", (unsigned)size);
+    return;
+  }
+  char* start = fragment + length;
+  serializeJson(doc, start, sizeof(fragment) - length);
+  if (needsComma) {
+    start[0] = ',';
+    length += size - 1;
+  } else {
+    memmove(start, start + 1, size - 2);
+    length += size - 2;
+  }
+  first[depth] = false;
+}
+
+void JsonChunkWriter::element(const JsonDocument& doc) {
+  size_t size = measureJson(doc);
+  size_t comma = first[depth] ? 0 : 1;
+  if (length + comma + size + 1 > sizeof(fragment)) {
+    droppedValues++;
+    LOG_WARNF("Wrote null for a %u byte JSON element that exceeds the stream fragment", (unsigned)size);
+    separator();
+    append("null", 4);
+    return;
+  }
+  separator();
+  serializeJson(doc, fragment + length, sizeof(fragment) - length);
+  length += size;
+}
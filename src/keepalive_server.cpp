@@ -0,0 +1,410 @@
+#include "keepalive_server.h"
+#include "metrics.h"
+
+// Responses are filled one piece at a time on the AsyncTCP task, so one
+// buffer serves every connection
+static uint8_t chunk[KEEPALIVE_CHUNK_SIZE];
+
+static const char* statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
+
+bool KeepAliveRequest::queryArg(const char* name, char* value, size_t size) const {
+  size_t nameLength = strlen(name);
+  const char* cursor = query;
+  while (*cursor) {
+    const char* end = strchr(cursor, '&');
+    if (end == nullptr) {
+      end = cursor + strlen(cursor);
+    }
+    if (strncmp(cursor, name, nameLength) == 0 && (cursor[nameLength] == '=' || cursor + nameLength == end)) {
+      const char* start = cursor[nameLength] == '=' ? cursor + nameLength + 1 : end;
+      size_t length = min((size_t)(end - start), size - 1);
+      memcpy(value, start, length);
+      value[length] = '\0';
+      return true;
+    }
+    cursor = *end ? end + 1 : end;
+  }
+  return false;
+}
+
+void KeepAliveResponse::addHeader(const char* name, const char* value) {
+  size_t used = strlen(headers);
+  snprintf(headers + used, sizeof(headers) - used, "%s: %s\r\n", name, value);
+}
+
+// A fixed text body; text must outlive the response (a literal)
+void KeepAliveResponse::send(int code, const char* type, const char* text) {
+  status = code;
+  contentType = type;
+  contentLength = strlen(text);
+  size_t offset = 0;
+  body = [text, offset](uint8_t* buffer, size_t maxLength) mutable -> size_t {
+    size_t count = min(maxLength, strlen(text) - offset);
+    memcpy(buffer, text + offset, count);
+    offset += count;
+    return count;
+  };
+}
+
+bool KeepAliveServer::on(const char* path, const Handler& handler) {
+  if (routeCount >= KEEPALIVE_MAX_ROUTES) {
+    return false;
+  }
+  routes[routeCount].path = path;
+  routes[routeCount].handler = handler;
+  routeCount++;
+  return true;
+}
+
+void KeepAliveServer::begin() {
+  server.onClient([this](void*, AsyncClient* client) {
+    accept(client);
+  }, nullptr);
+  server.setNoDelay(true);
+  server.begin();
+}
+
+uint8_t KeepAliveServer::openConnections() const {
+  uint8_t open = 0;
+  for (uint8_t i = 0; i < KEEPALIVE_MAX_CONNECTIONS; i++) {
+    if (connections[i].client != nullptr) {
+      open++;
+    }
+  }
+  return open;
+}
+
+void KeepAliveServer::accept(AsyncClient* client) {
+  Connection* connection = nullptr;
+  for (uint8_t i = 0; accepting && i < KEEPALIVE_MAX_CONNECTIONS && connection == nullptr; i++) {
+    if (connections[i].client == nullptr) {
+      connection = &connections[i];
+    }
+  }
+
+  if (connection == nullptr) {
+    // All sockets are taken or heap is short; answer without keeping any state
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n"
+                               "Content-Length: 0\r\nConnection: close\r\n\r\n";
+    Metrics::observeKeepAliveConnection(false);
+    client->onDisconnect([](void*, AsyncClient* closed) {
+      delete closed;
+    }, nullptr);
+    client->add(busy, sizeof(busy) - 1);
+    client->send();
+    client->close();
+    return;
+  }
+
+  Metrics::observeKeepAliveConnection(true);
+  connection->client = client;
+  connection->buffered = 0;
+  connection->headLength = 0;
+  connection->requests = 0;
+  connection->responding = false;
+  connection->closeAfter = false;
+  connection->lastActivity = millis();
+
+  client->setNoDelay(true);
+  client->onData([this, connection](void*, AsyncClient*, void* data, size_t length) {
+    receive(*connection, (const uint8_t*)data, length);
+  }, nullptr);
+  client->onAck([this, connection](void*, AsyncClient*, size_t, uint32_t) {
+    pump(*connection);
+  }, nullptr);
+  // Polled about twice a second: resumes a response waiting for buffer
+  // space and closes connections that have been idle too long
+  client->onPoll([this, connection](void*, AsyncClient* polled) {
+    if (connection->responding) {
+      pump(*connection);
+    } else if (!connection->closeAfter && millis() - connection->lastActivity >= KEEPALIVE_IDLE_TIMEOUT) {
+      connection->closeAfter = true;
+      polled->close();
+    }
+  }, nullptr);
+  client->onTimeout([](void*, AsyncClient* timedOut, uint32_t) {
+    timedOut->close();
+  }, nullptr);
+  client->onDisconnect([this, connection](void*, AsyncClient* closed) {
+    release(*connection);
+    delete closed;
+  }, nullptr);
+}
+
+void KeepAliveServer::receive(Connection& connection, const uint8_t* data, size_t length) {
+  if (connection.closeAfter) {
+    return;  // Closing; whatever else the client sends is not answered
+  }
+  connection.lastActivity = millis();
+
+  size_t count = min(length, sizeof(connection.buffer) - connection.buffered);
+  memcpy(connection.buffer + connection.buffered, data, count);
+  connection.buffered += count;
+  bool overflow = count < length;
+  if (overflow && connection.responding) {
+    // More pipelined requests than the buffer holds: finish this one and close
+    connection.closeAfter = true;
+    return;
+  }
+  dispatch(connection);
+  if (overflow && !connection.closeAfter) {
+    connection.closeAfter = true;
+    if (!connection.responding) {
+      connection.client->close();
+    }
+  }
+}
+
+void KeepAliveServer::dispatch(Connection& connection) {
+  if (connection.responding || connection.closeAfter || connection.buffered == 0) {
+    return;
+  }
+
+  KeepAliveRequest request;
+  int headLength = parse(connection.buffer, connection.buffered, request);
+  int error = 0;
+  if (headLength == 0) {
+    if (connection.buffered < sizeof(connection.buffer)) {
+      return;  // Wait for the rest of the head
+    }
+    error = 431;
+  } else if (headLength < 0) {
+    error = 400;
+  }
+  connection.headLength = headLength > 0 ? headLength : connection.buffered;
+  request.remoteIP = (uint32_t)connection.client->remoteIP();
+
+  Metrics::observeKeepAliveRequest(connection.requests > 0);
+  connection.requests++;
+  startResponse(connection, request, error);
+}
+
+void KeepAliveServer::startResponse(Connection& connection, const KeepAliveRequest& request, int error) {
+  KeepAliveResponse& response = connection.response;
+  response = KeepAliveResponse();
+
+  if (error != 0) {
+    response.send(error, "text/plain", statusText(error));
+    connection.closeAfter = true;
+  } else if (strcmp(request.method, "GET") != 0 || request.hasBody) {
+    response.send(405, "text/plain", statusText(405));
+    response.addHeader("Allow", "GET");
+    connection.closeAfter = true;
+  } else {
+    const Route* route = nullptr;
+    for (uint8_t i = 0; i < routeCount && route == nullptr; i++) {
+      if (strcmp(routes[i].path, request.path) == 0) {
+        route = &routes[i];
+      }
+    }
+    if (route != nullptr) {
+      route->handler(request, response);
+    } else {
+      response.send(404, "text/plain", statusText(404));
+    }
+  }
+  // HTTP/1.0 has no chunked encoding; the end of the body is the end of the connection
+  connection.chunked = response.body && response.contentLength < 0 && request.http11;
+  if (!request.keepAlive || connection.requests >= KEEPALIVE_MAX_REQUESTS ||
+      (response.body && response.contentLength < 0 && !connection.chunked)) {
+    connection.closeAfter = true;
+  }
+
+  int length = snprintf(connection.head, sizeof(connection.head), "HTTP/1.1 %d %s\r\n", response.status, statusText(response.status));
+  if (response.body) {
+    length += snprintf(connection.head + length, sizeof(connection.head) - length, "Content-Type: %s\r\n", response.contentType);
+    if (response.contentLength >= 0) {
+      length += snprintf(connection.head + length, sizeof(connection.head) - length, "Content-Length: %ld\r\n", response.contentLength);
+    } else if (connection.chunked) {
+      length += snprintf(connection.head + length, sizeof(connection.head) - length, "Transfer-Encoding: chunked\r\n");
+    }
+  } else if (response.status != 304) {
+    length += snprintf(connection.head + length, sizeof(connection.head) - length, "Content-Length: 0\r\n");
+  }
+  if (connection.closeAfter) {
+    length += snprintf(connection.head + length, sizeof(connection.head) - length, "Connection: close\r\n");
+  } else {
+    length += snprintf(connection.head + length, sizeof(connection.head) - length, "Connection: keep-alive\r\nKeep-Alive: timeout=%u, max=%u\r\n",
+                       (unsigned)(KEEPALIVE_IDLE_TIMEOUT / 1000), (unsigned)(KEEPALIVE_MAX_REQUESTS - connection.requests));
+  }
+  snprintf(connection.head + length, sizeof(connection.head) - length, "%s\r\n", response.headers);
+
+  connection.headSize = strlen(connection.head);
+  connection.headSent = 0;
+  connection.bodySent = 0;
+  connection.bodyDone = !response.body;
+  connection.responding = true;
+  pump(connection);
+}
+
+// Writes as much of the response as the socket takes; the rest follows on
+// the next ack or poll
+void KeepAliveServer::pump(Connection& connection) {
+  if (!connection.responding) {
+    return;
+  }
+  AsyncClient* client = connection.client;
+  KeepAliveResponse& response = connection.response;
+  bool chunked = connection.chunked;
+
+  while (connection.headSent < connection.headSize || !connection.bodyDone) {
+    size_t space = client->space();
+    if (connection.headSent < connection.headSize) {
+      size_t count = min(space, connection.headSize - connection.headSent);
+      if (count == 0) {
+        break;
+      }
+      client->add(connection.head + connection.headSent, count);
+      connection.headSent += count;
+      continue;
+    }
+
+    // Leave room for the chunk size line and trailing CRLF
+    size_t overhead = chunked ? 16 : 0;
+    if (space <= overhead) {
+      break;
+    }
+    size_t count = response.body(chunk, min(space - overhead, sizeof(chunk)));
+    if (count == 0) {
+      if (chunked) {
+        client->add("0\r\n\r\n", 5);
+      } else if (response.contentLength >= 0 && connection.bodySent < (size_t)response.contentLength) {
+        connection.closeAfter = true;  // Body ended short of its length; the framing is lost
+      }
+      connection.bodyDone = true;
+      break;
+    }
+    if (chunked) {
+      char size[12];
+      client->add(size, snprintf(size, sizeof(size), "%x\r\n", (unsigned)count));
+      client->add((const char*)chunk, count);
+      client->add("\r\n", 2);
+    } else {
+      client->add((const char*)chunk, count);
+    }
+    connection.bodySent += count;
+  }
+  client->send();
+
+  if (connection.headSent == connection.headSize && connection.bodyDone) {
+    finishResponse(connection);
+  }
+}
+
+void KeepAliveServer::finishResponse(Connection& connection) {
+  connection.responding = false;
+  std::function<void()> done = connection.response.onDone;
+  connection.response = KeepAliveResponse();  // Drops whatever the body held on to
+  if (done) {
+    done();
+  }
+  connection.lastActivity = millis();
+
+  if (connection.closeAfter) {
+    connection.client->close();
+    return;
+  }
+  // Pipelined requests already received are answered next
+  memmove(connection.buffer, connection.buffer + connection.headLength, connection.buffered - connection.headLength);
+  connection.buffered -= connection.headLength;
+  connection.headLength = 0;
+  dispatch(connection);
+}
+
+void KeepAliveServer::release(Connection& connection) {
+  Metrics::observeKeepAliveClose();
+  std::function<void()> done = connection.responding ? connection.response.onDone : nullptr;
+  connection.response = KeepAliveResponse();
+  connection.client = nullptr;
+  connection.responding = false;
+  connection.buffered = 0;
+  if (done) {
+    done();
+  }
+}
+
+int KeepAliveServer::parse(char* buffer, size_t length, KeepAliveRequest& request) {
+  size_t headEnd = 0;
+  while (headEnd + 4 <= length && memcmp(buffer + headEnd, "\r\n\r\n", 4) != 0) {
+    headEnd++;
+  }
+  if (headEnd + 4 > length) {
+    return 0;
+  }
+  buffer[headEnd] = '\0';
+
+  // Request line: METHOD SP target SP HTTP/1.x
+  char* line = buffer;
+  char* next = strstr(line, "\r\n");
+  if (next != nullptr) {
+    *next = '\0';
+    next += 2;
+  }
+  char* target = strchr(line, ' ');
+  if (target == nullptr) {
+    return -1;
+  }
+  *target++ = '\0';
+  char* version = strchr(target, ' ');
+  if (version == nullptr || target[0] != '/') {
+    return -1;
+  }
+  *version++ = '\0';
+  if (strncmp(version, "HTTP/1.", 7) != 0 || (version[7] != '0' && version[7] != '1') || version[8] != '\0') {
+    return -1;
+  }
+  request.method = line;
+  request.path = target;
+  char* query = strchr(target, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+    request.query = query;
+  }
+  request.http11 = version[7] == '1';
+  request.keepAlive = request.http11;
+
+  for (line = next; line != nullptr; line = next) {
+    next = strstr(line, "\r\n");
+    if (next != nullptr) {
+      *next = '\0';
+      next += 2;
+    }
+    char* value = strchr(line, ':');
+    if (value == nullptr) {
+      return -1;
+    }
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+
+    if (strcasecmp(line, "Connection") == 0) {
+      if (strcasecmp(value, "close") == 0) {
+        request.keepAlive = false;
+      } else if (strcasecmp(value, "keep-alive") == 0) {
+        request.keepAlive = true;
+      }
+    } else if (strcasecmp(line, "Accept") == 0) {
+      request.accept = value;
+    } else if (strcasecmp(line, "If-None-Match") == 0) {
+      request.ifNoneMatch = value;
+    } else if (strcasecmp(line, "Content-Length") == 0) {
+      request.hasBody = strtoul(value, nullptr, 10) > 0;
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+      request.hasBody = true;
+    }
+  }
+  return headEnd + 4;
+}
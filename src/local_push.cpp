@@ -0,0 +1,82 @@
+#include "local_push.h"
+
+void LocalPresencePush::begin(const String& apiKey, unsigned long defaultTtlSeconds) {
+  portENTER_CRITICAL(&keyLock);
+  strlcpy(key, apiKey.c_str(), sizeof(key));
+  portEXIT_CRITICAL(&keyLock);
+  ttlDefault = defaultTtlSeconds > 0 ? min(defaultTtlSeconds, (unsigned long)LOCAL_PUSH_MAX_TTL) : LOCAL_PUSH_DEFAULT_TTL;
+}
+
+bool LocalPresencePush::authorize(const String& credential) const {
+  char expected[sizeof(key)];
+  portENTER_CRITICAL(&keyLock);
+  memcpy(expected, key, sizeof(key));
+  portEXIT_CRITICAL(&keyLock);
+  size_t expectedLength = strlen(expected);
+  if (expectedLength == 0) {
+    return false;
+  }
+
+  const char* presented = credential.c_str();
+  if (credential.startsWith("Bearer ")) {
+    presented += 7;
+  }
+
+  // Constant-time compare so response timing does not leak the key
+  size_t presentedLength = strlen(presented);
+  uint8_t diff = presentedLength != expectedLength;
+  for (size_t i = 0; i < expectedLength; i++) {
+    char c = i < presentedLength ? presented[i] : 0;
+    diff |= c ^ expected[i];
+  }
+  return diff == 0;
+}
+
+void LocalPresencePush::apply(TeamsPresence presence, unsigned long ttlSeconds, const char* source) {
+  ttlSeconds = ttlFor(ttlSeconds);
+
+  pushedPresence = presence;
+  strlcpy(pushSource, source != nullptr && source[0] ? source : "agent", sizeof(pushSource));
+  appliedAt = millis();
+  ttlMillis = ttlSeconds * 1000;
+  active = true;
+  pushCount++;
+}
+
+unsigned long LocalPresencePush::ttlFor(unsigned long ttlSeconds) const {
+  if (ttlSeconds == 0) {
+    ttlSeconds = ttlDefault;
+  }
+  return min(ttlSeconds, (unsigned long)LOCAL_PUSH_MAX_TTL);
+}
+
+void LocalPresencePush::clear() {
+  active = false;
+}
+
+bool LocalPresencePush::expired() {
+  if (active && millis() - appliedAt >= ttlMillis) {
+    active = false;
+    return true;
+  }
+  return false;
+}
+
+unsigned long LocalPresencePush::remainingSeconds() const {
+  if (!active) {
+    return 0;
+  }
+  unsigned long elapsed = millis() - appliedAt;
+  return elapsed >= ttlMillis ? 0 : (ttlMillis - elapsed + 999) / 1000;
+}
+
+String LocalPresencePush::generateKey() {
+  static const char hex[] = "0123456789abcdef";
+  String generated;
+  for (int i = 0; i < LOCAL_PUSH_KEY_BYTES; i++) {
+    uint8_t b = esp_random() & 0xFF;
+    generated += hex[b >> 4];
+    generated += hex[b & 0x0F];
+  }
+  return generated;
+}
@@ -1,6 +1,6 @@
 #include "logging.h"
+#include <algorithm>
 #include <cstdarg>
-#include <ArduinoJson.h>
 
 // Static member initialization
 int Logger::currentLevel = LOG_LEVEL;
@@ -166,54 +166,148 @@ void Logger::logMessagef(int level, const char* format, va_list args) {
     Serial.println(buffer);
 }
 
-String Logger::getLogsAsJson() {
-    return logBuffer.getLogsAsJson();
+int Logger::getLogCount() {
+    return logBuffer.size();
+}
+
+uint32_t Logger::getLastLogSeq() {
+    return logBuffer.lastSeq();
+}
+
+bool Logger::getLogEntry(uint32_t seq, JsonObject out) {
+    return logBuffer.seqToJson(seq, out);
+}
+
+bool Logger::getLogRow(uint32_t seq, JsonArray out) {
+    return logBuffer.seqToRow(seq, out);
 }
 
 void Logger::clearLogs() {
     logBuffer.clear();
 }
 
+void Logger::setLogCapacity(int entries) {
+    logBuffer.setCapacity(entries);
+}
+
 // LogBuffer implementation
 void LogBuffer::addEntry(int level, const String& component, const String& message) {
-    entries[head].timestamp = millis();
-    entries[head].level = level;
-    entries[head].component = component;
-    entries[head].message = message;
+    // Copied before and swapped in under the lock; the entry's old strings
+    // end up in these copies and are freed after it
+    String componentCopy = component;
+    String messageCopy = message;
+    unsigned long now = millis();
     
-    head = (head + 1) % LOG_BUFFER_SIZE;
-    if (count < LOG_BUFFER_SIZE) {
+    portENTER_CRITICAL(&lock);
+    LogEntry& entry = entries[head];
+    entry.seq = nextSeq++;
+    entry.timestamp = now;
+    entry.level = level;
+    std::swap(entry.component, componentCopy);
+    std::swap(entry.message, messageCopy);
+    
+    head = (head + 1) % capacity;
+    if (count < capacity) {
         count++;
     }
+    portEXIT_CRITICAL(&lock);
+}
+
+bool LogBuffer::entryToJson(int position, JsonObject out) const {
+    portENTER_CRITICAL(&lock);
+    bool found = position >= 0 && position < count;
+    if (found) {
+        writeJson(indexOf(position), out);
+    }
+    portEXIT_CRITICAL(&lock);
+    return found;
+}
+
+bool LogBuffer::seqToJson(uint32_t seq, JsonObject out) const {
+    portENTER_CRITICAL(&lock);
+    int position = positionOfSeq(seq);
+    if (position >= 0) {
+        writeJson(indexOf(position), out);
+    }
+    portEXIT_CRITICAL(&lock);
+    return position >= 0;
 }
 
-String LogBuffer::getLogsAsJson() const {
-    DynamicJsonDocument doc(4096);
-    JsonArray logs = doc.createNestedArray("logs");
-    
-    int start = (count < LOG_BUFFER_SIZE) ? 0 : head;
-    for (int i = 0; i < count; i++) {
-        int index = (start + i) % LOG_BUFFER_SIZE;
-        JsonObject logEntry = logs.createNestedObject();
-        
-        logEntry["timestamp"] = entries[index].timestamp;
-        logEntry["level"] = getLevelString(entries[index].level);
-        logEntry["component"] = entries[index].component;
-        logEntry["message"] = entries[index].message;
-        
-        // Add relative time for readability
-        unsigned long relativeTime = (millis() - entries[index].timestamp) / 1000;
-        logEntry["relative_time"] = relativeTime;
+bool LogBuffer::seqToRow(uint32_t seq, JsonArray out) const {
+    portENTER_CRITICAL(&lock);
+    int position = positionOfSeq(seq);
+    if (position >= 0) {
+        writeRow(indexOf(position), out);
     }
+    portEXIT_CRITICAL(&lock);
+    return position >= 0;
+}
+
+// Callers hold the lock
+int LogBuffer::indexOf(int position) const {
+    int start = (count < capacity) ? 0 : head;
+    return (start + position) % capacity;
+}
+
+int LogBuffer::positionOfSeq(uint32_t seq) const {
+    uint32_t oldestSeq = nextSeq - count;
+    return (seq >= oldestSeq && seq < nextSeq) ? (int)(seq - oldestSeq) : -1;
+}
+
+void LogBuffer::writeJson(int index, JsonObject out) const {
+    out["seq"] = entries[index].seq;
+    out["timestamp"] = entries[index].timestamp;
+    out["level"] = getLevelString(entries[index].level);
+    out["component"] = entries[index].component;
+    out["message"] = entries[index].message;
     
-    String result;
-    serializeJson(doc, result);
-    return result;
+    // Add relative time for readability
+    unsigned long relativeTime = (millis() - entries[index].timestamp) / 1000;
+    out["relative_time"] = relativeTime;
+}
+
+// Compact form for binary clients: positional fields and the numeric level
+void LogBuffer::writeRow(int index, JsonArray out) const {
+    out.add(entries[index].seq);
+    out.add(entries[index].timestamp);
+    out.add(entries[index].level);
+    out.add(entries[index].component);
+    out.add(entries[index].message);
 }
 
 void LogBuffer::clear() {
+    portENTER_CRITICAL(&lock);
     head = 0;
     count = 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+// Keeps the newest entries that fit and frees the strings of the rest. The
+// kept entries are laid out oldest first from the start of the array, which
+// is what the ring looks like before it first wraps. This moves entries a
+// /logs response may be reading, so it all happens under the lock; it only
+// runs when the heap governor changes level.
+void LogBuffer::setCapacity(int size) {
+    size = constrain(size, 1, LOG_BUFFER_SIZE);
+    portENTER_CRITICAL(&lock);
+    if (size == capacity) {
+        portEXIT_CRITICAL(&lock);
+        return;
+    }
+    
+    int start = (count < capacity) ? 0 : head;
+    std::rotate(entries, entries + start, entries + capacity);
+    int dropped = max(0, count - size);
+    std::rotate(entries, entries + dropped, entries + count);
+    count -= dropped;
+    for (int i = count; i < LOG_BUFFER_SIZE; i++) {
+        entries[i].component = String();
+        entries[i].message = String();
+    }
+    
+    capacity = size;
+    head = count % capacity;
+    portEXIT_CRITICAL(&lock);
 }
 
 const char* LogBuffer::getLevelString(int level) const {
@@ -1,23 +1,58 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <Update.h>
 #include <time.h>
+#include <memory>
 #include "config.h"
 #include "logging.h"
+#include "calendar_sync.h"
+#include "presence_relay.h"
+#include "local_push.h"
+#include "status_board.h"
+#include "json_stream.h"
+#include "msgpack_stream.h"
+#include "gzip_stream.h"
+#include "dashboard_events.h"
+#include "status_snapshot.h"
+#include "cursor_read.h"
+#include "metrics.h"
+#include "device_config.h"
+#include "admission.h"
+#include "keepalive_server.h"
+#include "heap_governor.h"
+#include "scratch_arena.h"
+#include "presence_client.h"
+#include "presence_log.h"
+#include "heap_trace.h"
+#include "ui_assets.h"
 
 // Global objects
-WebServer server(HTTP_PORT);
-Preferences preferences;
+AsyncWebServer server(HTTP_PORT);
+AsyncEventSource dashboardEvents(DASHBOARD_EVENTS_PATH);
+KeepAliveServer keepAliveServer(KEEPALIVE_PORT);
+MeteredPreferences preferences;
 WiFiClientSecure client;
+CalendarSync calendarSync;
+PresenceRelay presenceRelay;
+LocalPresencePush localPush;
+StatusBoard statusBoard;
+AdmissionControl admission;
+HeapGovernor heapGovernor;
+PresenceClient presenceClient;
+DashboardDelta dashboardDelta;
+StatusSnapshot statusSnapshot;     // Body of /status
+StatusSnapshot statusPackSnapshot; // MessagePack body of /status
+StatusSnapshot dashboardSnapshot;  // Body of /api/snapshot (status and presence history)
 
 // Global state
 DeviceState currentState = STATE_AP_MODE;
 TeamsPresence currentPresence = PRESENCE_UNKNOWN;
+TeamsPresence upstreamPresence = PRESENCE_UNKNOWN; // Last presence reported by Graph or the relay
 unsigned long lastLedToggle = 0;
 bool ledState = false;
 unsigned long lastPresenceCheck = 0;
@@ -46,6 +81,69 @@ String tenantId;
 String userEmail;
 String accessToken;
 String refreshToken;
+String relayUrl;
+String relayKey;
+String pushApiKey;
+unsigned long pushTtl = LOCAL_PUSH_DEFAULT_TTL;
+bool boardMode = false;
+String boardRoster;
+
+// Work requested by web handlers and carried out in loop(), since handlers
+// run on the AsyncTCP task and must not block on Graph or restart the chip
+volatile bool deviceCodeRequested = false;
+volatile bool deviceCodeStartFailed = false;
+volatile bool calendarSyncRequested = false;
+int calendarSyncResult = HTTP_CODE_OK;
+unsigned long lastCalendarAttempt = 0;
+volatile bool restartScheduled = false;
+unsigned long restartAt = 0;
+
+// A validated update posted to /api/config, applied by loop()
+struct PendingConfig {
+  DeviceConfig config;
+  uint32_t changes;
+  String journal;  // Settings of a fleet import, journaled while they are saved
+};
+
+// What handlers may know about the settings and the sign-in. loop() owns
+// the live globals and publishes a fresh copy whenever it changes them, so
+// handlers never read a String that loop() is reassigning, or NVS.
+struct ConfigSnapshot {
+  DeviceConfig config;
+  bool hasPushApiKey;
+  bool signedIn;           // An access token is held
+  String userCode;         // Set while a device code sign-in is waiting
+  String verificationUri;
+};
+
+// Both handed over as shared pointers under configLock, like StatusSnapshot
+std::shared_ptr<const PendingConfig> pendingConfig;
+std::shared_ptr<const ConfigSnapshot> configSnapshot;
+portMUX_TYPE configLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Agent pushes and a regenerated agent key, handed over under pendingPushLock
+enum PushAction : uint8_t { PUSH_NONE, PUSH_APPLY, PUSH_CLEAR };
+struct PendingPush {
+  PushAction action;
+  TeamsPresence presence;
+  unsigned long ttl;
+  char source[24];
+};
+PendingPush pendingPush = {};
+char pendingPushApiKey[LOCAL_PUSH_KEY_BYTES * 2 + 1] = "";  // Empty unless a new key waits to be saved
+portMUX_TYPE pendingPushLock = portMUX_INITIALIZER_UNLOCKED;
+
+
+// Last presence reported by Graph or the relay (served by /location)
+char reportedAvailability[24] = "";
+char reportedActivity[32] = "";
+unsigned long lastPresenceReport = 0;
+portMUX_TYPE reportedPresenceLock = portMUX_INITIALIZER_UNLOCKED;
+volatile bool presenceRefreshRequested = false;
+unsigned long lastDashboardEvent = 0;
+unsigned long lastSnapshotCheck = 0;
+unsigned long lastSnapshotBuild = 0;
+unsigned long lastHeapSample = 0;
 
 // Device Code Flow variables
 String deviceCode;
@@ -64,6 +162,8 @@ bool timeConfigured = false;
 PresenceLogEntry presenceLogs[MAX_PRESENCE_LOGS];
 uint8_t presenceLogCount = 0;
 uint8_t presenceLogIndex = 0;
+uint32_t presenceLogSeq = 0;  // Seq of the newest presence log entry
+portMUX_TYPE presenceLogLock = portMUX_INITIALIZER_UNLOCKED;  // History readers run on the AsyncTCP task
 
 // Function declarations
 void setupLED();
@@ -78,30 +178,96 @@ void initDefaultLEDs();  // Initialize with default LED configuration
 void setupWiFiAP();
 void setupWiFiSTA();
 void setupWebServer();
-void handleRoot();
-void handleConfig();
-void handleSave();
-void handleStatus();
-void handleLogs();
-void handleSchedule();
-void handleLocation();
-void handleUpdate();
-void handleLogin();
-void handleCallback();
+void onRoute(const char* path, WebRequestMethodComposite method, ArRequestHandlerFunction handler, ArBodyHandlerFunction onBody = nullptr);
+void sendRejection(AsyncWebServerRequest* request, AdmissionControl::Result result, uint32_t retryAfter);
+void onKeepAliveRoute(const char* path, KeepAliveServer::Handler handler);
+void onWiFiEvent(WiFiEvent_t event);
+void runDeferredWork();
+void applyPendingPush();
+void governHeap();
+bool calendarRefreshDue();
+void publishDashboardEvents();
+void publishPresenceLog(const PresenceLogEntry& entry);
+void collectRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+void collectConfigBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+void bufferRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total, size_t limit);
+void scheduleRestart();
+void serveUiAsset(AsyncWebServerRequest* request, const UiAsset* asset);
+void handleConfigJson(AsyncWebServerRequest* request);
+void handleSave(AsyncWebServerRequest* request);
+String htmlEscape(const String& text);
+void handleConfigUpdate(AsyncWebServerRequest* request);
+void configFormToJson(AsyncWebServerRequest* request, JsonDocument& doc);
+int stageConfigUpdate(JsonObjectConst body, uint32_t& changes, String& error, const String& journal = String());
+void handleConfigExport(AsyncWebServerRequest* request);
+void handleConfigImport(AsyncWebServerRequest* request);
+void finishConfigJournal();
+DeviceConfig currentConfig();
+void publishConfigSnapshot();
+std::shared_ptr<const ConfigSnapshot> currentConfigSnapshot();
+void applyConfig(const DeviceConfig& config, uint32_t changes);
+void applyLedSettings(const DeviceConfig& config, bool pinsChanged);
+void saveConfigChanges(const DeviceConfig& config, uint32_t changes);
+bool produceStatus(JsonChunkWriter& out, size_t step);
+bool producePresenceHistory(JsonChunkWriter& out, size_t step, CursorWindow& window);
+bool produceLogs(JsonChunkWriter& out, size_t step, CursorWindow& window);
+bool packStatus(MsgPackChunkWriter& out, size_t step);
+bool packPresenceHistory(MsgPackChunkWriter& out, size_t step, CursorWindow& window);
+bool packLogs(MsgPackChunkWriter& out, size_t step, CursorWindow& window);
+void fillCursorFooter(JsonDocument& doc, const CursorWindow& window, bool alwaysMissed = false);
+bool wantsMsgPack(AsyncWebServerRequest* request);
+bool wantsMsgPack(const KeepAliveRequest& request);
+bool acceptsGzip(AsyncWebServerRequest* request);
+size_t fillCompressed(GzipStream& stream, uint8_t* buffer, size_t maxLen);
+int presenceLogsHeld();
+uint32_t lastPresenceLogSeq();
+CursorQuery parseCursorQuery(AsyncWebServerRequest* request);
+template <typename Writer>
+void sendCursorRead(AsyncWebServerRequest* request, const CursorQuery& query, uint32_t (*lastSeq)(), int (*entryCount)(),
+                    bool (*producer)(Writer& out, size_t step, CursorWindow& window), const char* contentType);
+uint32_t statusFingerprint();
+void refreshSnapshots();
+void sendSnapshot(AsyncWebServerRequest* request, const StatusSnapshot& snapshot, const char* contentType);
+void sendSnapshot(const KeepAliveRequest& request, KeepAliveResponse& response, const StatusSnapshot& snapshot, const char* contentType);
+void handleStatus(AsyncWebServerRequest* request);
+void handleSnapshot(AsyncWebServerRequest* request);
+void handleMetrics(AsyncWebServerRequest* request);
+void handleHeap(AsyncWebServerRequest* request);
+void handleLogs(AsyncWebServerRequest* request);
+void handleSchedule(AsyncWebServerRequest* request);
+void handleLocation(AsyncWebServerRequest* request);
+void handleUpdate(AsyncWebServerRequest* request);
+void handleLogin(AsyncWebServerRequest* request);
+void handleCallback(AsyncWebServerRequest* request);
 bool startDeviceCodeFlow();
 bool pollDeviceCodeToken();
 bool pollDeviceCodeTokenWithSecret();
 void checkTeamsPresence();
+TeamsPresence mapTeamsPresence(const char* availability, const char* activity);
+const char* getPresenceName(TeamsPresence presence);
+const char* getStateName(DeviceState state);
+void updatePresence(TeamsPresence newPresence);
+void onRelayPresence(const char* availability, const char* activity);
+void recordReportedPresence(const char* availability, const char* activity);
+bool reportedPresenceFresh(unsigned long maxAgeMillis);
+void applyUpstreamPresence(TeamsPresence newPresence);
+void handlePresencePush(AsyncWebServerRequest* request);
+void handlePresencePushClear(AsyncWebServerRequest* request);
+TeamsPresence getLEDPresence(uint8_t ledIndex);
+void handleBoard(AsyncWebServerRequest* request);
 bool refreshAccessToken();
+bool exchangeRefreshToken();
 void loadConfiguration();
 void saveConfiguration();
+uint32_t getLedSetting(LedKey setting, uint8_t index, uint32_t defaultValue);
+void putLedSetting(LedKey setting, uint8_t index, uint32_t value);
 void setupTime();
 void updateTime();
 String getCurrentTimeString();
 void logPresenceChange(TeamsPresence newPresence);
 void loadPresenceLogs();
 void savePresenceLogs();
-void handlePresenceHistory();
+void handlePresenceHistory(AsyncWebServerRequest* request);
 
 void setup() {
   Logger::begin(115200);
@@ -117,11 +283,21 @@ void setup() {
   LOG_DEBUG("Loading configuration");
   // Load saved configuration
   loadConfiguration();
+  finishConfigJournal();
+  publishConfigSnapshot();
   
   LOG_DEBUG("Loading presence logs");
   // Load presence logs
   loadPresenceLogs();
   
+  LOG_DEBUG("Loading calendar store");
+  calendarSync.begin(&preferences);
+  
+  if (boardMode) {
+    LOG_DEBUG("Setting up status board roster");
+    statusBoard.begin(clientId, clientSecret, tenantId, boardRoster, mapTeamsPresence);
+  }
+  
   // Check if device code flow was in progress
   if (deviceCode.length() > 0 && deviceCodeExpires > millis()) {
     LOG_INFO("Resuming device code flow from previous session");
@@ -130,6 +306,7 @@ void setup() {
   }
   
   // Set up WiFi
+  WiFi.onEvent(onWiFiEvent);
   if (wifiSSID.length() > 0) {
     LOG_INFOF("WiFi credentials found, connecting to: %s", wifiSSID.c_str());
     setupWiFiSTA();
@@ -138,6 +315,12 @@ void setup() {
     setupWiFiAP();
   }
   
+  LOG_DEBUG("Building status snapshot");
+  statusSnapshot.begin(esp_random());
+  statusPackSnapshot.begin(esp_random());
+  dashboardSnapshot.begin(esp_random());
+  refreshSnapshots();
+  
   LOG_DEBUG("Setting up web server");
   // Set up web server
   setupWebServer();
@@ -146,9 +329,27 @@ void setup() {
 }
 
 void loop() {
-  server.handleClient();  // Handle incoming HTTP requests
+  uint32_t loopStart = micros();
+  
+  governHeap();
+  HeapTrace::tick();
+  
+  // HTTP requests are served by the AsyncTCP task; only deferred work runs here
+  runDeferredWork();
   
   updateLED();
+  publishDashboardEvents();
+  
+  if (millis() - lastSnapshotCheck >= STATUS_SNAPSHOT_CHECK_INTERVAL) {
+    lastSnapshotCheck = millis();
+    refreshSnapshots();
+  }
+  
+  // Hand control back to Graph/relay once an agent push runs out
+  if (localPush.expired()) {
+    LOG_INFOF("Local presence push expired, returning to %s", getPresenceName(upstreamPresence));
+    updatePresence(upstreamPresence);
+  }
   
   // Update time if connected to WiFi
   if (WiFi.status() == WL_CONNECTED && timeConfigured) {
@@ -173,7 +374,10 @@ void loop() {
           setupTime();
         }
         
-        if (accessToken.length() > 0) {
+        if (boardMode) {
+          LOG_DEBUG("Status board mode, using app-only authentication");
+          currentState = STATE_AUTHENTICATED;
+        } else if (accessToken.length() > 0) {
           LOG_DEBUG("Access token found, transitioning to authenticated state");
           currentState = STATE_AUTHENTICATED;
         } else {
@@ -194,9 +398,12 @@ void loop() {
         if (millis() > deviceCodeExpires) {
           LOG_WARN("Device code expired, returning to OAuth state");
           currentState = STATE_CONNECTING_OAUTH;
-        } else if (pollDeviceCodeToken()) {
-          LOG_INFO("Device code authentication successful!");
-          currentState = STATE_AUTHENTICATED;
+        } else {
+          HeapTraceScope trace(TRACE_GRAPH_TOKEN);
+          if (pollDeviceCodeToken()) {
+            LOG_INFO("Device code authentication successful!");
+            currentState = STATE_AUTHENTICATED;
+          }
         }
         lastDeviceCodePoll = millis();
       }
@@ -204,16 +411,49 @@ void loop() {
       
     case STATE_AUTHENTICATED:
       LOG_INFO("Authentication successful, starting monitoring");
+      if (!boardMode && relayUrl.length() > 0 && !presenceRelay.isEnabled()) {
+        presenceRelay.begin(relayUrl, userEmail, relayKey, onRelayPresence);
+      }
       currentState = STATE_MONITORING;
       break;
       
-    case STATE_MONITORING:
-      if (millis() - lastPresenceCheck > 30000) { // Check every 30 seconds
+    case STATE_MONITORING: {
+      if (boardMode) {
+        // One app token and one bulk request cover the whole roster
+        if (millis() - lastPresenceCheck > PRESENCE_POLL_INTERVAL) {
+          LOG_DEBUG("Polling status board roster");
+          HeapTraceScope trace(TRACE_GRAPH_BOARD);
+          uint32_t pollStart = micros();
+          int pollCode = statusBoard.poll();
+          Metrics::observeGraphPoll(pollCode == HTTP_CODE_OK, micros() - pollStart);
+          lastPresenceCheck = millis();
+        }
+        break;
+      }
+      
+      presenceRelay.loop();
+      
+      // While the relay pushes changes, polling only acts as a consistency check
+      unsigned long pollInterval = presenceRelay.isConnected() ? RELAY_SAFETY_POLL_INTERVAL : PRESENCE_POLL_INTERVAL;
+      
+      // Requests that found the cache too old share one early poll. The
+      // request stays pending while PRESENCE_REFRESH_MIN_INTERVAL holds the
+      // poll back, and is cleared only by the poll that answers it.
+      if (millis() - lastPresenceCheck > pollInterval ||
+          (presenceRefreshRequested && millis() - lastPresenceCheck > PRESENCE_REFRESH_MIN_INTERVAL)) {
+        presenceRefreshRequested = false;
         LOG_DEBUG("Checking Teams presence");
+        HeapTraceScope trace(TRACE_GRAPH_PRESENCE);
         checkTeamsPresence();
         lastPresenceCheck = millis();
       }
+      
+      // Keep the schedule cache warm so /schedule never waits on Graph
+      if (calendarRefreshDue()) {
+        calendarSyncRequested = true;
+      }
       break;
+    }
       
     case STATE_ERROR:
       LOG_ERROR("Device in error state");
@@ -221,6 +461,7 @@ void loop() {
       break;
   }
   
+  Metrics::observeLoop(micros() - loopStart);
   delay(100);
 }
 
@@ -460,6 +701,14 @@ void applyLEDPattern(LEDPattern pattern) {
   }
 }
 
+TeamsPresence getLEDPresence(uint8_t ledIndex) {
+  // On a status board each LED follows the roster member in the same position
+  if (boardMode) {
+    return statusBoard.presenceAt(ledIndex);
+  }
+  return currentPresence;
+}
+
 void updateMultipleLEDs() {
   // Update each LED with its appropriate pattern based on current state
   for (uint8_t i = 0; i < ledCount; i++) {
@@ -469,7 +718,7 @@ void updateMultipleLEDs() {
       case STATE_AUTHENTICATED:
       case STATE_MONITORING:
         // LED behavior based on Teams presence using individual patterns
-        switch (currentPresence) {
+        switch (getLEDPresence(i)) {
           case PRESENCE_BUSY:
             applyLEDPattern(i, leds[i].callPattern);
             break;
@@ -631,66 +880,109 @@ void setupWiFiSTA() {
 void setupWebServer() {
   LOG_DEBUG("Configuring web server routes");
   
-  // Serve static files
-  server.on("/", [](){
-    LOG_DEBUG("Serving root page");
-    handleRoot();
+  // Handlers run on the AsyncTCP task, independently of loop(). They must
+  // never block: anything that talks to Graph is handed to loop() through
+  // the deferred-work flags and served from cached state.
+  // Static UI (pages, CSS, JS) is gzipped into flash at build time by
+  // scripts/build_ui.py; pages fetch everything dynamic from the JSON APIs
+  for (size_t i = 0; i < UI_ASSET_COUNT; i++) {
+    const UiAsset* asset = &UI_ASSETS[i];
+    onRoute(asset->path, HTTP_GET, [asset](AsyncWebServerRequest* request){
+      LOG_DEBUGF("Serving UI asset %s", asset->path);
+      serveUiAsset(request, asset);
+    });
+  }
+  
+  // Registered before /api/config, which would otherwise match them as subpaths
+  onRoute("/api/config/export", HTTP_GET, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Serving configuration export");
+    handleConfigExport(request);
   });
   
-  server.on("/config", [](){
-    LOG_DEBUG("Serving config page");
-    handleConfig();
+  onRoute("/api/config/import", HTTP_POST, [](AsyncWebServerRequest* request){
+    LOG_INFO("Processing configuration import");
+    handleConfigImport(request);
+  }, collectConfigBody);
+  
+  onRoute("/api/config", HTTP_GET, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Serving configuration API request");
+    handleConfigJson(request);
   });
   
-  server.on("/save", HTTP_POST, [](){
+  onRoute("/api/config", HTTP_POST, [](AsyncWebServerRequest* request){
+    LOG_INFO("Processing configuration API update");
+    handleConfigUpdate(request);
+  }, collectConfigBody);
+  
+  onRoute("/save", HTTP_POST, [](AsyncWebServerRequest* request){
     LOG_INFO("Processing configuration save request");
-    handleSave();
+    handleSave(request);
   });
   
-  server.on("/status", [](){
+  onRoute("/status", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Serving status API request");
-    handleStatus();
+    handleStatus(request);
   });
   
-  server.on("/logs", [](){
+  onRoute("/logs", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Serving logs API request");
-    handleLogs();
+    handleLogs(request);
   });
   
-  server.on("/logs", HTTP_DELETE, [](){
+  onRoute("/logs", HTTP_DELETE, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Clearing logs request");
     Logger::clearLogs();
-    server.send(200, "application/json", "{\"status\":\"cleared\"}");
+    request->send(200, "application/json", "{\"status\":\"cleared\"}");
   });
   
-  server.on("/schedule", [](){
+  onRoute("/schedule", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Serving schedule API request");
-    handleSchedule();
+    handleSchedule(request);
+  });
+  
+  onRoute("/api/snapshot", HTTP_GET, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Serving snapshot API request");
+    handleSnapshot(request);
   });
   
-  server.on("/presence-history", [](){
+  onRoute("/presence-history", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Serving presence history API request");
-    handlePresenceHistory();
+    handlePresenceHistory(request);
   });
   
-  server.on("/location", [](){
+  onRoute("/location", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_DEBUG("Serving location API request");
-    handleLocation();
+    handleLocation(request);
   });
   
-  server.on("/update", HTTP_POST, [](){
+  onRoute("/board", HTTP_GET, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Serving status board API request");
+    handleBoard(request);
+  });
+  
+  onRoute("/api/presence", HTTP_POST, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Processing local presence push");
+    handlePresencePush(request);
+  }, collectRequestBody);
+  
+  onRoute("/api/presence", HTTP_DELETE, [](AsyncWebServerRequest* request){
+    LOG_DEBUG("Clearing local presence push");
+    handlePresencePushClear(request);
+  });
+  
+  onRoute("/update", HTTP_POST, [](AsyncWebServerRequest* request){
     LOG_INFO("Processing firmware update request");
-    handleUpdate();
+    handleUpdate(request);
   });
   
-  server.on("/login", [](){
+  onRoute("/login", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_INFO("Processing OAuth login request");
-    handleLogin();
+    handleLogin(request);
   });
   
-  server.on("/callback", [](){
+  onRoute("/callback", HTTP_GET, [](AsyncWebServerRequest* request){
     LOG_INFO("OAuth callback accessed - redirecting to device code flow");
-    server.send(200, "text/html", R"(
+    request->send(200, "text/html", R"(
 <!DOCTYPE html>
 <html>
 <head>
@@ -712,16 +1004,65 @@ void setupWebServer() {
     )");
   });
   
-  server.on("/restart", HTTP_POST, [](){
+  onRoute("/restart", HTTP_POST, [](AsyncWebServerRequest* request){
     LOG_WARN("Device restart requested via web interface");
-    server.send(200, "text/plain", "Restarting...");
-    delay(1000);
-    ESP.restart();
+    request->send(200, "text/plain", "Restarting...");
+    scheduleRestart();
+  });
+  
+  onRoute("/metrics", HTTP_GET, [](AsyncWebServerRequest* request){
+    handleMetrics(request);
+  });
+  
+  onRoute("/api/heap", HTTP_GET, [](AsyncWebServerRequest* request){
+    handleHeap(request);
+  });
+  
+  // Live dashboard updates; browsers fall back to polling /status without them
+  dashboardEvents.onConnect([](AsyncEventSourceClient* client){
+    if (dashboardEvents.count() > DASHBOARD_MAX_CLIENTS) {
+      LOG_WARN("Too many dashboard event streams, closing the new one");
+      client->close();
+      return;
+    }
+    client->send("{}", "hello", 0, DASHBOARD_RECONNECT_DELAY);
+  });
+  server.addHandler(&dashboardEvents);
+  
+  server.onNotFound([](AsyncWebServerRequest* request){
+    request->send(404, "text/plain", "Not found");
   });
   
   server.begin();
   LOG_INFOF("Web server started on port %d", HTTP_PORT);
   
+  // The same cached bodies on a port that keeps connections open, for
+  // pollers and scrapers that would otherwise reconnect on every request
+  onKeepAliveRoute("/status", [](const KeepAliveRequest& request, KeepAliveResponse& response){
+    if (wantsMsgPack(request)) {
+      sendSnapshot(request, response, statusPackSnapshot, MSGPACK_CONTENT_TYPE);
+    } else {
+      sendSnapshot(request, response, statusSnapshot, "application/json");
+    }
+  });
+  onKeepAliveRoute("/api/snapshot", [](const KeepAliveRequest& request, KeepAliveResponse& response){
+    sendSnapshot(request, response, dashboardSnapshot, "application/json");
+  });
+  onKeepAliveRoute("/metrics", [](const KeepAliveRequest& request, KeepAliveResponse& response){
+    uint32_t ticket = Metrics::beginScrape();
+    if (ticket == 0) {
+      response.send(503, "text/plain", "Scrape in progress");
+      response.addHeader("Retry-After", "1");
+      return;
+    }
+    response.contentType = "text/plain; version=0.0.4; charset=utf-8";
+    response.body = [ticket](uint8_t* buffer, size_t maxLen) -> size_t {
+      return Metrics::fillScrape(ticket, buffer, maxLen);
+    };
+  });
+  keepAliveServer.begin();
+  LOG_INFOF("Keep-alive server started on port %d", KEEPALIVE_PORT);
+  
   if (currentState == STATE_AP_MODE) {
     LOG_INFO("Access configuration at: http://192.168.4.1");
   } else {
@@ -729,614 +1070,668 @@ void setupWebServer() {
   }
 }
 
-void handleRoot() {
-  String html = "<!DOCTYPE html>";
-  html += "<html lang=\"en\">";
-  html += "<head>";
-  html += "<meta charset=\"UTF-8\">";
-  html += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">";
-  html += "<title>Teams Red Light</title>";
-  html += "<style>";
-  html += "* { margin: 0; padding: 0; box-sizing: border-box; }";
-  html += "body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif; line-height: 1.6; color: #333; background: linear-gradient(135deg, #667eea 0%, #764ba2 100%); min-height: 100vh; padding: 1rem; display: flex; align-items: center; justify-content: center; }";
-  html += ".container { background: white; border-radius: 12px; box-shadow: 0 8px 32px rgba(0, 0, 0, 0.1); width: 100%; max-width: 500px; overflow: hidden; }";
-  html += ".header { background: linear-gradient(135deg, #d73502, #b12d02); color: white; padding: 2rem; text-align: center; }";
-  html += ".header h1 { font-size: 1.8rem; font-weight: 600; margin-bottom: 0.5rem; }";
-  html += ".content { padding: 2rem; }";
-  html += ".status-card { background: #f8f9fa; border-radius: 8px; padding: 1.5rem; margin-bottom: 2rem; text-align: center; border-left: 4px solid #6c757d; transition: all 0.3s ease; }";
-  html += ".status-card.connected { border-left-color: #28a745; background: #d4edda; color: #155724; }";
-  html += ".status-card.disconnected { border-left-color: #dc3545; background: #f8d7da; color: #721c24; }";
-  html += ".status-card.configuring { border-left-color: #ffc107; background: #fff3cd; color: #856404; }";
-  html += ".status-icon { font-size: 2rem; margin-bottom: 0.5rem; display: block; }";
-  html += ".status-text { font-weight: 600; font-size: 1.1rem; margin-bottom: 0.5rem; }";
-  html += ".status-detail { font-size: 0.9rem; opacity: 0.8; }";
-  html += ".actions { display: grid; gap: 0.75rem; margin-top: 1.5rem; }";
-  html += ".btn { background: #d73502; color: white; border: none; padding: 0.75rem 1rem; border-radius: 6px; font-size: 1rem; cursor: pointer; transition: all 0.2s ease; text-decoration: none; display: inline-block; text-align: center; }";
-  html += ".btn:hover { background: #b12d02; transform: translateY(-1px); }";
-  html += ".btn-secondary { background: #6c757d; } .btn-secondary:hover { background: #5a6268; }";
-  html += ".btn-danger { background: #dc3545; } .btn-danger:hover { background: #c82333; }";
-  html += ".device-info { background: #f8f9fa; border-radius: 6px; padding: 1rem; margin-top: 1rem; font-size: 0.9rem; color: #6c757d; }";
-  html += ".device-info div { margin-bottom: 0.25rem; }";
-  html += "@media (max-width: 768px) { body { padding: 0.5rem; } .header { padding: 1.5rem; } .content { padding: 1.5rem; } }";
-  html += "</style>";
-  html += "</head>";
-  html += "<body>";
-  html += "<div class=\"container\">";
-  html += "<div class=\"header\">";
-  html += "<h1>&#x1F534; Teams Red Light</h1>";
-  html += "<p>Device Control Panel</p>";
-  html += "</div>";
-  html += "<div class=\"content\">";
-  html += "<div id=\"status\" class=\"status-card configuring\">";
-  html += "<span class=\"status-icon\">&#x23F3;</span>";
-  html += "<div class=\"status-text\">Loading Status...</div>";
-  html += "<div class=\"status-detail\">Please wait while we check the device status</div>";
-  html += "</div>";
-  html += "<div class=\"actions\">";
-  html += "<button class=\"btn\" onclick=\"window.location.href='/config'\">&#x2699;&#xFE0F; Configure Device</button>";
-  html += "<button class=\"btn btn-secondary\" onclick=\"checkStatus()\">&#x1F504; Refresh Status</button>";
-  html += "<button class=\"btn btn-danger\" onclick=\"restartDevice()\">&#x1F50C; Restart Device</button>";
-  html += "</div>";
-  html += "<div class=\"device-info\" id=\"deviceInfo\" style=\"display: none;\">";
-  html += "<div><strong>Device Information:</strong></div>";
-  html += "<div id=\"ipAddress\"></div>";
-  html += "<div id=\"uptime\"></div>";
-  html += "<div id=\"wifiStatus\"></div>";
-  html += "<div id=\"currentTime\"></div>";
-  html += "<div id=\"timezone\"></div>";
-  html += "</div>";
-  html += "<div class=\"device-info\" id=\"presenceHistory\" style=\"display: none; margin-top: 1rem;\">";
-  html += "<div><strong>Recent Presence Changes:</strong></div>";
-  html += "<div id=\"presenceList\" style=\"max-height: 150px; overflow-y: auto; font-size: 0.8rem; margin-top: 0.5rem;\"></div>";
-  html += "</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "<script>";
-  html += "function checkStatus() {";
-  html += "fetch('/status').then(response => response.json()).then(data => {";
-  html += "const statusDiv = document.getElementById('status');";
-  html += "const deviceInfo = document.getElementById('deviceInfo');";
-  html += "if (data.state === 'monitoring') {";
-  html += "statusDiv.className = 'status-card connected';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x2705;</span><div class=\"status-text\">Connected & Monitoring</div><div class=\"status-detail\">Teams presence: ' + (data.presence || 'Unknown') + '</div>';";
-  html += "} else if (data.state === 'ap_mode') {";
-  html += "statusDiv.className = 'status-card configuring';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x2699;&#xFE0F;</span><div class=\"status-text\">Configuration Mode</div><div class=\"status-detail\">Please configure WiFi and Teams settings</div>';";
-  html += "} else if (data.state === 'connecting_wifi') {";
-  html += "statusDiv.className = 'status-card configuring';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x1F4F6;</span><div class=\"status-text\">Connecting to WiFi</div><div class=\"status-detail\">Establishing network connection...</div>';";
-  html += "} else if (data.state === 'connecting_oauth' || data.state === 'device_code_pending') {";
-  html += "statusDiv.className = 'status-card configuring';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x1F510;</span><div class=\"status-text\">Waiting for Authentication</div><div class=\"status-detail\">Complete Microsoft Teams authentication</div>';";
-  html += "} else {";
-  html += "statusDiv.className = 'status-card disconnected';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x274C;</span><div class=\"status-text\">Disconnected</div><div class=\"status-detail\">' + (data.message || 'Not connected') + '</div>';";
-  html += "}";
-  html += "if (data.ip_address || data.uptime || data.wifi_connected !== undefined || data.time_configured) {";
-  html += "deviceInfo.style.display = 'block';";
-  html += "document.getElementById('ipAddress').textContent = data.ip_address ? 'IP Address: ' + data.ip_address : '';";
-  html += "document.getElementById('uptime').textContent = data.uptime ? 'Uptime: ' + Math.floor(data.uptime / 60) + ' minutes' : '';";
-  html += "document.getElementById('wifiStatus').textContent = data.wifi_connected !== undefined ? 'WiFi: ' + (data.wifi_connected ? 'Connected' : 'Disconnected') : '';";
-  html += "if (data.time_configured && data.current_time) {";
-  html += "document.getElementById('currentTime').textContent = 'Time: ' + data.current_time;";
-  html += "const tzOffset = data.timezone_offset || 0;";
-  html += "const dlOffset = data.daylight_offset || 0;";
-  html += "const totalOffset = tzOffset + dlOffset;";
-  html += "const sign = totalOffset >= 0 ? '+' : '';";
-  html += "document.getElementById('timezone').textContent = 'Timezone: UTC' + sign + totalOffset;";
-  html += "} else {";
-  html += "document.getElementById('currentTime').textContent = 'Time: Not synchronized';";
-  html += "document.getElementById('timezone').textContent = 'Timezone: Not configured';";
-  html += "}";
-  html += "}";
-  html += "if (data.state === 'monitoring') { loadPresenceHistory(); }";
-  html += "}).catch(() => {";
-  html += "const statusDiv = document.getElementById('status');";
-  html += "statusDiv.className = 'status-card disconnected';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x26A0;&#xFE0F;</span><div class=\"status-text\">Connection Error</div><div class=\"status-detail\">Unable to get device status</div>';";
-  html += "});";
-  html += "}";
-  html += "function restartDevice() {";
-  html += "if (confirm('Are you sure you want to restart the device? This will temporarily interrupt monitoring.')) {";
-  html += "fetch('/restart', { method: 'POST' }).then(() => {";
-  html += "const statusDiv = document.getElementById('status');";
-  html += "statusDiv.className = 'status-card configuring';";
-  html += "statusDiv.innerHTML = '<span class=\"status-icon\">&#x1F504;</span><div class=\"status-text\">Restarting Device</div><div class=\"status-detail\">Please wait 30 seconds...</div>';";
-  html += "setTimeout(() => location.reload(), 30000);";
-  html += "}).catch(() => { alert('Failed to restart device. Please try again.'); });";
-  html += "}";
-  html += "}";
-  html += "function loadPresenceHistory() {";
-  html += "fetch('/presence-history').then(response => response.json()).then(data => {";
-  html += "const presenceHistory = document.getElementById('presenceHistory');";
-  html += "const presenceList = document.getElementById('presenceList');";
-  html += "if (data.logs && data.logs.length > 0) {";
-  html += "presenceHistory.style.display = 'block';";
-  html += "presenceList.innerHTML = '';";
-  html += "const recentLogs = data.logs.slice(-10).reverse();";
-  html += "recentLogs.forEach(log => {";
-  html += "const logDiv = document.createElement('div');";
-  html += "logDiv.style.cssText = 'display: flex; justify-content: space-between; padding: 2px 0; border-bottom: 1px solid #eee; font-size: 0.75rem;';";
-  html += "let presenceColor = '#6c757d';";
-  html += "if (log.presence === 'Available') presenceColor = '#28a745';";
-  html += "else if (log.presence === 'Busy') presenceColor = '#ffc107';";
-  html += "else if (log.presence === 'In Meeting') presenceColor = '#dc3545';";
-  html += "else if (log.presence === 'Away') presenceColor = '#6c757d';";
-  html += "else if (log.presence === 'Offline') presenceColor = '#6c757d';";
-  html += "logDiv.innerHTML = '<span style=\"color: ' + presenceColor + ';\">' + log.presence + '</span><span style=\"color: #6c757d;\">' + log.timestamp + '</span>';";
-  html += "presenceList.appendChild(logDiv);";
-  html += "});";
-  html += "} else {";
-  html += "presenceHistory.style.display = 'none';";
-  html += "}";
-  html += "}).catch(() => { presenceHistory.style.display = 'none'; });";
-  html += "}";
-  html += "checkStatus(); setInterval(checkStatus, 10000);";
-  html += "</script>";
-  html += "</body>";
-  html += "</html>";
-  
-  server.send(200, "text/html", html);
-}
-
-void handleConfig() {
-  String html = "<!DOCTYPE html>";
-  html += "<html lang=\"en\">";
-  html += "<head>";
-  html += "<meta charset=\"UTF-8\">";
-  html += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">";
-  html += "<title>Teams Red Light - Configuration</title>";
-  html += "<style>";
-  html += "* { margin: 0; padding: 0; box-sizing: border-box; }";
-  html += "body { font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif; line-height: 1.6; color: #333; background: linear-gradient(135deg, #667eea 0%, #764ba2 100%); min-height: 100vh; padding: 1rem; }";
-  html += ".container { background: white; border-radius: 12px; box-shadow: 0 8px 32px rgba(0, 0, 0, 0.1); width: 100%; max-width: 700px; margin: 0 auto; overflow: hidden; }";
-  html += ".header { background: linear-gradient(135deg, #d73502, #b12d02); color: white; padding: 2rem; text-align: center; }";
-  html += ".header h1 { font-size: 1.8rem; font-weight: 600; margin-bottom: 0.5rem; }";
-  html += ".content { padding: 2rem; }";
-  html += ".section { background: #f8f9fa; border-radius: 8px; padding: 1.5rem; margin-bottom: 1.5rem; border-left: 4px solid #d73502; }";
-  html += ".section h3 { color: #d73502; margin-bottom: 1rem; font-size: 1.2rem; }";
-  html += ".form-group { margin-bottom: 1rem; }";
-  html += "label { display: block; margin-bottom: 0.5rem; font-weight: 600; color: #333; }";
-  html += "input[type=\"text\"], input[type=\"password\"], input[type=\"email\"], select { width: 100%; padding: 0.75rem; border: 2px solid #e9ecef; border-radius: 6px; font-size: 1rem; transition: border-color 0.2s ease; }";
-  html += "input:focus, select:focus { outline: none; border-color: #d73502; }";
-  html += ".help { font-size: 0.875rem; color: #6c757d; margin-top: 0.25rem; }";
-  html += ".led-config { border: 1px solid #dee2e6; border-radius: 6px; padding: 1rem; margin: 1rem 0; background: #fff; }";
-  html += ".led-config h4 { color: #495057; margin-bottom: 1rem; font-size: 1rem; border-bottom: 1px solid #dee2e6; padding-bottom: 0.5rem; }";
-  html += ".actions { display: grid; grid-template-columns: 1fr 1fr; gap: 1rem; margin-top: 2rem; }";
-  html += ".btn { background: #d73502; color: white; border: none; padding: 0.75rem 1.5rem; border-radius: 6px; font-size: 1rem; cursor: pointer; transition: all 0.2s ease; text-decoration: none; text-align: center; display: inline-block; }";
-  html += ".btn:hover { background: #b12d02; transform: translateY(-1px); }";
-  html += ".btn-secondary { background: #6c757d; color: white; } .btn-secondary:hover { background: #5a6268; }";
-  html += ".btn-auth { background: #0078d4; margin-top: 1rem; width: 100%; } .btn-auth:hover { background: #106ebe; }";
-  html += ".info-box { background: #e8f4fd; border: 1px solid #bee5eb; border-radius: 6px; padding: 1rem; margin-top: 1rem; }";
-  html += ".info-box h4 { color: #0c5460; margin-bottom: 0.5rem; }";
-  html += ".info-box ol { margin-left: 1.5rem; color: #0c5460; }";
-  html += ".info-box li { margin-bottom: 0.5rem; }";
-  html += "@media (max-width: 768px) { body { padding: 0.5rem; } .header { padding: 1.5rem; } .content { padding: 1.5rem; } .actions { grid-template-columns: 1fr; } }";
-  html += "</style>";
-  html += "</head>";
-  html += "<body>";
-  html += "<div class=\"container\">";
-  html += "<div class=\"header\">";
-  html += "<h1>&#x2699;&#xFE0F; Device Configuration</h1>";
-  html += "<p>Configure your Teams Red Light device</p>";
-  html += "</div>";
-  html += "<div class=\"content\">";
-  html += "<form action=\"/save\" method=\"POST\">";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F4F6; WiFi Connection</h3>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"wifi_ssid\">Network Name (SSID)</label>";
-  html += "<input type=\"text\" id=\"wifi_ssid\" name=\"wifi_ssid\" value=\"" + wifiSSID + "\" required placeholder=\"Enter your WiFi network name\">";
-  html += "</div>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"wifi_password\">WiFi Password</label>";
-  html += "<input type=\"password\" id=\"wifi_password\" name=\"wifi_password\" value=\"\" placeholder=\"Enter WiFi password\">";
-  html += "<div class=\"help\">&#x1F4A1; Leave blank to keep current password</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F510; Microsoft Teams Integration</h3>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"user_email\">Your Email Address</label>";
-  html += "<input type=\"email\" id=\"user_email\" name=\"user_email\" value=\"" + userEmail + "\" required placeholder=\"your.name@company.com\">";
-  html += "<div class=\"help\">&#x1F4E7; The email address for your Teams account</div>";
-  html += "</div>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"tenant_id\">Tenant ID (Optional)</label>";
-  html += "<input type=\"text\" id=\"tenant_id\" name=\"tenant_id\" value=\"" + tenantId + "\" placeholder=\"common\">";
-  html += "<div class=\"help\">&#x1F3E2; Your Office 365 tenant ID (use 'common' for personal accounts)</div>";
-  html += "</div>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"client_id\">Application Client ID</label>";
-  html += "<input type=\"text\" id=\"client_id\" name=\"client_id\" value=\"" + clientId + "\" required placeholder=\"12345678-1234-1234-1234-123456789012\">";
-  html += "<div class=\"help\">&#x1F194; Azure AD Application Client ID</div>";
-  html += "</div>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"client_secret\">Application Client Secret</label>";
-  html += "<input type=\"password\" id=\"client_secret\" name=\"client_secret\" value=\"\" placeholder=\"Enter client secret\">";
-  html += "<div class=\"help\">&#x1F511; Azure AD Application Client Secret (leave blank to keep current)</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F504; Firmware Updates</h3>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"ota_url\">Update URL</label>";
-  html += "<input type=\"text\" id=\"ota_url\" name=\"ota_url\" value=\"" + preferences.getString(OTA_UPDATE_URL_KEY, DEFAULT_OTA_URL) + "\" placeholder=\"https://github.com/...\">";
-  html += "<div class=\"help\">&#x1F310; URL for over-the-air firmware updates</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F4A1; LED Pattern Settings</h3>";
-  html += "<div class=\"form-group\">";
-  html += "<label for=\"led_count\">Number of LEDs</label>";
-  html += "<select id=\"led_count\" name=\"led_count\" onchange=\"updateLEDFields()\">";
-  for (uint8_t i = 1; i <= MAX_LEDS; i++) {
-    html += "<option value=\"" + String(i) + "\"" + String(ledCount == i ? " selected" : "") + ">" + String(i) + " LED" + (i > 1 ? "s" : "") + "</option>";
-  }
-  html += "</select>";
-  html += "<div class=\"help\">&#x1F4A1; Select the number of LEDs to configure</div>";
-  html += "</div>";
-  
-  html += "<div id=\"led_configurations\">";
-  for (uint8_t i = 0; i < MAX_LEDS; i++) {
-    html += "<div class=\"led-config\" id=\"led_config_" + String(i) + "\" style=\"" + String(i >= ledCount ? "display:none;" : "") + "\">";
-    html += "<h4>LED " + String(i + 1) + " Configuration</h4>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_pin_" + String(i) + "\">GPIO Pin</label>";
-    html += "<select id=\"led_pin_" + String(i) + "\" name=\"led_pin_" + String(i) + "\">";
-    for (uint8_t j = 0; j < availableGPIOCount; j++) {
-      uint8_t pin = availableGPIOPins[j];
-      uint8_t selectedPin = (i < ledCount) ? leds[i].pin : LED_PIN;
-      html += "<option value=\"" + String(pin) + "\"" + String(selectedPin == pin ? " selected" : "") + ">GPIO " + String(pin) + "</option>";
+// Registers a route whose handler time is recorded per route on /metrics and
+// whose heap use is traced on /api/heap.
+// Requests pass admission control first; an admitted one holds its slot
+// until the connection closes, which covers streamed bodies too. While heap
+// is critically low every request is refused before anything is built.
+void onRoute(const char* path, WebRequestMethodComposite method, ArRequestHandlerFunction handler, ArBodyHandlerFunction onBody) {
+  const char* methodName = method == HTTP_POST ? "POST" : (method == HTTP_DELETE ? "DELETE" : "GET");
+  int route = Metrics::registerRoute(methodName, path);
+  if (route < 0) {
+    LOG_WARNF("No metrics slot left for %s %s", methodName, path);
+  }
+  int point = HeapTrace::registerPoint(methodName, path);
+  RoutePriority priority = AdmissionControl::priorityFor(path);
+  server.on(path, method, [route, point, priority, handler](AsyncWebServerRequest* request){
+    if (heapGovernor.refuseRequests()) {
+      sendRejection(request, AdmissionControl::OVERLOADED, HEAP_REFUSE_RETRY_AFTER);
+      return;
     }
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F50C; Select GPIO pin for this LED</div>";
-    html += "</div>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_call_" + String(i) + "\">Call Pattern</label>";
-    html += "<select id=\"led_call_" + String(i) + "\" name=\"led_call_" + String(i) + "\">";
-    LEDPattern callPat = (i < ledCount) ? leds[i].callPattern : DEFAULT_CALL_PATTERN;
-    html += "<option value=\"0\"" + String(callPat == 0 ? " selected" : "") + ">Off</option>";
-    html += "<option value=\"1\"" + String(callPat == 1 ? " selected" : "") + ">Solid</option>";
-    html += "<option value=\"2\"" + String(callPat == 2 ? " selected" : "") + ">Slow Blink (1s)</option>";
-    html += "<option value=\"3\"" + String(callPat == 3 ? " selected" : "") + ">Medium Blink (0.5s)</option>";
-    html += "<option value=\"4\"" + String(callPat == 4 ? " selected" : "") + ">Fast Blink (0.2s) (Default)</option>";
-    html += "<option value=\"5\"" + String(callPat == 5 ? " selected" : "") + ">Double Blink</option>";
-    html += "<option value=\"6\"" + String(callPat == 6 ? " selected" : "") + ">Dim Solid</option>";
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F4F5; Pattern during calls (busy status)</div>";
-    html += "</div>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_meeting_" + String(i) + "\">Meeting Pattern</label>";
-    html += "<select id=\"led_meeting_" + String(i) + "\" name=\"led_meeting_" + String(i) + "\">";
-    LEDPattern meetPat = (i < ledCount) ? leds[i].meetingPattern : DEFAULT_MEETING_PATTERN;
-    html += "<option value=\"0\"" + String(meetPat == 0 ? " selected" : "") + ">Off</option>";
-    html += "<option value=\"1\"" + String(meetPat == 1 ? " selected" : "") + ">Solid (Default)</option>";
-    html += "<option value=\"2\"" + String(meetPat == 2 ? " selected" : "") + ">Slow Blink (1s)</option>";
-    html += "<option value=\"3\"" + String(meetPat == 3 ? " selected" : "") + ">Medium Blink (0.5s)</option>";
-    html += "<option value=\"4\"" + String(meetPat == 4 ? " selected" : "") + ">Fast Blink (0.2s)</option>";
-    html += "<option value=\"5\"" + String(meetPat == 5 ? " selected" : "") + ">Double Blink</option>";
-    html += "<option value=\"6\"" + String(meetPat == 6 ? " selected" : "") + ">Dim Solid</option>";
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F4C5; Pattern during meetings</div>";
-    html += "</div>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_available_" + String(i) + "\">Available Pattern</label>";
-    html += "<select id=\"led_available_" + String(i) + "\" name=\"led_available_" + String(i) + "\">";
-    LEDPattern availPat = (i < ledCount) ? leds[i].availablePattern : DEFAULT_AVAILABLE_PATTERN;
-    html += "<option value=\"0\"" + String(availPat == 0 ? " selected" : "") + ">Off (Default)</option>";
-    html += "<option value=\"1\"" + String(availPat == 1 ? " selected" : "") + ">Solid</option>";
-    html += "<option value=\"2\"" + String(availPat == 2 ? " selected" : "") + ">Slow Blink (1s)</option>";
-    html += "<option value=\"3\"" + String(availPat == 3 ? " selected" : "") + ">Medium Blink (0.5s)</option>";
-    html += "<option value=\"4\"" + String(availPat == 4 ? " selected" : "") + ">Fast Blink (0.2s)</option>";
-    html += "<option value=\"5\"" + String(availPat == 5 ? " selected" : "") + ">Double Blink</option>";
-    html += "<option value=\"6\"" + String(availPat == 6 ? " selected" : "") + ">Dim Solid</option>";
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F7E2; Pattern when available</div>";
-    html += "</div>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_away_" + String(i) + "\">Away Pattern</label>";
-    html += "<select id=\"led_away_" + String(i) + "\" name=\"led_away_" + String(i) + "\">";
-    LEDPattern awayPat = (i < ledCount) ? leds[i].awayPattern : DEFAULT_AWAY_PATTERN;
-    html += "<option value=\"0\"" + String(awayPat == 0 ? " selected" : "") + ">Off (Default)</option>";
-    html += "<option value=\"1\"" + String(awayPat == 1 ? " selected" : "") + ">Solid</option>";
-    html += "<option value=\"2\"" + String(awayPat == 2 ? " selected" : "") + ">Slow Blink (1s)</option>";
-    html += "<option value=\"3\"" + String(awayPat == 3 ? " selected" : "") + ">Medium Blink (0.5s)</option>";
-    html += "<option value=\"4\"" + String(awayPat == 4 ? " selected" : "") + ">Fast Blink (0.2s)</option>";
-    html += "<option value=\"5\"" + String(awayPat == 5 ? " selected" : "") + ">Double Blink</option>";
-    html += "<option value=\"6\"" + String(awayPat == 6 ? " selected" : "") + ">Dim Solid</option>";
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F530; Pattern when away</div>";
-    html += "</div>";
-    
-    html += "<div class=\"form-group\">";
-    html += "<label for=\"led_offline_" + String(i) + "\">Offline Pattern</label>";
-    html += "<select id=\"led_offline_" + String(i) + "\" name=\"led_offline_" + String(i) + "\">";
-    LEDPattern offlinePat = (i < ledCount) ? leds[i].offlinePattern : DEFAULT_OFFLINE_PATTERN;
-    html += "<option value=\"0\"" + String(offlinePat == 0 ? " selected" : "") + ">Off (Default)</option>";
-    html += "<option value=\"1\"" + String(offlinePat == 1 ? " selected" : "") + ">Solid</option>";
-    html += "<option value=\"2\"" + String(offlinePat == 2 ? " selected" : "") + ">Slow Blink (1s)</option>";
-    html += "<option value=\"3\"" + String(offlinePat == 3 ? " selected" : "") + ">Medium Blink (0.5s)</option>";
-    html += "<option value=\"4\"" + String(offlinePat == 4 ? " selected" : "") + ">Fast Blink (0.2s)</option>";
-    html += "<option value=\"5\"" + String(offlinePat == 5 ? " selected" : "") + ">Double Blink</option>";
-    html += "<option value=\"6\"" + String(offlinePat == 6 ? " selected" : "") + ">Dim Solid</option>";
-    html += "</select>";
-    html += "<div class=\"help\">&#x1F534; Pattern when offline</div>";
-    html += "</div>";
-    html += "</div>";
-  }
-  html += "</div>";
-  
-  html += "<script>";
-  html += "function updateLEDFields() {";
-  html += "  var count = parseInt(document.getElementById('led_count').value);";
-  html += "  for (var i = 0; i < " + String(MAX_LEDS) + "; i++) {";
-  html += "    var element = document.getElementById('led_config_' + i);";
-  html += "    if (element) {";
-  html += "      element.style.display = i < count ? 'block' : 'none';";
-  html += "    }";
-  html += "  }";
-  html += "}";
-  html += "</script>";
-  html += "</div>";
-  html += "<div class=\"actions\">";
-  html += "<button type=\"submit\" class=\"btn\">&#x1F4BE; Save Configuration</button>";
-  html += "<button type=\"button\" class=\"btn btn-secondary\" onclick=\"window.location.href='/'\">&#x2190; Back to Home</button>";
-  html += "</div>";
-  html += "</form>";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F510; Microsoft Authentication</h3>";
-  html += "<p>After saving your configuration, authenticate with Microsoft to enable Teams presence monitoring.</p>";
-  html += "<button type=\"button\" class=\"btn btn-auth\" onclick=\"window.location.href='/login'\">&#x1F680; Authenticate with Microsoft</button>";
-  html += "<div class=\"info-box\">";
-  html += "<h4>&#x2705; Secure Device Code Flow</h4>";
-  html += "<p>This device uses Microsoft's secure Device Code Flow - no redirect URLs or SSL certificates needed!</p>";
-  html += "</div>";
-  html += "</div>";
-  html += "<div class=\"section\">";
-  html += "<h3>&#x1F4CB; Setup Guide</h3>";
-  html += "<div class=\"info-box\">";
-  html += "<h4>Azure AD Application Setup:</h4>";
-  html += "<ol>";
-  html += "<li>Go to <strong>Azure Portal</strong> &#x2192; Azure Active Directory &#x2192; App registrations</li>";
-  html += "<li>Click <strong>\"New registration\"</strong></li>";
-  html += "<li>Enter name: <strong>\"Teams Red Light\"</strong></li>";
-  html += "<li>Leave redirect URI <strong>blank</strong> (not needed!)</li>";
-  html += "<li>Add API permission: <strong>Microsoft Graph &#x2192; Presence.Read</strong></li>";
-  html += "<li>Create a <strong>client secret</strong></li>";
-  html += "<li>Copy the <strong>Client ID</strong> and <strong>Client Secret</strong> above</li>";
-  html += "</ol>";
-  html += "</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "</div>";
-  html += "</body>";
-  html += "</html>";
-  
-  server.send(200, "text/html", html);
-}
-
-
-void handleSave() {
-  LOG_INFO("Processing configuration save request");
-  bool configChanged = false;
-  
-  // Save WiFi configuration
-  if (server.hasArg("wifi_ssid")) {
-    String newSSID = server.arg("wifi_ssid");
-    if (newSSID != wifiSSID) {
-      LOG_INFOF("WiFi SSID changed from '%s' to '%s'", wifiSSID.c_str(), newSSID.c_str());
-      wifiSSID = newSSID;
-      preferences.putString(KEY_WIFI_SSID, wifiSSID);
-      configChanged = true;
+    uint32_t retryAfter = 0;
+    AdmissionControl::Result result = admission.admit((uint32_t)request->client()->remoteIP(), priority, millis(), retryAfter);
+    if (result != AdmissionControl::ADMITTED) {
+      sendRejection(request, result, retryAfter);
+      return;
+    }
+    request->onDisconnect([](){
+      admission.release();
+    });
+
+    HeapTraceScope trace(point);
+    uint32_t start = micros();
+    handler(request);
+    Metrics::observeRoute(route, micros() - start);
+  }, nullptr, onBody);
+}
+
+// Keep-alive routes go through the same admission control; the slot is
+// released once the response has been sent
+void onKeepAliveRoute(const char* path, KeepAliveServer::Handler handler) {
+  int point = HeapTrace::registerPoint("keepalive", path);
+  RoutePriority priority = AdmissionControl::priorityFor(path);
+  bool added = keepAliveServer.on(path, [point, priority, handler](const KeepAliveRequest& request, KeepAliveResponse& response){
+    uint32_t retryAfter = 0;
+    AdmissionControl::Result result = admission.admit(request.remoteIP, priority, millis(), retryAfter);
+    if (result != AdmissionControl::ADMITTED) {
+      bool overloaded = result == AdmissionControl::OVERLOADED;
+      Metrics::countHttpRejection(overloaded);
+      response.send(overloaded ? 503 : 429, "application/json",
+                    overloaded ? "{\"error\":\"server busy\"}" : "{\"error\":\"too many requests\"}");
+      char seconds[12];
+      snprintf(seconds, sizeof(seconds), "%u", (unsigned)retryAfter);
+      response.addHeader("Retry-After", seconds);
+      return;
+    }
+    response.onDone = [](){
+      admission.release();
+    };
+    HeapTraceScope trace(point);
+    handler(request, response);
+  });
+  if (!added) {
+    LOG_WARNF("No keep-alive route slot left for %s", path);
+  }
+}
+
+void sendRejection(AsyncWebServerRequest* request, AdmissionControl::Result result, uint32_t retryAfter) {
+  bool overloaded = result == AdmissionControl::OVERLOADED;
+  Metrics::countHttpRejection(overloaded);
+  LOG_DEBUGF("%s %s from %s", overloaded ? "Overloaded, refused" : "Rate limited",
+             request->url().c_str(), request->client()->remoteIP().toString().c_str());
+
+  AsyncWebServerResponse* response = request->beginResponse(overloaded ? 503 : 429, "application/json",
+    overloaded ? "{\"error\":\"server busy\"}" : "{\"error\":\"too many requests\"}");
+  response->addHeader("Retry-After", String(retryAfter));
+  request->send(response);
+}
+
+void onWiFiEvent(WiFiEvent_t event) {
+  // The first connection is made by setupWiFiSTA(); later ones are the
+  // driver reconnecting after the access point was lost
+  static bool connectedBefore = false;
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    if (connectedBefore) {
+      Metrics::countWifiReconnect();
+      LOG_INFOF("WiFi reconnected, IP address: %s", WiFi.localIP().toString().c_str());
     }
+    connectedBefore = true;
   }
-  
-  if (server.hasArg("wifi_password") && server.arg("wifi_password").length() > 0) {
-    wifiPassword = server.arg("wifi_password");
-    preferences.putString(KEY_WIFI_PASS, wifiPassword);
-    LOG_INFO("WiFi password updated");
-    configChanged = true;
+}
+
+void collectRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+  bufferRequestBody(request, data, len, index, total, API_MAX_BODY_SIZE);
+}
+
+void collectConfigBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+  bufferRequestBody(request, data, len, index, total, CONFIG_MAX_BODY_SIZE);
+}
+
+void bufferRequestBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total, size_t limit) {
+  // Bodies arrive in TCP-sized pieces; keep small ones until the handler runs.
+  // The request frees _tempObject when it is destroyed.
+  if (total > limit) {
+    return;
   }
-  
-  // Save OAuth configuration
-  if (server.hasArg("user_email")) {
-    String newEmail = server.arg("user_email");
-    if (newEmail != userEmail) {
-      LOG_INFOF("User email changed from '%s' to '%s'", userEmail.c_str(), newEmail.c_str());
-      userEmail = newEmail;
-      preferences.putString(KEY_USER_EMAIL, userEmail);
-      configChanged = true;
+  if (index == 0) {
+    request->_tempObject = malloc(total + 1);
+  }
+  char* body = (char*)request->_tempObject;
+  if (body != nullptr) {
+    memcpy(body + index, data, len);
+    if (index + len == total) {
+      body[total] = '\0';
     }
   }
+}
+
+void scheduleRestart() {
+  // Give the response time to reach the browser before restarting from loop()
+  restartAt = millis() + 1000;
+  restartScheduled = true;
+}
+
+// Pushes state, presence and LED changes to open dashboards as they happen,
+// and a ping when nothing changed for a while so browsers can tell a quiet
+// channel from a dead one
+void publishDashboardEvents() {
+  if (dashboardEvents.count() == 0) {
+    // Browsers fetch the full status when they connect, so start over then
+    dashboardDelta.reset();
+    return;
+  }
   
-  if (server.hasArg("tenant_id")) {
-    String newTenantId = server.arg("tenant_id");
-    if (newTenantId.length() == 0) newTenantId = "common";
-    if (newTenantId != tenantId) {
-      LOG_INFOF("Tenant ID changed from '%s' to '%s'", tenantId.c_str(), newTenantId.c_str());
-      tenantId = newTenantId;
-      preferences.putString(KEY_TENANT_ID, tenantId);
-      configChanged = true;
-    }
+  DashboardState state;
+  state.state = getStateName(currentState);
+  state.presence = getPresenceName(currentPresence);
+  state.ledCount = ledCount;
+  for (uint8_t i = 0; i < ledCount; i++) {
+    state.ledPresence[i] = getLEDPresence(i);
   }
   
-  if (server.hasArg("client_id")) {
-    String newClientId = server.arg("client_id");
-    if (newClientId != clientId) {
-      LOG_INFOF("Client ID changed: %s", newClientId.length() > 0 ? "set" : "cleared");
-      clientId = newClientId;
-      preferences.putString(KEY_CLIENT_ID, clientId);
-      configChanged = true;
-    }
+  StaticJsonDocument<256> delta;
+  char payload[192];
+  if (dashboardDelta.write(state, delta)) {
+    serializeJson(delta, payload, sizeof(payload));
+    dashboardEvents.send(payload, "status");
+    lastDashboardEvent = millis();
+  } else if (millis() - lastDashboardEvent >= DASHBOARD_HEARTBEAT_INTERVAL) {
+    snprintf(payload, sizeof(payload), "{\"uptime\":%lu}", millis() / 1000);
+    dashboardEvents.send(payload, "ping");
+    lastDashboardEvent = millis();
   }
+}
+
+void publishPresenceLog(const PresenceLogEntry& entry) {
+  if (dashboardEvents.count() == 0) {
+    return;
+  }
+  
+  // Same fields as a /presence-history entry
+  char timeStr[32];
+  struct tm* timeInfo = localtime(&entry.timestamp);
+  strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", timeInfo);
   
-  if (server.hasArg("client_secret") && server.arg("client_secret").length() > 0) {
-    clientSecret = server.arg("client_secret");
-    preferences.putString(KEY_CLIENT_SECRET, clientSecret);
-    LOG_INFO("Client secret updated");
-    configChanged = true;
+  StaticJsonDocument<128> doc;
+  doc["seq"] = presenceLogSeq;
+  doc["timestamp"] = timeStr;
+  doc["presence"] = entry.presenceString;
+  doc["presence_code"] = entry.presence;
+  char payload[128];
+  serializeJson(doc, payload, sizeof(payload));
+  dashboardEvents.send(payload, "presence");
+}
+
+// Everything /status and /api/snapshot are built from. Uptime and the clock
+// only count in whole ticks, so an idle device rebuilds once a minute.
+uint32_t statusFingerprint() {
+  Fingerprint fingerprint;
+  fingerprint.add(currentState).add(currentPresence).add(millis() / STATUS_SNAPSHOT_TICK);
+  fingerprint.add(WiFi.status() == WL_CONNECTED).add((uint32_t)WiFi.localIP());
+  fingerprint.add(accessToken.length() > 0).add(userCode).add(verificationUri);
+  fingerprint.add(presenceRelay.isEnabled()).add(presenceRelay.isConnected()).add(presenceRelay.eventsReceived());
+  fingerprint.add(boardMode).add(statusBoard.memberCount()).add(statusBoard.isEnabled());
+  fingerprint.add(localPush.isActive()).add(localPush.source()).add(localPush.remainingSeconds() * 1000 / STATUS_SNAPSHOT_TICK);
+  fingerprint.add(ledCount);
+  for (uint8_t i = 0; i < ledCount; i++) {
+    fingerprint.add(leds[i].pin).add(leds[i].enabled).add(leds[i].callPattern).add(leds[i].meetingPattern);
+    fingerprint.add(leds[i].availablePattern).add(leds[i].awayPattern).add(leds[i].offlinePattern);
+  }
+  fingerprint.add(timeConfigured).add(timezoneOffset).add(daylightOffset);
+  fingerprint.add(presenceLogCount).add(presenceLogIndex);
+  return fingerprint.value();
+}
+
+void refreshSnapshots() {
+  uint32_t fingerprint = statusFingerprint();
+  if (!statusSnapshot.stale(fingerprint)) {
+    return;
+  }
+  // Each rebuild holds the old and new bodies at once; while heap is short
+  // the cached ones are served for longer instead
+  if (heapGovernor.cachedOnly() && millis() - lastSnapshotBuild < HEAP_CACHED_REBUILD_INTERVAL) {
+    return;
   }
+  lastSnapshotBuild = millis();
   
-  if (server.hasArg("ota_url")) {
-    String otaUrl = server.arg("ota_url");
-    String currentOtaUrl = preferences.getString(OTA_UPDATE_URL_KEY, DEFAULT_OTA_URL);
-    if (otaUrl != currentOtaUrl) {
-      LOG_INFOF("OTA URL changed to: %s", otaUrl.c_str());
-      preferences.putString(OTA_UPDATE_URL_KEY, otaUrl);
-      configChanged = true;
-    }
+  String status;
+  JsonChunkWriter(produceStatus).writeTo(status);
+  String history;
+  CursorWindow historyWindow = CursorQuery().window(presenceLogSeq, presenceLogsHeld());
+  JsonChunkWriter([&historyWindow](JsonChunkWriter& out, size_t step) {
+    return producePresenceHistory(out, step, historyWindow);
+  }).writeTo(history);
+  
+  String packedStatus;
+  MsgPackChunkWriter(packStatus).writeTo(packedStatus);
+  
+  statusSnapshot.publish(fingerprint, status);
+  statusPackSnapshot.publish(fingerprint, packedStatus);
+  dashboardSnapshot.publish(fingerprint, "{\"status\":" + status + ",\"presence_history\":" + history + "}");
+  LOG_DEBUGF("Status snapshot v%u (%u bytes)", (unsigned)statusSnapshot.version(), status.length());
+}
+
+// The schedule cache is refreshed once it is older than its TTL. Attempts
+// are spaced out, so a failing Graph call is not retried on every loop.
+bool calendarRefreshDue() {
+  if (!timeConfigured || accessToken.length() == 0 || calendarSyncRequested) {
+    return false;
+  }
+  if (lastCalendarAttempt != 0 && millis() - lastCalendarAttempt < CALENDAR_SYNC_MIN_INTERVAL) {
+    return false;
+  }
+  return !calendarSync.hasSynced() || millis() - calendarSync.lastSyncMillis() >= CALENDAR_CACHE_TTL;
+}
+
+// Samples the heap and sheds work as it runs low (see HeapGovernor). The
+// presence poll and LED rendering in loop() are never gated on the level.
+void governHeap() {
+  if (lastHeapSample != 0 && millis() - lastHeapSample < HEAP_SAMPLE_INTERVAL) {
+    return;
   }
+  lastHeapSample = millis();
   
-  // Save LED pattern configuration
-  if (server.hasArg("led_count")) {
-    uint8_t newLedCount = server.arg("led_count").toInt();
-    if (newLedCount > MAX_LEDS) newLedCount = MAX_LEDS;
-    if (newLedCount < 1) newLedCount = 1;
-    
-    if (newLedCount != ledCount) {
-      LOG_INFOF("LED count changed from %d to %d", ledCount, newLedCount);
-      ledCount = newLedCount;
-      configChanged = true;
+  HeapPressure previous = heapGovernor.level();
+  if (heapGovernor.sample(ESP.getFreeHeap(), ESP.getMaxAllocHeap())) {
+    HeapPressure level = heapGovernor.level();
+    if (level > previous) {
+      LOG_WARNF("Heap low (%u bytes free, largest block %u), shedding load: %s",
+                ESP.getFreeHeap(), ESP.getMaxAllocHeap(), HeapGovernor::levelName(level));
+    } else {
+      LOG_INFOF("Heap recovered (%u bytes free), load shedding eased to %s",
+                ESP.getFreeHeap(), HeapGovernor::levelName(level));
     }
-    
-    // Save individual LED configurations
-    for (uint8_t i = 0; i < ledCount; i++) {
-      String pinArg = "led_pin_" + String(i);
-      String callArg = "led_call_" + String(i);
-      String meetArg = "led_meeting_" + String(i);
-      String availArg = "led_available_" + String(i);
-      
-      if (server.hasArg(pinArg)) {
-        uint8_t newPin = server.arg(pinArg).toInt();
-        if (i >= MAX_LEDS) continue; // Safety check
-        
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].pin != newPin)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d pin changed from %d to %d", i, leds[i].pin, newPin);
-          }
-          leds[i].pin = newPin;
-          leds[i].enabled = true;
-          configChanged = true;
-        }
-      }
-      
-      if (server.hasArg(callArg)) {
-        LEDPattern newPattern = (LEDPattern)server.arg(callArg).toInt();
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].callPattern != newPattern)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d call pattern changed from %d to %d", i, leds[i].callPattern, newPattern);
-          }
-          leds[i].callPattern = newPattern;
-          configChanged = true;
-        }
-      }
-      
-      if (server.hasArg(meetArg)) {
-        LEDPattern newPattern = (LEDPattern)server.arg(meetArg).toInt();
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].meetingPattern != newPattern)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d meeting pattern changed from %d to %d", i, leds[i].meetingPattern, newPattern);
-          }
-          leds[i].meetingPattern = newPattern;
-          configChanged = true;
-        }
-      }
-      
-      if (server.hasArg(availArg)) {
-        LEDPattern newPattern = (LEDPattern)server.arg(availArg).toInt();
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].availablePattern != newPattern)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d available pattern changed from %d to %d", i, leds[i].availablePattern, newPattern);
-          }
-          leds[i].availablePattern = newPattern;
-          configChanged = true;
-        }
-      }
-      
-      String awayArg = "led_away_" + String(i);
-      if (server.hasArg(awayArg)) {
-        LEDPattern newPattern = (LEDPattern)server.arg(awayArg).toInt();
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].awayPattern != newPattern)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d away pattern changed from %d to %d", i, leds[i].awayPattern, newPattern);
-          }
-          leds[i].awayPattern = newPattern;
-          configChanged = true;
-        }
-      }
-      
-      String offlineArg = "led_offline_" + String(i);
-      if (server.hasArg(offlineArg)) {
-        LEDPattern newPattern = (LEDPattern)server.arg(offlineArg).toInt();
-        if (i < MAX_LEDS && (i >= ledCount || leds[i].offlinePattern != newPattern)) {
-          if (i < ledCount) {
-            LOG_INFOF("LED %d offline pattern changed from %d to %d", i, leds[i].offlinePattern, newPattern);
-          }
-          leds[i].offlinePattern = newPattern;
-          configChanged = true;
-        }
-      }
-      
-      // Initialize LED state variables
-      if (i < MAX_LEDS) {
-        // Set default patterns for new LEDs if not already set
-        if (i >= ledCount) {
-          leds[i].callPattern = DEFAULT_CALL_PATTERN;
-          leds[i].meetingPattern = DEFAULT_MEETING_PATTERN;
-          leds[i].availablePattern = DEFAULT_AVAILABLE_PATTERN;
-          leds[i].awayPattern = DEFAULT_AWAY_PATTERN;
-          leds[i].offlinePattern = DEFAULT_OFFLINE_PATTERN;
-        }
-        leds[i].lastToggle = 0;
-        leds[i].state = false;
-        leds[i].doubleBlinksStartTime = 0;
-        leds[i].doubleBlinksState = false;
-        leds[i].doubleBlinksCount = 0;
+    Logger::setLogCapacity(heapGovernor.shrinkBuffers() ? LOG_BUFFER_SHRUNK_SIZE : LOG_BUFFER_SIZE);
+    keepAliveServer.setAccepting(!heapGovernor.refuseRequests());
+    presenceClient.setKeepAlive(!heapGovernor.deferFetches());
+  }
+  Metrics::observeHeap(heapGovernor.level(), heapGovernor.lowestLargestBlock());
+}
+
+void runDeferredWork() {
+  if (restartScheduled && (long)(millis() - restartAt) >= 0) {
+    LOG_WARN("Restarting device");
+    ESP.restart();
+  }
+  
+  if (deviceCodeRequested) {
+    HeapTraceScope trace(TRACE_GRAPH_TOKEN);
+    deviceCodeStartFailed = !startDeviceCodeFlow();
+    deviceCodeRequested = false;
+  }
+  
+  // A sync needs a TLS session of its own; while heap is short it stays
+  // pending and the presence poll keeps the session budget
+  if (calendarSyncRequested && !heapGovernor.deferFetches()) {
+    // After the first sync this is a single small delta request that only
+    // carries changed events
+    if (accessToken.length() > 0 && WiFi.status() == WL_CONNECTED) {
+      lastCalendarAttempt = millis();
+      HeapTraceScope trace(TRACE_GRAPH_CALENDAR);
+      calendarSyncResult = calendarSync.sync(accessToken);
+      if (calendarSyncResult == HTTP_CODE_OK) {
+        LOG_INFO("Successfully synchronized calendar data");
+      } else {
+        LOG_ERRORF("Calendar sync failed with HTTP %d", calendarSyncResult);
       }
     }
-    
-    // Update legacy patterns for backward compatibility (use first LED)
-    if (ledCount > 0) {
-      callPattern = leds[0].callPattern;
-      meetingPattern = leds[0].meetingPattern;
-      availablePattern = leds[0].availablePattern;
+    calendarSyncRequested = false;
+  }
+  
+  portENTER_CRITICAL(&configLock);
+  std::shared_ptr<const PendingConfig> update = pendingConfig;
+  portEXIT_CRITICAL(&configLock);
+  if (update) {
+    // An import is journaled first, so a reset while its keys are being
+    // written is finished at the next boot instead of leaving half of it
+    bool journaled = update->journal.length() > 0;
+    if (journaled) {
+      preferences.putString(KEY_CONFIG_JOURNAL, update->journal);
     }
-  } else {
-    // Legacy LED pattern handling for backward compatibility
-    if (server.hasArg("meeting_pattern")) {
-      LEDPattern newMeetingPattern = (LEDPattern)server.arg("meeting_pattern").toInt();
-      if (newMeetingPattern != meetingPattern) {
-        LOG_INFOF("Meeting LED pattern changed from %d to %d", meetingPattern, newMeetingPattern);
-        meetingPattern = newMeetingPattern;
-        preferences.putUInt(KEY_MEETING_PATTERN, meetingPattern);
-        configChanged = true;
-      }
+    applyConfig(update->config, update->changes);
+    if (journaled) {
+      preferences.remove(KEY_CONFIG_JOURNAL);
     }
     
-    if (server.hasArg("no_meeting_pattern")) {
-      LEDPattern newNoMeetingPattern = (LEDPattern)server.arg("no_meeting_pattern").toInt();
-      if (newNoMeetingPattern != availablePattern) {
-        LOG_INFOF("No meeting LED pattern changed from %d to %d", availablePattern, newNoMeetingPattern);
-        availablePattern = newNoMeetingPattern;
-        preferences.putUInt(KEY_NO_MEETING_PATTERN, availablePattern);
-        configChanged = true;
-      }
+    // The next update is validated against these settings, so they are
+    // published before it is let in. The update is freed outside the lock.
+    publishConfigSnapshot();
+    std::shared_ptr<const PendingConfig> applied;
+    portENTER_CRITICAL(&configLock);
+    pendingConfig.swap(applied);
+    portEXIT_CRITICAL(&configLock);
+  }
+  
+  applyPendingPush();
+}
+
+// Takes over what the push handlers and the configuration form left for
+// loop(): presence, the presence log and preferences are only written here
+void applyPendingPush() {
+  PendingPush push;
+  char newKey[sizeof(pendingPushApiKey)];
+  portENTER_CRITICAL(&pendingPushLock);
+  push = pendingPush;
+  pendingPush.action = PUSH_NONE;
+  memcpy(newKey, pendingPushApiKey, sizeof(newKey));
+  pendingPushApiKey[0] = '\0';
+  portEXIT_CRITICAL(&pendingPushLock);
+  
+  if (newKey[0] != '\0') {
+    pushApiKey = newKey;
+    preferences.putString(KEY_PUSH_API_KEY, pushApiKey);
+    localPush.begin(pushApiKey, pushTtl);
+    publishConfigSnapshot();
+    LOG_INFO("Local presence push API key regenerated");
+  }
+  
+  if (push.action == PUSH_APPLY) {
+    localPush.apply(push.presence, push.ttl, push.source);
+    LOG_INFOF("Local presence push from %s: %s for %lu seconds", localPush.source(), getPresenceName(push.presence), localPush.remainingSeconds());
+    updatePresence(push.presence);
+  } else if (push.action == PUSH_CLEAR && localPush.isActive()) {
+    LOG_INFOF("Local presence push from %s cleared, returning to %s", localPush.source(), getPresenceName(upstreamPresence));
+    localPush.clear();
+    updatePresence(upstreamPresence);
+  }
+}
+
+void serveUiAsset(AsyncWebServerRequest* request, const UiAsset* asset) {
+  // Assets change only with the firmware, so the content hash is a strong ETag
+  const AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+  if (ifNoneMatch != nullptr && ifNoneMatch->value() == asset->etag) {
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", asset->cacheControl);
+    request->send(response);
+    return;
+  }
+  
+  // Streamed straight from flash, already gzipped at build time
+  AsyncWebServerResponse* response = request->beginResponse(200, asset->contentType, asset->data, asset->length);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", asset->etag);
+  response->addHeader("Cache-Control", asset->cacheControl);
+  request->send(response);
+}
+
+// ?since=<seq>&limit=<n>&wait=<seconds> of /logs and /presence-history
+CursorQuery parseCursorQuery(AsyncWebServerRequest* request) {
+  CursorQuery query;
+  if (request->hasArg("since")) {
+    query.hasSince = true;
+    query.since = strtoul(request->arg("since").c_str(), nullptr, 10);
+  }
+  if (request->hasArg("limit")) {
+    query.limit = constrain(request->arg("limit").toInt(), 0, CURSOR_MAX_LIMIT);
+  }
+  if (request->hasArg("wait")) {
+    query.waitMillis = constrain(request->arg("wait").toInt() * 1000L, 0L, (long)CURSOR_MAX_WAIT);
+  }
+  return query;
+}
+
+// Cursor fields that end every /logs and /presence-history response.
+// MessagePack declares its member count before the entries are read, so it
+// passes alwaysMissed and always carries the field.
+void fillCursorFooter(JsonDocument& doc, const CursorWindow& window, bool alwaysMissed) {
+  doc["last_seq"] = window.cursor;
+  doc["more"] = window.more;
+  if (window.missed || alwaysMissed) {
+    doc["missed"] = window.missed;
+  }
+}
+
+// Binary variant on ?format=msgpack, or an Accept header naming MessagePack
+// (application/msgpack, application/x-msgpack, application/vnd.msgpack)
+bool wantsMsgPack(AsyncWebServerRequest* request) {
+  if (request->hasArg("format")) {
+    return request->arg("format") == "msgpack";
+  }
+  const AsyncWebHeader* accept = request->getHeader("Accept");
+  return accept != nullptr && accept->value().indexOf("msgpack") >= 0;
+}
+
+bool wantsMsgPack(const KeepAliveRequest& request) {
+  char format[16];
+  if (request.queryArg("format", format, sizeof(format))) {
+    return strcmp(format, "msgpack") == 0;
+  }
+  return strstr(request.accept, "msgpack") != nullptr;
+}
+
+// Whether a response may be gzipped on the fly: the client accepts it, one
+// of the few compression slots is free (each holds a few KB) and heap is not
+// short
+bool acceptsGzip(AsyncWebServerRequest* request) {
+  if (heapGovernor.cachedOnly()) {
+    return false;
+  }
+  const AsyncWebHeader* encoding = request->getHeader("Accept-Encoding");
+  return encoding != nullptr && encoding->value().indexOf("gzip") >= 0 && GzipStream::available();
+}
+
+// Chunked filler over a gzip stream; the ratio and compression time go to
+// /metrics once the stream is complete
+size_t fillCompressed(GzipStream& stream, uint8_t* buffer, size_t maxLen) {
+  bool wasFinished = stream.finished();
+  size_t written = stream.fill(buffer, maxLen);
+  if (!wasFinished && stream.finished()) {
+    Metrics::observeGzip(stream.inputBytes(), stream.outputBytes(), stream.cpuMicros());
+  }
+  return written;
+}
+
+// Answers an incremental read. With a wait, a client that is caught up gets
+// no body until a newer entry exists or the wait runs out: the filler answers
+// RESPONSE_TRY_AGAIN and the AsyncTCP task asks again on its next poll, so
+// nothing blocks while the request is held. Logs and history are repetitive
+// JSON, so they are gzipped when the client accepts it.
+template <typename Writer>
+void sendCursorRead(AsyncWebServerRequest* request, const CursorQuery& query, uint32_t (*lastSeq)(), int (*entryCount)(),
+                    bool (*producer)(Writer& out, size_t step, CursorWindow& window), const char* contentType) {
+  unsigned long deadline = millis() + query.waitMillis;
+  std::shared_ptr<CursorWindow> window = std::make_shared<CursorWindow>();
+  std::shared_ptr<Writer> writer = std::make_shared<Writer>([=](Writer& out, size_t step) {
+    if (step == 0) {
+      *window = query.window(lastSeq(), entryCount());
     }
+    return producer(out, step, *window);
+  });
+  
+  std::shared_ptr<GzipStream> compressor;
+  if (acceptsGzip(request)) {
+    compressor = std::make_shared<GzipStream>([writer](uint8_t* buffer, size_t maxLen) -> size_t {
+      return writer->fill(buffer, maxLen);
+    });
   }
   
-  if (configChanged) {
-    LOG_INFO("Configuration changes saved to flash memory");
-  } else {
-    LOG_INFO("No configuration changes detected");
+  AsyncWebServerResponse* response = request->beginChunkedResponse(contentType, [=](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    if (index == 0 && !query.satisfiedBy(lastSeq()) && (long)(millis() - deadline) < 0) {
+      return RESPONSE_TRY_AGAIN;
+    }
+    return compressor ? fillCompressed(*compressor, buffer, maxLen) : writer->fill(buffer, maxLen);
+  });
+  if (compressor) {
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("Vary", "Accept, Accept-Encoding");
+  request->send(response);
+}
+
+void sendSnapshot(AsyncWebServerRequest* request, const StatusSnapshot& snapshot, const char* contentType) {
+  std::shared_ptr<const SnapshotEntry> entry = snapshot.current();
+  if (!entry) {
+    request->send(503, "application/json", "{\"error\":\"Status not ready\"}");
+    return;
+  }
+  
+  const AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+  if (ifNoneMatch != nullptr && StatusSnapshot::etagMatches(ifNoneMatch->value(), entry->etag)) {
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", entry->etag);
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("Vary", "Accept");
+    request->send(response);
+    return;
+  }
+  
+  // The callback keeps this entry alive until it has been sent, even if
+  // loop() publishes a newer one in the meantime
+  AsyncWebServerResponse* response = request->beginResponse(contentType, entry->body.length(),
+    [entry](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      size_t count = min(maxLen, entry->body.length() - index);
+      memcpy(buffer, entry->body.c_str() + index, count);
+      return count;
+    });
+  response->addHeader("ETag", entry->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->addHeader("Vary", "Accept");
+  request->send(response);
+}
+
+void sendSnapshot(const KeepAliveRequest& request, KeepAliveResponse& response, const StatusSnapshot& snapshot, const char* contentType) {
+  std::shared_ptr<const SnapshotEntry> entry = snapshot.current();
+  if (!entry) {
+    response.send(503, "application/json", "{\"error\":\"Status not ready\"}");
+    return;
+  }
+  
+  response.addHeader("ETag", entry->etag);
+  response.addHeader("Cache-Control", "no-cache");
+  response.addHeader("Vary", "Accept");
+  if (StatusSnapshot::etagMatches(request.ifNoneMatch, entry->etag)) {
+    response.status = 304;
+    return;
+  }
+  
+  response.contentType = contentType;
+  response.contentLength = entry->body.length();
+  size_t index = 0;
+  response.body = [entry, index](uint8_t* buffer, size_t maxLen) mutable -> size_t {
+    size_t count = min(maxLen, entry->body.length() - index);
+    memcpy(buffer, entry->body.c_str() + index, count);
+    index += count;
+    return count;
+  };
+}
+
+void handleConfigJson(AsyncWebServerRequest* request) {
+  // Current settings for the static configuration page (secrets are never returned)
+  std::shared_ptr<const ConfigSnapshot> snapshot = currentConfigSnapshot();
+  const DeviceConfig& config = snapshot->config;
+  DynamicJsonDocument doc(4096);
+  doc["wifi_ssid"] = config.wifiSSID;
+  doc["user_email"] = config.userEmail;
+  doc["tenant_id"] = config.tenantId;
+  doc["client_id"] = config.clientId;
+  doc["has_client_secret"] = config.clientSecret.length() > 0;
+  doc["relay_url"] = config.relayUrl;
+  doc["has_relay_key"] = config.relayKey.length() > 0;
+  doc["board_mode"] = config.boardMode;
+  doc["board_roster"] = config.boardRoster;
+  doc["board_max_members"] = BOARD_MAX_MEMBERS;
+  doc["has_push_api_key"] = snapshot->hasPushApiKey;
+  doc["push_ttl"] = config.pushTtl;
+  doc["push_max_ttl"] = LOCAL_PUSH_MAX_TTL;
+  doc["ota_url"] = config.otaUrl;
+  doc["timezone_offset"] = config.timezoneOffset;
+  doc["daylight_offset"] = config.daylightOffset;
+  
+  doc["led_count"] = config.ledCount;
+  doc["max_leds"] = MAX_LEDS;
+  doc["default_pin"] = LED_PIN;
+  JsonArray pins = doc.createNestedArray("gpio_pins");
+  for (uint8_t i = 0; i < availableGPIOCount; i++) {
+    pins.add(availableGPIOPins[i]);
+  }
+  JsonArray ledArray = doc.createNestedArray("leds");
+  for (uint8_t i = 0; i < config.ledCount; i++) {
+    JsonObject led = ledArray.createNestedObject();
+    led["pin"] = config.leds[i].pin;
+    led["call"] = (int)config.leds[i].call;
+    led["meeting"] = (int)config.leds[i].meeting;
+    led["available"] = (int)config.leds[i].available;
+    led["away"] = (int)config.leds[i].away;
+    led["offline"] = (int)config.leds[i].offline;
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+// Validation errors can echo submitted values, so they are escaped before
+// going into a page
+String htmlEscape(const String& text) {
+  String escaped;
+  escaped.reserve(text.length());
+  for (size_t i = 0; i < text.length(); i++) {
+    char c = text[i];
+    switch (c) {
+      case '&': escaped += "&amp;"; break;
+      case '<': escaped += "&lt;"; break;
+      case '>': escaped += "&gt;"; break;
+      case '"': escaped += "&quot;"; break;
+      case '\'': escaped += "&#39;"; break;
+      default: escaped += c; break;
+    }
+  }
+  return escaped;
+}
+
+void handleSave(AsyncWebServerRequest* request) {
+  LOG_INFO("Processing configuration save request");
+  
+  // The form goes through the same validation and selective apply as
+  // POST /api/config
+  DynamicJsonDocument doc(CONFIG_MAX_BODY_SIZE * 2);
+  configFormToJson(request, doc);
+  uint32_t changes = 0;
+  String error;
+  int status = stageConfigUpdate(doc.as<JsonObjectConst>(), changes, error);
+  if (status != 200) {
+    request->send(status, "text/html", String(R"(
+<!DOCTYPE html>
+<html>
+<head>
+    <title>Configuration Not Saved</title>
+    <style>
+        body { font-family: Arial, sans-serif; text-align: center; margin-top: 50px; }
+        .message { background-color: #f8d7da; color: #721c24; padding: 20px; border-radius: 5px; display: inline-block; }
+    </style>
+</head>
+<body>
+    <div class="message">
+        <h2>❌ Configuration Not Saved</h2>
+        <p>)") + htmlEscape(error) + R"(</p>
+        <p><a href="/config">Back to configuration</a></p>
+    </div>
+</body>
+</html>
+    )");
+    return;
   }
   
-  server.send(200, "text/html", R"(
+  // The key is never served again, so this page is the only place it shows
+  String newKey;
+  if (request->hasArg("regen_push_key")) {
+    // loop() saves it and hands it to localPush
+    newKey = LocalPresencePush::generateKey();
+    portENTER_CRITICAL(&pendingPushLock);
+    strlcpy(pendingPushApiKey, newKey.c_str(), sizeof(pendingPushApiKey));
+    portEXIT_CRITICAL(&pendingPushLock);
+  } else if (changes == 0) {
+    LOG_INFO("No configuration changes detected");
+  }
+  const char* detail = (changes & CONFIG_WIFI) ? "The device is connecting to the new network..." : "Changes take effect without a restart.";
+  if (newKey.length() > 0) {
+    request->send(200, "text/html", String(R"(
+<!DOCTYPE html>
+<html>
+<head>
+    <title>Configuration Saved</title>
+    <style>
+        body { font-family: Arial, sans-serif; text-align: center; margin-top: 50px; }
+        .message { background-color: #d4edda; color: #155724; padding: 20px; border-radius: 5px; display: inline-block; }
+        code { background-color: #fff; padding: 4px 8px; border-radius: 3px; font-size: 1.2em; }
+    </style>
+</head>
+<body>
+    <div class="message">
+        <h2>✅ Configuration Saved!</h2>
+        <p>)") + detail + R"(</p>
+        <p>New agent API key:</p>
+        <p><code>)" + newKey + R"(</code></p>
+        <p>Copy it now; it is not shown again.</p>
+        <p><a href="/">Back to the home page</a></p>
+    </div>
+</body>
+</html>
+    )");
+    return;
+  }
+  request->send(200, "text/html", String(R"(
 <!DOCTYPE html>
 <html>
 <head>
@@ -1350,17 +1745,416 @@ void handleSave() {
 <body>
     <div class="message">
         <h2>✅ Configuration Saved!</h2>
-        <p>The device will restart and connect to the new network...</p>
+        <p>)") + detail + R"(</p>
         <p>You will be redirected to the home page in 3 seconds.</p>
     </div>
 </body>
 </html>
   )");
+}
+
+// Translates the configuration form into the JSON shape of /api/config
+void configFormToJson(AsyncWebServerRequest* request, JsonDocument& doc) {
+  static const char* const textFields[] = {
+    "wifi_ssid", "wifi_password", "user_email", "tenant_id", "client_id", "client_secret", "relay_url", "relay_key", "ota_url"
+  };
+  for (const char* field : textFields) {
+    if (request->hasArg(field)) {
+      doc[field] = request->arg(field);
+    }
+  }
   
-  // Restart the device after a short delay
-  LOG_WARN("Restarting device to apply new configuration...");
-  delay(1000);
-  ESP.restart();
+  if (request->hasArg("board_roster")) {
+    // Unchecked checkboxes are not submitted, so the roster field marks the section as present
+    doc["board_roster"] = request->arg("board_roster");
+    doc["board_mode"] = request->hasArg("board_mode");
+  }
+  
+  if (request->hasArg("push_ttl")) {
+    doc["push_ttl"] = constrain(request->arg("push_ttl").toInt(), 10, LOCAL_PUSH_MAX_TTL);
+  }
+  
+  static const char* const patternFields[] = {"call", "meeting", "available", "away", "offline"};
+  if (request->hasArg("led_count")) {
+    uint8_t count = constrain(request->arg("led_count").toInt(), 1, MAX_LEDS);
+    doc["led_count"] = count;
+    JsonArray ledArray = doc.createNestedArray("leds");
+    for (uint8_t i = 0; i < count; i++) {
+      JsonObject led = ledArray.createNestedObject();
+      char argName[24];
+      snprintf(argName, sizeof(argName), "led_pin_%u", (unsigned)i);
+      if (request->hasArg(argName)) {
+        led["pin"] = request->arg(argName).toInt();
+      }
+      for (const char* field : patternFields) {
+        snprintf(argName, sizeof(argName), "led_%s_%u", field, (unsigned)i);
+        if (request->hasArg(argName)) {
+          led[field] = request->arg(argName).toInt();
+        }
+      }
+    }
+  } else if (request->hasArg("meeting_pattern") || request->hasArg("no_meeting_pattern")) {
+    // Legacy single-LED form
+    JsonObject led = doc.createNestedArray("leds").createNestedObject();
+    if (request->hasArg("meeting_pattern")) {
+      led["meeting"] = request->arg("meeting_pattern").toInt();
+    }
+    if (request->hasArg("no_meeting_pattern")) {
+      led["available"] = request->arg("no_meeting_pattern").toInt();
+    }
+  }
+}
+
+// The settings in effect, in the shape POST /api/config updates. Reads the
+// live globals and NVS, so only loop() and setup() call it; handlers use
+// currentConfigSnapshot().
+DeviceConfig currentConfig() {
+  DeviceConfig config;
+  config.wifiSSID = wifiSSID;
+  config.wifiPassword = wifiPassword;
+  config.userEmail = userEmail;
+  config.tenantId = tenantId;
+  config.clientId = clientId;
+  config.clientSecret = clientSecret;
+  config.relayUrl = relayUrl;
+  config.relayKey = relayKey;
+  config.boardMode = boardMode;
+  config.boardRoster = boardRoster;
+  config.pushTtl = pushTtl;
+  config.otaUrl = preferences.getString(OTA_UPDATE_URL_KEY, DEFAULT_OTA_URL);
+  config.timezoneOffset = timezoneOffset;
+  config.daylightOffset = daylightOffset;
+  config.ledCount = ledCount;
+  for (uint8_t i = 0; i < ledCount; i++) {
+    config.leds[i] = {leds[i].pin, leds[i].callPattern, leds[i].meetingPattern,
+                      leds[i].availablePattern, leds[i].awayPattern, leds[i].offlinePattern};
+  }
+  return config;
+}
+
+void publishConfigSnapshot() {
+  std::shared_ptr<ConfigSnapshot> next = std::make_shared<ConfigSnapshot>();
+  next->config = currentConfig();
+  next->hasPushApiKey = pushApiKey.length() > 0;
+  next->signedIn = accessToken.length() > 0;
+  next->userCode = userCode;
+  next->verificationUri = verificationUri;
+  
+  portENTER_CRITICAL(&configLock);
+  configSnapshot.swap(next);
+  portEXIT_CRITICAL(&configLock);
+}
+
+std::shared_ptr<const ConfigSnapshot> currentConfigSnapshot() {
+  portENTER_CRITICAL(&configLock);
+  std::shared_ptr<const ConfigSnapshot> result = configSnapshot;
+  portEXIT_CRITICAL(&configLock);
+  return result;
+}
+
+// Validates body against the published settings and hands what changed to
+// loop(), which drives the LEDs and WiFi. Returns the HTTP status; error
+// explains anything but 200.
+int stageConfigUpdate(JsonObjectConst body, uint32_t& changes, String& error, const String& journal) {
+  // An update not yet taken over by loop() would otherwise be lost, and the
+  // snapshot would not show it yet
+  portENTER_CRITICAL(&configLock);
+  bool busy = pendingConfig != nullptr;
+  portEXIT_CRITICAL(&configLock);
+  if (busy) {
+    error = "previous update still being applied";
+    return 503;
+  }
+  
+  std::shared_ptr<const ConfigSnapshot> snapshot = currentConfigSnapshot();
+  const DeviceConfig& current = snapshot->config;
+  std::shared_ptr<PendingConfig> update = std::make_shared<PendingConfig>();
+  update->config = current;
+  if (!update->config.update(body, availableGPIOPins, availableGPIOCount, error)) {
+    LOG_WARNF("Rejected configuration update: %s", error.c_str());
+    return 400;
+  }
+  
+  changes = DeviceConfig::diff(current, update->config);
+  if (changes != 0) {
+    update->changes = changes;
+    update->journal = journal;
+    portENTER_CRITICAL(&configLock);
+    pendingConfig = update;
+    portEXIT_CRITICAL(&configLock);
+  }
+  return 200;
+}
+
+void handleConfigUpdate(AsyncWebServerRequest* request) {
+  const char* body = (const char*)request->_tempObject;
+  if (body == nullptr) {
+    request->send(400, "application/json", "{\"error\":\"missing or oversized body\"}");
+    return;
+  }
+  
+  DynamicJsonDocument doc(CONFIG_MAX_BODY_SIZE * 2);
+  if (deserializeJson(doc, body) || !doc.is<JsonObject>()) {
+    request->send(400, "application/json", "{\"error\":\"invalid JSON\"}");
+    return;
+  }
+  
+  uint32_t changes = 0;
+  String error;
+  int status = stageConfigUpdate(doc.as<JsonObjectConst>(), changes, error);
+  
+  DynamicJsonDocument response(256);
+  if (status == 200) {
+    DeviceConfig::describe(changes, response.createNestedArray("changed"));
+    response["reconnect"] = (changes & CONFIG_WIFI) != 0;
+  } else {
+    response["error"] = error;
+  }
+  String responseBody;
+  serializeJson(response, responseBody);
+  AsyncWebServerResponse* reply = request->beginResponse(status, "application/json", responseBody);
+  if (status == 503) {
+    reply->addHeader("Retry-After", "1");
+  }
+  request->send(reply);
+}
+
+void handleConfigExport(AsyncWebServerRequest* request) {
+  DynamicJsonDocument doc(1024 + MAX_LEDS * 96);
+  currentConfigSnapshot()->config.exportDocument(doc.to<JsonObject>());
+  String body;
+  serializeJson(doc, body);
+  request->send(200, "application/json", body);
+}
+
+// A fleet document from /api/config/export (or provision_fleet.py), applied
+// like a POST to /api/config once its version and checksum check out
+void handleConfigImport(AsyncWebServerRequest* request) {
+  const char* body = (const char*)request->_tempObject;
+  if (body == nullptr) {
+    request->send(400, "application/json", "{\"error\":\"missing or oversized body\"}");
+    return;
+  }
+  
+  DynamicJsonDocument doc(CONFIG_MAX_BODY_SIZE * 2);
+  if (deserializeJson(doc, body) || !doc.is<JsonObject>()) {
+    request->send(400, "application/json", "{\"error\":\"invalid JSON\"}");
+    return;
+  }
+  
+  uint32_t changes = 0;
+  String error;
+  JsonObjectConst config;
+  int status = 400;
+  if (DeviceConfig::readDocument(doc.as<JsonObjectConst>(), config, error)) {
+    String journal;
+    serializeJson(config, journal);
+    status = stageConfigUpdate(config, changes, error, journal);
+  } else {
+    LOG_WARNF("Rejected configuration import: %s", error.c_str());
+  }
+  
+  DynamicJsonDocument response(256);
+  if (status == 200) {
+    response["version"] = CONFIG_DOCUMENT_VERSION;
+    DeviceConfig::describe(changes, response.createNestedArray("changed"));
+    response["reconnect"] = (changes & CONFIG_WIFI) != 0;
+  } else {
+    response["error"] = error;
+  }
+  String responseBody;
+  serializeJson(response, responseBody);
+  AsyncWebServerResponse* reply = request->beginResponse(status, "application/json", responseBody);
+  if (status == 503) {
+    reply->addHeader("Retry-After", "1");
+  }
+  request->send(reply);
+}
+
+// Finishes an import that was interrupted while its keys were being
+// written: the journal holds all of its settings, and the keys that still
+// differ are written again before the configuration is loaded once more
+void finishConfigJournal() {
+  String journal = preferences.getString(KEY_CONFIG_JOURNAL, "");
+  if (journal.length() == 0) {
+    return;
+  }
+  
+  DynamicJsonDocument doc(CONFIG_MAX_BODY_SIZE * 2);
+  DeviceConfig current = currentConfig();
+  DeviceConfig config = current;
+  String error;
+  if (deserializeJson(doc, journal) || !config.update(doc.as<JsonObjectConst>(), availableGPIOPins, availableGPIOCount, error)) {
+    LOG_ERRORF("Discarding unreadable configuration journal: %s", error.c_str());
+  } else {
+    LOG_WARN("Finishing a configuration import interrupted by a reset");
+    saveConfigChanges(config, DeviceConfig::diff(current, config));
+    loadConfiguration();
+  }
+  preferences.remove(KEY_CONFIG_JOURNAL);
+}
+
+// Takes over a validated configuration: persists what changed and restarts
+// only the subsystems behind it. Tokens, the relay stream and the presence
+// poll schedule are left alone unless their own settings changed.
+void applyConfig(const DeviceConfig& config, uint32_t changes) {
+  saveConfigChanges(config, changes);
+  
+  bool emailChanged = config.userEmail != userEmail;
+  if (emailChanged) {
+    calendarSync.reset(); // Cached events belong to the previous mailbox
+  }
+  wifiSSID = config.wifiSSID;
+  wifiPassword = config.wifiPassword;
+  userEmail = config.userEmail;
+  tenantId = config.tenantId;
+  clientId = config.clientId;
+  clientSecret = config.clientSecret;
+  relayUrl = config.relayUrl;
+  relayKey = config.relayKey;
+  boardMode = config.boardMode;
+  boardRoster = config.boardRoster;
+  
+  if (changes & CONFIG_PUSH) {
+    pushTtl = config.pushTtl;
+    localPush.begin(pushApiKey, pushTtl);
+    LOG_INFOF("Local push TTL changed to: %lu seconds", pushTtl);
+  }
+  
+  if (changes & CONFIG_TIME) {
+    timezoneOffset = config.timezoneOffset;
+    daylightOffset = config.daylightOffset;
+    if (timeConfigured) {
+      configTime(timezoneOffset * 3600, daylightOffset * 3600, NTP_SERVER);
+      lastTimeUpdate = millis();
+    }
+    LOG_INFOF("Time zone changed to UTC%+d, daylight offset %d hours", timezoneOffset, daylightOffset);
+  }
+  
+  if (changes & (CONFIG_LED_PINS | CONFIG_LED_PATTERNS)) {
+    applyLedSettings(config, changes & CONFIG_LED_PINS);
+  }
+  
+  // The app token belongs to the client and tenant, so either change starts over
+  if (changes & (CONFIG_ACCOUNT | CONFIG_BOARD)) {
+    if (boardMode) {
+      statusBoard.begin(clientId, clientSecret, tenantId, boardRoster, mapTeamsPresence);
+    } else {
+      statusBoard.stop();
+    }
+  }
+  
+  // The relay stream subscribes for one mailbox and is unused on a status board
+  if ((changes & (CONFIG_RELAY | CONFIG_BOARD)) || emailChanged) {
+    presenceRelay.stop();
+    if (currentState == STATE_MONITORING && !boardMode && relayUrl.length() > 0) {
+      presenceRelay.begin(relayUrl, userEmail, relayKey, onRelayPresence);
+    }
+  }
+  
+  // Switching between board and personal mode changes what authenticated means
+  if ((changes & CONFIG_BOARD) && currentState != STATE_AP_MODE && currentState != STATE_CONNECTING_WIFI) {
+    if (boardMode) {
+      currentState = STATE_AUTHENTICATED;
+    } else if (currentState == STATE_MONITORING || currentState == STATE_AUTHENTICATED) {
+      currentState = accessToken.length() > 0 ? STATE_AUTHENTICATED : STATE_CONNECTING_OAUTH;
+    }
+    lastPresenceCheck = 0;
+  }
+  
+  // Last, since it holds loop() until the new network answers or the
+  // device falls back to its access point
+  if (changes & CONFIG_WIFI) {
+    LOG_INFO("WiFi settings changed, reconnecting");
+    WiFi.disconnect();
+    setupWiFiSTA();
+  }
+  
+  LOG_INFO("Configuration applied without restart");
+}
+
+void applyLedSettings(const DeviceConfig& config, bool pinsChanged) {
+  if (pinsChanged) {
+    // Release the old pins so an LED that moved does not stay lit
+    for (uint8_t i = 0; i < ledCount; i++) {
+      if (leds[i].enabled) {
+        digitalWrite(leds[i].pin, LOW);
+        pinMode(leds[i].pin, INPUT);
+      }
+    }
+  }
+  
+  ledCount = config.ledCount;
+  for (uint8_t i = 0; i < ledCount; i++) {
+    leds[i].pin = config.leds[i].pin;
+    leds[i].callPattern = config.leds[i].call;
+    leds[i].meetingPattern = config.leds[i].meeting;
+    leds[i].availablePattern = config.leds[i].available;
+    leds[i].awayPattern = config.leds[i].away;
+    leds[i].offlinePattern = config.leds[i].offline;
+    leds[i].enabled = true;
+    leds[i].lastToggle = 0;
+    leds[i].state = false;
+    leds[i].doubleBlinksStartTime = 0;
+    leds[i].doubleBlinksState = false;
+    leds[i].doubleBlinksCount = 0;
+  }
+  
+  // Update legacy patterns for backward compatibility (use first LED)
+  callPattern = leds[0].callPattern;
+  meetingPattern = leds[0].meetingPattern;
+  availablePattern = leds[0].availablePattern;
+  
+  if (pinsChanged) {
+    setupMultipleLEDs();
+  }
+  LOG_INFOF("LED configuration applied (%d LEDs)", ledCount);
+}
+
+// Writes only the preference keys behind the changed settings
+void saveConfigChanges(const DeviceConfig& config, uint32_t changes) {
+  HeapTraceScope trace(TRACE_SAVE_CONFIG);
+  if (changes & CONFIG_WIFI) {
+    preferences.putString(KEY_WIFI_SSID, config.wifiSSID);
+    preferences.putString(KEY_WIFI_PASS, config.wifiPassword);
+  }
+  if (changes & CONFIG_ACCOUNT) {
+    preferences.putString(KEY_USER_EMAIL, config.userEmail);
+    preferences.putString(KEY_TENANT_ID, config.tenantId);
+    preferences.putString(KEY_CLIENT_ID, config.clientId);
+    preferences.putString(KEY_CLIENT_SECRET, config.clientSecret);
+  }
+  if (changes & CONFIG_RELAY) {
+    preferences.putString(KEY_RELAY_URL, config.relayUrl);
+    preferences.putString(KEY_RELAY_KEY, config.relayKey);
+  }
+  if (changes & CONFIG_BOARD) {
+    preferences.putBool(KEY_BOARD_MODE, config.boardMode);
+    preferences.putString(KEY_BOARD_ROSTER, config.boardRoster);
+  }
+  if (changes & CONFIG_PUSH) {
+    preferences.putULong(KEY_PUSH_TTL, config.pushTtl);
+  }
+  if (changes & CONFIG_OTA) {
+    preferences.putString(OTA_UPDATE_URL_KEY, config.otaUrl);
+  }
+  if (changes & CONFIG_TIME) {
+    preferences.putInt(KEY_TIMEZONE_OFFSET, config.timezoneOffset);
+    preferences.putInt(KEY_DAYLIGHT_OFFSET, config.daylightOffset);
+  }
+  if (changes & (CONFIG_LED_PINS | CONFIG_LED_PATTERNS)) {
+    preferences.putUInt(KEY_LED_COUNT, config.ledCount);
+    for (uint8_t i = 0; i < config.ledCount; i++) {
+      const LedSettings& led = config.leds[i];
+      putLedSetting(LED_KEY_PIN, i, led.pin);
+      putLedSetting(LED_KEY_CALL, i, led.call);
+      putLedSetting(LED_KEY_MEETING, i, led.meeting);
+      putLedSetting(LED_KEY_AVAILABLE, i, led.available);
+      putLedSetting(LED_KEY_AWAY, i, led.away);
+      putLedSetting(LED_KEY_OFFLINE, i, led.offline);
+    }
+  }
+  LOG_INFO("Configuration changes saved to flash memory");
 }
 
 const char* getPatternName(LEDPattern pattern) {
@@ -1376,24 +2170,20 @@ const char* getPatternName(LEDPattern pattern) {
   }
 }
 
-void handleStatus() {
-  DynamicJsonDocument doc(1024);
+void fillStatusSummary(JsonDocument& doc) {
+  doc["state"] = getStateName(currentState);
   
   switch (currentState) {
     case STATE_AP_MODE:
-      doc["state"] = "ap_mode";
       doc["message"] = "Configuration mode - Please configure WiFi";
       break;
     case STATE_CONNECTING_WIFI:
-      doc["state"] = "connecting_wifi";
       doc["message"] = "Connecting to WiFi";
       break;
     case STATE_CONNECTING_OAUTH:
-      doc["state"] = "connecting_oauth";
       doc["message"] = "Waiting for OAuth authentication";
       break;
     case STATE_DEVICE_CODE_PENDING:
-      doc["state"] = "device_code_pending";
       doc["message"] = "Waiting for device code authentication";
       if (userCode.length() > 0) {
         doc["user_code"] = userCode;
@@ -1407,11 +2197,9 @@ void handleStatus() {
       }
       break;
     case STATE_AUTHENTICATED:
-      doc["state"] = "authenticated";
       doc["message"] = "Authenticated, starting monitoring";
       break;
     case STATE_MONITORING:
-      doc["state"] = "monitoring";
       doc["message"] = "Monitoring Teams presence";
       switch (currentPresence) {
         case PRESENCE_AVAILABLE:
@@ -1435,7 +2223,6 @@ void handleStatus() {
       }
       break;
     case STATE_ERROR:
-      doc["state"] = "error";
       doc["message"] = "Error occurred";
       break;
   }
@@ -1445,200 +2232,467 @@ void handleStatus() {
     doc["ip_address"] = WiFi.localIP().toString();
   }
   doc["has_token"] = accessToken.length() > 0;
+  if (presenceRelay.isEnabled()) {
+    doc["relay_connected"] = presenceRelay.isConnected();
+    doc["relay_events"] = presenceRelay.eventsReceived();
+  }
+  doc["board_mode"] = boardMode;
+  if (boardMode) {
+    doc["board_members"] = statusBoard.memberCount();
+    doc["board_enabled"] = statusBoard.isEnabled();
+  }
+  doc["local_push_active"] = localPush.isActive();
+  if (localPush.isActive()) {
+    doc["local_push_source"] = localPush.source();
+    doc["local_push_expires_in"] = localPush.remainingSeconds();
+  }
   doc["uptime"] = millis() / 1000;
+
+  doc["led_count"] = ledCount;
+}
+
+void fillLedStatus(JsonDocument& doc, uint8_t i) {
+  doc["id"] = i;
+  doc["pin"] = leds[i].pin;
+  doc["enabled"] = leds[i].enabled;
+  doc["current_state"] = leds[i].state;
+  
+  // Add pattern names for readability
+  doc["call_pattern"] = getPatternName(leds[i].callPattern);
+  doc["meeting_pattern"] = getPatternName(leds[i].meetingPattern);
+  doc["available_pattern"] = getPatternName(leds[i].availablePattern);
+  doc["away_pattern"] = getPatternName(leds[i].awayPattern);
+  doc["offline_pattern"] = getPatternName(leds[i].offlinePattern);
+}
+
+void fillStatusFooter(JsonDocument& doc) {
+  // Add time information
+  doc["time_configured"] = timeConfigured;
+  if (timeConfigured) {
+    doc["current_time"] = getCurrentTimeString();
+    doc["timezone_offset"] = timezoneOffset;
+    doc["daylight_offset"] = daylightOffset;
+  }
+  
+  // Add presence logging info
+  doc["presence_logs_count"] = presenceLogCount;
+  doc["max_presence_logs"] = MAX_PRESENCE_LOGS;
+}
+
+// Summary fields, one LED per step, then the footer
+bool produceStatus(JsonChunkWriter& out, size_t step) {
+  StaticJsonDocument<768> doc;
+  if (step == 0) {
+    fillStatusSummary(doc);
+    out.beginObject();
+    out.members(doc);
+    out.beginArray("leds");
+    return true;
+  }
+  
+  uint8_t led = step - 1;
+  if (led < ledCount) {
+    fillLedStatus(doc, led);
+    out.element(doc);
+    return true;
+  }
+  
+  out.endArray();
+  fillStatusFooter(doc);
+  out.members(doc);
+  out.endObject();
+  return false;
+}
+
+// MessagePack /status for fleet collectors: the same members, with enum
+// codes in place of display strings and one row of codes per LED:
+// [pin, enabled, current_state, call, meeting, available, away, offline]
+void fillPackedStatusSummary(JsonDocument& doc) {
+  fillStatusSummary(doc);
+  doc.remove("message");
+  doc["state"] = (int)currentState;
+  if (doc.containsKey("presence")) {
+    doc["presence"] = (int)currentPresence;
+  }
+}
+
+void fillPackedStatusFooter(JsonDocument& doc) {
+  fillStatusFooter(doc);
+  if (timeConfigured) {
+    doc.remove("current_time");
+    doc["time"] = time(nullptr);
+  }
+}
+
+bool packStatus(MsgPackChunkWriter& out, size_t step) {
+  StaticJsonDocument<768> doc;
+  if (step == 0) {
+    StaticJsonDocument<256> footer;
+    fillPackedStatusSummary(doc);
+    fillPackedStatusFooter(footer);
+    out.beginMap(nullptr, doc.size() + 1 + footer.size());
+    out.members(doc);
+    out.beginArray("leds", ledCount);
+    return true;
+  }
   
-  // Add LED status information
-  doc["led_count"] = ledCount;
-  JsonArray ledArray = doc.createNestedArray("leds");
-  for (uint8_t i = 0; i < ledCount; i++) {
-    JsonObject led = ledArray.createNestedObject();
-    led["id"] = i;
-    led["pin"] = leds[i].pin;
-    led["enabled"] = leds[i].enabled;
-    led["current_state"] = leds[i].state;
-    
-    // Add pattern names for readability
-    led["call_pattern"] = getPatternName(leds[i].callPattern);
-    led["meeting_pattern"] = getPatternName(leds[i].meetingPattern);
-    led["available_pattern"] = getPatternName(leds[i].availablePattern);
-    led["away_pattern"] = getPatternName(leds[i].awayPattern);
-    led["offline_pattern"] = getPatternName(leds[i].offlinePattern);
+  uint8_t led = step - 1;
+  if (led < ledCount) {
+    JsonArray row = doc.to<JsonArray>();
+    row.add(leds[led].pin);
+    row.add(leds[led].enabled);
+    row.add(leds[led].state);
+    row.add(leds[led].callPattern);
+    row.add(leds[led].meetingPattern);
+    row.add(leds[led].availablePattern);
+    row.add(leds[led].awayPattern);
+    row.add(leds[led].offlinePattern);
+    out.element(doc);
+    return true;
   }
   
-  // Add time information
-  doc["time_configured"] = timeConfigured;
-  if (timeConfigured) {
-    doc["current_time"] = getCurrentTimeString();
-    doc["timezone_offset"] = timezoneOffset;
-    doc["daylight_offset"] = daylightOffset;
+  fillPackedStatusFooter(doc);
+  out.members(doc);
+  return false;
+}
+
+// Served from the cached snapshot; a request costs no JSON work at all
+void handleStatus(AsyncWebServerRequest* request) {
+  if (wantsMsgPack(request)) {
+    sendSnapshot(request, statusPackSnapshot, MSGPACK_CONTENT_TYPE);
+  } else {
+    sendSnapshot(request, statusSnapshot, "application/json");
+  }
+}
+
+void handleSnapshot(AsyncWebServerRequest* request) {
+  sendSnapshot(request, dashboardSnapshot, "application/json");
+}
+
+// Heap telemetry: the current reading, the periodic series, the latest traced
+// calls and totals per traced point, streamed one entry at a time
+void handleHeap(AsyncWebServerRequest* request) {
+  std::shared_ptr<JsonChunkWriter> writer = std::make_shared<JsonChunkWriter>(HeapTrace::produce);
+  request->send(request->beginChunkedResponse("application/json", [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    return writer->fill(buffer, maxLen);
+  }));
+}
+
+void handleMetrics(AsyncWebServerRequest* request) {
+  // Metrics render into one static buffer, so overlapping scrapes take turns
+  uint32_t ticket = Metrics::beginScrape();
+  if (ticket == 0) {
+    AsyncWebServerResponse* response = request->beginResponse(503, "text/plain", "Scrape in progress");
+    response->addHeader("Retry-After", "1");
+    request->send(response);
+    return;
   }
   
-  // Add presence logging info
-  doc["presence_logs_count"] = presenceLogCount;
-  doc["max_presence_logs"] = MAX_PRESENCE_LOGS;
+  request->send(request->beginChunkedResponse("text/plain; version=0.0.4; charset=utf-8", [ticket](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    return Metrics::fillScrape(ticket, buffer, maxLen);
+  }));
+}
+
+void handleBoard(AsyncWebServerRequest* request) {
+  DynamicJsonDocument doc(512 + BOARD_MAX_MEMBERS * 192);
+  doc["enabled"] = statusBoard.isEnabled();
+  doc["has_token"] = statusBoard.hasToken();
+  doc["http_code"] = statusBoard.lastHttpCode();
+  if (statusBoard.lastPollMillis() > 0) {
+    doc["poll_age"] = (millis() - statusBoard.lastPollMillis()) / 1000;
+  }
+  
+  JsonArray members = doc.createNestedArray("members");
+  for (uint8_t i = 0; i < statusBoard.memberCount(); i++) {
+    const BoardMember& member = statusBoard.member(i);
+    JsonObject entry = members.createNestedObject();
+    entry["user"] = (const char*)member.upn;
+    entry["resolved"] = member.id[0] != '\0';
+    entry["presence"] = getPresenceName(member.presence);
+    entry["availability"] = (const char*)member.availability;
+    entry["activity"] = (const char*)member.activity;
+    if (i < ledCount) {
+      entry["led"] = i;
+    }
+  }
   
   String response;
   serializeJson(doc, response);
-  server.send(200, "application/json", response);
+  request->send(200, "application/json", response);
 }
 
-void handleUpdate() {
+void handleUpdate(AsyncWebServerRequest* request) {
   LOG_INFO("Firmware update request received");
   // OTA Update functionality - simplified for now
   LOG_WARN("OTA Update not implemented in this version");
-  server.send(200, "text/plain", "OTA Update not implemented in this version");
+  request->send(200, "text/plain", "OTA Update not implemented in this version");
+}
+
+// One log line per step, looked up by seq so lines logged while the
+// response is being sent do not shift it. A line overwritten before it was
+// sent is left out and reported as missed.
+bool produceLogs(JsonChunkWriter& out, size_t step, CursorWindow& window) {
+  if (step == 0) {
+    out.beginObject();
+    out.beginArray("logs");
+    return true;
+  }
+  
+  int position = window.first + step - 1;
+  StaticJsonDocument<JSON_STREAM_FRAGMENT_SIZE> doc;
+  if (position < window.end) {
+    if (Logger::getLogEntry(window.seqAt(position), doc.to<JsonObject>())) {
+      out.element(doc);
+    } else {
+      window.missed = true;
+    }
+    return true;
+  }
+  
+  out.endArray();
+  doc.clear();
+  fillCursorFooter(doc, window);
+  out.members(doc);
+  out.endObject();
+  return false;
+}
+
+// MessagePack /logs: each line is [seq, timestamp, level, component, message]
+// with the numeric level. The line count is declared up front, so a line
+// overwritten while the response is sent becomes nil.
+bool packLogs(MsgPackChunkWriter& out, size_t step, CursorWindow& window) {
+  StaticJsonDocument<JSON_STREAM_FRAGMENT_SIZE> doc;
+  if (step == 0) {
+    fillCursorFooter(doc, window, true);
+    out.beginMap(nullptr, 1 + doc.size());
+    out.beginArray("logs", window.end - window.first);
+    return true;
+  }
+  
+  int position = window.first + step - 1;
+  if (position < window.end) {
+    if (!Logger::getLogRow(window.seqAt(position), doc.to<JsonArray>())) {
+      doc.clear();
+      window.missed = true;
+    }
+    out.element(doc);
+    return true;
+  }
+  
+  fillCursorFooter(doc, window, true);
+  out.members(doc);
+  return false;
 }
 
-void handleLogs() {
+void handleLogs(AsyncWebServerRequest* request) {
   LOG_DEBUG("Logs API request received");
-  String logsJson = Logger::getLogsAsJson();
-  server.send(200, "application/json", logsJson);
+  if (wantsMsgPack(request)) {
+    sendCursorRead(request, parseCursorQuery(request), Logger::getLastLogSeq, Logger::getLogCount, packLogs, MSGPACK_CONTENT_TYPE);
+  } else {
+    sendCursorRead(request, parseCursorQuery(request), Logger::getLastLogSeq, Logger::getLogCount, produceLogs, "application/json");
+  }
 }
 
-void handleSchedule() {
+void handleSchedule(AsyncWebServerRequest* request) {
   LOG_DEBUG("Schedule API request received");
   
-  if (accessToken.length() == 0) {
+  if (!currentConfigSnapshot()->signedIn) {
     DynamicJsonDocument doc(256);
     doc["error"] = "No access token available";
     doc["schedule"] = nullptr;
     doc["working_hours"] = nullptr;
     String response;
     serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    request->send(200, "application/json", response);
     return;
   }
   
-  // Get calendar events for today
-  WiFiClientSecure secureClient;
-  secureClient.setInsecure();
-  HTTPClient http;
-  
-  // Get today's date in ISO format
-  time_t now = time(nullptr);
-  struct tm* timeInfo = localtime(&now);
-  char startTime[32], endTime[32];
-  snprintf(startTime, sizeof(startTime), "%04d-%02d-%02dT00:00:00Z", 
-           timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday);
-  snprintf(endTime, sizeof(endTime), "%04d-%02d-%02dT23:59:59Z", 
-           timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday);
-  
-  String calendarUrl = "https://graph.microsoft.com/v1.0/me/calendarview?startDateTime=" + String(startTime) + "&endDateTime=" + String(endTime) + "&$select=subject,start,end,isAllDay,showAs&$top=10";
+  // Graph is never called from the request. loop() keeps the store fresh on
+  // its own schedule, however many dashboards are reading it; a request only
+  // nudges that refresh when it is already due.
+  int httpCode = timeConfigured ? calendarSyncResult : -1;
+  if (calendarRefreshDue()) {
+    calendarSyncRequested = true;
+  }
   
-  http.begin(secureClient, calendarUrl);
-  http.addHeader("Authorization", "Bearer " + accessToken);
-  http.addHeader("User-Agent", "TeamsRedLight/1.0");
+  // Serve today's events from the store, written one at a time. Each is
+  // copied out by key, since loop() may be syncing the store meanwhile.
+  const CalendarStore& store = calendarSync.store();
+  time_t dayStart = calendarSync.windowStartTime();
+  time_t dayEnd = dayStart + 86400;
   
-  int httpCode = http.GET();
-  DynamicJsonDocument doc(2048);
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->print("{\"value\":[");
   
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    DeserializationError error = deserializeJson(doc, payload);
+  char buffer[CALENDAR_ITEM_DOC_SIZE];
+  bool first = true;
+  CalendarEvent event;
+  bool found = store.next(nullptr, event);
+  for (; found; found = store.next(&event, event)) {
+    if (event.end <= dayStart || event.start >= dayEnd) {
+      continue;
+    }
     
-    if (!error) {
-      LOG_INFO("Successfully retrieved calendar data");
-    } else {
-      LOG_ERRORF("Failed to parse calendar JSON: %s", error.c_str());
-      doc.clear();
-      doc["error"] = "Failed to parse calendar data";
+    char startStr[32], endStr[32];
+    CalendarSync::formatDateTime(event.start, startStr, sizeof(startStr));
+    CalendarSync::formatDateTime(event.end, endStr, sizeof(endStr));
+    
+    StaticJsonDocument<384> item;
+    item["subject"] = event.subject;
+    item["start"]["dateTime"] = startStr;
+    item["start"]["timeZone"] = "UTC";
+    item["end"]["dateTime"] = endStr;
+    item["end"]["timeZone"] = "UTC";
+    item["isAllDay"] = event.isAllDay;
+    item["showAs"] = CalendarSync::showAsName(event.showAs);
+    
+    size_t length = 0;
+    if (!first) {
+      buffer[length++] = ',';
     }
+    length += serializeJson(item, buffer + length, sizeof(buffer) - length);
+    response->write((const uint8_t*)buffer, length);
+    first = false;
+  }
+  
+  StaticJsonDocument<192> meta;
+  if (httpCode != HTTP_CODE_OK) {
+    meta["error"] = "Failed to retrieve calendar data";
+    meta["http_code"] = httpCode;
+  }
+  meta["synced"] = calendarSync.hasSynced();
+  meta["sync_pending"] = calendarSyncRequested;
+  meta["ttl"] = CALENDAR_CACHE_TTL / 1000;
+  if (calendarSync.hasSynced()) {
+    unsigned long age = millis() - calendarSync.lastSyncMillis();
+    meta["sync_age"] = age / 1000;
+    meta["stale"] = age >= CALENDAR_CACHE_TTL;
   } else {
-    LOG_ERRORF("Calendar request failed with HTTP %d", httpCode);
-    doc["error"] = "Failed to retrieve calendar data";
-    doc["http_code"] = httpCode;
+    meta["stale"] = true;
   }
   
-  http.end();
-  
-  String response;
-  serializeJson(doc, response);
-  server.send(200, "application/json", response);
+  // Append the metadata fields after the array: "],<fields of meta>}"
+  size_t length = serializeJson(meta, buffer + 1, sizeof(buffer) - 1);
+  buffer[0] = ']';
+  buffer[1] = ',';
+  response->write((const uint8_t*)buffer, length + 1);
+  request->send(response);
 }
 
-void handleLocation() {
+void handleLocation(AsyncWebServerRequest* request) {
   LOG_DEBUG("Location API request received");
   
-  if (accessToken.length() == 0) {
+  if (!currentConfigSnapshot()->signedIn) {
     DynamicJsonDocument doc(256);
     doc["error"] = "No access token available";
     doc["location"] = "Unknown";
     String response;
     serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    request->send(200, "application/json", response);
     return;
   }
   
-  // Get user's presence with location information
-  WiFiClientSecure secureClient;
-  secureClient.setInsecure();
-  HTTPClient http;
-  http.begin(secureClient, "https://graph.microsoft.com/v1.0/me/presence");
-  http.addHeader("Authorization", "Bearer " + accessToken);
-  http.addHeader("User-Agent", "TeamsRedLight/1.0");
+  // Optional freshness bound in seconds, e.g. /location?max_age=10
+  bool fresh = true;
+  if (request->hasArg("max_age")) {
+    long maxAge = max(0L, request->arg("max_age").toInt());
+    fresh = reportedPresenceFresh(maxAge * 1000UL);
+  }
   
-  int httpCode = http.GET();
-  DynamicJsonDocument doc(1024);
+  DynamicJsonDocument doc(512);
+  if (!fresh) {
+    doc["stale"] = true;
+    doc["refresh_pending"] = true;
+  }
+  // Copied under the lock loop() writes them with
+  char availability[sizeof(reportedAvailability)];
+  char activity[sizeof(reportedActivity)];
+  portENTER_CRITICAL(&reportedPresenceLock);
+  unsigned long reportedAt = lastPresenceReport;
+  memcpy(availability, reportedAvailability, sizeof(availability));
+  memcpy(activity, reportedActivity, sizeof(activity));
+  portEXIT_CRITICAL(&reportedPresenceLock);
   
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    DeserializationError error = deserializeJson(doc, payload);
+  if (reportedAt == 0) {
+    // Nothing reported by Graph or the relay yet
+    doc["error"] = "Presence not retrieved yet";
+    doc["location"] = "Unknown";
+  } else {
+    // Infer location from the presence last reported by Graph or the relay
+    // instead of issuing a Graph request from the web handler
     
-    if (!error) {
-      // Extract location information if available
-      String availability = doc["availability"].as<String>();
-      String activity = doc["activity"].as<String>();
-      
-      // Infer location based on presence status
-      String location = "Unknown";
-      if (activity == "InAMeeting" || activity == "InACall" || activity == "InAConferenceCall") {
-        location = "In Meeting";
-      } else if (availability == "Available" || availability == "Busy") {
-        location = "Online/Remote";
-      } else if (availability == "Away" || availability == "BeRightBack") {
-        location = "Away";
-      } else if (availability == "Offline") {
-        location = "Offline";
-      }
-      
-      doc["location"] = location;
-      doc["inferred_from"] = "presence";
-      LOG_INFOF("Location inferred as: %s", location.c_str());
-    } else {
-      LOG_ERRORF("Failed to parse presence JSON: %s", error.c_str());
-      doc.clear();
-      doc["error"] = "Failed to parse presence data";
-      doc["location"] = "Unknown";
+    const char* location = "Unknown";
+    if (strcmp(activity, "InAMeeting") == 0 || strcmp(activity, "InACall") == 0 || strcmp(activity, "InAConferenceCall") == 0) {
+      location = "In Meeting";
+    } else if (strcmp(availability, "Available") == 0 || strcmp(availability, "Busy") == 0) {
+      location = "Online/Remote";
+    } else if (strcmp(availability, "Away") == 0 || strcmp(availability, "BeRightBack") == 0) {
+      location = "Away";
+    } else if (strcmp(availability, "Offline") == 0) {
+      location = "Offline";
     }
-  } else {
-    LOG_ERRORF("Presence request failed with HTTP %d", httpCode);
-    doc["error"] = "Failed to retrieve presence data";
-    doc["location"] = "Unknown";
-    doc["http_code"] = httpCode;
+    
+    doc["availability"] = availability;
+    doc["activity"] = activity;
+    doc["location"] = location;
+    doc["inferred_from"] = "presence";
+    doc["presence_age"] = (millis() - reportedAt) / 1000;
   }
   
-  http.end();
-  
   String response;
   serializeJson(doc, response);
-  server.send(200, "application/json", response);
+  request->send(200, "application/json", response);
 }
 
-void handleLogin() {
+void handleLogin(AsyncWebServerRequest* request) {
   LOG_INFO("Device code authentication request received");
   
-  if (clientId.length() == 0 || tenantId.length() == 0) {
+  std::shared_ptr<const ConfigSnapshot> snapshot = currentConfigSnapshot();
+  if (snapshot->config.clientId.length() == 0 || snapshot->config.tenantId.length() == 0) {
     LOG_ERROR("Authentication failed - missing client ID or tenant ID");
-    server.send(400, "text/plain", "Client ID and Tenant ID must be configured first");
+    request->send(400, "text/plain", "Client ID and Tenant ID must be configured first");
     return;
   }
   
-  // Start device code flow
-  if (startDeviceCodeFlow()) {
+  // The device code request goes to Azure AD from loop(); the browser is
+  // bounced back here until it completes
+  if (!request->hasArg("wait")) {
+    deviceCodeStartFailed = false;
+    deviceCodeRequested = true;
+  }
+  
+  if (deviceCodeRequested) {
+    request->send(200, "text/html", R"(
+<!DOCTYPE html>
+<html>
+<head>
+    <title>Teams Red Light - Device Authentication</title>
+    <meta charset="UTF-8">
+    <meta http-equiv="refresh" content="2;url=/login?wait=1">
+    <style>
+        body { font-family: Arial, sans-serif; text-align: center; margin-top: 50px; }
+        .message { background-color: #d1ecf1; color: #0c5460; padding: 20px; border-radius: 5px; display: inline-block; }
+    </style>
+</head>
+<body>
+    <div class="message">
+        <h2>&#x23F3; Contacting Microsoft...</h2>
+        <p>Your sign-in code will appear in a moment.</p>
+    </div>
+</body>
+</html>
+    )");
+    return;
+  }
+  
+  if (!deviceCodeStartFailed && snapshot->userCode.length() > 0) {
     LOG_INFO("Device code flow started successfully");
     
     // Display the user code and verification URL to the user
-    String html = R"(
+    // Built in scratch memory; the server keeps one copy of the finished page
+    ScratchScope scratch;
+    ScratchString html(scratch, 3072);
+    html.append(R"(
 <!DOCTYPE html>
 <html>
 <head>
@@ -1707,11 +2761,11 @@ void handleLogin() {
         <div class="instructions">
             <h2>Step 1: Visit the Microsoft login page</h2>
             <div class="verification-url">
-                <strong>Go to:</strong> <a href=")" + verificationUri + R"(" target="_blank">)" + verificationUri + R"(</a>
+                <strong>Go to:</strong> <a href=")").append(snapshot->verificationUri).append(R"(" target="_blank">)").append(snapshot->verificationUri).append(R"(</a>
             </div>
             
             <h2>Step 2: Enter this code</h2>
-            <div class="user-code">)" + userCode + R"(</div>
+            <div class="user-code">)").append(snapshot->userCode).append(R"(</div>
             
             <h2>Step 3: Sign in with your Teams account</h2>
             <p>After entering the code, sign in with your Microsoft Teams/Office 365 account and authorize the application.</p>
@@ -1723,49 +2777,49 @@ void handleLogin() {
         </div>
         
         <div style="margin-top: 30px;">
-            <a href=")" + verificationUri + R"(" target="_blank" class="button">Open Microsoft Login</a>
+            <a href=")").append(snapshot->verificationUri).append(R"(" target="_blank" class="button">Open Microsoft Login</a>
             <a href="/status" class="button">Check Status</a>
         </div>
     </div>
 </body>
 </html>
-    )";
+    )");
     
-    server.send(200, "text/html", html);
+    request->send(200, "text/html", html.c_str());
   } else {
     LOG_ERROR("Failed to start device code flow");
-    server.send(500, "text/plain", "Failed to start authentication process. Please try again.");
+    request->send(500, "text/plain", "Failed to start authentication process. Please try again.");
   }
 }
 
-void handleCallback() {
+void handleCallback(AsyncWebServerRequest* request) {
   LOG_INFO("OAuth callback received");
   
-  if (server.hasArg("code")) {
-    String code = server.arg("code");
+  if (request->hasArg("code")) {
+    String code = request->arg("code");
     LOG_INFOF("Authorization code received (length: %d)", code.length());
     
     // Exchange code for tokens
     WiFiClientSecure secureClient;
     secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
     HTTPClient http;
-    String tokenUrl = "https://login.microsoftonline.com/" + tenantId + "/oauth2/v2.0/token";
+    ScratchScope scratch;
+    ScratchString tokenUrl(scratch, 96);
+    tokenUrl.append("https://login.microsoftonline.com/").append(tenantId).append("/oauth2/v2.0/token");
     LOG_DEBUGF("Making token exchange request to: %s", tokenUrl.c_str());
     
-    http.begin(secureClient, tokenUrl);
+    http.begin(secureClient, tokenUrl.c_str());
     http.addHeader("Content-Type", "application/x-www-form-urlencoded");
     
-    String deviceIP = WiFi.localIP().toString();
-    String redirectUri = "http://" + deviceIP + "/callback";
-    
-    String postData = "client_id=" + clientId;
-    postData += "&client_secret=" + clientSecret;
-    postData += "&code=" + code;
-    postData += "&grant_type=authorization_code";
-    postData += "&redirect_uri=" + redirectUri;
+    ScratchString postData(scratch, 256 + code.length());
+    postData.append("client_id=").append(clientId);
+    postData.append("&client_secret=").append(clientSecret);
+    postData.append("&code=").append(code);
+    postData.append("&grant_type=authorization_code");
+    postData.append("&redirect_uri=http://").append(WiFi.localIP().toString()).append("/callback");
     
     LOG_DEBUG("Sending token exchange request...");
-    int httpCode = http.POST(postData);
+    int httpCode = http.POST(postData.bytes(), postData.length());
     LOG_INFOF("Token exchange response: HTTP %d", httpCode);
     
     if (httpCode == HTTP_CODE_OK) {
@@ -1777,7 +2831,7 @@ void handleCallback() {
       
       if (error) {
         LOG_ERRORF("Failed to parse token response JSON: %s", error.c_str());
-        server.send(400, "text/plain", "Authentication failed: Invalid JSON response");
+        request->send(400, "text/plain", "Authentication failed: Invalid JSON response");
       } else if (doc.containsKey("access_token")) {
         accessToken = doc["access_token"].as<String>();
         refreshToken = doc["refresh_token"].as<String>();
@@ -1803,7 +2857,7 @@ void handleCallback() {
         currentState = STATE_AUTHENTICATED;
         LOG_INFO("Device state changed to AUTHENTICATED");
         
-        server.send(200, "text/html", R"(
+        request->send(200, "text/html", R"(
 <!DOCTYPE html>
 <html>
 <head>
@@ -1830,7 +2884,7 @@ void handleCallback() {
           String errorDesc = doc.containsKey("error_description") ? doc["error_description"].as<String>() : "";
           LOG_ERRORF("OAuth error: %s - %s", error.c_str(), errorDesc.c_str());
         }
-        server.send(400, "text/plain", "Authentication failed: No access token received");
+        request->send(400, "text/plain", "Authentication failed: No access token received");
       }
     } else {
       LOG_ERRORF("Token exchange failed with HTTP %d", httpCode);
@@ -1838,18 +2892,18 @@ void handleCallback() {
       if (response.length() > 0) {
         LOG_DEBUGF("Error response: %s", response.c_str());
       }
-      server.send(400, "text/plain", "Authentication failed: HTTP " + String(httpCode));
+      request->send(400, "text/plain", "Authentication failed: HTTP " + String(httpCode));
     }
     
     http.end();
-  } else if (server.hasArg("error")) {
-    String error = server.arg("error");
-    String errorDesc = server.hasArg("error_description") ? server.arg("error_description") : "";
+  } else if (request->hasArg("error")) {
+    String error = request->arg("error");
+    String errorDesc = request->hasArg("error_description") ? request->arg("error_description") : "";
     LOG_ERRORF("OAuth authentication error: %s - %s", error.c_str(), errorDesc.c_str());
-    server.send(400, "text/plain", "Authentication failed: " + error);
+    request->send(400, "text/plain", "Authentication failed: " + error);
   } else {
     LOG_ERROR("OAuth callback received without authorization code or error");
-    server.send(400, "text/plain", "Authentication failed: No authorization code received");
+    request->send(400, "text/plain", "Authentication failed: No authorization code received");
   }
 }
 
@@ -1859,18 +2913,21 @@ bool startDeviceCodeFlow() {
   WiFiClientSecure secureClient;
   secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
   HTTPClient http;
-  String deviceCodeUrl = "https://login.microsoftonline.com/" + tenantId + "/oauth2/v2.0/devicecode";
+  ScratchScope scratch;
+  ScratchString deviceCodeUrl(scratch, 96);
+  deviceCodeUrl.append("https://login.microsoftonline.com/").append(tenantId).append("/oauth2/v2.0/devicecode");
   
-  http.begin(secureClient, deviceCodeUrl);
+  http.begin(secureClient, deviceCodeUrl.c_str());
   http.addHeader("Content-Type", "application/x-www-form-urlencoded");
   
-  String postData = "client_id=" + clientId;
-  postData += "&scope=" + String(DEVICE_CODE_SCOPE);
+  ScratchString postData(scratch, 128);
+  postData.append("client_id=").append(clientId);
+  postData.append("&scope=" DEVICE_CODE_SCOPE);
   
   LOG_DEBUGF("Device code request URL: %s", deviceCodeUrl.c_str());
   LOG_DEBUG("Sending device code request...");
   
-  int httpCode = http.POST(postData);
+  int httpCode = http.POST(postData.bytes(), postData.length());
   LOG_INFOF("Device code response: HTTP %d", httpCode);
   
   if (httpCode == HTTP_CODE_OK) {
@@ -1902,6 +2959,7 @@ bool startDeviceCodeFlow() {
     preferences.putString(KEY_USER_CODE, userCode);
     preferences.putString(KEY_VERIFICATION_URI, verificationUri);
     preferences.putULong64(KEY_DEVICE_CODE_EXPIRES, deviceCodeExpires);
+    publishConfigSnapshot();  // /login shows the code from the snapshot
     
     currentState = STATE_DEVICE_CODE_PENDING;
     lastDeviceCodePoll = millis();
@@ -1930,16 +2988,19 @@ bool pollDeviceCodeToken() {
   WiFiClientSecure secureClient;
   secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
   HTTPClient http;
-  String tokenUrl = "https://login.microsoftonline.com/" + tenantId + "/oauth2/v2.0/token";
+  ScratchScope scratch;
+  ScratchString tokenUrl(scratch, 96);
+  tokenUrl.append("https://login.microsoftonline.com/").append(tenantId).append("/oauth2/v2.0/token");
   
-  http.begin(secureClient, tokenUrl);
+  http.begin(secureClient, tokenUrl.c_str());
   http.addHeader("Content-Type", "application/x-www-form-urlencoded");
   
-  String postData = "grant_type=urn:ietf:params:oauth:grant-type:device_code";
-  postData += "&client_id=" + clientId;
-  postData += "&device_code=" + deviceCode;
+  ScratchString postData(scratch, 128 + deviceCode.length());
+  postData.append("grant_type=urn:ietf:params:oauth:grant-type:device_code");
+  postData.append("&client_id=").append(clientId);
+  postData.append("&device_code=").append(deviceCode);
   
-  int httpCode = http.POST(postData);
+  int httpCode = http.POST(postData.bytes(), postData.length());
   LOG_DEBUGF("Token poll response: HTTP %d", httpCode);
   
   if (httpCode == HTTP_CODE_OK || httpCode == 400 || httpCode == 401) {
@@ -1986,6 +3047,7 @@ bool pollDeviceCodeToken() {
       userCode = "";
       verificationUri = "";
       deviceCodeExpires = 0;
+      publishConfigSnapshot();
       
       http.end();
       return true;
@@ -2051,17 +3113,20 @@ bool pollDeviceCodeTokenWithSecret() {
   WiFiClientSecure secureClient;
   secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
   HTTPClient http;
-  String tokenUrl = "https://login.microsoftonline.com/" + tenantId + "/oauth2/v2.0/token";
+  ScratchScope scratch;
+  ScratchString tokenUrl(scratch, 96);
+  tokenUrl.append("https://login.microsoftonline.com/").append(tenantId).append("/oauth2/v2.0/token");
   
-  http.begin(secureClient, tokenUrl);
+  http.begin(secureClient, tokenUrl.c_str());
   http.addHeader("Content-Type", "application/x-www-form-urlencoded");
   
-  String postData = "grant_type=urn:ietf:params:oauth:grant-type:device_code";
-  postData += "&client_id=" + clientId;
-  postData += "&client_secret=" + clientSecret;
-  postData += "&device_code=" + deviceCode;
+  ScratchString postData(scratch, 192 + deviceCode.length());
+  postData.append("grant_type=urn:ietf:params:oauth:grant-type:device_code");
+  postData.append("&client_id=").append(clientId);
+  postData.append("&client_secret=").append(clientSecret);
+  postData.append("&device_code=").append(deviceCode);
   
-  int httpCode = http.POST(postData);
+  int httpCode = http.POST(postData.bytes(), postData.length());
   LOG_DEBUGF("Token poll with secret response: HTTP %d", httpCode);
   
   if (httpCode == HTTP_CODE_OK || httpCode == 400 || httpCode == 401) {
@@ -2108,6 +3173,7 @@ bool pollDeviceCodeTokenWithSecret() {
       userCode = "";
       verificationUri = "";
       deviceCodeExpires = 0;
+      publishConfigSnapshot();
       
       http.end();
       return true;
@@ -2147,6 +3213,168 @@ bool pollDeviceCodeTokenWithSecret() {
   }
 }
 
+TeamsPresence mapTeamsPresence(const char* availability, const char* activity) {
+  // Map Teams presence to our enum
+  if (strcmp(activity, "InAMeeting") == 0 || strcmp(activity, "InACall") == 0 || strcmp(activity, "InAConferenceCall") == 0) {
+    return PRESENCE_IN_MEETING;
+  } else if (strcmp(availability, "Busy") == 0 || strcmp(availability, "DoNotDisturb") == 0) {
+    return PRESENCE_BUSY;
+  } else if (strcmp(availability, "Available") == 0) {
+    return PRESENCE_AVAILABLE;
+  } else if (strcmp(availability, "Away") == 0 || strcmp(availability, "BeRightBack") == 0) {
+    return PRESENCE_AWAY;
+  } else if (strcmp(availability, "Offline") == 0) {
+    return PRESENCE_OFFLINE;
+  }
+  LOG_WARNF("Unknown presence state - Availability: %s, Activity: %s", availability, activity);
+  return PRESENCE_UNKNOWN;
+}
+
+const char* getStateName(DeviceState state) {
+  switch (state) {
+    case STATE_AP_MODE: return "ap_mode";
+    case STATE_CONNECTING_WIFI: return "connecting_wifi";
+    case STATE_CONNECTING_OAUTH: return "connecting_oauth";
+    case STATE_DEVICE_CODE_PENDING: return "device_code_pending";
+    case STATE_AUTHENTICATED: return "authenticated";
+    case STATE_MONITORING: return "monitoring";
+    default: return "error";
+  }
+}
+
+const char* getPresenceName(TeamsPresence presence) {
+  switch (presence) {
+    case PRESENCE_AVAILABLE: return "Available";
+    case PRESENCE_BUSY: return "Busy";
+    case PRESENCE_IN_MEETING: return "In Meeting";
+    case PRESENCE_AWAY: return "Away";
+    case PRESENCE_OFFLINE: return "Offline";
+    default: return "Unknown";
+  }
+}
+
+void updatePresence(TeamsPresence newPresence) {
+  // Only log if presence changed
+  if (newPresence != currentPresence) {
+    LOG_INFOF("Teams presence changed: %s (was %s)", getPresenceName(newPresence), getPresenceName(currentPresence));
+    
+    // Log presence change persistently
+    logPresenceChange(newPresence);
+    
+    currentPresence = newPresence;
+  } else {
+    LOG_DEBUG("Teams presence unchanged");
+  }
+}
+
+void recordReportedPresence(const char* availability, const char* activity) {
+  portENTER_CRITICAL(&reportedPresenceLock);
+  strlcpy(reportedAvailability, availability, sizeof(reportedAvailability));
+  strlcpy(reportedActivity, activity, sizeof(reportedActivity));
+  lastPresenceReport = millis();
+  portEXIT_CRITICAL(&reportedPresenceLock);
+}
+
+// For presence-derived endpoints: true when the last report is no older than
+// maxAgeMillis. Otherwise loop() is asked for an early poll, which any number
+// of callers coalesce into one; the caller answers from the cache meanwhile.
+// While heap is short no early poll is asked for and the regular one is
+// waited for.
+bool reportedPresenceFresh(unsigned long maxAgeMillis) {
+  if (lastPresenceReport != 0 && millis() - lastPresenceReport <= maxAgeMillis) {
+    return true;
+  }
+  if (!heapGovernor.deferFetches()) {
+    presenceRefreshRequested = true;
+  }
+  return false;
+}
+
+void applyUpstreamPresence(TeamsPresence newPresence) {
+  upstreamPresence = newPresence;
+  
+  // A desk-side agent push wins until its TTL expires
+  if (localPush.isActive()) {
+    LOG_DEBUGF("Local push from %s active, deferring %s", localPush.source(), getPresenceName(newPresence));
+    return;
+  }
+  updatePresence(newPresence);
+}
+
+void onRelayPresence(const char* availability, const char* activity) {
+  LOG_DEBUGF("Presence pushed by relay - Availability: %s, Activity: %s", availability, activity);
+  recordReportedPresence(availability, activity);
+  applyUpstreamPresence(mapTeamsPresence(availability, activity));
+}
+
+bool authorizePresencePush(AsyncWebServerRequest* request) {
+  const AsyncWebHeader* authorization = request->getHeader("Authorization");
+  if (authorization == nullptr || !localPush.authorize(authorization->value())) {
+    LOG_WARNF("Rejected local presence push from %s", request->client()->remoteIP().toString().c_str());
+    request->send(401, "application/json", "{\"error\":\"invalid or missing API key\"}");
+    return false;
+  }
+  return true;
+}
+
+void handlePresencePush(AsyncWebServerRequest* request) {
+  if (!authorizePresencePush(request)) {
+    return;
+  }
+  
+  const char* body = (const char*)request->_tempObject;
+  if (body == nullptr) {
+    request->send(400, "application/json", "{\"error\":\"missing or oversized body\"}");
+    return;
+  }
+  
+  StaticJsonDocument<256> doc;
+  DeserializationError error = deserializeJson(doc, body);
+  if (error) {
+    request->send(400, "application/json", "{\"error\":\"invalid JSON\"}");
+    return;
+  }
+  
+  // Same vocabulary as Graph /me/presence so the mapping is shared
+  const char* availability = doc["availability"] | "";
+  const char* activity = doc["activity"] | "";
+  TeamsPresence pushed = mapTeamsPresence(availability, activity);
+  if (pushed == PRESENCE_UNKNOWN) {
+    request->send(400, "application/json", "{\"error\":\"unknown availability/activity\"}");
+    return;
+  }
+  
+  // Applied by loop(), which owns presence and the presence log; a newer
+  // push or clear arriving first replaces this one
+  const char* source = doc["source"] | "";
+  unsigned long ttl = localPush.ttlFor(doc["ttl"] | 0UL);
+  portENTER_CRITICAL(&pendingPushLock);
+  pendingPush.action = PUSH_APPLY;
+  pendingPush.presence = pushed;
+  pendingPush.ttl = ttl;
+  strlcpy(pendingPush.source, source[0] ? source : "agent", sizeof(pendingPush.source));
+  portEXIT_CRITICAL(&pendingPushLock);
+  
+  DynamicJsonDocument response(256);
+  response["presence"] = getPresenceName(pushed);
+  response["source"] = source[0] ? source : "agent";
+  response["expires_in"] = ttl;
+  String reply;
+  serializeJson(response, reply);
+  request->send(200, "application/json", reply);
+}
+
+void handlePresencePushClear(AsyncWebServerRequest* request) {
+  if (!authorizePresencePush(request)) {
+    return;
+  }
+  
+  portENTER_CRITICAL(&pendingPushLock);
+  pendingPush.action = PUSH_CLEAR;
+  portEXIT_CRITICAL(&pendingPushLock);
+  request->send(200, "application/json", "{\"status\":\"cleared\"}");
+}
+
 void checkTeamsPresence() {
   if (accessToken.length() == 0) {
     LOG_WARN("Cannot check Teams presence - no access token available");
@@ -2168,76 +3396,32 @@ void checkTeamsPresence() {
   }
   
   LOG_DEBUG("Making Teams presence API request");
-  WiFiClientSecure secureClient;
-  secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
-  HTTPClient http;
-  http.begin(secureClient, "https://graph.microsoft.com/v1.0/me/presence");
-  http.addHeader("Authorization", "Bearer " + accessToken);
-  http.addHeader("User-Agent", "TeamsRedLight/1.0");
   
-  int httpCode = http.GET();
+  // Kept connection and fixed buffers: a steady-state poll stays off the heap
+  uint32_t pollStart = micros();
+  int httpCode = presenceClient.fetch(accessToken);
   LOG_DEBUGF("Presence API response: HTTP %d", httpCode);
+  const PresenceResponse& response = presenceClient.response();
   
   if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    LOG_DEBUGF("Presence API response payload length: %d", payload.length());
+    LOG_DEBUGF("Presence API response payload length: %u", response.bodyLength());
     
-    DynamicJsonDocument doc(1024);
-    DeserializationError error = deserializeJson(doc, payload);
+    GraphPresence presence;
+    DeserializationError error = PresenceResponse::parsePresence(response.body(), response.bodyLength(), presence);
+    Metrics::observeGraphPoll(!error, micros() - pollStart);
     
     if (error) {
       LOG_ERRORF("Failed to parse presence JSON: %s", error.c_str());
-      http.end();
       return;
     }
     
-    String availability = doc["availability"].as<String>();
-    String activity = doc["activity"].as<String>();
-    
-    LOG_DEBUGF("Teams presence - Availability: %s, Activity: %s", availability.c_str(), activity.c_str());
-    
-    TeamsPresence newPresence;
-    
-    // Map Teams presence to our enum
-    if (activity == "InAMeeting" || activity == "InACall" || activity == "InAConferenceCall") {
-      newPresence = PRESENCE_IN_MEETING;
-    } else if (availability == "Busy" || availability == "DoNotDisturb") {
-      newPresence = PRESENCE_BUSY;
-    } else if (availability == "Available") {
-      newPresence = PRESENCE_AVAILABLE;
-    } else if (availability == "Away" || availability == "BeRightBack") {
-      newPresence = PRESENCE_AWAY;
-    } else if (availability == "Offline") {
-      newPresence = PRESENCE_OFFLINE;
-    } else {
-      newPresence = PRESENCE_UNKNOWN;
-      LOG_WARNF("Unknown presence state - Availability: %s, Activity: %s", availability.c_str(), activity.c_str());
-    }
+    LOG_DEBUGF("Teams presence - Availability: %s, Activity: %s", presence.availability, presence.activity);
     
-    // Only log if presence changed
-    if (newPresence != currentPresence) {
-      const char* presenceStr = "";
-      switch (newPresence) {
-        case PRESENCE_AVAILABLE: presenceStr = "Available"; break;
-        case PRESENCE_BUSY: presenceStr = "Busy"; break;
-        case PRESENCE_IN_MEETING: presenceStr = "In Meeting"; break;
-        case PRESENCE_AWAY: presenceStr = "Away"; break;
-        case PRESENCE_OFFLINE: presenceStr = "Offline"; break;
-        default: presenceStr = "Unknown"; break;
-      }
-      
-      LOG_INFOF("Teams presence changed: %s (was %s)", presenceStr, 
-               currentPresence == PRESENCE_UNKNOWN ? "Unknown" : "different");
-      
-      // Log presence change persistently
-      logPresenceChange(newPresence);
-      
-      currentPresence = newPresence;
-    } else {
-      LOG_DEBUG("Teams presence unchanged");
-    }
+    recordReportedPresence(presence.availability, presence.activity);
+    applyUpstreamPresence(mapTeamsPresence(presence.availability, presence.activity));
     
   } else if (httpCode == HTTP_CODE_UNAUTHORIZED) {
+    Metrics::observeGraphPoll(false, micros() - pollStart);
     LOG_WARN("Teams API returned 401 Unauthorized - token may be expired");
     LOG_INFO("Attempting to refresh access token...");
     if (!refreshAccessToken()) {
@@ -2247,17 +3431,22 @@ void checkTeamsPresence() {
       LOG_INFO("Token refreshed successfully, will retry next cycle");
     }
   } else {
+    Metrics::observeGraphPoll(false, micros() - pollStart);
     LOG_ERRORF("Teams presence API failed: HTTP %d", httpCode);
-    String response = http.getString();
-    if (response.length() > 0 && response.length() < 200) {
-      LOG_DEBUGF("Error response: %s", response.c_str());
+    if (response.bodyLength() > 0 && response.bodyLength() < 200) {
+      LOG_DEBUGF("Error response: %s", response.body());
     }
   }
-  
-  http.end();
 }
 
 bool refreshAccessToken() {
+  HeapTraceScope trace(TRACE_GRAPH_TOKEN);
+  bool refreshed = exchangeRefreshToken();
+  Metrics::countTokenRefresh(refreshed);
+  return refreshed;
+}
+
+bool exchangeRefreshToken() {
   if (refreshToken.length() == 0) {
     LOG_ERROR("Cannot refresh token - no refresh token available");
     return false;
@@ -2268,20 +3457,23 @@ bool refreshAccessToken() {
   WiFiClientSecure secureClient;
   secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
   HTTPClient http;
-  String tokenUrl = "https://login.microsoftonline.com/" + tenantId + "/oauth2/v2.0/token";
+  ScratchScope scratch;
+  ScratchString tokenUrl(scratch, 96);
+  tokenUrl.append("https://login.microsoftonline.com/").append(tenantId).append("/oauth2/v2.0/token");
   LOG_DEBUGF("Token refresh URL: %s", tokenUrl.c_str());
   
-  http.begin(secureClient, tokenUrl);
+  http.begin(secureClient, tokenUrl.c_str());
   http.addHeader("Content-Type", "application/x-www-form-urlencoded");
   
-  String postData = "client_id=" + clientId;
-  postData += "&client_secret=" + clientSecret;
-  postData += "&refresh_token=" + refreshToken;
-  postData += "&grant_type=refresh_token";
-  postData += "&scope=" + String(DEVICE_CODE_SCOPE);
+  ScratchString postData(scratch, 256 + refreshToken.length());
+  postData.append("client_id=").append(clientId);
+  postData.append("&client_secret=").append(clientSecret);
+  postData.append("&refresh_token=").append(refreshToken);
+  postData.append("&grant_type=refresh_token");
+  postData.append("&scope=" DEVICE_CODE_SCOPE);
   
   LOG_DEBUG("Sending token refresh request...");
-  int httpCode = http.POST(postData);
+  int httpCode = http.POST(postData.bytes(), postData.length());
   LOG_INFOF("Token refresh response: HTTP %d", httpCode);
   
   if (httpCode == HTTP_CODE_OK) {
@@ -2350,6 +3542,7 @@ bool refreshAccessToken() {
       accessToken = "";
       refreshToken = "";
       tokenExpires = 0;
+      publishConfigSnapshot();
     }
   }
   
@@ -2357,6 +3550,19 @@ bool refreshAccessToken() {
   return false;
 }
 
+// LED settings are stored one key per setting and LED; keys are built on the stack
+uint32_t getLedSetting(LedKey setting, uint8_t index, uint32_t defaultValue) {
+  char key[LED_KEY_SIZE];
+  DeviceConfig::ledKey(setting, index, key);
+  return preferences.getUInt(key, defaultValue);
+}
+
+void putLedSetting(LedKey setting, uint8_t index, uint32_t value) {
+  char key[LED_KEY_SIZE];
+  DeviceConfig::ledKey(setting, index, key);
+  preferences.putUInt(key, value);
+}
+
 void loadConfiguration() {
   LOG_INFO("Loading configuration from flash memory");
   
@@ -2366,6 +3572,19 @@ void loadConfiguration() {
   clientSecret = preferences.getString(KEY_CLIENT_SECRET, "");
   tenantId = preferences.getString(KEY_TENANT_ID, "common");
   userEmail = preferences.getString(KEY_USER_EMAIL, "");
+  relayUrl = preferences.getString(KEY_RELAY_URL, "");
+  relayKey = preferences.getString(KEY_RELAY_KEY, "");
+  pushTtl = preferences.getULong(KEY_PUSH_TTL, LOCAL_PUSH_DEFAULT_TTL);
+  pushApiKey = preferences.getString(KEY_PUSH_API_KEY, "");
+  if (pushApiKey.length() == 0) {
+    // Generated once so desk-side agents can be paired from the config page
+    pushApiKey = LocalPresencePush::generateKey();
+    preferences.putString(KEY_PUSH_API_KEY, pushApiKey);
+    LOG_INFO("Generated local presence push API key");
+  }
+  localPush.begin(pushApiKey, pushTtl);
+  boardMode = preferences.getBool(KEY_BOARD_MODE, false);
+  boardRoster = preferences.getString(KEY_BOARD_ROSTER, "");
   accessToken = preferences.getString(KEY_ACCESS_TOKEN, "");
   refreshToken = preferences.getString(KEY_REFRESH_TOKEN, "");
   tokenExpires = preferences.getULong64(KEY_TOKEN_EXPIRES, 0);
@@ -2395,19 +3614,12 @@ void loadConfiguration() {
   } else {
     // Load configured LEDs
     for (uint8_t i = 0; i < ledCount; i++) {
-      String pinKey = String(KEY_LED_PIN_PREFIX) + String(i);
-      String callKey = String(KEY_LED_CALL_PATTERN_PREFIX) + String(i);
-      String meetKey = String(KEY_LED_MEETING_PATTERN_PREFIX) + String(i);
-      String availKey = String(KEY_LED_AVAILABLE_PATTERN_PREFIX) + String(i);
-      String awayKey = String(KEY_LED_AWAY_PATTERN_PREFIX) + String(i);
-      String offlineKey = String(KEY_LED_OFFLINE_PATTERN_PREFIX) + String(i);
-      
-      leds[i].pin = preferences.getUInt(pinKey.c_str(), LED_PIN);
-      leds[i].callPattern = (LEDPattern)preferences.getUInt(callKey.c_str(), DEFAULT_CALL_PATTERN);
-      leds[i].meetingPattern = (LEDPattern)preferences.getUInt(meetKey.c_str(), DEFAULT_MEETING_PATTERN);
-      leds[i].availablePattern = (LEDPattern)preferences.getUInt(availKey.c_str(), DEFAULT_AVAILABLE_PATTERN);
-      leds[i].awayPattern = (LEDPattern)preferences.getUInt(awayKey.c_str(), DEFAULT_AWAY_PATTERN);
-      leds[i].offlinePattern = (LEDPattern)preferences.getUInt(offlineKey.c_str(), DEFAULT_OFFLINE_PATTERN);
+      leds[i].pin = getLedSetting(LED_KEY_PIN, i, LED_PIN);
+      leds[i].callPattern = (LEDPattern)getLedSetting(LED_KEY_CALL, i, DEFAULT_CALL_PATTERN);
+      leds[i].meetingPattern = (LEDPattern)getLedSetting(LED_KEY_MEETING, i, DEFAULT_MEETING_PATTERN);
+      leds[i].availablePattern = (LEDPattern)getLedSetting(LED_KEY_AVAILABLE, i, DEFAULT_AVAILABLE_PATTERN);
+      leds[i].awayPattern = (LEDPattern)getLedSetting(LED_KEY_AWAY, i, DEFAULT_AWAY_PATTERN);
+      leds[i].offlinePattern = (LEDPattern)getLedSetting(LED_KEY_OFFLINE, i, DEFAULT_OFFLINE_PATTERN);
       leds[i].enabled = true;
       leds[i].lastToggle = 0;
       leds[i].state = false;
@@ -2424,6 +3636,10 @@ void loadConfiguration() {
   LOG_INFOF("Tenant ID: %s", tenantId.c_str());
   LOG_INFOF("Client ID: %s", clientId.length() > 0 ? "(configured)" : "(not configured)");
   LOG_INFOF("Client Secret: %s", clientSecret.length() > 0 ? "(configured)" : "(not configured)");
+  LOG_INFOF("Presence Relay: %s", relayUrl.length() > 0 ? relayUrl.c_str() : "(not configured)");
+  LOG_INFOF("Presence Relay Key: %s", relayKey.length() > 0 ? "(configured)" : "(not configured)");
+  LOG_INFOF("Local Push TTL: %lu seconds", pushTtl);
+  LOG_INFOF("Status Board: %s", boardMode ? "enabled" : "disabled");
   LOG_INFOF("Access Token: %s", accessToken.length() > 0 ? "(available)" : "(not available)");
   LOG_INFOF("Refresh Token: %s", refreshToken.length() > 0 ? "(available)" : "(not available)");
   LOG_INFOF("Call LED Pattern: %d", callPattern);
@@ -2451,6 +3667,7 @@ void loadConfiguration() {
 }
 
 void saveConfiguration() {
+  HeapTraceScope trace(TRACE_SAVE_CONFIG);
   LOG_INFO("Saving configuration to flash memory");
   
   preferences.putString(KEY_WIFI_SSID, wifiSSID);
@@ -2459,6 +3676,12 @@ void saveConfiguration() {
   preferences.putString(KEY_CLIENT_SECRET, clientSecret);
   preferences.putString(KEY_TENANT_ID, tenantId);
   preferences.putString(KEY_USER_EMAIL, userEmail);
+  preferences.putString(KEY_RELAY_URL, relayUrl);
+  preferences.putString(KEY_RELAY_KEY, relayKey);
+  preferences.putString(KEY_PUSH_API_KEY, pushApiKey);
+  preferences.putULong(KEY_PUSH_TTL, pushTtl);
+  preferences.putBool(KEY_BOARD_MODE, boardMode);
+  preferences.putString(KEY_BOARD_ROSTER, boardRoster);
   preferences.putString(KEY_ACCESS_TOKEN, accessToken);
   preferences.putString(KEY_REFRESH_TOKEN, refreshToken);
   preferences.putULong64(KEY_TOKEN_EXPIRES, tokenExpires);
@@ -2475,19 +3698,12 @@ void saveConfiguration() {
   // Save multiple LED configuration
   preferences.putUInt(KEY_LED_COUNT, ledCount);
   for (uint8_t i = 0; i < ledCount; i++) {
-    String pinKey = String(KEY_LED_PIN_PREFIX) + String(i);
-    String callKey = String(KEY_LED_CALL_PATTERN_PREFIX) + String(i);
-    String meetKey = String(KEY_LED_MEETING_PATTERN_PREFIX) + String(i);
-    String availKey = String(KEY_LED_AVAILABLE_PATTERN_PREFIX) + String(i);
-    String awayKey = String(KEY_LED_AWAY_PATTERN_PREFIX) + String(i);
-    String offlineKey = String(KEY_LED_OFFLINE_PATTERN_PREFIX) + String(i);
-    
-    preferences.putUInt(pinKey.c_str(), leds[i].pin);
-    preferences.putUInt(callKey.c_str(), leds[i].callPattern);
-    preferences.putUInt(meetKey.c_str(), leds[i].meetingPattern);
-    preferences.putUInt(availKey.c_str(), leds[i].availablePattern);
-    preferences.putUInt(awayKey.c_str(), leds[i].awayPattern);
-    preferences.putUInt(offlineKey.c_str(), leds[i].offlinePattern);
+    putLedSetting(LED_KEY_PIN, i, leds[i].pin);
+    putLedSetting(LED_KEY_CALL, i, leds[i].callPattern);
+    putLedSetting(LED_KEY_MEETING, i, leds[i].meetingPattern);
+    putLedSetting(LED_KEY_AVAILABLE, i, leds[i].availablePattern);
+    putLedSetting(LED_KEY_AWAY, i, leds[i].awayPattern);
+    putLedSetting(LED_KEY_OFFLINE, i, leds[i].offlinePattern);
   }
   
   LOG_INFO("Configuration saved successfully");
@@ -2550,27 +3766,23 @@ void logPresenceChange(TeamsPresence newPresence) {
   time_t now = time(nullptr);
   
   // Convert presence to string
-  const char* presenceStr = "";
-  switch (newPresence) {
-    case PRESENCE_AVAILABLE: presenceStr = "Available"; break;
-    case PRESENCE_BUSY: presenceStr = "Busy"; break;
-    case PRESENCE_IN_MEETING: presenceStr = "In Meeting"; break;
-    case PRESENCE_AWAY: presenceStr = "Away"; break;
-    case PRESENCE_OFFLINE: presenceStr = "Offline"; break;
-    default: presenceStr = "Unknown"; break;
-  }
-  
-  // Add to circular buffer
-  presenceLogs[presenceLogIndex].timestamp = now;
-  presenceLogs[presenceLogIndex].presence = newPresence;
-  strncpy(presenceLogs[presenceLogIndex].presenceString, presenceStr, sizeof(presenceLogs[presenceLogIndex].presenceString) - 1);
-  presenceLogs[presenceLogIndex].presenceString[sizeof(presenceLogs[presenceLogIndex].presenceString) - 1] = '\0';
-  
-  // Update indices
+  const char* presenceStr = getPresenceName(newPresence);
+  
+  // Add to circular buffer; the entry, its seq and the indices change
+  // together so a reader never pairs a seq with another entry's content
+  PresenceLogEntry logged = {};
+  logged.timestamp = now;
+  logged.presence = newPresence;
+  strlcpy(logged.presenceString, presenceStr, sizeof(logged.presenceString));
+  portENTER_CRITICAL(&presenceLogLock);
+  presenceLogs[presenceLogIndex] = logged;
+  presenceLogSeq++;
   presenceLogIndex = (presenceLogIndex + 1) % MAX_PRESENCE_LOGS;
   if (presenceLogCount < MAX_PRESENCE_LOGS) {
     presenceLogCount++;
   }
+  portEXIT_CRITICAL(&presenceLogLock);
+  publishPresenceLog(logged);
   
   LOG_INFOF("Logged presence change: %s at %s", presenceStr, getCurrentTimeString().c_str());
   
@@ -2585,23 +3797,14 @@ void loadPresenceLogs() {
   if (presenceLogCount > MAX_PRESENCE_LOGS) {
     presenceLogCount = MAX_PRESENCE_LOGS;
   }
+  presenceLogSeq = presenceLogCount;  // Sequence numbers restart with each boot
   
+  char logKey[PRESENCE_LOG_KEY_SIZE];
+  char logData[PRESENCE_LOG_RECORD_SIZE];
   for (uint8_t i = 0; i < presenceLogCount; i++) {
-    String logKey = String(KEY_PRESENCE_LOG_PREFIX) + String(i);
-    String logData = preferences.getString(logKey.c_str(), "");
-    
-    if (logData.length() > 0) {
-      // Parse: timestamp,presence,presenceString
-      int firstComma = logData.indexOf(',');
-      int secondComma = logData.indexOf(',', firstComma + 1);
-      
-      if (firstComma > 0 && secondComma > firstComma) {
-        presenceLogs[i].timestamp = logData.substring(0, firstComma).toInt();
-        presenceLogs[i].presence = (TeamsPresence)logData.substring(firstComma + 1, secondComma).toInt();
-        String presenceStr = logData.substring(secondComma + 1);
-        strncpy(presenceLogs[i].presenceString, presenceStr.c_str(), sizeof(presenceLogs[i].presenceString) - 1);
-        presenceLogs[i].presenceString[sizeof(presenceLogs[i].presenceString) - 1] = '\0';
-      }
+    presenceLogKey(i, logKey);
+    if (preferences.getString(logKey, logData, sizeof(logData)) > 0) {
+      parsePresenceLog(logData, presenceLogs[i]);
     }
   }
   
@@ -2610,60 +3813,141 @@ void loadPresenceLogs() {
 }
 
 void savePresenceLogs() {
+  HeapTraceScope trace(TRACE_SAVE_PRESENCE_HISTORY);
   preferences.putUInt(KEY_PRESENCE_LOG_COUNT, presenceLogCount);
   
   // Save logs in a circular manner - save the most recent entries
   uint8_t startIndex = (presenceLogCount >= MAX_PRESENCE_LOGS) ? presenceLogIndex : 0;
   uint8_t logsToSave = (presenceLogCount >= MAX_PRESENCE_LOGS) ? MAX_PRESENCE_LOGS : presenceLogCount;
   
+  char logKey[PRESENCE_LOG_KEY_SIZE];
+  char logData[PRESENCE_LOG_RECORD_SIZE];
   for (uint8_t i = 0; i < logsToSave; i++) {
     uint8_t logArrayIndex = (startIndex + i) % MAX_PRESENCE_LOGS;
-    String logKey = String(KEY_PRESENCE_LOG_PREFIX) + String(i);
-    String logData = String(presenceLogs[logArrayIndex].timestamp) + "," + 
-                     String(presenceLogs[logArrayIndex].presence) + "," + 
-                     String(presenceLogs[logArrayIndex].presenceString);
-    preferences.putString(logKey.c_str(), logData);
+    presenceLogKey(i, logKey);
+    formatPresenceLog(presenceLogs[logArrayIndex], logData);
+    preferences.putString(logKey, logData);
   }
 }
 
-void handlePresenceHistory() {
-  LOG_DEBUG("Presence history API request received");
+int presenceLogsHeld() {
+  return (presenceLogCount >= MAX_PRESENCE_LOGS) ? MAX_PRESENCE_LOGS : presenceLogCount;
+}
+
+uint32_t lastPresenceLogSeq() {
+  return presenceLogSeq;
+}
+
+// Looks an entry up by seq rather than by position, since positions shift
+// when a change is logged; false once the entry has been overwritten
+bool presenceLogBySeq(uint32_t seq, PresenceLogEntry& out) {
+  portENTER_CRITICAL(&presenceLogLock);
+  int held = presenceLogsHeld();
+  uint32_t oldestSeq = presenceLogSeq - held + 1;
+  bool found = held > 0 && seq >= oldestSeq && seq <= presenceLogSeq;
+  if (found) {
+    uint8_t startIndex = (presenceLogCount >= MAX_PRESENCE_LOGS) ? presenceLogIndex : 0;
+    out = presenceLogs[(startIndex + (seq - oldestSeq)) % MAX_PRESENCE_LOGS];
+  }
+  portEXIT_CRITICAL(&presenceLogLock);
+  return found;
+}
+
+// Logs in chronological order (oldest first), one per step. Entries are
+// read by seq; one overwritten while the response is sent is left out and
+// reported as missed.
+bool producePresenceHistory(JsonChunkWriter& out, size_t step, CursorWindow& window) {
+  StaticJsonDocument<256> doc;
+  if (step == 0) {
+    out.beginObject();
+    out.beginArray("logs");
+    return true;
+  }
   
-  DynamicJsonDocument doc(4096);
-  JsonArray logs = doc.createNestedArray("logs");
+  int position = window.first + step - 1;
+  if (position < window.end) {
+    PresenceLogEntry entry;
+    if (!presenceLogBySeq(window.seqAt(position), entry)) {
+      window.missed = true;
+      return true;
+    }
+    
+    // Format timestamp as ISO string
+    time_t timestamp = entry.timestamp;
+    struct tm* timeInfo = localtime(&timestamp);
+    char timeStr[32];
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", timeInfo);
+    
+    doc["seq"] = window.seqAt(position);
+    doc["timestamp"] = timeStr;
+    doc["presence"] = entry.presenceString;
+    doc["presence_code"] = entry.presence;
+    out.element(doc);
+    return true;
+  }
+  
+  out.endArray();
   
   // Add current time info
   doc["current_time"] = getCurrentTimeString();
   doc["time_configured"] = timeConfigured;
   doc["timezone_offset"] = timezoneOffset;
   doc["daylight_offset"] = daylightOffset;
+  doc["total_logs"] = presenceLogCount;
+  doc["max_logs"] = MAX_PRESENCE_LOGS;
+  fillCursorFooter(doc, window);
+  out.members(doc);
+  out.endObject();
+  return false;
+}
+
+// MessagePack history: each change is [seq, epoch seconds, presence_code];
+// the client formats times itself
+void fillPackedHistoryFooter(JsonDocument& doc, const CursorWindow& window) {
+  doc["time_configured"] = timeConfigured;
+  doc["timezone_offset"] = timezoneOffset;
+  doc["daylight_offset"] = daylightOffset;
+  doc["total_logs"] = presenceLogCount;
+  doc["max_logs"] = MAX_PRESENCE_LOGS;
+  fillCursorFooter(doc, window, true);
+}
+
+bool packPresenceHistory(MsgPackChunkWriter& out, size_t step, CursorWindow& window) {
+  StaticJsonDocument<256> doc;
+  if (step == 0) {
+    fillPackedHistoryFooter(doc, window);
+    out.beginMap(nullptr, 1 + doc.size());
+    out.beginArray("logs", window.end - window.first);
+    return true;
+  }
   
-  // Add logs in chronological order (oldest first)
-  if (presenceLogCount > 0) {
-    uint8_t startIndex = (presenceLogCount >= MAX_PRESENCE_LOGS) ? presenceLogIndex : 0;
-    uint8_t logsToShow = (presenceLogCount >= MAX_PRESENCE_LOGS) ? MAX_PRESENCE_LOGS : presenceLogCount;
-    
-    for (uint8_t i = 0; i < logsToShow; i++) {
-      uint8_t logArrayIndex = (startIndex + i) % MAX_PRESENCE_LOGS;
-      JsonObject logEntry = logs.createNestedObject();
-      
-      // Format timestamp as ISO string
-      time_t timestamp = presenceLogs[logArrayIndex].timestamp;
-      struct tm* timeInfo = localtime(&timestamp);
-      char timeStr[32];
-      strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", timeInfo);
-      
-      logEntry["timestamp"] = timeStr;
-      logEntry["presence"] = presenceLogs[logArrayIndex].presenceString;
-      logEntry["presence_code"] = presenceLogs[logArrayIndex].presence;
+  // The row count is declared up front, so an overwritten entry becomes nil
+  int position = window.first + step - 1;
+  if (position < window.end) {
+    PresenceLogEntry entry;
+    if (presenceLogBySeq(window.seqAt(position), entry)) {
+      JsonArray row = doc.to<JsonArray>();
+      row.add(window.seqAt(position));
+      row.add(entry.timestamp);
+      row.add(entry.presence);
+    } else {
+      window.missed = true;
     }
+    out.element(doc);
+    return true;
   }
   
-  doc["total_logs"] = presenceLogCount;
-  doc["max_logs"] = MAX_PRESENCE_LOGS;
-  
-  String response;
-  serializeJson(doc, response);
-  server.send(200, "application/json", response);
+  fillPackedHistoryFooter(doc, window);
+  out.members(doc);
+  return false;
+}
+
+void handlePresenceHistory(AsyncWebServerRequest* request) {
+  LOG_DEBUG("Presence history API request received");
+  if (wantsMsgPack(request)) {
+    sendCursorRead(request, parseCursorQuery(request), lastPresenceLogSeq, presenceLogsHeld, packPresenceHistory, MSGPACK_CONTENT_TYPE);
+  } else {
+    sendCursorRead(request, parseCursorQuery(request), lastPresenceLogSeq, presenceLogsHeld, producePresenceHistory, "application/json");
+  }
 }
 
@@ -0,0 +1,371 @@
+#include "metrics.h"
+#include "scratch_arena.h"
+#include <WiFi.h>
+#include <cstdarg>
+
+#define METRICS_PREFIX "teamsredlight_"
+
+// Upper bounds of the first eight buckets; the ninth is +Inf
+static const uint32_t BUCKET_BOUNDS[METRICS_BUCKET_COUNT - 1] = {
+  1000, 5000, 25000, 100000, 250000, 1000000, 2500000, 10000000
+};
+static const char* const BUCKET_LABELS[METRICS_BUCKET_COUNT] = {
+  "0.001", "0.005", "0.025", "0.1", "0.25", "1", "2.5", "10", "+Inf"
+};
+
+// Static member initialization
+Metrics::Route Metrics::routeTable[METRICS_MAX_ROUTES];
+int Metrics::routes = 0;
+LatencyHistogram Metrics::graphPollLatency;
+LatencyHistogram Metrics::loopLatency;
+uint32_t Metrics::graphPolls[2];
+uint32_t Metrics::tokenRefreshes[2];
+uint32_t Metrics::wifiReconnects = 0;
+uint32_t Metrics::nvsWrites = 0;
+uint32_t Metrics::httpRejections[2];
+LatencyHistogram Metrics::gzipLatency;
+uint64_t Metrics::gzipBytes[2];
+uint32_t Metrics::keepAliveConnections[2];
+uint32_t Metrics::keepAliveRequests[2];
+uint32_t Metrics::keepAliveOpen = 0;
+uint8_t Metrics::heapPressure = HEAP_NORMAL;
+uint32_t Metrics::heapPressureRaised[HEAP_PRESSURE_LEVELS];
+uint32_t Metrics::heapLowestBlock = 0;
+portMUX_TYPE Metrics::lock = portMUX_INITIALIZER_UNLOCKED;
+char Metrics::fragment[METRICS_FRAGMENT_SIZE];
+size_t Metrics::length = 0;
+size_t Metrics::offset = 0;
+size_t Metrics::section = 0;
+uint32_t Metrics::scrapeTicket = 0;
+uint32_t Metrics::lastTicket = 0;
+unsigned long Metrics::scrapeActivity = 0;
+
+// LatencyHistogram implementation
+void LatencyHistogram::observe(uint32_t micros) {
+  uint8_t bucket = 0;
+  while (bucket < METRICS_BUCKET_COUNT - 1 && micros > BUCKET_BOUNDS[bucket]) {
+    bucket++;
+  }
+  buckets[bucket]++;
+  count++;
+  sumMicros += micros;
+}
+
+// Metrics implementation
+int Metrics::registerRoute(const char* method, const char* path) {
+  if (routes >= METRICS_MAX_ROUTES) {
+    return -1;
+  }
+  Route& route = routeTable[routes];
+  route.method = method;
+  route.path = path;
+  memset(&route.latency, 0, sizeof(route.latency));
+  return routes++;
+}
+
+void Metrics::observeRoute(int route, uint32_t micros) {
+  if (route < 0 || route >= routes) {
+    return;
+  }
+  portENTER_CRITICAL(&lock);
+  routeTable[route].latency.observe(micros);
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeGraphPoll(bool success, uint32_t micros) {
+  portENTER_CRITICAL(&lock);
+  graphPolls[success ? 1 : 0]++;
+  graphPollLatency.observe(micros);
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeLoop(uint32_t micros) {
+  portENTER_CRITICAL(&lock);
+  loopLatency.observe(micros);
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::countTokenRefresh(bool success) {
+  portENTER_CRITICAL(&lock);
+  tokenRefreshes[success ? 1 : 0]++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::countWifiReconnect() {
+  portENTER_CRITICAL(&lock);
+  wifiReconnects++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::countNvsWrite() {
+  portENTER_CRITICAL(&lock);
+  nvsWrites++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::countHttpRejection(bool overloaded) {
+  portENTER_CRITICAL(&lock);
+  httpRejections[overloaded ? 1 : 0]++;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeGzip(size_t inputBytes, size_t outputBytes, uint32_t micros) {
+  portENTER_CRITICAL(&lock);
+  gzipBytes[0] += inputBytes;
+  gzipBytes[1] += outputBytes;
+  gzipLatency.observe(micros);
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeKeepAliveConnection(bool accepted) {
+  portENTER_CRITICAL(&lock);
+  keepAliveConnections[accepted ? 1 : 0]++;
+  if (accepted) {
+    keepAliveOpen++;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeKeepAliveClose() {
+  portENTER_CRITICAL(&lock);
+  if (keepAliveOpen > 0) {
+    keepAliveOpen--;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeHeap(uint8_t pressure, uint32_t lowestLargestBlock) {
+  portENTER_CRITICAL(&lock);
+  if (pressure > heapPressure && pressure < HEAP_PRESSURE_LEVELS) {
+    heapPressureRaised[pressure]++;
+  }
+  heapPressure = pressure;
+  heapLowestBlock = lowestLargestBlock;
+  portEXIT_CRITICAL(&lock);
+}
+
+void Metrics::observeKeepAliveRequest(bool reused) {
+  portENTER_CRITICAL(&lock);
+  keepAliveRequests[reused ? 1 : 0]++;
+  portEXIT_CRITICAL(&lock);
+}
+
+LatencyHistogram Metrics::snapshot(const LatencyHistogram& histogram) {
+  portENTER_CRITICAL(&lock);
+  LatencyHistogram copy = histogram;
+  portEXIT_CRITICAL(&lock);
+  return copy;
+}
+
+LatencyHistogram Metrics::routeHistogram(int route) {
+  return snapshot(routeTable[route].latency);
+}
+
+uint32_t Metrics::beginScrape() {
+  if (scrapeTicket != 0 && millis() - scrapeActivity < METRICS_SCRAPE_TIMEOUT) {
+    return 0;
+  }
+  // Skip 0, which means "no scrape"
+  if (++lastTicket == 0) {
+    lastTicket = 1;
+  }
+  scrapeTicket = lastTicket;
+  scrapeActivity = millis();
+  length = 0;
+  offset = 0;
+  section = 0;
+  return scrapeTicket;
+}
+
+size_t Metrics::fillScrape(uint32_t ticket, uint8_t* buffer, size_t maxLength) {
+  if (ticket != scrapeTicket) {
+    return 0;  // Abandoned and taken over by a newer scrape
+  }
+  scrapeActivity = millis();
+
+  size_t written = 0;
+  while (written < maxLength) {
+    if (offset == length) {
+      length = 0;
+      offset = 0;
+      if (!renderSection(section++)) {
+        scrapeTicket = 0;
+        break;
+      }
+      continue;
+    }
+    size_t count = min(length - offset, maxLength - written);
+    memcpy(buffer + written, fragment + offset, count);
+    offset += count;
+    written += count;
+  }
+  return written;
+}
+
+void Metrics::appendf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(fragment + length, sizeof(fragment) - length, format, args);
+  va_end(args);
+  if (n > 0) {
+    length = min(length + (size_t)n, sizeof(fragment) - 1);
+  }
+}
+
+void Metrics::appendHistogram(const char* name, const char* labels, const LatencyHistogram& histogram) {
+  const char* comma = labels[0] ? "," : "";
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < METRICS_BUCKET_COUNT; i++) {
+    cumulative += histogram.buckets[i];
+    appendf(METRICS_PREFIX "%s_bucket{%s%sle=\"%s\"} %u\n", name, labels, comma, BUCKET_LABELS[i], (unsigned)cumulative);
+  }
+  const char* open = labels[0] ? "{" : "";
+  const char* close = labels[0] ? "}" : "";
+  appendf(METRICS_PREFIX "%s_sum%s%s%s %llu.%06llu\n", name, open, labels, close,
+          histogram.sumMicros / 1000000ULL, histogram.sumMicros % 1000000ULL);
+  appendf(METRICS_PREFIX "%s_count%s%s%s %u\n", name, open, labels, close, (unsigned)histogram.count);
+}
+
+// One section per call: device gauges, counters, the Graph poll, loop and
+// compression histograms, keep-alive connections, scratch memory, then one
+// request histogram per route
+bool Metrics::renderSection(size_t index) {
+  if (index == 0) {
+    appendf("# HELP " METRICS_PREFIX "uptime_seconds Time since boot.\n"
+            "# TYPE " METRICS_PREFIX "uptime_seconds gauge\n"
+            METRICS_PREFIX "uptime_seconds %lu\n", millis() / 1000);
+    appendf("# HELP " METRICS_PREFIX "heap_free_bytes Free heap.\n"
+            "# TYPE " METRICS_PREFIX "heap_free_bytes gauge\n"
+            METRICS_PREFIX "heap_free_bytes %u\n", (unsigned)ESP.getFreeHeap());
+    appendf("# HELP " METRICS_PREFIX "heap_largest_free_block_bytes Largest block the heap can allocate.\n"
+            "# TYPE " METRICS_PREFIX "heap_largest_free_block_bytes gauge\n"
+            METRICS_PREFIX "heap_largest_free_block_bytes %u\n", (unsigned)ESP.getMaxAllocHeap());
+    appendf("# HELP " METRICS_PREFIX "heap_min_free_bytes Lowest free heap since boot.\n"
+            "# TYPE " METRICS_PREFIX "heap_min_free_bytes gauge\n"
+            METRICS_PREFIX "heap_min_free_bytes %u\n", (unsigned)ESP.getMinFreeHeap());
+    portENTER_CRITICAL(&lock);
+    uint8_t pressure = heapPressure;
+    uint32_t lowestBlock = heapLowestBlock;
+    portEXIT_CRITICAL(&lock);
+    appendf("# HELP " METRICS_PREFIX "heap_min_largest_free_block_bytes Smallest largest free block seen since boot.\n"
+            "# TYPE " METRICS_PREFIX "heap_min_largest_free_block_bytes gauge\n"
+            METRICS_PREFIX "heap_min_largest_free_block_bytes %u\n", (unsigned)lowestBlock);
+    appendf("# HELP " METRICS_PREFIX "heap_pressure_level Load shedding level, 0 (normal) to 4 (refusing requests).\n"
+            "# TYPE " METRICS_PREFIX "heap_pressure_level gauge\n"
+            METRICS_PREFIX "heap_pressure_level %u\n", (unsigned)pressure);
+    if (WiFi.status() == WL_CONNECTED) {
+      appendf("# HELP " METRICS_PREFIX "wifi_rssi_dbm Signal strength of the access point.\n"
+              "# TYPE " METRICS_PREFIX "wifi_rssi_dbm gauge\n"
+              METRICS_PREFIX "wifi_rssi_dbm %d\n", (int)WiFi.RSSI());
+    }
+    return true;
+  }
+  if (index == 1) {
+    portENTER_CRITICAL(&lock);
+    uint32_t polls[2] = {graphPolls[0], graphPolls[1]};
+    uint32_t refreshes[2] = {tokenRefreshes[0], tokenRefreshes[1]};
+    uint32_t reconnects = wifiReconnects;
+    uint32_t writes = nvsWrites;
+    uint32_t rejections[2] = {httpRejections[0], httpRejections[1]};
+    uint32_t raised[HEAP_PRESSURE_LEVELS];
+    memcpy(raised, heapPressureRaised, sizeof(raised));
+    portEXIT_CRITICAL(&lock);
+
+    appendf("# HELP " METRICS_PREFIX "wifi_reconnects_total Connections regained after losing WiFi.\n"
+            "# TYPE " METRICS_PREFIX "wifi_reconnects_total counter\n"
+            METRICS_PREFIX "wifi_reconnects_total %u\n", (unsigned)reconnects);
+    appendf("# HELP " METRICS_PREFIX "nvs_writes_total Preferences writes and removals.\n"
+            "# TYPE " METRICS_PREFIX "nvs_writes_total counter\n"
+            METRICS_PREFIX "nvs_writes_total %u\n", (unsigned)writes);
+    appendf("# HELP " METRICS_PREFIX "graph_polls_total Presence polls of Microsoft Graph.\n"
+            "# TYPE " METRICS_PREFIX "graph_polls_total counter\n"
+            METRICS_PREFIX "graph_polls_total{result=\"success\"} %u\n"
+            METRICS_PREFIX "graph_polls_total{result=\"failure\"} %u\n", (unsigned)polls[1], (unsigned)polls[0]);
+    appendf("# HELP " METRICS_PREFIX "token_refreshes_total Access token requests.\n"
+            "# TYPE " METRICS_PREFIX "token_refreshes_total counter\n"
+            METRICS_PREFIX "token_refreshes_total{result=\"success\"} %u\n"
+            METRICS_PREFIX "token_refreshes_total{result=\"failure\"} %u\n", (unsigned)refreshes[1], (unsigned)refreshes[0]);
+    appendf("# HELP " METRICS_PREFIX "http_rejections_total Web requests turned away by admission control.\n"
+            "# TYPE " METRICS_PREFIX "http_rejections_total counter\n"
+            METRICS_PREFIX "http_rejections_total{reason=\"rate_limited\"} %u\n"
+            METRICS_PREFIX "http_rejections_total{reason=\"overloaded\"} %u\n", (unsigned)rejections[0], (unsigned)rejections[1]);
+    appendf("# HELP " METRICS_PREFIX "heap_pressure_raised_total Times heap pressure rose to a load shedding level.\n"
+            "# TYPE " METRICS_PREFIX "heap_pressure_raised_total counter\n");
+    for (uint8_t i = HEAP_DEFER_FETCHES; i < HEAP_PRESSURE_LEVELS; i++) {
+      appendf(METRICS_PREFIX "heap_pressure_raised_total{level=\"%s\"} %u\n",
+              HeapGovernor::levelName((HeapPressure)i), (unsigned)raised[i]);
+    }
+    return true;
+  }
+  if (index == 2) {
+    appendf("# HELP " METRICS_PREFIX "graph_poll_duration_seconds Time taken by presence polls.\n"
+            "# TYPE " METRICS_PREFIX "graph_poll_duration_seconds histogram\n");
+    appendHistogram("graph_poll_duration_seconds", "", snapshot(graphPollLatency));
+    return true;
+  }
+  if (index == 3) {
+    appendf("# HELP " METRICS_PREFIX "loop_duration_seconds Time spent in one loop() iteration, excluding its delay.\n"
+            "# TYPE " METRICS_PREFIX "loop_duration_seconds histogram\n");
+    appendHistogram("loop_duration_seconds", "", snapshot(loopLatency));
+    return true;
+  }
+  if (index == 4) {
+    portENTER_CRITICAL(&lock);
+    uint64_t bytes[2] = {gzipBytes[0], gzipBytes[1]};
+    portEXIT_CRITICAL(&lock);
+
+    appendf("# HELP " METRICS_PREFIX "gzip_input_bytes_total Response bytes before compression.\n"
+            "# TYPE " METRICS_PREFIX "gzip_input_bytes_total counter\n"
+            METRICS_PREFIX "gzip_input_bytes_total %llu\n", (unsigned long long)bytes[0]);
+    appendf("# HELP " METRICS_PREFIX "gzip_output_bytes_total Response bytes sent after compression.\n"
+            "# TYPE " METRICS_PREFIX "gzip_output_bytes_total counter\n"
+            METRICS_PREFIX "gzip_output_bytes_total %llu\n", (unsigned long long)bytes[1]);
+    appendf("# HELP " METRICS_PREFIX "gzip_duration_seconds CPU time spent compressing one response.\n"
+            "# TYPE " METRICS_PREFIX "gzip_duration_seconds histogram\n");
+    appendHistogram("gzip_duration_seconds", "", snapshot(gzipLatency));
+    return true;
+  }
+  if (index == 5) {
+    portENTER_CRITICAL(&lock);
+    uint32_t connections[2] = {keepAliveConnections[0], keepAliveConnections[1]};
+    uint32_t requests[2] = {keepAliveRequests[0], keepAliveRequests[1]};
+    uint32_t open = keepAliveOpen;
+    portEXIT_CRITICAL(&lock);
+
+    appendf("# HELP " METRICS_PREFIX "keepalive_connections_open Open connections on the keep-alive port.\n"
+            "# TYPE " METRICS_PREFIX "keepalive_connections_open gauge\n"
+            METRICS_PREFIX "keepalive_connections_open %u\n", (unsigned)open);
+    appendf("# HELP " METRICS_PREFIX "keepalive_connections_total Connections to the keep-alive port.\n"
+            "# TYPE " METRICS_PREFIX "keepalive_connections_total counter\n"
+            METRICS_PREFIX "keepalive_connections_total{result=\"accepted\"} %u\n"
+            METRICS_PREFIX "keepalive_connections_total{result=\"refused\"} %u\n", (unsigned)connections[1], (unsigned)connections[0]);
+    appendf("# HELP " METRICS_PREFIX "keepalive_requests_total Requests on the keep-alive port, by whether the connection was reused.\n"
+            "# TYPE " METRICS_PREFIX "keepalive_requests_total counter\n"
+            METRICS_PREFIX "keepalive_requests_total{connection=\"new\"} %u\n"
+            METRICS_PREFIX "keepalive_requests_total{connection=\"reused\"} %u\n", (unsigned)requests[0], (unsigned)requests[1]);
+    return true;
+  }
+  if (index == 6) {
+    appendf("# HELP " METRICS_PREFIX "scratch_arena_high_water_bytes Most scratch memory one request or call has used.\n"
+            "# TYPE " METRICS_PREFIX "scratch_arena_high_water_bytes gauge\n"
+            METRICS_PREFIX "scratch_arena_high_water_bytes %u\n", (unsigned)ScratchArena::poolHighWater());
+    appendf("# HELP " METRICS_PREFIX "scratch_arena_fallbacks_total Scratch strings that did not fit an arena and used the heap.\n"
+            "# TYPE " METRICS_PREFIX "scratch_arena_fallbacks_total counter\n"
+            METRICS_PREFIX "scratch_arena_fallbacks_total %u\n", (unsigned)ScratchArena::fallbacks());
+    return true;
+  }
+  if (index == 7) {
+    appendf("# HELP " METRICS_PREFIX "http_request_duration_seconds Time spent in web request handlers.\n"
+            "# TYPE " METRICS_PREFIX "http_request_duration_seconds histogram\n");
+    return true;
+  }
+
+  size_t route = index - 8;
+  if (route >= (size_t)routes) {
+    return false;
+  }
+  char labels[96];
+  snprintf(labels, sizeof(labels), "method=\"%s\",path=\"%s\"", routeTable[route].method, routeTable[route].path);
+  appendHistogram("http_request_duration_seconds", labels, snapshot(routeTable[route].latency));
+  return true;
+}
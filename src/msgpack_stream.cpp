@@ -0,0 +1,115 @@
+#include "msgpack_stream.h"
+#include "logging.h"
+
+MsgPackChunkWriter::MsgPackChunkWriter(const Producer& producer) : producer(producer) {
+}
+
+size_t MsgPackChunkWriter::fill(uint8_t* buffer, size_t maxLength) {
+  size_t written = 0;
+  while (written < maxLength) {
+    if (offset == length) {
+      if (done) {
+        break;
+      }
+      length = 0;
+      offset = 0;
+      done = !producer(*this, step++);
+      continue;
+    }
+    size_t count = min(length - offset, maxLength - written);
+    memcpy(buffer + written, fragment + offset, count);
+    offset += count;
+    written += count;
+  }
+  return written;
+}
+
+void MsgPackChunkWriter::writeTo(String& out) {
+  uint8_t buffer[64];
+  size_t written;
+  while ((written = fill(buffer, sizeof(buffer))) > 0) {
+    out.concat((const char*)buffer, written);
+  }
+}
+
+bool MsgPackChunkWriter::append(const uint8_t* data, size_t dataLength) {
+  if (length + dataLength > sizeof(fragment)) {
+    return false;
+  }
+  memcpy(fragment + length, data, dataLength);
+  length += dataLength;
+  return true;
+}
+
+// fixmap/fixarray below 16 entries, map16/array16 above
+void MsgPackChunkWriter::header(uint8_t fixBase, uint8_t wide, size_t count) {
+  if (count < 16) {
+    uint8_t byte = fixBase | count;
+    append(&byte, 1);
+    return;
+  }
+  uint8_t bytes[3] = {wide, (uint8_t)(count >> 8), (uint8_t)count};
+  append(bytes, sizeof(bytes));
+}
+
+// Keys are short literals from our own code (fixstr, under 32 bytes)
+void MsgPackChunkWriter::key(const char* key) {
+  size_t keyLength = strlen(key);
+  uint8_t prefix = 0xa0 | keyLength;
+  append(&prefix, 1);
+  append((const uint8_t*)key, keyLength);
+}
+
+void MsgPackChunkWriter::beginMap(const char* key, size_t count) {
+  if (key != nullptr) {
+    this->key(key);
+  }
+  header(0x80, 0xde, count);
+}
+
+void MsgPackChunkWriter::beginArray(const char* key, size_t count) {
+  if (key != nullptr) {
+    this->key(key);
+  }
+  header(0x90, 0xdc, count);
+}
+
+void MsgPackChunkWriter::members(const JsonDocument& doc) {
+  size_t size = measureMsgPack(doc);
+  size_t skip = headerSize(doc.size());
+  if (size <= skip) {
+    return;  // Empty object
+  }
+  if (length + size > sizeof(fragment)) {
+    // The enclosing map already counted these members, so each keeps its
+    // key with a nil value rather than leaving the map short
+    droppedValues++;
+    LOG_WARNF("Wrote nil for %u bytes of MessagePack members that exceed the stream fragment", (unsigned)size);
+    uint8_t nil = 0xc0;
+    for (JsonPairConst member : doc.as<JsonObjectConst>()) {
+      key(member.key().c_str());
+      append(&nil, 1);
+    }
+    return;
+  }
+
+  // Serialize the map in place, then drop its header: the enclosing map
+  // already counted these members
+  uint8_t* start = fragment + length;
+  serializeMsgPack(doc, start, sizeof(fragment) - length);
+  memmove(start, start + skip, size - skip);
+  length += size - skip;
+}
+
+void MsgPackChunkWriter::element(const JsonDocument& doc) {
+  size_t size = measureMsgPack(doc);
+  if (length + size > sizeof(fragment)) {
+    droppedValues++;
+    LOG_WARNF("Wrote nil for a %u byte MessagePack element that exceeds the stream fragment", (unsigned)size);
+    uint8_t nil = 0xc0;
+    append(&nil, 1);
+    return;
+  }
+  serializeMsgPack(doc, fragment + length, sizeof(fragment) - length);
+  length += size;
+}
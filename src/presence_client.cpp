@@ -0,0 +1,247 @@
+#include "presence_client.h"
+#include "scratch_arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+void PresenceResponse::reset() {
+  state = STATUS_LINE;
+  statusCode = 0;
+  keepConnection = false;
+  chunked = false;
+  bodyDropped = false;
+  remaining = -1;
+  lineUsed = 0;
+  bodyUsed = 0;
+  bodyText[0] = '\0';
+}
+
+size_t PresenceResponse::feed(const char* data, size_t length) {
+  size_t used = 0;
+  while (used < length && state != DONE && state != FAILED) {
+    if (state == BODY || state == CHUNK_DATA) {
+      size_t take = length - used;
+      if (remaining >= 0 && (size_t)remaining < take) {
+        take = remaining;
+      }
+      keepBody(data + used, take);
+      used += take;
+      if (remaining >= 0) {
+        remaining -= take;
+        if (remaining == 0) {
+          state = (state == BODY) ? DONE : CHUNK_END;
+        }
+      }
+      continue;
+    }
+
+    char c = data[used++];
+    if (c == '\n') {
+      if (lineUsed > 0 && line[lineUsed - 1] == '\r') {
+        lineUsed--;
+      }
+      line[lineUsed] = '\0';
+      endLine();
+      lineUsed = 0;
+    } else if (lineUsed < sizeof(line) - 1) {
+      line[lineUsed++] = c;
+    }
+  }
+  return used;
+}
+
+void PresenceResponse::finish() {
+  if (state == BODY && remaining < 0) {
+    state = DONE;
+  } else if (state != DONE) {
+    state = FAILED;
+  }
+  keepConnection = false;
+}
+
+void PresenceResponse::endLine() {
+  switch (state) {
+    case STATUS_LINE: {
+      // "HTTP/1.1 200 OK"
+      if (strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ') {
+        state = FAILED;
+        return;
+      }
+      char* end;
+      statusCode = strtol(line + 9, &end, 10);
+      if (end == line + 9) {
+        state = FAILED;
+        return;
+      }
+      keepConnection = line[7] != '0';
+      state = HEADERS;
+      break;
+    }
+    case HEADERS: {
+      if (lineUsed == 0) {
+        endHeaders();
+        return;
+      }
+      char* colon = strchr(line, ':');
+      if (colon == nullptr) {
+        state = FAILED;
+        return;
+      }
+      *colon = '\0';
+      const char* value = colon + 1;
+      while (*value == ' ' || *value == '\t') {
+        value++;
+      }
+      header(line, value);
+      break;
+    }
+    case CHUNK_SIZE: {
+      char* end;
+      unsigned long size = strtoul(line, &end, 16);
+      if (end == line) {
+        state = FAILED;
+        return;
+      }
+      remaining = size;
+      state = (size == 0) ? TRAILERS : CHUNK_DATA;
+      break;
+    }
+    case CHUNK_END:
+      state = (lineUsed == 0) ? CHUNK_SIZE : FAILED;
+      break;
+    case TRAILERS:
+      if (lineUsed == 0) {
+        state = DONE;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void PresenceResponse::header(const char* name, const char* value) {
+  if (strcasecmp(name, "Content-Length") == 0) {
+    remaining = strtol(value, nullptr, 10);
+  } else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+    chunked = strcasecmp(value, "chunked") == 0;
+  } else if (strcasecmp(name, "Connection") == 0) {
+    if (strcasecmp(value, "close") == 0) {
+      keepConnection = false;
+    } else if (strcasecmp(value, "keep-alive") == 0) {
+      keepConnection = true;
+    }
+  }
+}
+
+void PresenceResponse::endHeaders() {
+  if (statusCode >= 100 && statusCode < 200) {
+    // Interim response; the real one follows on the same connection
+    reset();
+    return;
+  }
+  if (statusCode == 204 || statusCode == 304) {
+    state = DONE;
+  } else if (chunked) {
+    remaining = -1;
+    state = CHUNK_SIZE;
+  } else if (remaining == 0) {
+    state = DONE;
+  } else {
+    if (remaining < 0) {
+      keepConnection = false;  // Only the close ends this body
+    }
+    state = BODY;
+  }
+}
+
+void PresenceResponse::keepBody(const char* data, size_t length) {
+  size_t room = PRESENCE_BODY_SIZE - bodyUsed;
+  if (length > room) {
+    bodyDropped = true;
+    length = room;
+  }
+  memcpy(bodyText + bodyUsed, data, length);
+  bodyUsed += length;
+  bodyText[bodyUsed] = '\0';
+}
+
+DeserializationError PresenceResponse::parsePresence(const char* body, size_t length, GraphPresence& out) {
+  StaticJsonDocument<64> filter;
+  filter["availability"] = true;
+  filter["activity"] = true;
+
+  StaticJsonDocument<192> doc;
+  DeserializationError error = deserializeJson(doc, body, length, DeserializationOption::Filter(filter));
+  strlcpy(out.availability, doc["availability"] | "", sizeof(out.availability));
+  strlcpy(out.activity, doc["activity"] | "", sizeof(out.activity));
+  return error;
+}
+
+int PresenceClient::fetch(const String& accessToken) {
+  // A kept connection may have been closed by Graph since the last poll,
+  // which only shows when it is used; that case gets one fresh connection
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused = client.connected();
+    if (!reused) {
+      client.setInsecure();  // Same as the other Graph calls
+      if (!client.connect(PRESENCE_HOST, 443)) {
+        return -1;
+      }
+    }
+    if (exchange(accessToken)) {
+      if (!keepAlive || !reply.keepAlive()) {
+        client.stop();
+      }
+      return reply.status();
+    }
+    client.stop();
+    if (!reused) {
+      break;
+    }
+  }
+  return -1;
+}
+
+bool PresenceClient::exchange(const String& accessToken) {
+  {
+    ScratchScope scratch;
+    ScratchString request(scratch, accessToken.length() + 160);
+    request.append("GET " PRESENCE_PATH " HTTP/1.1\r\nHost: " PRESENCE_HOST "\r\nAuthorization: Bearer ")
+           .append(accessToken)
+           .append("\r\nUser-Agent: TeamsRedLight/1.0\r\nAccept: application/json\r\n\r\n");
+    if (request.truncated() || client.write(request.bytes(), request.length()) != request.length()) {
+      return false;
+    }
+  }
+
+  reply.reset();
+  uint8_t chunk[256];
+  unsigned long start = millis();
+  while (!reply.done() && !reply.failed()) {
+    int available = client.available();
+    if (available > 0) {
+      int got = client.read(chunk, min(available, (int)sizeof(chunk)));
+      if (got > 0) {
+        reply.feed((const char*)chunk, got);
+      }
+    } else if (!client.connected()) {
+      reply.finish();
+    } else if (millis() - start > PRESENCE_TIMEOUT) {
+      return false;
+    } else {
+      delay(1);
+    }
+  }
+  return reply.done();
+}
+
+void PresenceClient::setKeepAlive(bool keep) {
+  keepAlive = keep;
+  if (!keep) {
+    stop();
+  }
+}
+
+void PresenceClient::stop() {
+  client.stop();
+}
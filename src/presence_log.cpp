@@ -0,0 +1,32 @@
+#include "presence_log.h"
+#include <cstdlib>
+#include <cstring>
+
+void presenceLogKey(uint8_t position, char (&key)[PRESENCE_LOG_KEY_SIZE]) {
+  snprintf(key, sizeof(key), KEY_PRESENCE_LOG_PREFIX "%u", position);
+}
+
+size_t formatPresenceLog(const PresenceLogEntry& entry, char (&record)[PRESENCE_LOG_RECORD_SIZE]) {
+  // Seconds fit 32 bits until 2106, and integer formatting stays off the heap
+  int length = snprintf(record, sizeof(record), "%lu,%d,%s",
+                        (unsigned long)entry.timestamp, (int)entry.presence, entry.presenceString);
+  return length < 0 ? 0 : min((size_t)length, sizeof(record) - 1);
+}
+
+bool parsePresenceLog(const char* record, PresenceLogEntry& entry) {
+  char* end;
+  unsigned long timestamp = strtoul(record, &end, 10);
+  if (end == record || *end != ',') {
+    return false;
+  }
+  const char* code = end + 1;
+  long presence = strtol(code, &end, 10);
+  if (end == code || *end != ',') {
+    return false;
+  }
+
+  entry.timestamp = (time_t)timestamp;
+  entry.presence = (TeamsPresence)presence;
+  strlcpy(entry.presenceString, end + 1, sizeof(entry.presenceString));
+  return true;
+}
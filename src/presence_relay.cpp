@@ -0,0 +1,303 @@
+#include "presence_relay.h"
+#include <ArduinoJson.h>
+#include "logging.h"
+
+// SseParser implementation
+void SseParser::reset() {
+  lineLength = 0;
+  eventName[0] = '\0';
+  dataLength = 0;
+  hasData = false;
+}
+
+void SseParser::feed(char c, const EventHandler& onEvent) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    // Overlong lines are truncated rather than split into bogus fields
+    if (lineLength + 1 < sizeof(line)) {
+      line[lineLength++] = c;
+    }
+    return;
+  }
+  line[lineLength] = '\0';
+  processLine(onEvent);
+  lineLength = 0;
+}
+
+void SseParser::processLine(const EventHandler& onEvent) {
+  if (lineLength == 0) {
+    // Blank line terminates the event
+    if (hasData) {
+      data[dataLength] = '\0';
+      onEvent(eventName[0] ? eventName : "message", data);
+    }
+    eventName[0] = '\0';
+    dataLength = 0;
+    hasData = false;
+    return;
+  }
+
+  if (line[0] == ':') {
+    return; // Comment / heartbeat
+  }
+
+  char* value = strchr(line, ':');
+  if (value != nullptr) {
+    *value++ = '\0';
+    if (*value == ' ') {
+      value++;
+    }
+  } else {
+    value = line + lineLength; // Field with empty value
+  }
+
+  if (strcmp(line, "event") == 0) {
+    strlcpy(eventName, value, sizeof(eventName));
+  } else if (strcmp(line, "data") == 0) {
+    // Multiple data lines are joined with newlines
+    if (hasData && dataLength + 1 < sizeof(data)) {
+      data[dataLength++] = '\n';
+    }
+    size_t length = strlen(value);
+    if (length > sizeof(data) - 1 - dataLength) {
+      length = sizeof(data) - 1 - dataLength;
+    }
+    memcpy(data + dataLength, value, length);
+    dataLength += length;
+    hasData = true;
+  }
+  // id and retry fields are not used
+}
+
+// PresenceRelay implementation
+static String urlEncode(const String& value) {
+  static const char hex[] = "0123456789ABCDEF";
+  String encoded;
+  for (size_t i = 0; i < value.length(); i++) {
+    char c = value[i];
+    if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      encoded += c;
+    } else {
+      encoded += '%';
+      encoded += hex[((uint8_t)c) >> 4];
+      encoded += hex[((uint8_t)c) & 0x0F];
+    }
+  }
+  return encoded;
+}
+
+bool PresenceRelay::begin(const String& url, const String& user, const String& key, PresenceHandler handler) {
+  stop();
+  if (!parseUrl(url, user)) {
+    LOG_ERRORF("Invalid presence relay URL: %s", url.c_str());
+    return false;
+  }
+  authorization = key.length() > 0 ? "Authorization: Bearer " + key + "\r\n" : "";
+  if (authorization.length() == 0) {
+    LOG_WARN("Presence relay has no key configured - the stream is unauthenticated");
+  }
+
+  onPresence = handler;
+  enabled = true;
+  nextAttempt = millis();
+  reconnectDelay = RELAY_RECONNECT_MIN_DELAY;
+  LOG_INFOF("Presence relay enabled: %s://%s:%d%s", secure ? "https" : "http", host.c_str(), port, path.c_str());
+  return true;
+}
+
+void PresenceRelay::stop() {
+  if (client != nullptr) {
+    client->stop();
+  }
+  state = RELAY_IDLE;
+  enabled = false;
+}
+
+bool PresenceRelay::parseUrl(const String& url, const String& user) {
+  String rest;
+  if (url.startsWith("https://")) {
+    secure = true;
+    port = 443;
+    rest = url.substring(8);
+  } else if (url.startsWith("http://")) {
+    secure = false;
+    port = 80;
+    rest = url.substring(7);
+  } else {
+    return false;
+  }
+
+  int slash = rest.indexOf('/');
+  String hostPort = slash >= 0 ? rest.substring(0, slash) : rest;
+  path = slash >= 0 ? rest.substring(slash) : "/";
+
+  int colon = hostPort.indexOf(':');
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = hostPort.substring(colon + 1).toInt();
+  } else {
+    host = hostPort;
+  }
+
+  if (user.length() > 0) {
+    path += path.indexOf('?') >= 0 ? "&user=" : "?user=";
+    path += urlEncode(user);
+  }
+
+  return host.length() > 0 && port != 0;
+}
+
+void PresenceRelay::loop() {
+  if (!enabled) {
+    return;
+  }
+
+  if (WiFi.status() != WL_CONNECTED) {
+    if (state != RELAY_IDLE) {
+      disconnect("WiFi disconnected");
+    }
+    return;
+  }
+
+  if (state == RELAY_IDLE) {
+    if ((long)(millis() - nextAttempt) >= 0) {
+      connect();
+    }
+    return;
+  }
+
+  // Bounded read per iteration so LED updates are never starved
+  int budget = RELAY_READ_BUDGET;
+  while (budget-- > 0 && client->available() > 0) {
+    int c = client->read();
+    if (c < 0) {
+      break;
+    }
+    lastActivity = millis();
+    if (state == RELAY_READING_HEADERS) {
+      readHeaderByte((char)c);
+      if (state == RELAY_IDLE) {
+        return; // Rejected by the relay
+      }
+    } else {
+      parser.feed((char)c, [this](const char* event, const char* data) {
+        handleEvent(event, data);
+      });
+    }
+  }
+
+  if (!client->connected() && client->available() == 0) {
+    disconnect("connection closed by relay");
+  } else if (millis() - lastActivity > RELAY_IDLE_TIMEOUT) {
+    disconnect("no heartbeat received");
+  }
+}
+
+bool PresenceRelay::connect() {
+  LOG_DEBUGF("Connecting to presence relay %s:%d", host.c_str(), port);
+
+  bool connected;
+  if (secure) {
+    secureClient.setInsecure(); // Same policy as the Graph connections
+    secureClient.setHandshakeTimeout(RELAY_HANDSHAKE_TIMEOUT);
+    connected = secureClient.connect(host.c_str(), port, RELAY_CONNECT_TIMEOUT);
+    client = &secureClient;
+  } else {
+    connected = plainClient.connect(host.c_str(), port, RELAY_CONNECT_TIMEOUT);
+    client = &plainClient;
+  }
+
+  // A failed connect goes through disconnect() too, so an unreachable relay
+  // is retried with the same backoff instead of blocking every loop()
+  if (!connected) {
+    disconnect("connect failed");
+    return false;
+  }
+
+  // HTTP/1.0 keeps the event stream free of chunked framing
+  client->print("GET " + path + " HTTP/1.0\r\n" +
+                "Host: " + host + "\r\n" +
+                "Accept: text/event-stream\r\n" +
+                "Cache-Control: no-cache\r\n" +
+                authorization +
+                "User-Agent: TeamsRedLight/1.0\r\n\r\n");
+
+  state = RELAY_READING_HEADERS;
+  headerLength = 0;
+  statusSeen = false;
+  statusOk = false;
+  parser.reset();
+  lastActivity = millis();
+  return true;
+}
+
+void PresenceRelay::disconnect(const char* reason) {
+  if (client != nullptr) {
+    client->stop();
+  }
+  bool wasStreaming = state == RELAY_STREAMING;
+  state = RELAY_IDLE;
+
+  if (wasStreaming) {
+    reconnectCount++;
+    reconnectDelay = RELAY_RECONNECT_MIN_DELAY;
+  }
+  LOG_WARNF("Presence relay disconnected (%s), retrying in %lu seconds - falling back to polling", reason, reconnectDelay / 1000);
+  nextAttempt = millis() + reconnectDelay;
+  reconnectDelay = min(reconnectDelay * 2, (unsigned long)RELAY_RECONNECT_MAX_DELAY);
+}
+
+void PresenceRelay::readHeaderByte(char c) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    if (headerLength + 1 < sizeof(headerLine)) {
+      headerLine[headerLength++] = c;
+    }
+    return;
+  }
+  headerLine[headerLength] = '\0';
+
+  if (!statusSeen) {
+    statusSeen = true;
+    statusOk = strncmp(headerLine, "HTTP/1.", 7) == 0 && strstr(headerLine, " 200") != nullptr;
+    if (!statusOk) {
+      LOG_ERRORF("Presence relay rejected stream: %s", headerLine);
+    }
+  } else if (headerLength == 0) {
+    // End of headers
+    if (statusOk) {
+      state = RELAY_STREAMING;
+      reconnectDelay = RELAY_RECONNECT_MIN_DELAY;
+      LOG_INFO("Presence relay connected - receiving push updates");
+    } else {
+      disconnect("relay rejected stream");
+    }
+  }
+  headerLength = 0;
+}
+
+void PresenceRelay::handleEvent(const char* event, const char* data) {
+  if (strcmp(event, "presence") != 0) {
+    LOG_DEBUGF("Ignoring relay event: %s", event);
+    return;
+  }
+
+  StaticJsonDocument<256> doc;
+  DeserializationError error = deserializeJson(doc, data);
+  if (error) {
+    LOG_ERRORF("Failed to parse relay presence event: %s", error.c_str());
+    return;
+  }
+
+  const char* availability = doc["availability"] | "";
+  const char* activity = doc["activity"] | "";
+  eventCount++;
+  LOG_DEBUGF("Relay presence event - Availability: %s, Activity: %s", availability, activity);
+  if (onPresence) {
+    onPresence(availability, activity);
+  }
+}
@@ -0,0 +1,204 @@
+#include "scratch_arena.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ARDUINO
+static portMUX_TYPE poolLock = portMUX_INITIALIZER_UNLOCKED;
+#define POOL_LOCK() portENTER_CRITICAL(&poolLock)
+#define POOL_UNLOCK() portEXIT_CRITICAL(&poolLock)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+#define SCRATCH_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
+static uint8_t poolMemory[SCRATCH_ARENA_COUNT][SCRATCH_ARENA_SIZE] __attribute__((aligned(4)));
+static ScratchArena pool[SCRATCH_ARENA_COUNT];
+static uint32_t freeArenas = (1u << SCRATCH_ARENA_COUNT) - 1;  // One bit per arena not lent out
+
+volatile uint32_t ScratchArena::fallbackCount = 0;
+
+void* ScratchArena::allocate(size_t length) {
+  size_t start = SCRATCH_ALIGN(offset);
+  if (memory == nullptr || length > size || start > size - length) {
+    return nullptr;
+  }
+  lastBlock = start;
+  offset = start + length;
+  if (offset > peak) {
+    peak = offset;
+  }
+  return memory + start;
+}
+
+bool ScratchArena::extend(void* block, size_t length) {
+  if (block != memory + lastBlock || offset == 0 || length > size - lastBlock) {
+    return false;
+  }
+  if (lastBlock + length > offset) {
+    offset = lastBlock + length;
+    if (offset > peak) {
+      peak = offset;
+    }
+  }
+  return true;
+}
+
+ScratchArena* ScratchArena::borrow() {
+  POOL_LOCK();
+  if (freeArenas == 0) {
+    POOL_UNLOCK();
+    return nullptr;
+  }
+  int index = __builtin_ctz(freeArenas);
+  freeArenas &= ~(1u << index);
+  POOL_UNLOCK();
+
+  ScratchArena& arena = pool[index];
+  arena.memory = poolMemory[index];
+  arena.size = SCRATCH_ARENA_SIZE;
+  arena.reset();
+  return &arena;
+}
+
+void ScratchArena::release(ScratchArena* arena) {
+  if (arena == nullptr) {
+    return;
+  }
+  arena->reset();
+  POOL_LOCK();
+  freeArenas |= 1u << (arena - pool);
+  POOL_UNLOCK();
+}
+
+uint8_t ScratchArena::available() {
+  return __builtin_popcount(freeArenas);
+}
+
+size_t ScratchArena::poolHighWater() {
+  size_t highest = 0;
+  for (uint8_t i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+    if (pool[i].peak > highest) {
+      highest = pool[i].peak;
+    }
+  }
+  return highest;
+}
+
+// ScratchString implementation
+ScratchString::ScratchString(ScratchArena* arena, size_t reserve) : arena(arena) {
+  this->reserve(reserve);
+}
+
+ScratchString::~ScratchString() {
+  if (heap) {
+    free(data);
+  }
+}
+
+ScratchString& ScratchString::append(const char* text) {
+  return text ? append(text, strlen(text)) : *this;
+}
+
+ScratchString& ScratchString::append(const char* text, size_t length) {
+  if (length == 0 || !reserve(used + length)) {
+    return *this;
+  }
+  memcpy(data + used, text, length);
+  used += length;
+  data[used] = '\0';
+  return *this;
+}
+
+ScratchString& ScratchString::appendf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  va_list retry;
+  va_copy(retry, args);
+  int n = vsnprintf(data ? data + used : nullptr, data ? reserved - used : 0, format, args);
+  va_end(args);
+  if (n > 0 && used + n >= reserved && reserve(used + n)) {
+    vsnprintf(data + used, reserved - used, format, retry);
+  }
+  va_end(retry);
+  if (n > 0 && used + n < reserved) {
+    used += n;
+  } else if (data != nullptr) {
+    data[used] = '\0';  // Drop whatever part of the text did fit
+  }
+  return *this;
+}
+
+void ScratchString::clear() {
+  used = 0;
+  if (data) {
+    data[0] = '\0';
+  }
+}
+
+// Makes room for length characters plus the terminator
+bool ScratchString::reserve(size_t length) {
+  if (length < reserved) {
+    return true;
+  }
+  if (failed) {
+    return false;
+  }
+  size_t wanted = length + 1;
+
+  if (!heap && arena != nullptr) {
+    // The newest block grows in place, exactly as far as needed
+    if (data != nullptr && arena->extend(data, wanted)) {
+      reserved = wanted;
+      return true;
+    }
+    // Otherwise it moves, with room to grow so it does not move again soon
+    size_t grown = data ? (wanted > 2 * reserved ? wanted : 2 * reserved) : wanted;
+    char* moved = (char*)arena->allocate(grown);
+    if (moved == nullptr && grown > wanted) {
+      moved = (char*)arena->allocate(wanted);
+      grown = wanted;
+    }
+    if (moved != nullptr) {
+      if (data != nullptr) {
+        memcpy(moved, data, used + 1);
+      } else {
+        moved[0] = '\0';
+      }
+      data = moved;
+      reserved = grown;
+      return true;
+    }
+  }
+
+  if (!heap) {
+    ScratchArena::countFallback();
+    char* copy = (char*)malloc(wanted);
+    if (copy == nullptr) {
+      failed = true;
+      return false;
+    }
+    if (data != nullptr) {
+      memcpy(copy, data, used + 1);
+    } else {
+      copy[0] = '\0';
+    }
+    data = copy;
+    heap = true;
+    reserved = wanted;
+    return true;
+  }
+
+  size_t doubled = wanted > 2 * reserved ? wanted : 2 * reserved;
+  char* grown = (char*)realloc(data, doubled);
+  if (grown == nullptr) {
+    failed = true;
+    return false;
+  }
+  data = grown;
+  reserved = doubled;
+  return true;
+}
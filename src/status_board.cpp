@@ -0,0 +1,325 @@
+#include "status_board.h"
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include "graph_stream.h"
+#include "logging.h"
+#include "metrics.h"
+#include "scratch_arena.h"
+
+// Percent-encodes everything but RFC 3986 unreserved characters, for form
+// bodies and URL path segments
+static void appendUrlEncoded(ScratchString& out, const char* value) {
+  static const char hex[] = "0123456789ABCDEF";
+  for (const char* p = value; *p; p++) {
+    char c = *p;
+    if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      out.append(c);
+    } else {
+      out.append('%');
+      out.append(hex[((uint8_t)c) >> 4]);
+      out.append(hex[((uint8_t)c) & 0x0F]);
+    }
+  }
+}
+
+void StatusBoard::begin(const String& appClientId, const String& appClientSecret, const String& appTenantId,
+                        const String& roster, PresenceMapper mapper) {
+  clientId = appClientId;
+  clientSecret = appClientSecret;
+  tenantId = appTenantId;
+  mapPresence = mapper;
+  appToken = "";
+  count = parseRoster(roster, members, BOARD_MAX_MEMBERS);
+
+  enabled = false;
+  if (count == 0) {
+    LOG_WARN("Status board roster is empty");
+  } else if (clientId.length() == 0 || clientSecret.length() == 0) {
+    LOG_ERROR("Status board requires a client ID and client secret");
+  } else if (tenantId.length() == 0 || tenantId == "common" || tenantId == "organizations") {
+    LOG_ERROR("Status board requires a specific tenant ID (client credentials cannot use 'common')");
+  } else {
+    enabled = true;
+    LOG_INFOF("Status board enabled for %d members", count);
+  }
+}
+
+void StatusBoard::stop() {
+  enabled = false;
+  appToken = "";
+  count = 0;
+}
+
+uint8_t StatusBoard::parseRoster(const String& roster, BoardMember* out, uint8_t max) {
+  uint8_t parsed = 0;
+  int start = 0;
+  int length = roster.length();
+
+  while (start < length && parsed < max) {
+    int end = start;
+    while (end < length && roster[end] != ',' && roster[end] != '\n' && roster[end] != ';') {
+      end++;
+    }
+
+    String entry = roster.substring(start, end);
+    entry.trim();
+    if (entry.length() > 0 && entry.length() < BOARD_UPN_LEN) {
+      BoardMember& member = out[parsed++];
+      strlcpy(member.upn, entry.c_str(), sizeof(member.upn));
+      // Object ids can be polled directly, emails are resolved on first poll
+      strlcpy(member.id, isObjectId(member.upn) ? member.upn : "", sizeof(member.id));
+      member.presence = PRESENCE_UNKNOWN;
+      member.availability[0] = '\0';
+      member.activity[0] = '\0';
+      member.resolveFailures = 0;
+      member.resolveRetryAt = 0;
+    } else if (entry.length() >= BOARD_UPN_LEN) {
+      LOG_WARNF("Ignoring roster entry longer than %d characters", BOARD_UPN_LEN - 1);
+    }
+    start = end + 1;
+  }
+
+  if (start < length) {
+    LOG_WARNF("Status board roster truncated to %d members", max);
+  }
+  return parsed;
+}
+
+bool StatusBoard::isObjectId(const char* value) {
+  // 8-4-4-4-12 hexadecimal GUID
+  if (strlen(value) != 36) {
+    return false;
+  }
+  for (int i = 0; i < 36; i++) {
+    bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+    if (dash ? value[i] != '-' : !isxdigit((unsigned char)value[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Doubles from BOARD_RESOLVE_RETRY with each failure in a row, up to
+// BOARD_RESOLVE_MAX_RETRY
+unsigned long StatusBoard::resolveRetryDelay(uint8_t failures) {
+  unsigned long delay = BOARD_RESOLVE_RETRY;
+  for (uint8_t i = 1; i < failures && delay < BOARD_RESOLVE_MAX_RETRY; i++) {
+    delay *= 2;
+  }
+  return min(delay, (unsigned long)BOARD_RESOLVE_MAX_RETRY);
+}
+
+TeamsPresence StatusBoard::presenceAt(uint8_t index) const {
+  return index < count ? members[index].presence : PRESENCE_UNKNOWN;
+}
+
+int StatusBoard::poll() {
+  if (!enabled) {
+    return -1;
+  }
+  if (!ensureToken()) {
+    lastCode = -1;
+    return lastCode;
+  }
+
+  int resolveCode = resolveMembers();
+  if (resolveCode == HTTP_CODE_UNAUTHORIZED) {
+    appToken = "";
+    lastCode = resolveCode;
+    return lastCode;
+  }
+
+  lastCode = fetchPresences();
+  if (lastCode == HTTP_CODE_UNAUTHORIZED) {
+    // Token revoked or rotated - fetch a new one next cycle
+    appToken = "";
+  }
+  lastPoll = millis();
+  return lastCode;
+}
+
+bool StatusBoard::ensureToken() {
+  // Renew five minutes before the token runs out
+  if (appToken.length() > 0 && millis() - tokenAcquired + 300000UL < tokenLifetime) {
+    return true;
+  }
+
+  LOG_INFO("Requesting status board app token (client credentials)");
+  WiFiClientSecure secureClient;
+  secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
+  HTTPClient http;
+  ScratchScope scratch;
+  ScratchString url(scratch, 96);
+  url.append("https://" GRAPH_LOGIN_HOST "/").append(tenantId).append("/oauth2/v2.0/token");
+  http.begin(secureClient, url.c_str());
+  http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+
+  // Azure secrets often contain '+', '=' or '&', which the form body would
+  // otherwise read as separators
+  ScratchString postData(scratch, 192);
+  postData.append("client_id=");
+  appendUrlEncoded(postData, clientId.c_str());
+  postData.append("&client_secret=");
+  appendUrlEncoded(postData, clientSecret.c_str());
+  postData.append("&grant_type=client_credentials");
+  postData.append("&scope=https://graph.microsoft.com/.default");
+
+  int httpCode = http.POST(postData.bytes(), postData.length());
+  if (httpCode != HTTP_CODE_OK) {
+    LOG_ERRORF("Status board token request failed with HTTP %d", httpCode);
+    String response = http.getString();
+    if (response.length() > 0 && response.length() < 300) {
+      LOG_DEBUGF("Error response: %s", response.c_str());
+    }
+    http.end();
+    appToken = "";
+    Metrics::countTokenRefresh(false);
+    return false;
+  }
+
+  StaticJsonDocument<64> filter;
+  filter["access_token"] = true;
+  filter["expires_in"] = true;
+  DynamicJsonDocument doc(3072);
+  DeserializationError error = deserializeJson(doc, http.getStream(), DeserializationOption::Filter(filter));
+  http.end();
+
+  if (error || !doc.containsKey("access_token")) {
+    LOG_ERRORF("Failed to parse status board token response: %s", error ? error.c_str() : "no access_token");
+    appToken = "";
+    Metrics::countTokenRefresh(false);
+    return false;
+  }
+
+  appToken = doc["access_token"].as<String>();
+  tokenLifetime = (doc["expires_in"] | 3600UL) * 1000UL;
+  tokenAcquired = millis();
+  tokenCount++;
+  Metrics::countTokenRefresh(true);
+  LOG_INFOF("Status board app token acquired, expires in %lu seconds", tokenLifetime / 1000);
+  return true;
+}
+
+int StatusBoard::resolveMembers() {
+  for (uint8_t i = 0; i < count; i++) {
+    BoardMember& member = members[i];
+    if (member.id[0] != '\0') {
+      continue;
+    }
+    // A member that does not exist would otherwise cost a TLS lookup every poll
+    if (member.resolveFailures > 0 && (long)(millis() - member.resolveRetryAt) < 0) {
+      continue;
+    }
+
+    WiFiClientSecure secureClient;
+    secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
+    HTTPClient http;
+    ScratchScope scratch;
+    // Guest UPNs contain '#' (alice_contoso.com#EXT#@...), which would end the path
+    ScratchString url(scratch, 64 + 3 * BOARD_UPN_LEN);
+    url.append("https://" GRAPH_API_HOST "/v1.0/users/");
+    appendUrlEncoded(url, member.upn);
+    url.append("?$select=id");
+    ScratchString authorization(scratch, 8 + appToken.length());
+    authorization.append("Bearer ").append(appToken);
+    http.begin(secureClient, url.c_str());
+    http.addHeader("Authorization", authorization.c_str());
+    http.addHeader("User-Agent", "TeamsRedLight/1.0");
+
+    int httpCode = http.GET();
+    if (httpCode == HTTP_CODE_OK) {
+      StaticJsonDocument<256> doc;
+      DeserializationError error = deserializeJson(doc, http.getStream());
+      if (!error) {
+        strlcpy(member.id, doc["id"] | "", sizeof(member.id));
+        LOG_DEBUGF("Resolved board member %s to %s", member.upn, member.id);
+      }
+    } else {
+      LOG_ERRORF("Failed to resolve board member %s: HTTP %d", member.upn, httpCode);
+    }
+    http.end();
+
+    if (httpCode == HTTP_CODE_UNAUTHORIZED) {
+      return httpCode;  // The token's fault, not the member's
+    }
+    if (member.id[0] == '\0') {
+      if (member.resolveFailures < UINT8_MAX) {
+        member.resolveFailures++;
+      }
+      unsigned long delay = resolveRetryDelay(member.resolveFailures);
+      member.resolveRetryAt = millis() + delay;
+      LOG_WARNF("Retrying board member %s in %lu seconds", member.upn, delay / 1000);
+    }
+  }
+  return HTTP_CODE_OK;
+}
+
+int StatusBoard::fetchPresences() {
+  DynamicJsonDocument body(64 + BOARD_MAX_MEMBERS * (BOARD_ID_LEN + 8));
+  JsonArray ids = body.createNestedArray("ids");
+  for (uint8_t i = 0; i < count; i++) {
+    if (members[i].id[0] != '\0') {
+      ids.add((const char*)members[i].id);
+    }
+  }
+  if (ids.size() == 0) {
+    LOG_WARN("No status board members could be resolved");
+    return -1;
+  }
+
+  String payload;
+  serializeJson(body, payload);
+
+  WiFiClientSecure secureClient;
+  secureClient.setInsecure(); // Disable SSL certificate verification for IoT device
+  HTTPClient http;
+  ScratchScope scratch;
+  ScratchString authorization(scratch, 8 + appToken.length());
+  authorization.append("Bearer ").append(appToken);
+  http.begin(secureClient, "https://" GRAPH_API_HOST "/v1.0/communications/getPresencesByUserId");
+  http.addHeader("Authorization", authorization.c_str());
+  http.addHeader("Content-Type", "application/json");
+  http.addHeader("User-Agent", "TeamsRedLight/1.0");
+  http.useHTTP10(true);
+
+  int httpCode = http.POST(payload);
+  LOG_DEBUGF("Bulk presence response: HTTP %d", httpCode);
+  if (httpCode != HTTP_CODE_OK) {
+    LOG_ERRORF("Bulk presence request failed with HTTP %d", httpCode);
+    http.end();
+    return httpCode;
+  }
+
+  StaticJsonDocument<96> filter;
+  filter["id"] = true;
+  filter["availability"] = true;
+  filter["activity"] = true;
+
+  StaticJsonDocument<256> item;
+  GraphPageReader reader(http.getStream(), item, filter);
+  bool ok = reader.read([&](JsonObject presence) {
+    const char* id = presence["id"] | "";
+    for (uint8_t i = 0; i < count; i++) {
+      BoardMember& member = members[i];
+      if (strcasecmp(member.id, id) != 0) {
+        continue;
+      }
+      strlcpy(member.availability, presence["availability"] | "", sizeof(member.availability));
+      strlcpy(member.activity, presence["activity"] | "", sizeof(member.activity));
+      TeamsPresence updated = mapPresence != nullptr ? mapPresence(member.availability, member.activity) : PRESENCE_UNKNOWN;
+      if (updated != member.presence) {
+        LOG_INFOF("Board member %s: %s/%s", member.upn, member.availability, member.activity);
+        member.presence = updated;
+      }
+      break;
+    }
+  });
+  http.end();
+
+  if (!ok) {
+    LOG_ERRORF("Failed to parse bulk presence response: %s", reader.error());
+    return -1;
+  }
+  return HTTP_CODE_OK;
+}
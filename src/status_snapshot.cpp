@@ -0,0 +1,74 @@
+#include "status_snapshot.h"
+
+// Fingerprint implementation
+void Fingerprint::mix(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+}
+
+Fingerprint& Fingerprint::add(uint32_t value) {
+  mix((const uint8_t*)&value, sizeof(value));
+  return *this;
+}
+
+Fingerprint& Fingerprint::add(const char* text) {
+  // Include the terminator so "ab","c" and "a","bc" hash differently
+  mix((const uint8_t*)text, strlen(text) + 1);
+  return *this;
+}
+
+// StatusSnapshot implementation
+bool StatusSnapshot::stale(uint32_t fingerprint) const {
+  return !entry || fingerprint != lastFingerprint;
+}
+
+void StatusSnapshot::publish(uint32_t fingerprint, const String& body) {
+  std::shared_ptr<SnapshotEntry> next = std::make_shared<SnapshotEntry>();
+  next->body = body;
+  next->version = ++versionCounter;
+  snprintf(next->etag, sizeof(next->etag), "\"%08x-%u\"", (unsigned)boot, (unsigned)next->version);
+
+  portENTER_CRITICAL(&lock);
+  entry = next;
+  portEXIT_CRITICAL(&lock);
+  lastFingerprint = fingerprint;
+}
+
+std::shared_ptr<const SnapshotEntry> StatusSnapshot::current() const {
+  portENTER_CRITICAL(&lock);
+  std::shared_ptr<const SnapshotEntry> result = entry;
+  portEXIT_CRITICAL(&lock);
+  return result;
+}
+
+bool StatusSnapshot::etagMatches(const String& ifNoneMatch, const char* etag) {
+  // The header is a comma-separated list; weak tags (W/"...") compare equal here
+  size_t etagLength = strlen(etag);
+  const char* p = ifNoneMatch.c_str();
+  while (*p) {
+    while (*p == ' ' || *p == ',') {
+      p++;
+    }
+    if (*p == '*') {
+      return true;
+    }
+    if (p[0] == 'W' && p[1] == '/') {
+      p += 2;
+    }
+    const char* end = strchr(p, ',');
+    size_t length = end ? (size_t)(end - p) : strlen(p);
+    while (length > 0 && p[length - 1] == ' ') {
+      length--;
+    }
+    if (length == etagLength && strncmp(p, etag, length) == 0) {
+      return true;
+    }
+    if (!end) {
+      break;
+    }
+    p = end;
+  }
+  return false;
+}
@@ -0,0 +1,95 @@
+// Allocation attribution on the host: which call sites allocate, and which
+// still hold memory when a workload ends.
+//
+// The device can only say how much the heap moved around a route, Graph call
+// or save (/api/heap). This replays the request building those calls do, with
+// malloc replaced by the counting allocator in src/alloc_counter.cpp, and
+// prints the heaviest stacks. Blocks still live at the end of a run point at
+// a leak; stacks with many short-lived allocations point at fragmentation.
+// Requests are built while every arena is lent out too, so the heap fallback
+// shows up as a site of its own.
+//
+// Build and run on the host:
+//   g++ -std=c++17 -O1 -g -rdynamic -DALLOC_COUNTER -DALLOC_SITES -Iinclude test/host/alloc_sites.cpp src/scratch_arena.cpp src/alloc_counter.cpp -o alloc_sites
+//   ./alloc_sites [polls] [top]
+//
+// Pipe the output through c++filt for readable names.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "alloc_counter.h"
+#include "scratch_arena.h"
+
+#define TOKEN_LENGTH 1400
+#define LOG_RING 50
+
+static std::string accessToken(TOKEN_LENGTH, 'e');
+static std::vector<std::string> logRing;
+
+static size_t buildPresenceRequest(ScratchArena* arena) {
+  ScratchString request(arena, 256);
+  request.append("GET /v1.0/me/presence HTTP/1.1\r\nHost: graph.microsoft.com\r\n");
+  request.append("Authorization: Bearer ").append(accessToken.c_str(), accessToken.size());
+  request.append("\r\nConnection: keep-alive\r\n\r\n");
+  return request.length();
+}
+
+static size_t buildTokenRequest(ScratchArena* arena) {
+  ScratchString body(arena);
+  body.append("client_id=").append("00000000-0000-0000-0000-000000000000");
+  body.append("&grant_type=refresh_token&refresh_token=");
+  for (int i = 0; i < 3; i++) {
+    body.append(accessToken.c_str(), accessToken.size());
+  }
+  body.appendf("&scope=%s", "Presence.Read%20Calendars.Read%20offline_access");
+  return body.length();
+}
+
+static size_t buildStatusPage(ScratchArena* arena) {
+  ScratchString page(arena, 512);
+  for (int i = 0; i < 40; i++) {
+    page.appendf("<tr><td>%d</td><td>Available</td></tr>", i);
+  }
+  return page.length();
+}
+
+// Log lines are kept as heap strings, like the device's log buffer
+static void logLine(int poll) {
+  char line[96];
+  snprintf(line, sizeof(line), "[INFO] Presence poll %d: Available", poll);
+  if (logRing.size() == LOG_RING) {
+    logRing.erase(logRing.begin());
+  }
+  logRing.emplace_back(line);
+}
+
+int main(int argc, char** argv) {
+  int polls = argc > 1 ? atoi(argv[1]) : 2880;  // A day at one poll per 30 s
+  int top = argc > 2 ? atoi(argv[2]) : 8;
+  size_t built = 0;
+
+  for (int poll = 0; poll < polls; poll++) {
+    {
+      ScratchScope scope;
+      built += buildPresenceRequest(scope.get());
+    }
+    if (poll % 120 == 0) {
+      ScratchScope scope;
+      built += buildTokenRequest(scope.get());
+    }
+    if (poll % 10 == 0) {
+      // A web request while the other arenas are out
+      ScratchScope held[SCRATCH_ARENA_COUNT];
+      built += buildStatusPage(ScratchArena::borrow());
+    }
+    logLine(poll);
+  }
+
+  printf("%d polls, %zu bytes of requests built, %u arena fallbacks\n\n", polls, built,
+         ScratchArena::fallbacks());
+  fflush(stdout);
+  AllocCounter::reportSites(stdout, top);
+  return 0;
+}
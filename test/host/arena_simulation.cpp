@@ -0,0 +1,390 @@
+// Long-running heap simulation: what the scratch arena changes for the heap
+// over weeks of uptime.
+//
+// The ESP32 heap is modelled as a first-fit allocator with coalescing over a
+// fixed region, which is close to how the IDF heap behaves for blocks of this
+// size. Both runs replay the same workload: presence polls every 30 seconds,
+// web requests, hourly token refreshes, log lines and snapshot rebuilds. The
+// "heap" run builds every temporary String on the heap, growing it one
+// append at a time like Arduino String does. The "arena" run builds URLs,
+// headers, form bodies and pages in a ScratchArena and copies only the final
+// text to the heap where a library insists on a String of its own. Its pool
+// is reserved in the arena run's heap, since on the device it is static
+// memory the heap would otherwise have.
+//
+// The arena cuts heap allocations by about two thirds. It does not improve
+// fragmentation: the largest free block and its share of free heap come out
+// the same, less the pool itself.
+//
+// Build and run on the host:
+//   g++ -std=c++17 -O2 -Iinclude test/host/arena_simulation.cpp src/scratch_arena.cpp -o arena_simulation
+//   ./arena_simulation [days]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "scratch_arena.h"
+
+#define HEAP_SIZE (160 * 1024)
+#define BLOCK_HEADER 8
+#define POLL_SECONDS 30
+#define LOG_RING 50
+
+// First-fit heap over a fixed region. Block sizes include the header and are
+// kept in a side table, so the region itself is never touched.
+class SimHeap {
+public:
+  SimHeap() { freeList.push_back({0, HEAP_SIZE}); }
+
+  long allocate(size_t length) {
+    size_t needed = align(length) + BLOCK_HEADER;
+    for (size_t i = 0; i < freeList.size(); i++) {
+      if (freeList[i].size >= needed) {
+        long at = freeList[i].start;
+        // Splinters too small to hold a block stay with the allocation
+        if (freeList[i].size - needed < 16) {
+          needed = freeList[i].size;
+          freeList.erase(freeList.begin() + i);
+        } else {
+          freeList[i].start += needed;
+          freeList[i].size -= needed;
+        }
+        sizes[at] = needed;
+        freeBytes -= needed;
+        if (freeBytes < lowestFree) {
+          lowestFree = freeBytes;
+        }
+        allocations++;
+        return at;
+      }
+    }
+    failures++;
+    return -1;
+  }
+
+  void release(long at) {
+    if (at < 0) {
+      return;
+    }
+    size_t size = sizes[at];
+    freeBytes += size;
+    size_t i = 0;
+    while (i < freeList.size() && freeList[i].start < at) {
+      i++;
+    }
+    freeList.insert(freeList.begin() + i, {at, size});
+    if (i + 1 < freeList.size() && freeList[i].start + (long)freeList[i].size == freeList[i + 1].start) {
+      freeList[i].size += freeList[i + 1].size;
+      freeList.erase(freeList.begin() + i + 1);
+    }
+    if (i > 0 && freeList[i - 1].start + (long)freeList[i - 1].size == freeList[i].start) {
+      freeList[i - 1].size += freeList[i].size;
+      freeList.erase(freeList.begin() + i);
+    }
+  }
+
+  // Grows in place when the next block is free, otherwise moves, like
+  // realloc() in the IDF heap
+  long resize(long at, size_t length) {
+    if (at < 0) {
+      return allocate(length);
+    }
+    size_t needed = align(length) + BLOCK_HEADER;
+    size_t size = sizes[at];
+    if (needed <= size) {
+      return at;
+    }
+    for (size_t i = 0; i < freeList.size(); i++) {
+      if (freeList[i].start == at + (long)size && freeList[i].size >= needed - size) {
+        size_t taken = needed - size;
+        freeList[i].start += taken;
+        freeList[i].size -= taken;
+        if (freeList[i].size == 0) {
+          freeList.erase(freeList.begin() + i);
+        }
+        sizes[at] = needed;
+        freeBytes -= taken;
+        if (freeBytes < lowestFree) {
+          lowestFree = freeBytes;
+        }
+        allocations++;
+        return at;
+      }
+    }
+    long moved = allocate(length);
+    release(at);
+    return moved;
+  }
+
+  size_t largestBlock() const {
+    size_t largest = 0;
+    for (const Block& block : freeList) {
+      if (block.size > largest) {
+        largest = block.size;
+      }
+    }
+    return largest > BLOCK_HEADER ? largest - BLOCK_HEADER : 0;
+  }
+
+  size_t freeBytes = HEAP_SIZE;
+  size_t lowestFree = HEAP_SIZE;
+  size_t fragments() const { return freeList.size(); }
+  unsigned long long allocations = 0;
+  unsigned long failures = 0;
+
+private:
+  struct Block {
+    long start;
+    size_t size;
+  };
+  std::vector<Block> freeList;
+  std::vector<size_t> sizes = std::vector<size_t>(HEAP_SIZE, 0);
+
+  static size_t align(size_t n) { return (n + 3) & ~(size_t)3; }
+};
+
+// Deterministic so both runs see the same requests
+class Random {
+public:
+  explicit Random(uint32_t seed) : state(seed) {}
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  size_t between(size_t low, size_t high) { return low + next() % (high - low + 1); }
+
+private:
+  uint32_t state;
+};
+
+// A String built on the heap one append at a time: every append reallocs
+// to the exact new length
+static long growString(SimHeap& heap, long at, size_t& length, size_t appended) {
+  length += appended;
+  return heap.resize(at, length + 1);
+}
+
+static long buildString(SimHeap& heap, Random& split, size_t total, size_t pieces) {
+  long at = -1;
+  size_t length = 0;
+  for (size_t i = 0; i < pieces && length < total; i++) {
+    size_t share = (total - length) / (pieces - i) * 2;
+    size_t piece = i + 1 == pieces ? total - length : split.between(1, share > 1 ? share : 1);
+    at = growString(heap, at, length, piece);
+  }
+  return at;
+}
+
+// Text built in a borrowed arena; copied to the heap in one exact-size
+// allocation when a library needs its own String
+static long buildScratch(SimHeap& heap, size_t total, bool copyToHeap) {
+  ScratchScope scope;
+  ScratchString text(scope, 64);
+  char piece[64];
+  memset(piece, 'x', sizeof(piece));
+  for (size_t left = total; left > 0;) {
+    size_t n = left < sizeof(piece) ? left : sizeof(piece);
+    text.append(piece, n);
+    left -= n;
+  }
+  long copy = copyToHeap ? heap.allocate(text.length() + 1) : -1;
+  if (text.onHeap()) {
+    // Stands in for the fallback allocation the builder made
+    heap.release(heap.allocate(text.length() + 1));
+  }
+  return copy;
+}
+
+// One day of readings. The largest block is read in the middle of each
+// poll, just before its TLS buffer is allocated, which is when it matters.
+struct DayStats {
+  size_t lowestLargest = HEAP_SIZE;
+  double fragmentation = 0;   // Sum of 1 - largest / free after each cycle
+  size_t mostHoles = 0;
+  unsigned long cycles = 0;
+};
+
+struct Workload {
+  bool arena;
+  SimHeap heap;
+  Random random{0x5eed1234};
+  Random split{0xc0ffee};     // Only splits text into appends, so both runs see the same workload
+  DayStats day;
+  long accessToken = -1;
+  long refreshToken = -1;
+  long snapshots[3] = {-1, -1, -1};
+  long logs[LOG_RING][2];
+  size_t logHead = 0;
+
+  explicit Workload(bool useArena) : arena(useArena) {
+    for (auto& log : logs) {
+      log[0] = log[1] = -1;
+    }
+    // The arena pool is static memory the heap run has as heap instead
+    if (arena) {
+      heap.allocate(SCRATCH_ARENA_COUNT * SCRATCH_ARENA_SIZE);
+    }
+    accessToken = heap.allocate(2100);
+    refreshToken = heap.allocate(1400);
+  }
+
+  // Temporary text; with libraryCopy the finished text is also copied into a
+  // String the caller hands on (server response, HTTPClient URL, snapshot)
+  long text(size_t total, size_t pieces, bool libraryCopy) {
+    if (arena) {
+      return buildScratch(heap, total, libraryCopy);
+    }
+    long built = buildString(heap, split, total, pieces);
+    if (!libraryCopy) {
+      return built;
+    }
+    long copy = heap.allocate(total + 1);
+    heap.release(built);
+    return copy;
+  }
+
+  void log() {
+    heap.release(logs[logHead][0]);
+    heap.release(logs[logHead][1]);
+    logs[logHead][0] = heap.allocate(random.between(8, 24));
+    logs[logHead][1] = heap.allocate(random.between(30, 140));
+    logHead = (logHead + 1) % LOG_RING;
+  }
+
+  void poll() {
+    // "Bearer " + token; HTTPClient then appends it to its own header block
+    long bearer = text(2107, 2, false);
+    long headers = heap.allocate(2150);
+    size_t largest = heap.largestBlock();
+    if (largest < day.lowestLargest) {
+      day.lowestLargest = largest;
+    }
+    long tls = heap.allocate(16 * 1024);
+    long tlsOut = heap.allocate(4 * 1024);
+    long payload = heap.allocate(random.between(250, 600));
+    long doc = heap.allocate(1024);
+    long availability = heap.allocate(12);
+    long activity = heap.allocate(16);
+    log();
+    heap.release(activity);
+    heap.release(availability);
+    heap.release(doc);
+    heap.release(payload);
+    heap.release(tlsOut);
+    heap.release(tls);
+    heap.release(headers);
+    heap.release(bearer);
+  }
+
+  void webRequest() {
+    long request = heap.allocate(220);
+    long url = heap.allocate(random.between(8, 40));
+    size_t body = random.between(120, 2600);
+    // A page or JSON fragment assembled from many pieces; the server keeps
+    // its own copy of the finished body
+    long response = text(body, random.between(4, 30), true);
+    if (random.next() % 4 == 0) {
+      log();
+    }
+    heap.release(response);
+    heap.release(url);
+    heap.release(request);
+  }
+
+  void refreshTokens() {
+    long url = text(80, 3, true);
+    long form = text(random.between(1900, 2300), 5, false);
+    long tls = heap.allocate(16 * 1024);
+    long payload = heap.allocate(random.between(3600, 4400));
+    long doc = heap.allocate(4096);
+    heap.release(accessToken);
+    heap.release(refreshToken);
+    accessToken = heap.allocate(random.between(1900, 2300));
+    refreshToken = heap.allocate(random.between(1200, 1600));
+    heap.release(doc);
+    heap.release(payload);
+    heap.release(tls);
+    heap.release(form);
+    heap.release(url);
+    log();
+  }
+
+  void rebuildSnapshots() {
+    static const size_t ranges[3][2] = {{900, 1300}, {600, 900}, {2000, 2600}};
+    for (int i = 0; i < 3; i++) {
+      long next = text(random.between(ranges[i][0], ranges[i][1]), 12, true);
+      heap.release(snapshots[i]);
+      snapshots[i] = next;
+    }
+  }
+
+  void cycle(unsigned long n) {
+    poll();
+    for (size_t i = random.between(0, 3); i > 0; i--) {
+      webRequest();
+    }
+    if (random.next() % 12 == 0) {
+      rebuildSnapshots();
+    }
+    if (n % (3600 / POLL_SECONDS) == 0) {
+      refreshTokens();
+    }
+
+    day.fragmentation += 1.0 - (double)heap.largestBlock() / heap.freeBytes;
+    if (heap.fragments() > day.mostHoles) {
+      day.mostHoles = heap.fragments();
+    }
+    day.cycles++;
+  }
+};
+
+static void report(Workload& run) {
+  printf(" %9zu %5.1f%% %5zu |", run.day.lowestLargest, 100.0 * run.day.fragmentation / run.day.cycles, run.day.mostHoles);
+  run.day = DayStats();
+}
+
+int main(int argc, char** argv) {
+  int days = argc > 1 ? atoi(argv[1]) : 30;
+  unsigned long cyclesPerDay = 86400 / POLL_SECONDS;
+
+  Workload before(false);
+  Workload after(true);
+
+  printf("Lowest largest block during a poll, mean fragmentation and most free holes per day\n\n");
+  printf("%-5s | %-23s | %-23s |\n", "", "heap Strings", "scratch arena");
+  printf("%-5s | %9s %6s %5s | %9s %6s %5s |\n", "day", "largest", "frag", "holes", "largest", "frag", "holes");
+  for (int day = 1; day <= days; day++) {
+    for (unsigned long n = 0; n < cyclesPerDay; n++) {
+      unsigned long cycle = (day - 1) * cyclesPerDay + n;
+      before.cycle(cycle);
+      after.cycle(cycle);
+    }
+    if (day == 1 || day % 5 == 0 || day == days) {
+      printf("%-5d |", day);
+      report(before);
+      report(after);
+      printf("\n");
+    } else {
+      before.day = DayStats();
+      after.day = DayStats();
+    }
+  }
+
+  printf("\nheap allocations: %llu with heap Strings, %llu with the arena\n",
+         before.heap.allocations, after.heap.allocations);
+  printf("lowest free heap: %zu with heap Strings, %zu with the arena\n",
+         before.heap.lowestFree, after.heap.lowestFree);
+  printf("failed allocations: %lu with heap Strings, %lu with the arena\n",
+         before.heap.failures, after.heap.failures);
+  printf("arena high water %zu of %d bytes, %u fallbacks to the heap\n",
+         ScratchArena::poolHighWater(), SCRATCH_ARENA_SIZE, (unsigned)ScratchArena::fallbacks());
+
+  if (ScratchArena::available() != SCRATCH_ARENA_COUNT) {
+    printf("arena leaked: %u of %d returned\n", ScratchArena::available(), SCRATCH_ARENA_COUNT);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/admission.h"
+
+static const uint32_t SCRIPT = 0x0A00000A;
+static const uint32_t BROWSER = 0x0A00000B;
+
+static AdmissionControl admission;
+static uint32_t retryAfter;
+
+void setUp(void) {
+    admission = AdmissionControl();
+    retryAfter = 0;
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+// Admits and immediately releases, like a request that completed
+static AdmissionControl::Result request(uint32_t client, RoutePriority priority, unsigned long now) {
+    AdmissionControl::Result result = admission.admit(client, priority, now, retryAfter);
+    if (result == AdmissionControl::ADMITTED) {
+        admission.release();
+    }
+    return result;
+}
+
+void test_route_priorities() {
+    TEST_ASSERT_EQUAL(PRIORITY_HIGH, AdmissionControl::priorityFor("/status"));
+    TEST_ASSERT_EQUAL(PRIORITY_LOW, AdmissionControl::priorityFor("/schedule"));
+    TEST_ASSERT_EQUAL(PRIORITY_LOW, AdmissionControl::priorityFor("/location"));
+    TEST_ASSERT_EQUAL(PRIORITY_LOW, AdmissionControl::priorityFor("/logs"));
+    TEST_ASSERT_EQUAL(PRIORITY_NORMAL, AdmissionControl::priorityFor("/api/config"));
+}
+
+void test_burst_then_rate_limited() {
+    for (int i = 0; i < ADMISSION_BURST; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_HIGH, 1000));
+    }
+    TEST_ASSERT_EQUAL(AdmissionControl::RATE_LIMITED, request(SCRIPT, PRIORITY_HIGH, 1000));
+    TEST_ASSERT_EQUAL(1, retryAfter);
+    TEST_ASSERT_EQUAL(1, admission.rateLimited());
+
+    // Other clients keep their own bucket
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(BROWSER, PRIORITY_HIGH, 1000));
+
+    // One token comes back every 1000 / rate ms
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_HIGH, 1000 + 1000 / ADMISSION_REFILL_PER_SECOND));
+    TEST_ASSERT_EQUAL(AdmissionControl::RATE_LIMITED, request(SCRIPT, PRIORITY_HIGH, 1000 + 1000 / ADMISSION_REFILL_PER_SECOND));
+}
+
+void test_expensive_routes_cost_more() {
+    for (int i = 0; i < ADMISSION_BURST / ADMISSION_LOW_PRIORITY_COST; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_LOW, 0));
+    }
+    TEST_ASSERT_EQUAL(AdmissionControl::RATE_LIMITED, request(SCRIPT, PRIORITY_LOW, 0));
+
+    // Half a low-priority request's worth of tokens is enough for /status
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_HIGH, 1000 / ADMISSION_REFILL_PER_SECOND));
+}
+
+void test_concurrency_cap_keeps_room_for_status() {
+    for (int i = 0; i < ADMISSION_MAX_ACTIVE_LOW; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, admission.admit(BROWSER + i, PRIORITY_LOW, 0, retryAfter));
+    }
+    TEST_ASSERT_EQUAL(AdmissionControl::OVERLOADED, admission.admit(SCRIPT, PRIORITY_LOW, 0, retryAfter));
+    TEST_ASSERT_EQUAL(1, retryAfter);
+
+    while (admission.activeRequests() < ADMISSION_MAX_ACTIVE_NORMAL) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, admission.admit(SCRIPT, PRIORITY_NORMAL, 0, retryAfter));
+    }
+    TEST_ASSERT_EQUAL(AdmissionControl::OVERLOADED, admission.admit(SCRIPT, PRIORITY_NORMAL, 0, retryAfter));
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, admission.admit(SCRIPT, PRIORITY_HIGH, 0, retryAfter));
+    TEST_ASSERT_EQUAL(2, admission.overloaded());
+
+    admission.release();
+    admission.release();
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, admission.admit(SCRIPT, PRIORITY_NORMAL, 0, retryAfter));
+}
+
+void test_refused_request_costs_no_tokens() {
+    for (int i = 0; i < ADMISSION_MAX_ACTIVE_LOW; i++) {
+        admission.admit(BROWSER, PRIORITY_LOW, 0, retryAfter);
+    }
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::OVERLOADED, admission.admit(SCRIPT, PRIORITY_LOW, 0, retryAfter));
+    }
+    for (int i = 0; i < ADMISSION_BURST; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_HIGH, 0));
+    }
+}
+
+void test_least_recent_client_is_recycled() {
+    for (int i = 0; i < ADMISSION_BURST; i++) {
+        request(SCRIPT, PRIORITY_HIGH, 0);
+    }
+    for (uint32_t i = 1; i <= ADMISSION_MAX_CLIENTS; i++) {
+        TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(BROWSER + i, PRIORITY_HIGH, i));
+    }
+    // The script's bucket was handed to another client, so it starts over full
+    TEST_ASSERT_EQUAL(AdmissionControl::ADMITTED, request(SCRIPT, PRIORITY_HIGH, 100));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_route_priorities);
+    RUN_TEST(test_burst_then_rate_limited);
+    RUN_TEST(test_expensive_routes_cost_more);
+    RUN_TEST(test_concurrency_cap_keeps_room_for_status);
+    RUN_TEST(test_refused_request_costs_no_tokens);
+    RUN_TEST(test_least_recent_client_is_recycled);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,137 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/calendar_sync.h"
+
+static CalendarStore store;
+
+static CalendarEvent makeEvent(const char* id, time_t start, const char* subject) {
+    CalendarEvent event;
+    memset(&event, 0, sizeof(event));
+    event.idHash = CalendarStore::hashId(id);
+    event.start = start;
+    event.end = start + 1800;
+    event.showAs = SHOW_AS_BUSY;
+    strlcpy(event.subject, subject, sizeof(event.subject));
+    return event;
+}
+
+void setUp(void) {
+    store.clear();
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_parse_graph_datetime() {
+    // 2024-01-15T09:30:00 UTC
+    TEST_ASSERT_EQUAL(1705311000, CalendarSync::parseDateTime("2024-01-15T09:30:00.0000000"));
+    TEST_ASSERT_EQUAL(0, CalendarSync::parseDateTime("1970-01-01T00:00:00"));
+    TEST_ASSERT_EQUAL(951782400, CalendarSync::parseDateTime("2000-02-29T00:00:00"));
+    TEST_ASSERT_EQUAL(0, CalendarSync::parseDateTime("not a date"));
+}
+
+void test_format_roundtrip() {
+    char buffer[32];
+    CalendarSync::formatDateTime(1705311000, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("2024-01-15T09:30:00", buffer);
+    TEST_ASSERT_EQUAL(1705311000, CalendarSync::parseDateTime(buffer));
+}
+
+void test_show_as_mapping() {
+    TEST_ASSERT_EQUAL(SHOW_AS_BUSY, CalendarSync::parseShowAs("busy"));
+    TEST_ASSERT_EQUAL(SHOW_AS_WORKING_ELSEWHERE, CalendarSync::parseShowAs("workingElsewhere"));
+    TEST_ASSERT_EQUAL(SHOW_AS_UNKNOWN, CalendarSync::parseShowAs("something"));
+    TEST_ASSERT_EQUAL_STRING("oof", CalendarSync::showAsName(SHOW_AS_OOF));
+}
+
+void test_store_orders_by_start() {
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("b", 2000, "Second")));
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("a", 1000, "First")));
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("c", 3000, "Third")));
+
+    TEST_ASSERT_EQUAL(3, store.count());
+    TEST_ASSERT_EQUAL_STRING("First", store.at(0).subject);
+    TEST_ASSERT_EQUAL_STRING("Second", store.at(1).subject);
+    TEST_ASSERT_EQUAL_STRING("Third", store.at(2).subject);
+}
+
+void test_store_upsert_and_remove() {
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("a", 1000, "Standup")));
+
+    // Same content is not a change
+    TEST_ASSERT_FALSE(store.upsert(makeEvent("a", 1000, "Standup")));
+
+    // Moved event replaces the old record
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("a", 5000, "Standup")));
+    TEST_ASSERT_EQUAL(1, store.count());
+    TEST_ASSERT_EQUAL(5000, store.at(0).start);
+
+    TEST_ASSERT_TRUE(store.remove(CalendarStore::hashId("a")));
+    TEST_ASSERT_FALSE(store.remove(CalendarStore::hashId("a")));
+    TEST_ASSERT_EQUAL(0, store.count());
+}
+
+void test_store_full_keeps_earliest() {
+    char id[8];
+    for (int i = 0; i < CALENDAR_MAX_EVENTS; i++) {
+        snprintf(id, sizeof(id), "e%d", i);
+        TEST_ASSERT_TRUE(store.upsert(makeEvent(id, 1000 + i * 100, "Event")));
+    }
+
+    TEST_ASSERT_FALSE(store.truncated());
+
+    // Later than everything stored - dropped
+    TEST_ASSERT_FALSE(store.upsert(makeEvent("late", 999999, "Late")));
+    TEST_ASSERT_EQUAL(CALENDAR_MAX_EVENTS, store.count());
+    TEST_ASSERT_TRUE(store.truncated());
+
+    // Earlier than everything stored - evicts the last event
+    TEST_ASSERT_TRUE(store.upsert(makeEvent("early", 10, "Early")));
+    TEST_ASSERT_EQUAL(CALENDAR_MAX_EVENTS, store.count());
+    TEST_ASSERT_EQUAL_STRING("Early", store.at(0).subject);
+
+    store.clear();
+    TEST_ASSERT_FALSE(store.truncated());
+}
+
+void test_store_next_walks_by_start() {
+    store.upsert(makeEvent("b", 2000, "Second"));
+    store.upsert(makeEvent("a", 1000, "First"));
+
+    CalendarEvent event;
+    TEST_ASSERT_TRUE(store.next(nullptr, event));
+    TEST_ASSERT_EQUAL_STRING("First", event.subject);
+
+    // An earlier event added mid-walk does not make the walk repeat one
+    store.upsert(makeEvent("c", 500, "Earlier"));
+    TEST_ASSERT_TRUE(store.next(&event, event));
+    TEST_ASSERT_EQUAL_STRING("Second", event.subject);
+    TEST_ASSERT_FALSE(store.next(&event, event));
+}
+
+void test_subject_truncated() {
+    CalendarEvent event = makeEvent("long", 1000, "A very long meeting subject that does not fit in the compact record");
+    TEST_ASSERT_EQUAL(CALENDAR_SUBJECT_LEN - 1, strlen(event.subject));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_graph_datetime);
+    RUN_TEST(test_format_roundtrip);
+    RUN_TEST(test_show_as_mapping);
+    RUN_TEST(test_store_orders_by_start);
+    RUN_TEST(test_store_upsert_and_remove);
+    RUN_TEST(test_store_full_keeps_earliest);
+    RUN_TEST(test_store_next_walks_by_start);
+    RUN_TEST(test_subject_truncated);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/cursor_read.h"
+
+// A buffer holding 10 entries, seq 41..50
+static const uint32_t LAST_SEQ = 50;
+static const int COUNT = 10;
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_without_cursor_returns_everything() {
+    CursorQuery query;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(0, window.first);
+    TEST_ASSERT_EQUAL(10, window.end);
+    TEST_ASSERT_FALSE(window.more);
+}
+
+void test_limit_without_cursor_returns_newest() {
+    CursorQuery query;
+    query.limit = 3;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(7, window.first);  // seq 48..50
+    TEST_ASSERT_EQUAL(10, window.end);
+}
+
+void test_since_returns_only_newer_entries() {
+    CursorQuery query;
+    query.hasSince = true;
+    query.since = 47;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(7, window.first);  // seq 48
+    TEST_ASSERT_EQUAL(10, window.end);
+    TEST_ASSERT_FALSE(window.missed);
+    TEST_ASSERT_EQUAL_UINT32(48, window.seqAt(window.first));
+    TEST_ASSERT_EQUAL_UINT32(50, window.cursor);
+
+    query.since = 50;
+    window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(window.first, window.end);
+}
+
+void test_limit_with_cursor_pages_forward() {
+    CursorQuery query;
+    query.hasSince = true;
+    query.since = 40;
+    query.limit = 4;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(0, window.first);  // seq 41..44
+    TEST_ASSERT_EQUAL(4, window.end);
+    TEST_ASSERT_TRUE(window.more);
+    TEST_ASSERT_EQUAL_UINT32(44, window.cursor);
+}
+
+void test_overwritten_entries_are_reported() {
+    CursorQuery query;
+    query.hasSince = true;
+    query.since = 30;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_TRUE(window.missed);
+    TEST_ASSERT_EQUAL(0, window.first);
+}
+
+void test_cursor_from_previous_boot_reads_from_start() {
+    CursorQuery query;
+    query.hasSince = true;
+    query.since = 900;
+    CursorWindow window = query.window(LAST_SEQ, COUNT);
+    TEST_ASSERT_EQUAL(0, window.first);
+    TEST_ASSERT_EQUAL(10, window.end);
+    TEST_ASSERT_TRUE(query.satisfiedBy(LAST_SEQ));
+}
+
+void test_long_poll_waits_only_when_caught_up() {
+    CursorQuery query;
+    TEST_ASSERT_TRUE(query.satisfiedBy(LAST_SEQ));
+
+    query.hasSince = true;
+    query.since = 50;
+    TEST_ASSERT_FALSE(query.satisfiedBy(LAST_SEQ));
+    TEST_ASSERT_TRUE(query.satisfiedBy(51));
+}
+
+void test_empty_buffer() {
+    CursorQuery query;
+    query.hasSince = true;
+    CursorWindow window = query.window(0, 0);
+    TEST_ASSERT_EQUAL(0, window.end);
+    TEST_ASSERT_EQUAL_UINT32(0, window.cursor);
+    TEST_ASSERT_FALSE(query.satisfiedBy(0));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_without_cursor_returns_everything);
+    RUN_TEST(test_limit_without_cursor_returns_newest);
+    RUN_TEST(test_since_returns_only_newer_entries);
+    RUN_TEST(test_limit_with_cursor_pages_forward);
+    RUN_TEST(test_overwritten_entries_are_reported);
+    RUN_TEST(test_cursor_from_previous_boot_reads_from_start);
+    RUN_TEST(test_long_poll_waits_only_when_caught_up);
+    RUN_TEST(test_empty_buffer);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
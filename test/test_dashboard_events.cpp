@@ -0,0 +1,85 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "../include/dashboard_events.h"
+
+static DashboardDelta tracker;
+static DashboardState current;
+static StaticJsonDocument<256> delta;
+
+void setUp(void) {
+    tracker.reset();
+    current.state = "monitoring";
+    current.presence = "Available";
+    current.ledCount = 2;
+    current.ledPresence[0] = PRESENCE_AVAILABLE;
+    current.ledPresence[1] = PRESENCE_AVAILABLE;
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_first_write_reports_everything() {
+    TEST_ASSERT_TRUE(tracker.write(current, delta));
+    TEST_ASSERT_EQUAL_STRING("monitoring", delta["state"]);
+    TEST_ASSERT_EQUAL_STRING("Available", delta["presence"]);
+    TEST_ASSERT_EQUAL(2, delta["led_presence"].size());
+}
+
+void test_unchanged_state_writes_nothing() {
+    tracker.write(current, delta);
+    TEST_ASSERT_FALSE(tracker.write(current, delta));
+    TEST_ASSERT_EQUAL(0, delta.size());
+}
+
+void test_only_changed_fields_are_sent() {
+    tracker.write(current, delta);
+
+    current.presence = "Busy";
+    current.ledPresence[1] = PRESENCE_BUSY;
+    TEST_ASSERT_TRUE(tracker.write(current, delta));
+    TEST_ASSERT_TRUE(delta["state"].isNull());
+    TEST_ASSERT_EQUAL_STRING("Busy", delta["presence"]);
+    TEST_ASSERT_EQUAL(PRESENCE_AVAILABLE, delta["led_presence"][0]);
+    TEST_ASSERT_EQUAL(PRESENCE_BUSY, delta["led_presence"][1]);
+
+    current.state = "error";
+    TEST_ASSERT_TRUE(tracker.write(current, delta));
+    TEST_ASSERT_EQUAL_STRING("error", delta["state"]);
+    TEST_ASSERT_TRUE(delta["presence"].isNull());
+    TEST_ASSERT_TRUE(delta["led_presence"].isNull());
+}
+
+void test_led_count_change_resends_leds() {
+    tracker.write(current, delta);
+
+    current.ledCount = 1;
+    TEST_ASSERT_TRUE(tracker.write(current, delta));
+    TEST_ASSERT_EQUAL(1, delta["led_presence"].size());
+}
+
+void test_reset_reports_everything_again() {
+    tracker.write(current, delta);
+    tracker.reset();
+    TEST_ASSERT_TRUE(tracker.write(current, delta));
+    TEST_ASSERT_EQUAL_STRING("monitoring", delta["state"]);
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_first_write_reports_everything);
+    RUN_TEST(test_unchanged_state_writes_nothing);
+    RUN_TEST(test_only_changed_fields_are_sent);
+    RUN_TEST(test_led_count_change_resends_leds);
+    RUN_TEST(test_reset_reports_everything_again);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
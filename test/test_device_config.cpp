@@ -0,0 +1,205 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "../include/device_config.h"
+#include "../include/alloc_counter.h"
+
+static const uint8_t validPins[] = {2, 4, 5, 12};
+
+static DeviceConfig baseConfig() {
+    DeviceConfig config;
+    config.wifiSSID = "office";
+    config.wifiPassword = "secret";
+    config.tenantId = "common";
+    config.ledCount = 1;
+    config.leds[0] = DeviceConfig::defaultLed(2);
+    return config;
+}
+
+static bool apply(DeviceConfig& config, const char* json, String& error) {
+    DynamicJsonDocument doc(1024);
+    deserializeJson(doc, json);
+    return config.update(doc.as<JsonObjectConst>(), validPins, sizeof(validPins), error);
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_pattern_change_is_not_a_restart() {
+    DeviceConfig before = baseConfig();
+    DeviceConfig after = before;
+    String error;
+    TEST_ASSERT_TRUE(apply(after, "{\"leds\":[{\"call\":0}],\"timezone_offset\":-5}", error));
+    TEST_ASSERT_EQUAL(PATTERN_OFF, after.leds[0].call);
+    TEST_ASSERT_EQUAL(2, after.leds[0].pin);
+    TEST_ASSERT_EQUAL(CONFIG_LED_PATTERNS | CONFIG_TIME, DeviceConfig::diff(before, after));
+
+    StaticJsonDocument<128> names;
+    DeviceConfig::describe(DeviceConfig::diff(before, after), names.to<JsonArray>());
+    String json;
+    serializeJson(names, json);
+    TEST_ASSERT_EQUAL_STRING("[\"time\",\"led_patterns\"]", json.c_str());
+}
+
+void test_empty_secret_keeps_stored_value() {
+    DeviceConfig before = baseConfig();
+    DeviceConfig after = before;
+    String error;
+    TEST_ASSERT_TRUE(apply(after, "{\"wifi_ssid\":\"office\",\"wifi_password\":\"\",\"tenant_id\":\"\"}", error));
+    TEST_ASSERT_EQUAL_STRING("secret", after.wifiPassword.c_str());
+    TEST_ASSERT_EQUAL_STRING("common", after.tenantId.c_str());
+    TEST_ASSERT_EQUAL(0, DeviceConfig::diff(before, after));
+
+    TEST_ASSERT_TRUE(apply(after, "{\"wifi_password\":\"changed\"}", error));
+    TEST_ASSERT_EQUAL(CONFIG_WIFI, DeviceConfig::diff(before, after));
+
+    DeviceConfig relay = before;
+    relay.relayKey = "shared";
+    TEST_ASSERT_TRUE(apply(relay, "{\"relay_key\":\"\"}", error));
+    TEST_ASSERT_EQUAL_STRING("shared", relay.relayKey.c_str());
+    TEST_ASSERT_TRUE(apply(relay, "{\"relay_key\":\"rotated\"}", error));
+    TEST_ASSERT_EQUAL(CONFIG_RELAY, DeviceConfig::diff(before, relay));
+}
+
+void test_added_led_needs_free_valid_pin() {
+    DeviceConfig config = baseConfig();
+    String error;
+    TEST_ASSERT_FALSE(apply(config, "{\"led_count\":2}", error));
+    TEST_ASSERT_EQUAL_STRING("leds[1].pin is required for an added LED", error.c_str());
+    TEST_ASSERT_FALSE(apply(config, "{\"led_count\":2,\"leds\":[{},{\"pin\":2}]}", error));
+    TEST_ASSERT_EQUAL_STRING("leds[1].pin 2 is already used by LED 0", error.c_str());
+    TEST_ASSERT_FALSE(apply(config, "{\"leds\":[{\"pin\":3}]}", error));
+    TEST_ASSERT_EQUAL_STRING("leds[0].pin 3 is not an available GPIO", error.c_str());
+    TEST_ASSERT_EQUAL(1, config.ledCount);
+
+    DeviceConfig before = config;
+    TEST_ASSERT_TRUE(apply(config, "{\"led_count\":2,\"leds\":[{},{\"pin\":4}]}", error));
+    TEST_ASSERT_EQUAL(4, config.leds[1].pin);
+    TEST_ASSERT_EQUAL(DEFAULT_CALL_PATTERN, config.leds[1].call);
+    TEST_ASSERT_EQUAL(CONFIG_LED_PINS, DeviceConfig::diff(before, config));
+}
+
+void test_diff_isolates_subsystems() {
+    DeviceConfig before = baseConfig();
+    String error;
+
+    // Re-sending the current values, as a fleet push does, changes nothing
+    DeviceConfig same = before;
+    TEST_ASSERT_TRUE(apply(same, "{\"wifi_ssid\":\"office\",\"leds\":[{\"pin\":2,\"call\":4}],\"board_mode\":false}", error));
+    TEST_ASSERT_EQUAL(0, DeviceConfig::diff(before, same));
+
+    DeviceConfig moved = before;
+    TEST_ASSERT_TRUE(apply(moved, "{\"leds\":[{\"pin\":5}]}", error));
+    TEST_ASSERT_EQUAL(CONFIG_LED_PINS, DeviceConfig::diff(before, moved));
+
+    DeviceConfig account = before;
+    TEST_ASSERT_TRUE(apply(account, "{\"tenant_id\":\"contoso.onmicrosoft.com\",\"board_roster\":\"a@contoso.com\"}", error));
+    TEST_ASSERT_EQUAL(CONFIG_ACCOUNT | CONFIG_BOARD, DeviceConfig::diff(before, account));
+}
+
+void test_invalid_value_changes_nothing() {
+    DeviceConfig config = baseConfig();
+    String error;
+    TEST_ASSERT_FALSE(apply(config, "{\"wifi_ssid\":\"other\",\"push_ttl\":5}", error));
+    TEST_ASSERT_EQUAL_STRING("office", config.wifiSSID.c_str());
+    TEST_ASSERT_TRUE(error.startsWith("push_ttl must be an integer"));
+    TEST_ASSERT_FALSE(apply(config, "{\"board_mode\":\"yes\"}", error));
+    TEST_ASSERT_FALSE(apply(config, "{\"leds\":[{\"meeting\":42}]}", error));
+    TEST_ASSERT_TRUE(error.startsWith("leds[0].meeting"));
+}
+
+void test_checksum_matches_host_tool() {
+    // zlib.crc32 of the same JSON as written by scripts/provision_fleet.py
+    DynamicJsonDocument doc(256);
+    deserializeJson(doc, "{ \"wifi_ssid\": \"office\", \"leds\": [ {\"pin\": 2, \"call\": 4} ] }");
+    TEST_ASSERT_EQUAL_HEX32(0x87286af8, DeviceConfig::checksum(doc.as<JsonVariantConst>()));
+}
+
+void test_export_import_round_trip() {
+    DeviceConfig source = baseConfig();
+    source.clientId = "4f1c0f4e-app";
+    source.relayKey = "shared";
+    source.leds[0].meeting = PATTERN_DOUBLE_BLINK;
+    DynamicJsonDocument exported(1024);
+    source.exportDocument(exported.to<JsonObject>());
+    TEST_ASSERT_TRUE(exported["config"]["wifi_password"].isNull());
+    TEST_ASSERT_TRUE(exported["config"]["relay_key"].isNull());
+
+    String text;
+    serializeJson(exported, text);
+    DynamicJsonDocument imported(1024);
+    deserializeJson(imported, text);
+    JsonObjectConst config;
+    String error;
+    TEST_ASSERT_TRUE(DeviceConfig::readDocument(imported.as<JsonObjectConst>(), config, error));
+
+    // A device with other settings ends up with the fleet's, keeping its own secrets
+    DeviceConfig target;
+    target.wifiPassword = "local";
+    target.leds[0] = DeviceConfig::defaultLed(2);
+    TEST_ASSERT_TRUE(target.update(config, validPins, sizeof(validPins), error));
+    target.wifiPassword = source.wifiPassword;
+    target.relayKey = source.relayKey;
+    TEST_ASSERT_EQUAL(0, DeviceConfig::diff(source, target));
+}
+
+void test_import_rejects_tampered_document() {
+    DynamicJsonDocument doc(1024);
+    baseConfig().exportDocument(doc.to<JsonObject>());
+    JsonObjectConst config;
+    String error;
+
+    doc["config"]["leds"][0]["pin"] = 4;
+    TEST_ASSERT_FALSE(DeviceConfig::readDocument(doc.as<JsonObjectConst>(), config, error));
+    TEST_ASSERT_EQUAL_STRING("crc32 does not match config", error.c_str());
+
+    doc["version"] = 2;
+    TEST_ASSERT_FALSE(DeviceConfig::readDocument(doc.as<JsonObjectConst>(), config, error));
+    TEST_ASSERT_EQUAL_STRING("version must be 1", error.c_str());
+}
+
+void test_led_keys_match_stored_names() {
+    char key[LED_KEY_SIZE];
+    DeviceConfig::ledKey(LED_KEY_PIN, 0, key);
+    TEST_ASSERT_EQUAL_STRING("led_pin_0", key);
+    DeviceConfig::ledKey(LED_KEY_OFFLINE, MAX_LEDS - 1, key);
+    TEST_ASSERT_EQUAL_STRING((String(KEY_LED_OFFLINE_PATTERN_PREFIX) + (MAX_LEDS - 1)).c_str(), key);
+
+    if (!AllocCounter::enabled()) {
+        TEST_IGNORE_MESSAGE("allocation count needs the esp32dev_alloccheck environment");
+    }
+    AllocWindow window;
+    for (uint8_t i = 0; i < MAX_LEDS; i++) {
+        for (int setting = 0; setting < LED_KEY_COUNT; setting++) {
+            DeviceConfig::ledKey((LedKey)setting, i, key);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, window.allocations());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pattern_change_is_not_a_restart);
+    RUN_TEST(test_empty_secret_keeps_stored_value);
+    RUN_TEST(test_added_led_needs_free_valid_pin);
+    RUN_TEST(test_diff_isolates_subsystems);
+    RUN_TEST(test_invalid_value_changes_nothing);
+    RUN_TEST(test_checksum_matches_host_tool);
+    RUN_TEST(test_export_import_round_trip);
+    RUN_TEST(test_import_rejects_tampered_document);
+    RUN_TEST(test_led_keys_match_stored_names);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <StreamString.h>
+#include <ArduinoJson.h>
+#include "../include/graph_stream.h"
+
+static StaticJsonDocument<128> filter;
+static StaticJsonDocument<256> item;
+
+void setUp(void) {
+    filter.clear();
+    filter["id"] = true;
+    filter["subject"] = true;
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_reads_items_and_delta_link() {
+    StreamString input;
+    input.print("{\"@odata.context\":\"https://graph.microsoft.com/v1.0/$metadata#events\","
+                "\"value\":[{\"id\":\"a\",\"subject\":\"Standup\",\"body\":{\"content\":\"long text\"}},"
+                "{\"id\":\"b\",\"subject\":\"Review\"}],"
+                "\"@odata.deltaLink\":\"https://graph.microsoft.com/v1.0/me/calendarView/delta?$deltatoken=abc\"}");
+
+    int seen = 0;
+    GraphPageReader reader(input, item, filter);
+    TEST_ASSERT_TRUE(reader.read([&](JsonObject event) {
+        seen++;
+        TEST_ASSERT_TRUE(event["body"].isNull()); // Filtered out
+        TEST_ASSERT_NOT_NULL(event["subject"].as<const char*>());
+    }));
+
+    TEST_ASSERT_EQUAL(2, seen);
+    TEST_ASSERT_EQUAL(2, reader.itemCount());
+    TEST_ASSERT_EQUAL_STRING("", reader.nextLink().c_str());
+    TEST_ASSERT_EQUAL_STRING("https://graph.microsoft.com/v1.0/me/calendarView/delta?$deltatoken=abc", reader.deltaLink().c_str());
+}
+
+void test_next_link_before_value() {
+    StreamString input;
+    input.print("{ \"@odata.nextLink\" : \"https://graph/next?a=1\\u0026b=2\", \"@odata.count\": 42,"
+                " \"flag\": true, \"value\" : [ ] }");
+
+    GraphPageReader reader(input, item, filter);
+    TEST_ASSERT_TRUE(reader.read([](JsonObject) {}));
+    TEST_ASSERT_EQUAL(0, reader.itemCount());
+    TEST_ASSERT_EQUAL_STRING("https://graph/next?a=1&b=2", reader.nextLink().c_str());
+}
+
+void test_skips_nested_unknown_values() {
+    StreamString input;
+    input.print("{\"meta\":{\"list\":[1,2,{\"x\":\"}]\"}],\"n\":null},\"value\":[{\"id\":\"c\"}]}");
+
+    GraphPageReader reader(input, item, filter);
+    TEST_ASSERT_TRUE(reader.read([](JsonObject event) {
+        TEST_ASSERT_EQUAL_STRING("c", event["id"].as<const char*>());
+    }));
+    TEST_ASSERT_EQUAL(1, reader.itemCount());
+}
+
+void test_malformed_page_reports_error() {
+    StreamString input;
+    input.print("[1,2,3]");
+
+    GraphPageReader reader(input, item, filter);
+    TEST_ASSERT_FALSE(reader.read([](JsonObject) {}));
+    TEST_ASSERT_EQUAL_STRING("expected object", reader.error());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reads_items_and_delta_link);
+    RUN_TEST(test_next_link_before_value);
+    RUN_TEST(test_skips_nested_unknown_values);
+    RUN_TEST(test_malformed_page_reports_error);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,106 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/gzip_stream.h"
+
+static uint8_t output[8192];
+
+// Compresses text, feeding and draining it in small pieces like a slow socket
+static size_t compress(const String& text, size_t sourceChunk, size_t outputChunk) {
+    size_t offset = 0;
+    GzipStream stream([&](uint8_t* buffer, size_t maxLength) -> size_t {
+        size_t count = min(min(maxLength, sourceChunk), text.length() - offset);
+        memcpy(buffer, text.c_str() + offset, count);
+        offset += count;
+        return count;
+    });
+    size_t total = 0;
+    size_t written;
+    while ((written = stream.fill(output + total, min(outputChunk, sizeof(output) - total))) > 0) {
+        total += written;
+    }
+    TEST_ASSERT_TRUE(stream.finished());
+    TEST_ASSERT_EQUAL(text.length(), stream.inputBytes());
+    TEST_ASSERT_EQUAL(total, stream.outputBytes());
+    return total;
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_crc32_check_value() {
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, GzipStream::crc32(0, (const uint8_t*)"123456789", 9));
+    // Incremental updates give the same result
+    uint32_t crc = GzipStream::crc32(0, (const uint8_t*)"1234", 4);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, GzipStream::crc32(crc, (const uint8_t*)"56789", 5));
+}
+
+void test_known_output() {
+    // Checked against Python's gzip.decompress()
+    static const uint8_t empty[] = {
+        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x02, 0x0c,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    TEST_ASSERT_EQUAL(sizeof(empty), compress("", 16, 16));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(empty, output, sizeof(empty));
+
+    static const uint8_t repeated[] = {
+        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x2a, 0x49,
+        0x4d, 0xcc, 0x2d, 0x2e, 0x4a, 0x4d, 0xc9, 0xc9, 0x4c, 0xcf, 0x28, 0x51,
+        0xc0, 0xc3, 0x03, 0x0c, 0x00, 0xce, 0x0c, 0xf5, 0x33, 0x29, 0x00, 0x00,
+        0x00
+    };
+    TEST_ASSERT_EQUAL(sizeof(repeated), compress("teamsredlight teamsredlight teamsredlight", 5, 3));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(repeated, output, sizeof(repeated));
+}
+
+void test_output_independent_of_chunking() {
+    // Longer than the window, so matches cross a buffer slide
+    String json = "{\"logs\":[";
+    for (int i = 0; i < 60; i++) {
+        json += "{\"seq\":" + String(i) + ",\"level\":\"INFO\",\"component\":\"checkTeamsPresence\",\"message\":\"Presence is Busy\"},";
+    }
+    json += "{}]}";
+
+    size_t length = compress(json, 4096, 4096);
+    TEST_ASSERT_TRUE(length < json.length() / 4);
+    uint8_t expected[1024];
+    TEST_ASSERT_TRUE(length <= sizeof(expected));
+    memcpy(expected, output, length);
+
+    TEST_ASSERT_EQUAL(length, compress(json, 1, 7));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, output, length);
+    TEST_ASSERT_EQUAL(length, compress(json, 300, 1));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, output, length);
+}
+
+void test_stream_slots() {
+    TEST_ASSERT_TRUE(GzipStream::available());
+    {
+        GzipStream first([](uint8_t*, size_t) -> size_t { return 0; });
+        GzipStream second([](uint8_t*, size_t) -> size_t { return 0; });
+        TEST_ASSERT_FALSE(GzipStream::available());
+    }
+    TEST_ASSERT_TRUE(GzipStream::available());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_known_output);
+    RUN_TEST(test_output_independent_of_chunking);
+    RUN_TEST(test_stream_slots);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
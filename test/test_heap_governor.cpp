@@ -0,0 +1,99 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/heap_governor.h"
+
+static const uint32_t PLENTY = 120000;
+
+static HeapGovernor governor;
+
+void setUp(void) {
+    governor = HeapGovernor();
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_levels_follow_free_heap() {
+    TEST_ASSERT_EQUAL(HEAP_NORMAL, HeapGovernor::levelFor(PLENTY, PLENTY, 0));
+    TEST_ASSERT_EQUAL(HEAP_DEFER_FETCHES, HeapGovernor::levelFor(HEAP_DEFER_FREE - 1, PLENTY, 0));
+    TEST_ASSERT_EQUAL(HEAP_CACHED_ONLY, HeapGovernor::levelFor(HEAP_CACHED_FREE - 1, PLENTY, 0));
+    TEST_ASSERT_EQUAL(HEAP_SHRINK_BUFFERS, HeapGovernor::levelFor(HEAP_SHRINK_FREE - 1, PLENTY, 0));
+    TEST_ASSERT_EQUAL(HEAP_REFUSE_REQUESTS, HeapGovernor::levelFor(HEAP_REFUSE_FREE - 1, PLENTY, 0));
+}
+
+void test_fragmented_heap_counts_as_low() {
+    // Plenty free in total, but no block large enough for a TLS record buffer
+    TEST_ASSERT_EQUAL(HEAP_REFUSE_REQUESTS, HeapGovernor::levelFor(PLENTY, HEAP_REFUSE_BLOCK - 1, 0));
+    TEST_ASSERT_EQUAL(HEAP_CACHED_ONLY, HeapGovernor::levelFor(PLENTY, HEAP_CACHED_BLOCK - 1, 0));
+}
+
+void test_measures_accumulate() {
+    governor.sample(HEAP_SHRINK_FREE - 1, PLENTY);
+    TEST_ASSERT_TRUE(governor.deferFetches());
+    TEST_ASSERT_TRUE(governor.cachedOnly());
+    TEST_ASSERT_TRUE(governor.shrinkBuffers());
+    TEST_ASSERT_FALSE(governor.refuseRequests());
+}
+
+void test_recovery_needs_margin() {
+    TEST_ASSERT_TRUE(governor.sample(HEAP_DEFER_FREE - 1, PLENTY));
+    TEST_ASSERT_EQUAL(HEAP_DEFER_FETCHES, governor.level());
+
+    // Just above the threshold is not enough to leave the level
+    TEST_ASSERT_FALSE(governor.sample(HEAP_DEFER_FREE + 1, PLENTY));
+    TEST_ASSERT_EQUAL(HEAP_DEFER_FETCHES, governor.level());
+
+    TEST_ASSERT_TRUE(governor.sample(HEAP_DEFER_FREE + HEAP_RECOVERY_MARGIN, PLENTY));
+    TEST_ASSERT_EQUAL(HEAP_NORMAL, governor.level());
+}
+
+void test_recovery_steps_down_with_heap() {
+    governor.sample(HEAP_REFUSE_FREE - 1, PLENTY);
+    TEST_ASSERT_EQUAL(HEAP_REFUSE_REQUESTS, governor.level());
+
+    // Freed enough to clear the refuse threshold with margin, still under the shrink one
+    governor.sample(HEAP_REFUSE_FREE + HEAP_RECOVERY_MARGIN, PLENTY);
+    TEST_ASSERT_EQUAL(HEAP_SHRINK_BUFFERS, governor.level());
+
+    governor.sample(PLENTY, PLENTY);
+    TEST_ASSERT_EQUAL(HEAP_NORMAL, governor.level());
+}
+
+void test_watermarks() {
+    governor.sample(90000, 60000);
+    governor.sample(HEAP_CACHED_FREE - 1, 20000);
+    governor.sample(PLENTY, PLENTY);
+
+    TEST_ASSERT_EQUAL(HEAP_CACHED_FREE - 1, governor.lowestFree());
+    TEST_ASSERT_EQUAL(20000, governor.lowestLargestBlock());
+    TEST_ASSERT_EQUAL(HEAP_SHRINK_BUFFERS, governor.highestLevel());
+    TEST_ASSERT_EQUAL(1, governor.timesEntered(HEAP_SHRINK_BUFFERS));
+    TEST_ASSERT_EQUAL(0, governor.timesEntered(HEAP_REFUSE_REQUESTS));
+    TEST_ASSERT_EQUAL(HEAP_NORMAL, governor.level());
+}
+
+void test_level_names() {
+    TEST_ASSERT_EQUAL_STRING("normal", HeapGovernor::levelName(HEAP_NORMAL));
+    TEST_ASSERT_EQUAL_STRING("refuse_requests", HeapGovernor::levelName(HEAP_REFUSE_REQUESTS));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_levels_follow_free_heap);
+    RUN_TEST(test_fragmented_heap_counts_as_low);
+    RUN_TEST(test_measures_accumulate);
+    RUN_TEST(test_recovery_needs_margin);
+    RUN_TEST(test_recovery_steps_down_with_heap);
+    RUN_TEST(test_watermarks);
+    RUN_TEST(test_level_names);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "../include/heap_trace.h"
+
+static HeapReading reading(uint32_t freeHeap, uint32_t largestBlock, uint32_t allocations = 0, uint32_t frees = 0) {
+    HeapReading heap = {};
+    heap.freeHeap = freeHeap;
+    heap.minFreeHeap = freeHeap;
+    heap.largestBlock = largestBlock;
+    heap.allocations = allocations;
+    heap.frees = frees;
+    return heap;
+}
+
+void setUp(void) {
+    HeapTrace::clear();
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_spans_add_up_per_point() {
+    HeapTrace::recordSpan(TRACE_GRAPH_PRESENCE, reading(100000, 40000, 10, 10), reading(99000, 40000, 14, 12), 5);
+    HeapTrace::recordSpan(TRACE_GRAPH_PRESENCE, reading(99000, 40000, 14, 12), reading(99500, 40000, 15, 15), 35);
+
+    HeapPointTotals totals;
+    TEST_ASSERT_TRUE(HeapTrace::pointAt(TRACE_GRAPH_PRESENCE, totals));
+    TEST_ASSERT_EQUAL_STRING("graph", totals.kind);
+    TEST_ASSERT_EQUAL_STRING("presence", totals.name);
+    TEST_ASSERT_EQUAL(2, totals.calls);
+    TEST_ASSERT_EQUAL(-500, totals.netFree);
+    TEST_ASSERT_EQUAL(1000, totals.worstDrop);
+    TEST_ASSERT_EQUAL(0, totals.netAllocations);
+
+    HeapTrace::recordSpan(-1, reading(1, 1), reading(1, 1), 40);
+    TEST_ASSERT_EQUAL(2, HeapTrace::spanCount());
+}
+
+void test_span_ring_keeps_the_newest() {
+    for (uint32_t i = 0; i < HEAP_TRACE_SPANS + 3; i++) {
+        HeapTrace::recordSpan(TRACE_SAVE_CONFIG, reading(90000, 30000), reading(90000, 30000), i);
+    }
+    TEST_ASSERT_EQUAL(HEAP_TRACE_SPANS, HeapTrace::spanCount());
+
+    HeapSpan span;
+    TEST_ASSERT_TRUE(HeapTrace::spanAt(0, span));
+    TEST_ASSERT_EQUAL(3, span.uptime);
+    TEST_ASSERT_TRUE(HeapTrace::spanAt(HEAP_TRACE_SPANS - 1, span));
+    TEST_ASSERT_EQUAL(HEAP_TRACE_SPANS + 2, span.uptime);
+    TEST_ASSERT_FALSE(HeapTrace::spanAt(HEAP_TRACE_SPANS, span));
+}
+
+void test_series_halves_when_full() {
+    for (uint32_t i = 0; i < HEAP_TRACE_SERIES; i++) {
+        HeapTrace::recordSample(i * HEAP_TRACE_INTERVAL, reading(100000 - i, 50000 - i));
+    }
+    TEST_ASSERT_EQUAL(HEAP_TRACE_SERIES, HeapTrace::sampleCount());
+    TEST_ASSERT_EQUAL(HEAP_TRACE_INTERVAL, HeapTrace::sampleInterval());
+
+    HeapTrace::recordSample(HEAP_TRACE_SERIES * HEAP_TRACE_INTERVAL, reading(1000, 500));
+    TEST_ASSERT_EQUAL(HEAP_TRACE_SERIES / 2 + 1, HeapTrace::sampleCount());
+    TEST_ASSERT_EQUAL(2 * HEAP_TRACE_INTERVAL, HeapTrace::sampleInterval());
+
+    HeapSample sample;
+    TEST_ASSERT_TRUE(HeapTrace::sampleAt(0, sample));
+    TEST_ASSERT_EQUAL(HEAP_TRACE_INTERVAL, sample.uptime);
+    TEST_ASSERT_EQUAL(50000 - 1, sample.lowestLargestBlock);
+    TEST_ASSERT_TRUE(HeapTrace::sampleAt(HEAP_TRACE_SERIES / 2, sample));
+    TEST_ASSERT_EQUAL(1000, sample.reading.freeHeap);
+}
+
+void test_sample_keeps_smallest_block_seen_by_spans() {
+    HeapTrace::recordSpan(TRACE_GRAPH_TOKEN, reading(80000, 20000), reading(70000, 9000), 10);
+    HeapTrace::recordSample(60, reading(80000, 20000));
+    HeapTrace::recordSample(120, reading(80000, 20000));
+
+    HeapSample sample;
+    TEST_ASSERT_TRUE(HeapTrace::sampleAt(0, sample));
+    TEST_ASSERT_EQUAL(9000, sample.lowestLargestBlock);
+    TEST_ASSERT_TRUE(HeapTrace::sampleAt(1, sample));
+    TEST_ASSERT_EQUAL(20000, sample.lowestLargestBlock);
+}
+
+void test_registered_points_follow_fixed_ones() {
+    int point = HeapTrace::registerPoint("GET", "/api/heap");
+    TEST_ASSERT_GREATER_OR_EQUAL(TRACE_FIXED_POINTS, point);
+    TEST_ASSERT_EQUAL(point + 1, HeapTrace::pointCount());
+
+    HeapPointTotals totals;
+    TEST_ASSERT_TRUE(HeapTrace::pointAt(point, totals));
+    TEST_ASSERT_EQUAL_STRING("/api/heap", totals.name);
+    TEST_ASSERT_EQUAL(0, totals.calls);
+}
+
+void test_produce_writes_series_spans_and_points() {
+    HeapTrace::recordSample(60, reading(100000, 50000));
+    HeapTrace::recordSpan(TRACE_SAVE_PRESENCE_HISTORY, reading(100000, 50000), reading(99800, 50000), 70);
+
+    String body;
+    JsonChunkWriter(HeapTrace::produce).writeTo(body);
+
+    DynamicJsonDocument doc(8192);
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(doc, body).code());
+    TEST_ASSERT_TRUE(doc["free_heap"].is<uint32_t>());
+    TEST_ASSERT_EQUAL(HEAP_TRACE_INTERVAL, doc["sample_interval"].as<uint32_t>());
+    TEST_ASSERT_EQUAL(1, doc["series"].size());
+    TEST_ASSERT_EQUAL(50000, doc["series"][0]["largest_free_block"].as<uint32_t>());
+    TEST_ASSERT_EQUAL(1, doc["spans"].size());
+    TEST_ASSERT_EQUAL_STRING("presence_history", doc["spans"][0]["point"].as<const char*>());
+    TEST_ASSERT_EQUAL(99800, doc["spans"][0]["after"]["free_heap"].as<uint32_t>());
+    TEST_ASSERT_EQUAL(1, doc["points"].size());
+    TEST_ASSERT_EQUAL(-200, doc["points"][0]["net_free_heap"].as<int>());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_spans_add_up_per_point);
+    RUN_TEST(test_span_ring_keeps_the_newest);
+    RUN_TEST(test_series_halves_when_full);
+    RUN_TEST(test_sample_keeps_smallest_block_seen_by_spans);
+    RUN_TEST(test_registered_points_follow_fixed_ones);
+    RUN_TEST(test_produce_writes_series_spans_and_points);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
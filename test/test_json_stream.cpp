@@ -0,0 +1,131 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "../include/json_stream.h"
+
+// Drains the writer through a deliberately small buffer, like a slow socket
+static String drain(JsonChunkWriter& writer, size_t chunkSize) {
+    String output;
+    uint8_t buffer[16];
+    size_t written;
+    while ((written = writer.fill(buffer, chunkSize)) > 0) {
+        output.concat((const char*)buffer, written);
+    }
+    return output;
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_streams_object_with_array() {
+    JsonChunkWriter writer([](JsonChunkWriter& out, size_t step) {
+        StaticJsonDocument<128> doc;
+        if (step == 0) {
+            doc["state"] = "monitoring";
+            doc["uptime"] = 42;
+            out.beginObject();
+            out.members(doc);
+            out.beginArray("leds");
+            return true;
+        }
+        if (step <= 3) {
+            doc["id"] = step - 1;
+            out.element(doc);
+            return true;
+        }
+        out.endArray();
+        doc["total"] = 3;
+        out.members(doc);
+        out.endObject();
+        return false;
+    });
+
+    TEST_ASSERT_EQUAL_STRING("{\"state\":\"monitoring\",\"uptime\":42,\"leds\":[{\"id\":0},{\"id\":1},{\"id\":2}],\"total\":3}",
+                             drain(writer, 7).c_str());
+}
+
+void test_empty_array_and_escaping() {
+    JsonChunkWriter writer([](JsonChunkWriter& out, size_t step) {
+        StaticJsonDocument<128> doc;
+        doc["message"] = "say \"hi\"\n";
+        out.beginObject();
+        out.beginArray("logs");
+        out.endArray();
+        out.members(doc);
+        out.endObject();
+        return false;
+    });
+
+    String output = drain(writer, 1);
+    TEST_ASSERT_EQUAL_STRING("{\"logs\":[],\"message\":\"say \\\"hi\\\"\\n\"}", output.c_str());
+
+    StaticJsonDocument<128> parsed;
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(parsed, output).code());
+}
+
+void test_output_is_independent_of_chunk_size() {
+    JsonChunkWriter::Producer producer = [](JsonChunkWriter& out, size_t step) {
+        if (step == 0) {
+            out.beginArray();
+            return true;
+        }
+        if (step <= 100) {
+            StaticJsonDocument<64> doc;
+            doc["n"] = step;
+            out.element(doc);
+            return true;
+        }
+        out.endArray();
+        return false;
+    };
+
+    JsonChunkWriter small(producer);
+    JsonChunkWriter large(producer);
+    String a = drain(small, 3);
+    String b = drain(large, 16);
+    TEST_ASSERT_EQUAL_STRING(a.c_str(), b.c_str());
+
+    DynamicJsonDocument parsed(8192);
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(parsed, a).code());
+    TEST_ASSERT_EQUAL(100, parsed.as<JsonArray>().size());
+}
+
+void test_oversized_element_becomes_null() {
+    JsonChunkWriter writer([](JsonChunkWriter& out, size_t step) {
+        DynamicJsonDocument doc(JSON_STREAM_FRAGMENT_SIZE * 2);
+        String big;
+        while (big.length() < JSON_STREAM_FRAGMENT_SIZE) {
+            big += "0123456789";
+        }
+        doc["message"] = big;
+        out.beginArray();
+        out.element(doc);
+        out.endArray();
+        return false;
+    });
+
+    TEST_ASSERT_EQUAL_STRING("[null]", drain(writer, 16).c_str());
+    TEST_ASSERT_EQUAL(1, writer.dropped());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_streams_object_with_array);
+    RUN_TEST(test_empty_array_and_escaping);
+    RUN_TEST(test_output_is_independent_of_chunk_size);
+    RUN_TEST(test_oversized_element_becomes_null);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
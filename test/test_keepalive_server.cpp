@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/keepalive_server.h"
+
+static char buffer[KEEPALIVE_REQUEST_SIZE];
+
+// Copies text into the buffer (parse() works in place) and parses it
+static int parse(const char* text, KeepAliveRequest& request) {
+    strlcpy(buffer, text, sizeof(buffer));
+    return KeepAliveServer::parse(buffer, strlen(text), request);
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_parse_request_head() {
+    KeepAliveRequest request;
+    const char* text = "GET /status?format=msgpack HTTP/1.1\r\nHost: 10.0.0.5:8080\r\n"
+                       "accept: application/msgpack\r\nIf-None-Match: \"1a2b-3\"\r\n\r\n";
+    TEST_ASSERT_EQUAL(strlen(text), parse(text, request));
+    TEST_ASSERT_EQUAL_STRING("GET", request.method);
+    TEST_ASSERT_EQUAL_STRING("/status", request.path);
+    TEST_ASSERT_EQUAL_STRING("format=msgpack", request.query);
+    TEST_ASSERT_EQUAL_STRING("application/msgpack", request.accept);
+    TEST_ASSERT_EQUAL_STRING("\"1a2b-3\"", request.ifNoneMatch);
+    TEST_ASSERT_TRUE(request.http11);
+    TEST_ASSERT_TRUE(request.keepAlive);
+    TEST_ASSERT_FALSE(request.hasBody);
+}
+
+void test_connection_header_decides_keep_alive() {
+    KeepAliveRequest closing;
+    parse("GET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n", closing);
+    TEST_ASSERT_FALSE(closing.keepAlive);
+
+    KeepAliveRequest legacy;
+    parse("GET /metrics HTTP/1.0\r\n\r\n", legacy);
+    TEST_ASSERT_FALSE(legacy.http11);
+    TEST_ASSERT_FALSE(legacy.keepAlive);
+
+    KeepAliveRequest asked;
+    parse("GET /metrics HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", asked);
+    TEST_ASSERT_TRUE(asked.keepAlive);
+}
+
+void test_pipelined_requests_parse_one_at_a_time() {
+    KeepAliveRequest first;
+    const char* text = "GET /status HTTP/1.1\r\n\r\nGET /api/snapshot HTTP/1.1\r\n\r\n";
+    strlcpy(buffer, text, sizeof(buffer));
+    int length = KeepAliveServer::parse(buffer, strlen(text), first);
+    TEST_ASSERT_EQUAL(24, length);
+    TEST_ASSERT_EQUAL_STRING("/status", first.path);
+
+    KeepAliveRequest second;
+    TEST_ASSERT_EQUAL(strlen(text) - 24, KeepAliveServer::parse(buffer + length, strlen(text) - length, second));
+    TEST_ASSERT_EQUAL_STRING("/api/snapshot", second.path);
+}
+
+void test_incomplete_and_malformed_heads() {
+    KeepAliveRequest request;
+    TEST_ASSERT_EQUAL(0, parse("GET /status HTTP/1.1\r\nHost: x\r\n", request));
+    TEST_ASSERT_EQUAL(-1, parse("GET /status\r\n\r\n", request));
+    TEST_ASSERT_EQUAL(-1, parse("GET status HTTP/1.1\r\n\r\n", request));
+    TEST_ASSERT_EQUAL(-1, parse("GET /status HTTP/2\r\n\r\n", request));
+    TEST_ASSERT_EQUAL(-1, parse("GET /status HTTP/1.1\r\nno colon\r\n\r\n", request));
+
+    KeepAliveRequest post;
+    parse("POST /status HTTP/1.1\r\nContent-Length: 12\r\n\r\n", post);
+    TEST_ASSERT_TRUE(post.hasBody);
+}
+
+void test_query_args() {
+    KeepAliveRequest request;
+    parse("GET /status?pretty&format=msgpack&x=1 HTTP/1.1\r\n\r\n", request);
+    char value[8];
+    TEST_ASSERT_TRUE(request.queryArg("format", value, sizeof(value)));
+    TEST_ASSERT_EQUAL_STRING("msgpack", value);
+    TEST_ASSERT_TRUE(request.queryArg("pretty", value, sizeof(value)));
+    TEST_ASSERT_EQUAL_STRING("", value);
+    TEST_ASSERT_FALSE(request.queryArg("form", value, sizeof(value)));
+    TEST_ASSERT_FALSE(request.queryArg("since", value, sizeof(value)));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_request_head);
+    RUN_TEST(test_connection_header_decides_keep_alive);
+    RUN_TEST(test_pipelined_requests_parse_one_at_a_time);
+    RUN_TEST(test_incomplete_and_malformed_heads);
+    RUN_TEST(test_query_args);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,97 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/local_push.h"
+
+static LocalPresencePush push;
+
+void setUp(void) {
+    push = LocalPresencePush();
+    push.begin("0123456789abcdef", 60);
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_authorize_accepts_bearer_and_bare_key() {
+    TEST_ASSERT_TRUE(push.authorize("Bearer 0123456789abcdef"));
+    TEST_ASSERT_TRUE(push.authorize("0123456789abcdef"));
+}
+
+void test_authorize_rejects_wrong_keys() {
+    TEST_ASSERT_FALSE(push.authorize(""));
+    TEST_ASSERT_FALSE(push.authorize("Bearer "));
+    TEST_ASSERT_FALSE(push.authorize("Bearer 0123456789abcdeX"));
+    TEST_ASSERT_FALSE(push.authorize("Bearer 0123456789abcde"));
+    TEST_ASSERT_FALSE(push.authorize("Bearer 0123456789abcdef0"));
+}
+
+void test_authorize_rejects_everything_without_key() {
+    LocalPresencePush unconfigured;
+    unconfigured.begin("", 60);
+    TEST_ASSERT_FALSE(unconfigured.authorize(""));
+    TEST_ASSERT_FALSE(unconfigured.authorize("Bearer "));
+}
+
+void test_apply_uses_default_ttl() {
+    push.apply(PRESENCE_IN_MEETING, 0, "teams-agent");
+    TEST_ASSERT_TRUE(push.isActive());
+    TEST_ASSERT_EQUAL(PRESENCE_IN_MEETING, push.presence());
+    TEST_ASSERT_EQUAL_STRING("teams-agent", push.source());
+    TEST_ASSERT_EQUAL(60, push.remainingSeconds());
+    TEST_ASSERT_EQUAL(1, push.pushesReceived());
+}
+
+void test_apply_clamps_ttl() {
+    push.apply(PRESENCE_BUSY, LOCAL_PUSH_MAX_TTL * 10, "");
+    TEST_ASSERT_EQUAL(LOCAL_PUSH_MAX_TTL, push.remainingSeconds());
+    TEST_ASSERT_EQUAL_STRING("agent", push.source());
+}
+
+void test_push_expires_once() {
+    push.apply(PRESENCE_BUSY, 1, "agent");
+    TEST_ASSERT_FALSE(push.expired());
+    delay(1100);
+    TEST_ASSERT_TRUE(push.expired());
+    TEST_ASSERT_FALSE(push.isActive());
+    TEST_ASSERT_FALSE(push.expired());
+}
+
+void test_clear_does_not_report_expiry() {
+    push.apply(PRESENCE_BUSY, 1, "agent");
+    push.clear();
+    delay(1100);
+    TEST_ASSERT_FALSE(push.expired());
+    TEST_ASSERT_EQUAL(0, push.remainingSeconds());
+}
+
+void test_generated_keys_are_hex_and_unique() {
+    String first = LocalPresencePush::generateKey();
+    String second = LocalPresencePush::generateKey();
+    TEST_ASSERT_EQUAL(LOCAL_PUSH_KEY_BYTES * 2, first.length());
+    TEST_ASSERT_TRUE(first != second);
+    for (size_t i = 0; i < first.length(); i++) {
+        TEST_ASSERT_TRUE(isxdigit(first[i]));
+    }
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_authorize_accepts_bearer_and_bare_key);
+    RUN_TEST(test_authorize_rejects_wrong_keys);
+    RUN_TEST(test_authorize_rejects_everything_without_key);
+    RUN_TEST(test_apply_uses_default_ttl);
+    RUN_TEST(test_apply_clamps_ttl);
+    RUN_TEST(test_push_expires_once);
+    RUN_TEST(test_clear_does_not_report_expiry);
+    RUN_TEST(test_generated_keys_are_hex_and_unique);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
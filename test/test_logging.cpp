@@ -108,6 +108,31 @@ void test_formatted_logging() {
     TEST_ASSERT_TRUE(true);
 }
 
+void test_log_buffer_shrinks_to_newest_entries() {
+    LogBuffer buffer;
+    for (int i = 0; i < LOG_BUFFER_SIZE + 5; i++) {
+        buffer.addEntry(LOG_LEVEL_INFO, "test", String(i));
+    }
+    
+    buffer.setCapacity(LOG_BUFFER_SHRUNK_SIZE);
+    TEST_ASSERT_EQUAL(LOG_BUFFER_SHRUNK_SIZE, buffer.size());
+    StaticJsonDocument<256> doc;
+    JsonObject oldest = doc.to<JsonObject>();
+    buffer.entryToJson(0, oldest);
+    TEST_ASSERT_EQUAL(LOG_BUFFER_SIZE + 5 - LOG_BUFFER_SHRUNK_SIZE + 1, oldest["seq"].as<int>());
+    
+    // The ring keeps going at the smaller size, then grows back without loss
+    buffer.addEntry(LOG_LEVEL_INFO, "test", "newest");
+    TEST_ASSERT_EQUAL(LOG_BUFFER_SHRUNK_SIZE, buffer.size());
+    buffer.setCapacity(LOG_BUFFER_SIZE);
+    buffer.addEntry(LOG_LEVEL_INFO, "test", "after");
+    TEST_ASSERT_EQUAL(LOG_BUFFER_SHRUNK_SIZE + 1, buffer.size());
+    JsonObject newest = doc.to<JsonObject>();
+    buffer.entryToJson(buffer.size() - 1, newest);
+    TEST_ASSERT_EQUAL_STRING("after", newest["message"]);
+    TEST_ASSERT_EQUAL(buffer.lastSeq(), newest["seq"].as<uint32_t>());
+}
+
 void setup() {
     delay(2000); // Wait for serial monitor
     
@@ -121,6 +146,7 @@ void setup() {
     RUN_TEST(test_basic_logging_functions);
     RUN_TEST(test_logging_level_filtering);
     RUN_TEST(test_formatted_logging);
+    RUN_TEST(test_log_buffer_shrinks_to_newest_entries);
     
     UNITY_END();
 }
@@ -0,0 +1,104 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/metrics.h"
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+// Runs a whole scrape through a small buffer, the way the web server would
+String scrape() {
+    uint32_t ticket = Metrics::beginScrape();
+    TEST_ASSERT_NOT_EQUAL(0, ticket);
+    String text;
+    uint8_t buffer[100];
+    size_t written;
+    while ((written = Metrics::fillScrape(ticket, buffer, sizeof(buffer))) > 0) {
+        text.concat((const char*)buffer, written);
+    }
+    return text;
+}
+
+void test_histogram_buckets_by_upper_bound() {
+    LatencyHistogram histogram = {};
+    histogram.observe(0);
+    histogram.observe(1000);       // 1 ms is inside the first bucket
+    histogram.observe(1001);
+    histogram.observe(30000000);   // Past the last bound
+
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.buckets[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[METRICS_BUCKET_COUNT - 1]);
+    TEST_ASSERT_EQUAL_UINT32(4, histogram.count);
+    TEST_ASSERT_EQUAL_UINT64(30002001ULL, histogram.sumMicros);
+}
+
+void test_route_observations() {
+    int route = Metrics::registerRoute("GET", "/status");
+    TEST_ASSERT_TRUE(route >= 0);
+    Metrics::observeRoute(route, 2000);
+    Metrics::observeRoute(route, 2000);
+    Metrics::observeRoute(-1, 2000);  // Unregistered routes are ignored
+
+    LatencyHistogram histogram = Metrics::routeHistogram(route);
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.count);
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.buckets[1]);
+}
+
+void test_scrape_renders_cumulative_buckets() {
+    int route = Metrics::registerRoute("POST", "/api/presence");
+    Metrics::observeRoute(route, 500);
+    Metrics::observeRoute(route, 3000);
+    Metrics::observeRoute(route, 20000000);
+    Metrics::countTokenRefresh(true);
+    Metrics::countNvsWrite();
+
+    String text = scrape();
+    TEST_ASSERT_TRUE(text.indexOf("# TYPE teamsredlight_http_request_duration_seconds histogram\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_http_request_duration_seconds_bucket{method=\"POST\",path=\"/api/presence\",le=\"0.001\"} 1\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_http_request_duration_seconds_bucket{method=\"POST\",path=\"/api/presence\",le=\"0.005\"} 2\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_http_request_duration_seconds_bucket{method=\"POST\",path=\"/api/presence\",le=\"+Inf\"} 3\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_http_request_duration_seconds_sum{method=\"POST\",path=\"/api/presence\"} 20.003500\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_http_request_duration_seconds_count{method=\"POST\",path=\"/api/presence\"} 3\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_token_refreshes_total{result=\"success\"} 1\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_nvs_writes_total 1\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_loop_duration_seconds_count 0\n") >= 0);
+    TEST_ASSERT_TRUE(text.indexOf("teamsredlight_heap_free_bytes ") >= 0);
+}
+
+void test_one_scrape_at_a_time() {
+    uint32_t first = Metrics::beginScrape();
+    TEST_ASSERT_NOT_EQUAL(0, first);
+    TEST_ASSERT_EQUAL(0, Metrics::beginScrape());
+
+    // Draining the first scrape frees the buffer for the next one
+    uint8_t buffer[256];
+    while (Metrics::fillScrape(first, buffer, sizeof(buffer)) > 0) {
+    }
+    uint32_t second = Metrics::beginScrape();
+    TEST_ASSERT_NOT_EQUAL(0, second);
+    TEST_ASSERT_EQUAL(0, Metrics::fillScrape(first, buffer, sizeof(buffer)));
+    while (Metrics::fillScrape(second, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_histogram_buckets_by_upper_bound);
+    RUN_TEST(test_route_observations);
+    RUN_TEST(test_scrape_renders_cumulative_buckets);
+    RUN_TEST(test_one_scrape_at_a_time);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
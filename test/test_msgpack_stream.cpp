@@ -0,0 +1,149 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "../include/msgpack_stream.h"
+
+static uint8_t output[4096];
+
+// Drains the writer through a deliberately small buffer, like a slow socket
+static size_t drain(MsgPackChunkWriter& writer, size_t chunkSize) {
+    size_t total = 0;
+    size_t written;
+    while ((written = writer.fill(output + total, min(chunkSize, sizeof(output) - total))) > 0) {
+        total += written;
+    }
+    return total;
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_streams_map_with_rows() {
+    MsgPackChunkWriter writer([](MsgPackChunkWriter& out, size_t step) {
+        StaticJsonDocument<128> doc;
+        if (step == 0) {
+            doc["state"] = 5;
+            doc["uptime"] = 42;
+            out.beginMap(nullptr, doc.size() + 2);
+            out.members(doc);
+            out.beginArray("leds", 3);
+            return true;
+        }
+        if (step <= 3) {
+            JsonArray row = doc.to<JsonArray>();
+            row.add(step - 1);
+            row.add(true);
+            out.element(doc);
+            return true;
+        }
+        doc["total"] = 3;
+        out.members(doc);
+        return false;
+    });
+
+    size_t length = drain(writer, 5);
+    StaticJsonDocument<512> parsed;
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeMsgPack(parsed, output, length).code());
+    TEST_ASSERT_EQUAL(5, parsed["state"]);
+    TEST_ASSERT_EQUAL(42, parsed["uptime"]);
+    TEST_ASSERT_EQUAL(3, parsed["total"]);
+    TEST_ASSERT_EQUAL(3, parsed["leds"].size());
+    TEST_ASSERT_EQUAL(2, parsed["leds"][2][0]);
+
+    String json;
+    serializeJson(parsed, json);
+    TEST_ASSERT_EQUAL_STRING("{\"state\":5,\"uptime\":42,\"leds\":[[0,true],[1,true],[2,true]],\"total\":3}", json.c_str());
+}
+
+void test_wide_headers() {
+    // 20 entries need map16/array16 headers rather than the fix forms
+    MsgPackChunkWriter writer([](MsgPackChunkWriter& out, size_t step) {
+        if (step == 0) {
+            out.beginMap(nullptr, 1);
+            out.beginArray("logs", 20);
+            return true;
+        }
+        StaticJsonDocument<64> doc;
+        doc["n"] = step;
+        out.element(doc);
+        return step < 20;
+    });
+
+    size_t length = drain(writer, 3);
+    TEST_ASSERT_EQUAL_HEX8(0x81, output[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xdc, output[6]);
+    DynamicJsonDocument parsed(2048);
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeMsgPack(parsed, output, length).code());
+    TEST_ASSERT_EQUAL(20, parsed["logs"].size());
+    TEST_ASSERT_EQUAL(20, parsed["logs"][19]["n"]);
+
+    StaticJsonDocument<512> many;
+    for (int i = 0; i < 20; i++) {
+        many[String("k") + i] = i;
+    }
+    TEST_ASSERT_EQUAL(3, MsgPackChunkWriter::headerSize(many.size()));
+    TEST_ASSERT_EQUAL(1, MsgPackChunkWriter::headerSize(15));
+}
+
+void test_oversized_element_becomes_nil() {
+    MsgPackChunkWriter writer([](MsgPackChunkWriter& out, size_t step) {
+        DynamicJsonDocument doc(JSON_STREAM_FRAGMENT_SIZE * 2);
+        String big;
+        while (big.length() < JSON_STREAM_FRAGMENT_SIZE) {
+            big += "0123456789";
+        }
+        doc["message"] = big;
+        out.beginArray(nullptr, 1);
+        out.element(doc);
+        return false;
+    });
+
+    TEST_ASSERT_EQUAL(2, drain(writer, 16));
+    TEST_ASSERT_EQUAL_HEX8(0x91, output[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xc0, output[1]);
+    TEST_ASSERT_EQUAL(1, writer.dropped());
+}
+
+void test_oversized_members_keep_their_keys() {
+    MsgPackChunkWriter writer([](MsgPackChunkWriter& out, size_t step) {
+        DynamicJsonDocument doc(JSON_STREAM_FRAGMENT_SIZE * 2);
+        String big;
+        while (big.length() < JSON_STREAM_FRAGMENT_SIZE) {
+            big += "0123456789";
+        }
+        doc["message"] = big;
+        out.beginMap(nullptr, doc.size());
+        out.members(doc);
+        return false;
+    });
+
+    // The map still holds the member it declared: {"message": nil}
+    TEST_ASSERT_EQUAL(10, drain(writer, 16));
+    TEST_ASSERT_EQUAL_HEX8(0x81, output[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xa7, output[1]);
+    TEST_ASSERT_EQUAL(0, memcmp(output + 2, "message", 7));
+    TEST_ASSERT_EQUAL_HEX8(0xc0, output[9]);
+    TEST_ASSERT_EQUAL(1, writer.dropped());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_streams_map_with_rows);
+    RUN_TEST(test_wide_headers);
+    RUN_TEST(test_oversized_element_becomes_nil);
+    RUN_TEST(test_oversized_members_keep_their_keys);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,149 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/presence_client.h"
+#include "../include/alloc_counter.h"
+
+static PresenceResponse response;
+
+static const char* BODY =
+    "{\"@odata.context\":\"https://graph.microsoft.com/v1.0/$metadata#users('1f2e')/presence/$entity\","
+    "\"id\":\"1f2e\",\"availability\":\"Busy\",\"activity\":\"InAMeeting\",\"statusMessage\":null}";
+
+// Feeds text in pieces of at most step bytes, as it would come off the socket
+static void feed(const char* text, size_t step) {
+    size_t length = strlen(text);
+    for (size_t offset = 0; offset < length && !response.done() && !response.failed(); offset += step) {
+        response.feed(text + offset, min(step, length - offset));
+    }
+}
+
+void setUp(void) {
+    response.reset();
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_content_length_response() {
+    char text[512];
+    snprintf(text, sizeof(text), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %u\r\n\r\n%s",
+             (unsigned)strlen(BODY), BODY);
+    feed(text, sizeof(text));
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_EQUAL(200, response.status());
+    TEST_ASSERT_TRUE(response.keepAlive());
+    TEST_ASSERT_EQUAL_STRING(BODY, response.body());
+    TEST_ASSERT_FALSE(response.truncated());
+}
+
+void test_chunked_response_byte_by_byte() {
+    feed("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+         "4\r\n{\"av\r\n"
+         "a;ext=1\r\nailability\r\n"
+         "9\r\n\":\"Away\"}\r\n"
+         "0\r\n\r\n", 1);
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_EQUAL_STRING("{\"availability\":\"Away\"}", response.body());
+    TEST_ASSERT_TRUE(response.keepAlive());
+}
+
+void test_body_until_close() {
+    feed("HTTP/1.0 200 OK\r\n\r\n{}", 4);
+    TEST_ASSERT_FALSE(response.done());
+    response.finish();
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_FALSE(response.keepAlive());
+    TEST_ASSERT_EQUAL_STRING("{}", response.body());
+}
+
+void test_error_response_keeps_connection() {
+    feed("HTTP/1.1 401 Unauthorized\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n", 7);
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_EQUAL(401, response.status());
+    TEST_ASSERT_TRUE(response.keepAlive());
+
+    response.reset();
+    feed("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 2\r\n\r\n{}", 64);
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_FALSE(response.keepAlive());
+}
+
+void test_oversized_body_is_read_to_its_end() {
+    static char text[PRESENCE_BODY_SIZE + 128];
+    int head = snprintf(text, sizeof(text), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", PRESENCE_BODY_SIZE + 10);
+    memset(text + head, 'x', PRESENCE_BODY_SIZE + 10);
+    text[head + PRESENCE_BODY_SIZE + 10] = '\0';
+    feed(text, 100);
+    TEST_ASSERT_TRUE(response.done());
+    TEST_ASSERT_TRUE(response.truncated());
+    TEST_ASSERT_EQUAL(PRESENCE_BODY_SIZE, response.bodyLength());
+}
+
+void test_malformed_responses_fail() {
+    feed("HTTP/2 200\r\n\r\n", 64);
+    TEST_ASSERT_TRUE(response.failed());
+
+    response.reset();
+    feed("HTTP/1.1 200 OK\r\nno colon here\r\n\r\n", 64);
+    TEST_ASSERT_TRUE(response.failed());
+
+    response.reset();
+    feed("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n{}", 64);
+    response.finish();
+    TEST_ASSERT_TRUE(response.failed());
+}
+
+void test_parse_presence() {
+    GraphPresence presence;
+    TEST_ASSERT_FALSE(PresenceResponse::parsePresence(BODY, strlen(BODY), presence));
+    TEST_ASSERT_EQUAL_STRING("Busy", presence.availability);
+    TEST_ASSERT_EQUAL_STRING("InAMeeting", presence.activity);
+
+    TEST_ASSERT_FALSE(PresenceResponse::parsePresence("{\"id\":\"1f2e\"}", 13, presence));
+    TEST_ASSERT_EQUAL_STRING("", presence.availability);
+    TEST_ASSERT_TRUE(PresenceResponse::parsePresence("{\"availability\":", 16, presence));
+}
+
+void test_poll_response_makes_no_allocations() {
+    if (!AllocCounter::enabled()) {
+        TEST_IGNORE_MESSAGE("needs the esp32dev_alloccheck environment");
+    }
+    char text[512];
+    snprintf(text, sizeof(text), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n%x\r\n%s\r\n0\r\n\r\n",
+             (unsigned)strlen(BODY), BODY);
+
+    // The counter must see a String, or a zero below proves nothing
+    AllocWindow check;
+    String copy = BODY;
+    TEST_ASSERT_GREATER_THAN(0, check.allocations());
+
+    AllocWindow window;
+    feed(text, 64);
+    GraphPresence presence;
+    DeserializationError error = PresenceResponse::parsePresence(response.body(), response.bodyLength(), presence);
+    TEST_ASSERT_EQUAL(0, window.allocations());
+    TEST_ASSERT_FALSE(error);
+    TEST_ASSERT_EQUAL_STRING("InAMeeting", presence.activity);
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_content_length_response);
+    RUN_TEST(test_chunked_response_byte_by_byte);
+    RUN_TEST(test_body_until_close);
+    RUN_TEST(test_error_response_keeps_connection);
+    RUN_TEST(test_oversized_body_is_read_to_its_end);
+    RUN_TEST(test_malformed_responses_fail);
+    RUN_TEST(test_parse_presence);
+    RUN_TEST(test_poll_response_makes_no_allocations);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,91 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/presence_log.h"
+#include "../include/alloc_counter.h"
+
+static PresenceLogEntry entry(time_t timestamp, TeamsPresence presence, const char* name) {
+    PresenceLogEntry log = {};
+    log.timestamp = timestamp;
+    log.presence = presence;
+    strlcpy(log.presenceString, name, sizeof(log.presenceString));
+    return log;
+}
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_record_matches_saved_format() {
+    char record[PRESENCE_LOG_RECORD_SIZE];
+    size_t length = formatPresenceLog(entry(1760000000, PRESENCE_IN_MEETING, "In Meeting"), record);
+    TEST_ASSERT_EQUAL_STRING("1760000000,3,In Meeting", record);
+    TEST_ASSERT_EQUAL(strlen(record), length);
+
+    char key[PRESENCE_LOG_KEY_SIZE];
+    presenceLogKey(49, key);
+    TEST_ASSERT_EQUAL_STRING("pres_log_49", key);
+}
+
+void test_record_round_trip() {
+    char record[PRESENCE_LOG_RECORD_SIZE];
+    formatPresenceLog(entry(1760000123, PRESENCE_AWAY, "Away"), record);
+
+    PresenceLogEntry loaded = {};
+    TEST_ASSERT_TRUE(parsePresenceLog(record, loaded));
+    TEST_ASSERT_EQUAL(1760000123, loaded.timestamp);
+    TEST_ASSERT_EQUAL(PRESENCE_AWAY, loaded.presence);
+    TEST_ASSERT_EQUAL_STRING("Away", loaded.presenceString);
+}
+
+void test_malformed_records_leave_entry_alone() {
+    PresenceLogEntry loaded = entry(5, PRESENCE_BUSY, "Busy");
+    TEST_ASSERT_FALSE(parsePresenceLog("", loaded));
+    TEST_ASSERT_FALSE(parsePresenceLog(",2,Busy", loaded));
+    TEST_ASSERT_FALSE(parsePresenceLog("1760000000,Busy", loaded));
+    TEST_ASSERT_FALSE(parsePresenceLog("1760000000;2;Busy", loaded));
+    TEST_ASSERT_EQUAL(5, loaded.timestamp);
+    TEST_ASSERT_EQUAL_STRING("Busy", loaded.presenceString);
+}
+
+void test_saving_history_makes_no_allocations() {
+    if (!AllocCounter::enabled()) {
+        TEST_IGNORE_MESSAGE("needs the esp32dev_alloccheck environment");
+    }
+    static PresenceLogEntry history[MAX_PRESENCE_LOGS];
+    for (int i = 0; i < MAX_PRESENCE_LOGS; i++) {
+        history[i] = entry(1760000000 + i * 60, PRESENCE_AVAILABLE, "Available");
+    }
+
+    AllocWindow window;
+    char key[PRESENCE_LOG_KEY_SIZE];
+    char record[PRESENCE_LOG_RECORD_SIZE];
+    PresenceLogEntry loaded;
+    for (uint8_t i = 0; i < MAX_PRESENCE_LOGS; i++) {
+        presenceLogKey(i, key);
+        formatPresenceLog(history[i], record);
+        parsePresenceLog(record, loaded);
+    }
+    TEST_ASSERT_EQUAL(0, window.allocations());
+    TEST_ASSERT_EQUAL(history[MAX_PRESENCE_LOGS - 1].timestamp, loaded.timestamp);
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_record_matches_saved_format);
+    RUN_TEST(test_record_round_trip);
+    RUN_TEST(test_malformed_records_leave_entry_alone);
+    RUN_TEST(test_saving_history_makes_no_allocations);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
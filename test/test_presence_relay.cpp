@@ -0,0 +1,89 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/presence_relay.h"
+
+static SseParser parser;
+static String lastEvent;
+static String lastData;
+static int eventCount;
+
+static void feed(const char* input) {
+    for (const char* c = input; *c; c++) {
+        parser.feed(*c, [](const char* event, const char* data) {
+            lastEvent = event;
+            lastData = data;
+            eventCount++;
+        });
+    }
+}
+
+void setUp(void) {
+    parser.reset();
+    lastEvent = "";
+    lastData = "";
+    eventCount = 0;
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_presence_event_dispatched() {
+    feed("event: presence\ndata: {\"availability\":\"Busy\",\"activity\":\"InACall\"}\n\n");
+    TEST_ASSERT_EQUAL(1, eventCount);
+    TEST_ASSERT_EQUAL_STRING("presence", lastEvent.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"availability\":\"Busy\",\"activity\":\"InACall\"}", lastData.c_str());
+}
+
+void test_heartbeat_comments_ignored() {
+    feed(": keepalive\n\n: keepalive\n\n");
+    TEST_ASSERT_EQUAL(0, eventCount);
+}
+
+void test_crlf_and_default_event_name() {
+    feed("data: hello\r\n\r\n");
+    TEST_ASSERT_EQUAL(1, eventCount);
+    TEST_ASSERT_EQUAL_STRING("message", lastEvent.c_str());
+    TEST_ASSERT_EQUAL_STRING("hello", lastData.c_str());
+}
+
+void test_multiline_data_joined() {
+    feed("event: presence\ndata: first\ndata: second\n\n");
+    TEST_ASSERT_EQUAL_STRING("first\nsecond", lastData.c_str());
+}
+
+void test_event_name_resets_between_events() {
+    feed("event: presence\ndata: a\n\ndata: b\n\n");
+    TEST_ASSERT_EQUAL(2, eventCount);
+    TEST_ASSERT_EQUAL_STRING("message", lastEvent.c_str());
+}
+
+void test_overlong_data_truncated() {
+    String longLine = "data: ";
+    for (int i = 0; i < RELAY_LINE_MAX * 2; i++) {
+        longLine += 'x';
+    }
+    longLine += "\n\n";
+    feed(longLine.c_str());
+    TEST_ASSERT_EQUAL(1, eventCount);
+    TEST_ASSERT_TRUE(lastData.length() < RELAY_LINE_MAX);
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_presence_event_dispatched);
+    RUN_TEST(test_heartbeat_comments_ignored);
+    RUN_TEST(test_crlf_and_default_event_name);
+    RUN_TEST(test_multiline_data_joined);
+    RUN_TEST(test_event_name_resets_between_events);
+    RUN_TEST(test_overlong_data_truncated);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/scratch_arena.h"
+
+static uint8_t memory[256] __attribute__((aligned(4)));
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_pool_lends_each_arena_once() {
+    ScratchArena* lent[SCRATCH_ARENA_COUNT];
+    for (int i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        lent[i] = ScratchArena::borrow();
+        TEST_ASSERT_NOT_NULL(lent[i]);
+    }
+    TEST_ASSERT_NULL(ScratchArena::borrow());
+    TEST_ASSERT_EQUAL(0, ScratchArena::available());
+
+    lent[1]->allocate(100);
+    ScratchArena::release(lent[1]);
+    ScratchArena* again = ScratchArena::borrow();
+    TEST_ASSERT_EQUAL_PTR(lent[1], again);
+    TEST_ASSERT_EQUAL(0, again->used());
+
+    ScratchArena::release(again);
+    for (int i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        if (i != 1) {
+            ScratchArena::release(lent[i]);
+        }
+    }
+    TEST_ASSERT_EQUAL(SCRATCH_ARENA_COUNT, ScratchArena::available());
+}
+
+void test_scope_returns_its_arena() {
+    {
+        ScratchScope scope;
+        TEST_ASSERT_NOT_NULL(scope.get());
+        TEST_ASSERT_EQUAL(SCRATCH_ARENA_COUNT - 1, ScratchArena::available());
+    }
+    TEST_ASSERT_EQUAL(SCRATCH_ARENA_COUNT, ScratchArena::available());
+}
+
+void test_allocations_are_aligned_and_bounded() {
+    ScratchArena arena(memory, sizeof(memory));
+    uint8_t* first = (uint8_t*)arena.allocate(3);
+    uint8_t* second = (uint8_t*)arena.allocate(4);
+    TEST_ASSERT_EQUAL_PTR(memory, first);
+    TEST_ASSERT_EQUAL_PTR(memory + 4, second);
+    TEST_ASSERT_EQUAL(8, arena.used());
+    TEST_ASSERT_NULL(arena.allocate(sizeof(memory)));
+
+    arena.reset();
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL(8, arena.highWater());
+}
+
+void test_string_grows_in_place() {
+    ScratchArena arena(memory, sizeof(memory));
+    ScratchString header(&arena, 8);
+    header.append("Bearer ");
+    for (int i = 0; i < 20; i++) {
+        header.append("eyJ0eXAi");
+    }
+    TEST_ASSERT_EQUAL(7 + 160, header.length());
+    TEST_ASSERT_EQUAL(7 + 160 + 1, arena.used());
+    TEST_ASSERT_FALSE(header.onHeap());
+    TEST_ASSERT_EQUAL(0, strncmp(header.c_str(), "Bearer eyJ0eXAi", 15));
+}
+
+void test_string_moves_past_newer_blocks() {
+    ScratchArena arena(memory, sizeof(memory));
+    ScratchString url(&arena, 4);
+    url.append("/v1");
+    ScratchString body(&arena, 4);
+    body.append("client_id=");
+    url.append(".0/me/presence");
+    body.append("abc");
+    TEST_ASSERT_EQUAL_STRING("/v1.0/me/presence", url.c_str());
+    TEST_ASSERT_EQUAL_STRING("client_id=abc", body.c_str());
+    TEST_ASSERT_FALSE(url.onHeap());
+}
+
+void test_string_falls_back_to_heap() {
+    uint32_t before = ScratchArena::fallbacks();
+    ScratchArena arena(memory, sizeof(memory));
+    ScratchString big(&arena, 16);
+    for (int i = 0; i < 40; i++) {
+        big.appendf("%02d--------", i);
+    }
+    TEST_ASSERT_TRUE(big.onHeap());
+    TEST_ASSERT_FALSE(big.truncated());
+    TEST_ASSERT_EQUAL(400, big.length());
+    TEST_ASSERT_EQUAL(0, strncmp(big.c_str() + 390, "39--------", 10));
+    TEST_ASSERT_EQUAL(before + 1, ScratchArena::fallbacks());
+
+    ScratchString orphan((ScratchArena*)nullptr);
+    orphan.append("no arena");
+    TEST_ASSERT_TRUE(orphan.onHeap());
+    TEST_ASSERT_EQUAL_STRING("no arena", orphan.c_str());
+}
+
+void test_appendf() {
+    ScratchArena arena(memory, sizeof(memory));
+    ScratchString text(&arena, 4);
+    text.append("maxpagesize=").appendf("%d", 50).append('&');
+    TEST_ASSERT_EQUAL_STRING("maxpagesize=50&", text.c_str());
+    text.clear();
+    TEST_ASSERT_EQUAL_STRING("", text.c_str());
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pool_lends_each_arena_once);
+    RUN_TEST(test_scope_returns_its_arena);
+    RUN_TEST(test_allocations_are_aligned_and_bounded);
+    RUN_TEST(test_string_grows_in_place);
+    RUN_TEST(test_string_moves_past_newer_blocks);
+    RUN_TEST(test_string_falls_back_to_heap);
+    RUN_TEST(test_appendf);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,95 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/status_board.h"
+
+static BoardMember members[BOARD_MAX_MEMBERS];
+
+void setUp(void) {
+    memset(members, 0, sizeof(members));
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_object_id_detection() {
+    TEST_ASSERT_TRUE(StatusBoard::isObjectId("fa8bf3dc-eca7-46b7-bad1-db199b62afc3"));
+    TEST_ASSERT_TRUE(StatusBoard::isObjectId("FA8BF3DC-ECA7-46B7-BAD1-DB199B62AFC3"));
+    TEST_ASSERT_FALSE(StatusBoard::isObjectId("alice@company.com"));
+    TEST_ASSERT_FALSE(StatusBoard::isObjectId("fa8bf3dceeca7-46b7-bad1-db199b62afc3"));
+    TEST_ASSERT_FALSE(StatusBoard::isObjectId("fa8bf3dc-eca7-46b7-bad1-db199b62afcg"));
+    TEST_ASSERT_FALSE(StatusBoard::isObjectId(""));
+}
+
+void test_roster_separators_and_whitespace() {
+    uint8_t count = StatusBoard::parseRoster(" alice@company.com,bob@company.com\n carol@company.com ;; \n", members, BOARD_MAX_MEMBERS);
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL_STRING("alice@company.com", members[0].upn);
+    TEST_ASSERT_EQUAL_STRING("bob@company.com", members[1].upn);
+    TEST_ASSERT_EQUAL_STRING("carol@company.com", members[2].upn);
+}
+
+void test_roster_object_ids_skip_resolution() {
+    uint8_t count = StatusBoard::parseRoster("fa8bf3dc-eca7-46b7-bad1-db199b62afc3, dave@company.com", members, BOARD_MAX_MEMBERS);
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_STRING("fa8bf3dc-eca7-46b7-bad1-db199b62afc3", members[0].id);
+    TEST_ASSERT_EQUAL_STRING("", members[1].id);
+    TEST_ASSERT_EQUAL(PRESENCE_UNKNOWN, members[1].presence);
+}
+
+void test_roster_truncated_to_capacity() {
+    uint8_t count = StatusBoard::parseRoster("a@x.com,b@x.com,c@x.com", members, 2);
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_STRING("b@x.com", members[1].upn);
+}
+
+void test_roster_skips_overlong_entries() {
+    String roster = "";
+    for (int i = 0; i < BOARD_UPN_LEN; i++) {
+        roster += 'x';
+    }
+    roster += "@company.com,erin@company.com";
+    uint8_t count = StatusBoard::parseRoster(roster, members, BOARD_MAX_MEMBERS);
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_EQUAL_STRING("erin@company.com", members[0].upn);
+}
+
+void test_disabled_without_specific_tenant() {
+    StatusBoard board;
+    board.begin("client", "secret", "common", "alice@company.com", nullptr);
+    TEST_ASSERT_FALSE(board.isEnabled());
+    TEST_ASSERT_EQUAL(-1, board.poll());
+
+    board.begin("client", "secret", "contoso.onmicrosoft.com", "alice@company.com", nullptr);
+    TEST_ASSERT_TRUE(board.isEnabled());
+    TEST_ASSERT_EQUAL(1, board.memberCount());
+    TEST_ASSERT_EQUAL(PRESENCE_UNKNOWN, board.presenceAt(5));
+}
+
+void test_resolve_retry_backs_off() {
+    TEST_ASSERT_EQUAL(BOARD_RESOLVE_RETRY, StatusBoard::resolveRetryDelay(1));
+    TEST_ASSERT_EQUAL(BOARD_RESOLVE_RETRY * 2, StatusBoard::resolveRetryDelay(2));
+    TEST_ASSERT_EQUAL(BOARD_RESOLVE_RETRY * 4, StatusBoard::resolveRetryDelay(3));
+    TEST_ASSERT_EQUAL(BOARD_RESOLVE_MAX_RETRY, StatusBoard::resolveRetryDelay(40));
+    TEST_ASSERT_EQUAL(BOARD_RESOLVE_MAX_RETRY, StatusBoard::resolveRetryDelay(UINT8_MAX));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_object_id_detection);
+    RUN_TEST(test_roster_separators_and_whitespace);
+    RUN_TEST(test_roster_object_ids_skip_resolution);
+    RUN_TEST(test_roster_truncated_to_capacity);
+    RUN_TEST(test_roster_skips_overlong_entries);
+    RUN_TEST(test_disabled_without_specific_tenant);
+    RUN_TEST(test_resolve_retry_backs_off);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
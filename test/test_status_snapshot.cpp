@@ -0,0 +1,74 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "../include/status_snapshot.h"
+
+void setUp(void) {
+    // Set up before each test
+}
+
+void tearDown(void) {
+    // Clean up after each test
+}
+
+void test_fingerprint_depends_on_values_and_order() {
+    uint32_t a = Fingerprint().add(1).add("Busy").value();
+    uint32_t b = Fingerprint().add(1).add("Busy").value();
+    uint32_t c = Fingerprint().add(2).add("Busy").value();
+    TEST_ASSERT_EQUAL_UINT32(a, b);
+    TEST_ASSERT_NOT_EQUAL(a, c);
+
+    // String boundaries are part of the hash
+    TEST_ASSERT_NOT_EQUAL(Fingerprint().add("ab").add("c").value(), Fingerprint().add("a").add("bc").value());
+}
+
+void test_publish_only_when_fingerprint_changes() {
+    StatusSnapshot snapshot;
+    snapshot.begin(0x1234);
+    TEST_ASSERT_TRUE(snapshot.stale(42));
+    TEST_ASSERT_FALSE(snapshot.current());
+
+    snapshot.publish(42, "{\"state\":\"monitoring\"}");
+    TEST_ASSERT_FALSE(snapshot.stale(42));
+    TEST_ASSERT_TRUE(snapshot.stale(43));
+    TEST_ASSERT_EQUAL_STRING("{\"state\":\"monitoring\"}", snapshot.current()->body.c_str());
+    TEST_ASSERT_EQUAL_STRING("\"00001234-1\"", snapshot.current()->etag);
+}
+
+void test_old_entry_survives_republish() {
+    StatusSnapshot snapshot;
+    snapshot.publish(1, "{\"v\":1}");
+    std::shared_ptr<const SnapshotEntry> inFlight = snapshot.current();
+
+    snapshot.publish(2, "{\"v\":2}");
+    TEST_ASSERT_EQUAL_STRING("{\"v\":1}", inFlight->body.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"v\":2}", snapshot.current()->body.c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, snapshot.version());
+}
+
+void test_etag_matching() {
+    const char* etag = "\"00001234-7\"";
+    TEST_ASSERT_TRUE(StatusSnapshot::etagMatches("\"00001234-7\"", etag));
+    TEST_ASSERT_TRUE(StatusSnapshot::etagMatches("W/\"00001234-7\"", etag));
+    TEST_ASSERT_TRUE(StatusSnapshot::etagMatches("\"abc\", \"00001234-7\"", etag));
+    TEST_ASSERT_TRUE(StatusSnapshot::etagMatches("*", etag));
+    TEST_ASSERT_FALSE(StatusSnapshot::etagMatches("\"00001234-6\"", etag));
+    TEST_ASSERT_FALSE(StatusSnapshot::etagMatches("\"00001234-7", etag));
+    TEST_ASSERT_FALSE(StatusSnapshot::etagMatches("", etag));
+}
+
+void setup() {
+    delay(2000); // Wait for serial monitor
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fingerprint_depends_on_values_and_order);
+    RUN_TEST(test_publish_only_when_fingerprint_changes);
+    RUN_TEST(test_old_entry_survives_republish);
+    RUN_TEST(test_etag_matching);
+
+    UNITY_END();
+}
+
+void loop() {
+    // Empty loop for testing
+}
@@ -0,0 +1,117 @@
+// Configuration page: the form is static, current values come from /api/config
+
+var PATTERNS = ['Off', 'Solid', 'Slow Blink (1s)', 'Medium Blink (0.5s)', 'Fast Blink (0.2s)', 'Double Blink', 'Dim Solid'];
+
+// [form field prefix, label, default pattern, help text]
+var LED_STATES = [
+  ['led_call_', 'Call Pattern', 4, '&#x1F4F5; Pattern during calls (busy status)'],
+  ['led_meeting_', 'Meeting Pattern', 1, '&#x1F4C5; Pattern during meetings'],
+  ['led_available_', 'Available Pattern', 0, '&#x1F7E2; Pattern when available'],
+  ['led_away_', 'Away Pattern', 0, '&#x1F530; Pattern when away'],
+  ['led_offline_', 'Offline Pattern', 0, '&#x1F534; Pattern when offline']
+];
+var LED_STATE_KEYS = ['call', 'meeting', 'available', 'away', 'offline'];
+
+function byId(id) {
+  return document.getElementById(id);
+}
+
+function option(value, text, selected) {
+  var element = document.createElement('option');
+  element.value = value;
+  element.textContent = text;
+  element.selected = selected;
+  return element;
+}
+
+function formGroup(id, label, control, help) {
+  var group = document.createElement('div');
+  group.className = 'form-group';
+  var labelElement = document.createElement('label');
+  labelElement.htmlFor = id;
+  labelElement.textContent = label;
+  var helpElement = document.createElement('div');
+  helpElement.className = 'help';
+  helpElement.innerHTML = help;
+  group.appendChild(labelElement);
+  group.appendChild(control);
+  group.appendChild(helpElement);
+  return group;
+}
+
+function select(id, options) {
+  var element = document.createElement('select');
+  element.id = id;
+  element.name = id;
+  options.forEach(function (o) { element.appendChild(o); });
+  return element;
+}
+
+function buildLedSection(index, led, gpioPins, defaultPin) {
+  var section = document.createElement('div');
+  section.className = 'led-config';
+  section.id = 'led_config_' + index;
+  var title = document.createElement('h4');
+  title.textContent = 'LED ' + (index + 1) + ' Configuration';
+  section.appendChild(title);
+
+  var pin = led ? led.pin : defaultPin;
+  var pinOptions = gpioPins.map(function (p) { return option(p, 'GPIO ' + p, p === pin); });
+  section.appendChild(formGroup('led_pin_' + index, 'GPIO Pin', select('led_pin_' + index, pinOptions), '&#x1F50C; Select GPIO pin for this LED'));
+
+  LED_STATES.forEach(function (state, stateIndex) {
+    var current = led ? led[LED_STATE_KEYS[stateIndex]] : state[2];
+    var patternOptions = PATTERNS.map(function (name, value) {
+      return option(value, name + (value === state[2] ? ' (Default)' : ''), value === current);
+    });
+    section.appendChild(formGroup(state[0] + index, state[1], select(state[0] + index, patternOptions), state[3]));
+  });
+  return section;
+}
+
+function updateLEDFields() {
+  var count = parseInt(byId('led_count').value, 10);
+  var sections = byId('led_configurations').children;
+  for (var i = 0; i < sections.length; i++) {
+    sections[i].style.display = i < count ? 'block' : 'none';
+  }
+}
+
+function renderConfig(config) {
+  ['wifi_ssid', 'user_email', 'tenant_id', 'client_id', 'relay_url', 'board_roster', 'push_ttl', 'ota_url'].forEach(function (field) {
+    if (config[field] !== undefined) {
+      byId(field).value = config[field];
+    }
+  });
+  byId('board_mode').checked = !!config.board_mode;
+  byId('board_max_members').textContent = config.board_max_members;
+  byId('push_ttl').max = config.push_max_ttl;
+  if (config.has_client_secret) {
+    byId('client_secret').placeholder = '(configured)';
+  }
+  if (config.has_relay_key) {
+    byId('relay_key').placeholder = '(configured)';
+  }
+  if (config.has_push_api_key) {
+    byId('push_api_key').placeholder = '(hidden; generate a new key to see one)';
+  }
+
+  var ledCount = byId('led_count');
+  for (var i = 1; i <= config.max_leds; i++) {
+    ledCount.appendChild(option(i, i + ' LED' + (i > 1 ? 's' : ''), i === config.led_count));
+  }
+
+  var container = byId('led_configurations');
+  for (var j = 0; j < config.max_leds; j++) {
+    container.appendChild(buildLedSection(j, config.leds[j], config.gpio_pins, config.default_pin));
+  }
+  updateLEDFields();
+}
+
+byId('led_count').addEventListener('change', updateLEDFields);
+
+fetch('/api/config').then(function (response) {
+  return response.json();
+}).then(renderConfig).catch(function () {
+  alert('Failed to load the current configuration. Please reload the page.');
+});
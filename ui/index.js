@@ -0,0 +1,181 @@
+// Dashboard: all device data comes from the JSON APIs. Changes are pushed over
+// /events; /api/snapshot is polled only while that channel is down.
+
+var POLL_INTERVAL = 10000;
+var HEARTBEAT_TIMEOUT = 40000;  // Device pings every 15 s when nothing changes
+
+var PRESENCE_COLORS = {
+  'Available': '#28a745',
+  'Busy': '#ffc107',
+  'In Meeting': '#dc3545',
+  'Away': '#6c757d',
+  'Offline': '#6c757d'
+};
+
+var lastStatus = {};
+var presenceLogs = [];
+var pollTimer = null;
+var heartbeatTimer = null;
+
+function byId(id) {
+  return document.getElementById(id);
+}
+
+function showStatus(cssClass, icon, text, detail) {
+  var statusDiv = byId('status');
+  statusDiv.className = 'status-card ' + cssClass;
+  statusDiv.innerHTML = '<span class="status-icon">' + icon + '</span><div class="status-text"></div><div class="status-detail"></div>';
+  statusDiv.querySelector('.status-text').textContent = text;
+  statusDiv.querySelector('.status-detail').textContent = detail;
+}
+
+function renderStatus(data) {
+  if (data.state === 'monitoring') {
+    showStatus('connected', '&#x2705;', 'Connected & Monitoring', 'Teams presence: ' + (data.presence || 'Unknown'));
+  } else if (data.state === 'ap_mode') {
+    showStatus('configuring', '&#x2699;&#xFE0F;', 'Configuration Mode', 'Please configure WiFi and Teams settings');
+  } else if (data.state === 'connecting_wifi') {
+    showStatus('configuring', '&#x1F4F6;', 'Connecting to WiFi', 'Establishing network connection...');
+  } else if (data.state === 'connecting_oauth' || data.state === 'device_code_pending') {
+    showStatus('configuring', '&#x1F510;', 'Waiting for Authentication', 'Complete Microsoft Teams authentication');
+  } else {
+    showStatus('disconnected', '&#x274C;', 'Disconnected', data.message || 'Not connected');
+  }
+
+  if (data.ip_address || data.uptime || data.wifi_connected !== undefined || data.time_configured) {
+    byId('deviceInfo').classList.remove('hidden');
+    byId('ipAddress').textContent = data.ip_address ? 'IP Address: ' + data.ip_address : '';
+    byId('uptime').textContent = data.uptime ? 'Uptime: ' + Math.floor(data.uptime / 60) + ' minutes' : '';
+    byId('wifiStatus').textContent = data.wifi_connected !== undefined ? 'WiFi: ' + (data.wifi_connected ? 'Connected' : 'Disconnected') : '';
+    if (data.time_configured && data.current_time) {
+      var totalOffset = (data.timezone_offset || 0) + (data.daylight_offset || 0);
+      byId('currentTime').textContent = 'Time: ' + data.current_time;
+      byId('timezone').textContent = 'Timezone: UTC' + (totalOffset >= 0 ? '+' : '') + totalOffset;
+    } else {
+      byId('currentTime').textContent = 'Time: Not synchronized';
+      byId('timezone').textContent = 'Timezone: Not configured';
+    }
+  }
+}
+
+function renderPresenceHistory(data) {
+  var presenceHistory = byId('presenceHistory');
+  var presenceList = byId('presenceList');
+  if (!data.logs || data.logs.length === 0) {
+    presenceHistory.classList.add('hidden');
+    return;
+  }
+
+  presenceLogs = data.logs;
+  presenceHistory.classList.remove('hidden');
+  presenceList.innerHTML = '';
+  data.logs.slice(-10).reverse().forEach(function (log) {
+    var entry = document.createElement('div');
+    entry.className = 'presence-entry';
+    var presence = document.createElement('span');
+    presence.style.color = PRESENCE_COLORS[log.presence] || '#6c757d';
+    presence.textContent = log.presence;
+    var time = document.createElement('span');
+    time.className = 'time';
+    time.textContent = log.timestamp;
+    entry.appendChild(presence);
+    entry.appendChild(time);
+    presenceList.appendChild(entry);
+  });
+}
+
+// Status and presence history in one request; unchanged data comes back as 304
+function checkStatus() {
+  fetch('/api/snapshot').then(function (response) {
+    return response.json();
+  }).then(function (data) {
+    lastStatus = data.status;
+    renderStatus(data.status);
+    if (data.status.state === 'monitoring') {
+      renderPresenceHistory(data.presence_history);
+    }
+  }).catch(function () {
+    showStatus('disconnected', '&#x26A0;&#xFE0F;', 'Connection Error', 'Unable to get device status');
+  });
+}
+
+function startPolling() {
+  if (!pollTimer) {
+    pollTimer = setInterval(checkStatus, POLL_INTERVAL);
+  }
+}
+
+function stopPolling() {
+  clearInterval(pollTimer);
+  pollTimer = null;
+}
+
+// Any event proves the channel is alive; silence past the timeout means it is not
+function channelAlive() {
+  stopPolling();
+  clearTimeout(heartbeatTimer);
+  heartbeatTimer = setTimeout(startPolling, HEARTBEAT_TIMEOUT);
+}
+
+function applyStatusDelta(event) {
+  var delta = JSON.parse(event.data);
+  var stateChanged = delta.state !== undefined && delta.state !== lastStatus.state;
+  Object.keys(delta).forEach(function (key) {
+    lastStatus[key] = delta[key];
+  });
+  channelAlive();
+  if (stateChanged) {
+    // Messages, device code and time details come with the full status
+    checkStatus();
+  } else {
+    renderStatus(lastStatus);
+  }
+}
+
+function appendPresenceLog(event) {
+  presenceLogs.push(JSON.parse(event.data));
+  presenceLogs = presenceLogs.slice(-10);
+  channelAlive();
+  renderPresenceHistory({ logs: presenceLogs });
+}
+
+function connectEvents() {
+  if (!window.EventSource) {
+    startPolling();
+    return;
+  }
+  var source = new EventSource('/events');
+  source.addEventListener('hello', function () {
+    // Catch up on anything missed while disconnected, then rely on pushes
+    channelAlive();
+    checkStatus();
+  });
+  source.addEventListener('status', applyStatusDelta);
+  source.addEventListener('presence', appendPresenceLog);
+  source.addEventListener('ping', function (event) {
+    lastStatus.uptime = JSON.parse(event.data).uptime;
+    channelAlive();
+    renderStatus(lastStatus);
+  });
+  source.onerror = function () {
+    // EventSource reconnects by itself; poll until it does
+    startPolling();
+  };
+}
+
+function restartDevice() {
+  if (!confirm('Are you sure you want to restart the device? This will temporarily interrupt monitoring.')) {
+    return;
+  }
+  fetch('/restart', { method: 'POST' }).then(function () {
+    showStatus('configuring', '&#x1F504;', 'Restarting Device', 'Please wait 30 seconds...');
+    setTimeout(function () { location.reload(); }, 30000);
+  }).catch(function () {
+    alert('Failed to restart device. Please try again.');
+  });
+}
+
+byId('refreshButton').addEventListener('click', checkStatus);
+byId('restartButton').addEventListener('click', restartDevice);
+checkStatus();
+connectEvents();